@@ -211,7 +211,132 @@ static const GncGUID * gncEntryGetGUID(GncEntry *x);
 %include <gncIDSearch.h>
 
 // Commodity prices includes and stuff
+
+// gnc_pricedb_lookup_latest_before_matrix takes a list of commodities and a
+// list of dates (or integers) and returns a list with one list of
+// gnc_numeric values per commodity.
+%typemap(in) CommodityList *commodities {
+    int i, size;
+
+    if (!PyList_Check($input)) {
+        PyErr_SetString(PyExc_TypeError, "not a list");
+        return NULL;
+    }
+    $1 = NULL;
+    size = PyList_Size($input);
+    for (i = size-1; i >= 0; i--) {
+        void *commodity = NULL;
+        if (SWIG_ConvertPtr(PyList_GetItem($input, i), &commodity,
+                            SWIGTYPE_p_gnc_commodity, 0) == -1) {
+            PyErr_SetString(PyExc_TypeError, "list must contain commodities");
+            g_list_free($1);
+            return NULL;
+        }
+        $1 = g_list_prepend($1, commodity);
+    }
+}
+%typemap(freearg) CommodityList *commodities "g_list_free($1);"
+
+%typemap(in) (const time64 *dates, guint n_dates) {
+    int i;
+
+    PyDateTime_IMPORT;
+    if (!PyList_Check($input)) {
+        PyErr_SetString(PyExc_TypeError, "not a list");
+        return NULL;
+    }
+    $2 = PyList_Size($input);
+    $1 = g_new(time64, $2);
+    for (i = 0; i < $2; i++) {
+        PyObject *o = PyList_GetItem($input, i);
+        if (PyDate_Check(o)) {
+            struct tm time = {PyDateTime_DATE_GET_SECOND(o),
+                              PyDateTime_DATE_GET_MINUTE(o),
+                              PyDateTime_DATE_GET_HOUR(o),
+                              PyDateTime_GET_DAY(o),
+                              PyDateTime_GET_MONTH(o) - 1,
+                              PyDateTime_GET_YEAR(o) - 1900};
+            $1[i] = gnc_mktime(&time);
+        } else if (PyInt_Check(o)) {
+            $1[i] = PyInt_AsLong(o);
+        } else {
+            PyErr_SetString(PyExc_ValueError,"date, datetime or integer expected");
+            g_free($1);
+            return NULL;
+        }
+    }
+}
+%typemap(freearg) (const time64 *dates, guint n_dates) "g_free($1);"
+
+%typemap(out) GNCPriceMatrix * {
+    guint row, col;
+
+    $result = PyList_New(0);
+    for (row = 0; $1 && row < $1->n_commodities; row++) {
+        PyObject *values = PyList_New(0);
+        for (col = 0; col < $1->n_dates; col++) {
+            gnc_numeric *value = (gnc_numeric *) malloc(sizeof(gnc_numeric));
+            *value = gnc_price_matrix_get_value($1, row, col);
+            PyObject *o = SWIG_NewPointerObj(value, SWIGTYPE_p__gnc_numeric,
+                                             SWIG_POINTER_OWN);
+            PyList_Append(values, o);
+            Py_DECREF(o);
+        }
+        PyList_Append($result, values);
+        Py_DECREF(values);
+    }
+    gnc_price_matrix_free($1);
+}
+%ignore gnc_price_matrix_get_value;
+%ignore gnc_price_matrix_free;
+
+// Price samples are returned as a tuple of lists (times, values, min, max,
+// avg, counts), the last four being None for a plain range scan.
+%{
+static PyObject *
+price_samples_doubles_to_py (const double *values, guint len)
+{
+    PyObject *list;
+    guint i;
+
+    if (!values)
+        Py_RETURN_NONE;
+    list = PyList_New(len);
+    for (i = 0; i < len; i++)
+        PyList_SET_ITEM(list, i, PyFloat_FromDouble(values[i]));
+    return list;
+}
+%}
+%typemap(out) GNCPriceSamples * {
+    PyObject *times = PyList_New($1->len);
+    PyObject *counts = Py_None;
+    guint i;
+
+    for (i = 0; i < $1->len; i++)
+        PyList_SET_ITEM(times, i, PyLong_FromLongLong($1->times[i]));
+    if ($1->counts) {
+        counts = PyList_New($1->len);
+        for (i = 0; i < $1->len; i++)
+            PyList_SET_ITEM(counts, i, PyLong_FromUnsignedLong($1->counts[i]));
+    } else {
+        Py_INCREF(Py_None);
+    }
+    $result = PyTuple_New(6);
+    PyTuple_SET_ITEM($result, 0, times);
+    PyTuple_SET_ITEM($result, 1, price_samples_doubles_to_py($1->values, $1->len));
+    PyTuple_SET_ITEM($result, 2, price_samples_doubles_to_py($1->min, $1->len));
+    PyTuple_SET_ITEM($result, 3, price_samples_doubles_to_py($1->max, $1->len));
+    PyTuple_SET_ITEM($result, 4, price_samples_doubles_to_py($1->avg, $1->len));
+    PyTuple_SET_ITEM($result, 5, counts);
+    gnc_price_samples_free($1);
+}
+%ignore gnc_price_samples_free;
+
 %include <gnc-pricedb.h>
+%clear CommodityList *commodities;
+%clear (const time64 *dates, guint n_dates);
+%clear GNCPriceMatrix *;
+%clear GNCPriceSamples *;
 
 %include <cap-gains.h>
 %include <Scrub3.h>
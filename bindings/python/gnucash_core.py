@@ -386,6 +386,16 @@ methods_return_instance(GncPriceDB,PriceDB_dict)
 GncPriceDB.get_prices = method_function_returns_instance_list(
     GncPriceDB.get_prices, GncPrice )
 
+def _lookup_latest_before_matrix(self, commodities, currency, dates):
+    """Return one list per commodity with its value in currency at each of
+    dates (a list of date, datetime or integer time values), using the
+    latest price at or before each date. Values without a price are zero."""
+    rows = gnucash_core_c.gnc_pricedb_lookup_latest_before_matrix(
+        self.instance, [c.instance for c in commodities],
+        currency.instance, dates)
+    return [[GncNumeric(instance=value) for value in row] for row in rows]
+GncPriceDB.lookup_latest_before_matrix = _lookup_latest_before_matrix
+
 
 class GncCommodity(GnuCashCoreClass): pass
 
@@ -514,6 +514,11 @@ search_update_query (GNCSearchWindow *sw)
     if (sw->q)
         qof_query_destroy (sw->q);
 
+    /* Split searches only use getters that are safe to call from
+     * worker threads, so let the engine spread them over all cores. */
+    if (g_strcmp0 (sw->search_for, GNC_ID_SPLIT) == 0)
+        qof_query_set_parallel (new_q, -1);
+
     /* And save the new one */
     sw->q = new_q;
 }
@@ -1590,6 +1590,19 @@ gnc_main_window_update_all_titles (void)
                    NULL);
 }
 
+/* A save that went on after gnc_file_save() reported the file saved has
+ * failed. */
+static void
+gnc_main_window_book_save_failed (QofSession *session, gpointer user_data)
+{
+    QofBackendError io_err = qof_session_pop_error (session);
+
+    if (io_err != ERR_BACKEND_NO_ERR)
+        show_session_error (gnc_ui_get_main_window (NULL), io_err,
+                            qof_session_get_url (session),
+                            GNC_FILE_DIALOG_SAVE);
+}
+
 static void
 gnc_main_window_book_dirty_cb (QofBook *book,
                                gboolean dirty,
@@ -2538,6 +2551,8 @@ gnc_main_window_class_init (GncMainWindowClass *klass)
 
     gnc_hook_add_dangler(HOOK_BOOK_SAVED,
                          (GFunc)gnc_main_window_update_all_titles, NULL);
+    gnc_hook_add_dangler(HOOK_BOOK_SAVE_FAILED,
+                         (GFunc)gnc_main_window_book_save_failed, NULL);
     gnc_hook_add_dangler(HOOK_BOOK_OPENED,
                          (GFunc)gnc_main_window_attach_to_book, NULL);
 
@@ -43,6 +43,7 @@
 
 #include "gnc-component-manager.h"
 #include "gnc-engine.h"
+#include "gnc-event.h"
 #include "gnc-gobject-utils.h"
 #include "gnc-pricedb.h"
 #include "gnc-tree-model-price.h"
@@ -1134,7 +1135,6 @@ gnc_tree_model_price_get_iter_from_price (GncTreeModelPrice *model,
 {
     GncTreeModelPricePrivate *priv;
     gnc_commodity *commodity;
-    GList *list;
     gint n;
 
     ENTER("model %p, price %p, iter %p", model, price, iter);
@@ -1150,17 +1150,9 @@ gnc_tree_model_price_get_iter_from_price (GncTreeModelPrice *model,
         return FALSE;
     }
 
-    list = gnc_pricedb_get_prices(priv->price_db, commodity, NULL);
-    if (list == NULL)
-    {
-        LEAVE("empty list");
-        return FALSE;
-    }
-
-    n = g_list_index(list, price);
+    n = gnc_pricedb_price_index(priv->price_db, price);
     if (n == -1)
     {
-        gnc_price_list_destroy(list);
         LEAVE("not in list");
         return FALSE;
     }
@@ -1169,7 +1161,6 @@ gnc_tree_model_price_get_iter_from_price (GncTreeModelPrice *model,
     iter->user_data  = ITER_IS_PRICE;
     iter->user_data2 = price;
     iter->user_data3 = GINT_TO_POINTER(n);
-    gnc_price_list_destroy(list);
     LEAVE("iter %s", iter_to_string(model, iter));
     return TRUE;
 }
@@ -1490,7 +1481,6 @@ gnc_tree_model_price_do_deletions (gpointer price_db)
 
             /* Remove the path. */
             gnc_tree_model_price_row_delete(data->model, data->path);
-            gnc_pricedb_nth_price_reset_cache (price_db);
 
             gtk_tree_path_free(data->path);
             g_free(data);
@@ -1534,6 +1524,50 @@ gnc_tree_model_price_do_deletions (gpointer price_db)
  *
  *  @param event_data A pointer to additional data about this event.
  */
+/** This function handles the single event generated by
+ *  gnc_pricedb_remove_old_prices().  The prices are already gone, so the
+ *  rows past the new end of each commodity's list are deleted and the
+ *  rest are marked as changed.
+ */
+static void
+gnc_tree_model_price_remove_pruned (GncTreeModelPrice *model,
+                                    GList *removals)
+{
+    GtkTreeModel *tree_model = GTK_TREE_MODEL(model);
+    GList *node;
+
+    ENTER("model %p", model);
+    for (node = removals; node; node = g_list_next(node))
+    {
+        GNCPriceDBRemoval *removal = node->data;
+        GtkTreePath *path, *child;
+        GtkTreeIter iter;
+        gint n;
+
+        if (!gnc_tree_model_price_get_iter_from_commodity (model, removal->commodity, &iter))
+            continue;
+        path = gtk_tree_model_get_path (tree_model, &iter);
+
+        for (n = removal->num_before - 1; n >= removal->num_after; n--)
+        {
+            child = gtk_tree_path_copy (path);
+            gtk_tree_path_append_index (child, n);
+            gnc_tree_model_price_row_delete (model, child);
+            gtk_tree_path_free (child);
+        }
+        for (n = 0; n < removal->num_after; n++)
+        {
+            child = gtk_tree_path_copy (path);
+            gtk_tree_path_append_index (child, n);
+            if (gtk_tree_model_get_iter (tree_model, &iter, child))
+                gtk_tree_model_row_changed (tree_model, child, &iter);
+            gtk_tree_path_free (child);
+        }
+        gtk_tree_path_free (path);
+    }
+    LEAVE(" ");
+}
+
 static void
 gnc_tree_model_price_event_handler (QofInstance *entity,
                                     QofEventId event_type,
@@ -1560,7 +1594,14 @@ gnc_tree_model_price_event_handler (QofInstance *entity,
     g_return_if_fail(GNC_IS_TREE_MODEL_PRICE(model));
 
     /* get type specific data */
-    if (GNC_IS_COMMODITY(entity))
+    if (GNC_IS_PRICEDB(entity))
+    {
+        if (event_type == GNC_EVENT_ITEM_REMOVED && event_data)
+            gnc_tree_model_price_remove_pruned (model, event_data);
+        LEAVE(" ");
+        return;
+    }
+    else if (GNC_IS_COMMODITY(entity))
     {
         gnc_commodity *commodity;
 
@@ -1616,7 +1657,6 @@ gnc_tree_model_price_event_handler (QofInstance *entity,
     case QOF_EVENT_ADD:
         /* Tell the filters/views where the new price was added. */
         DEBUG("add %s", name);
-        gnc_pricedb_nth_price_reset_cache (priv->price_db);
         gnc_tree_model_price_row_add (model, &iter);
         break;
 
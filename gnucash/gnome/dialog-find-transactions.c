@@ -182,6 +182,10 @@ gnc_ui_find_transactions_dialog_create(GtkWindow *parent, GNCLedgerDisplay * ori
         }
     }
 
+    /* Text searches on big books are much faster with an index; it is
+     * built once and then kept up to date by the engine. */
+    xaccQueryEnableTextIndex (gnc_get_current_book ());
+
     ftd = g_new0 (struct _ftd_data, 1);
 
     if (orig_ledg)
@@ -351,6 +351,7 @@ gnc_reconcile_view_new (Account *account, GNCReconcileViewType type,
 
     query = qof_query_create_for (GNC_ID_SPLIT);
     qof_query_set_book (query, gnc_get_current_book ());
+    qof_query_set_cached (query, TRUE);
 
     include_children = xaccAccountGetReconcileChildrenStatus (account);
     if (include_children)
@@ -34,6 +34,7 @@ extern "C" {
 #include "gnc-ui-util.h"
 }
 
+#include <algorithm>
 #include <exception>
 #include <map>
 #include <string>
@@ -286,7 +287,8 @@ std::string GncImportPrice::verify_essentials (void)
         return std::string();
 }
 
-Result GncImportPrice::create_price (QofBook* book, GNCPriceDB *pdb, bool over)
+Result GncImportPrice::create_price (QofBook* book, GNCPriceDB *pdb, bool over,
+                                     PendingPrices* pending)
 {
     /* Gently refuse to create the price if the basics are not set correctly
      * This should have been tested before calling this function though!
@@ -303,8 +305,26 @@ Result GncImportPrice::create_price (QofBook* book, GNCPriceDB *pdb, bool over)
     auto amount = *m_amount;
     Result ret_val = ADDED;
 
-    GNCPrice *old_price = gnc_pricedb_lookup_day_t64 (pdb, *m_from_commodity,
-                                                      *m_to_currency, date);
+    auto from = *m_from_commodity;
+    auto to = *m_to_currency;
+    auto key = std::make_tuple (std::min (from, to), std::max (from, to),
+                                time64CanonicalDayTime (date));
+    GNCPrice *old_price = nullptr;
+
+    // A price for the same day may be waiting to be added
+    auto pending_it = pending ? pending->find (key) : PendingPrices::iterator{};
+    if (pending && pending_it != pending->end())
+    {
+        if (!over)
+            return DUPLICATED;
+
+        DEBUG("Over write pending");
+        gnc_price_unref (pending_it->second);
+        pending->erase (pending_it);
+        ret_val = REPLACED;
+    }
+    else
+        old_price = gnc_pricedb_lookup_day_t64 (pdb, from, to, date);
 
     // Should old price be over written
     if ((old_price != nullptr) && (over == true))
@@ -344,6 +364,12 @@ Result GncImportPrice::create_price (QofBook* book, GNCPriceDB *pdb, bool over)
         gnc_price_set_typestr (price, PRICE_TYPE_LAST);
         gnc_price_commit_edit (price);
 
+        if (pending)
+        {
+            (*pending)[key] = price;
+            return ret_val;
+        }
+
         bool perr = gnc_pricedb_add_price (pdb, price);
 
         gnc_price_unref (price);
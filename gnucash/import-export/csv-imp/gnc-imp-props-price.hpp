@@ -38,6 +38,7 @@ extern "C" {
 #include <string>
 #include <map>
 #include <memory>
+#include <tuple>
 #include <boost/optional.hpp>
 #include <gnc-datetime.hpp>
 #include <gnc-numeric.hpp>
@@ -58,6 +59,12 @@ enum class GncPricePropType {
 
 enum Result { FAILED, ADDED, DUPLICATED, REPLACED };
 
+/** Prices created by GncImportPrice::create_price that still have to be
+ *  added to the pricedb, keyed like gnc_pricedb_lookup_day_t64 looks them
+ *  up: by the commodity pair in either order and the day.  Each price holds
+ *  a reference. */
+using PendingPrices = std::map<std::tuple<gnc_commodity*, gnc_commodity*, time64>, GNCPrice*>;
+
 /** Maps all column types to a string representation.
  *  The actual definition is in gnc-imp-props-price.cpp.
  *  Attention: that definition should be adjusted for any
@@ -93,7 +100,11 @@ public:
     void set_currency_format (int currency_format) { m_currency_format = currency_format ;}
     void reset (GncPricePropType prop_type);
     std::string verify_essentials (void);
-    Result create_price (QofBook* book, GNCPriceDB *pdb, bool over);
+    /** Creates the price and adds it to pdb, or to pending if that is set
+     *  so the caller can add all of them in one go with
+     *  gnc_pricedb_add_prices. */
+    Result create_price (QofBook* book, GNCPriceDB *pdb, bool over,
+                         PendingPrices* pending = nullptr);
 
     gnc_commodity* get_from_commodity () { if (m_from_commodity) return *m_from_commodity; else return nullptr; }
     void set_from_commodity (gnc_commodity* comm) { if (comm) m_from_commodity = comm; else m_from_commodity = boost::none; }
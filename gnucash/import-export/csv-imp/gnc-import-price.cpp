@@ -554,7 +554,8 @@ static void price_properties_verify_essentials (std::vector<parse_line_t>::itera
         throw std::invalid_argument(error_message);
 }
 
-void GncPriceImport::create_price (std::vector<parse_line_t>::iterator& parsed_line)
+void GncPriceImport::create_price (std::vector<parse_line_t>::iterator& parsed_line,
+                                   PendingPrices& pending)
 {
     StrVec line;
     std::string error_message;
@@ -610,7 +611,8 @@ void GncPriceImport::create_price (std::vector<parse_line_t>::iterator& parsed_l
         GNCPriceDB *pdb = gnc_pricedb_get_db (book);
 
         /* If all went well, add this price to the list. */
-        auto price_created = price_props->create_price (book, pdb, m_over_write);
+        auto price_created = price_props->create_price (book, pdb, m_over_write,
+                                                        &pending);
         if (price_created == ADDED)
             m_prices_added++;
         else if (price_created == DUPLICATED)
@@ -643,6 +645,10 @@ void GncPriceImport::create_prices ()
     m_prices_duplicated = 0;
     m_prices_replaced = 0;
 
+    /* The new prices are collected first and added to the pricedb in one
+     * batch at the end. */
+    PendingPrices pending;
+
     /* Iterate over all parsed lines */
     for (auto parsed_lines_it = m_parsed_lines.begin();
             parsed_lines_it != m_parsed_lines.end();
@@ -653,8 +659,17 @@ void GncPriceImport::create_prices ()
             continue;
 
         /* Should not throw anymore, otherwise verify needs revision */
-        create_price (parsed_lines_it);
+        create_price (parsed_lines_it, pending);
     }
+
+    PriceList *prices = nullptr;
+    for (auto& pending_price : pending)
+        prices = g_list_prepend (prices, pending_price.second);
+    auto pdb = gnc_pricedb_get_db (gnc_get_current_book());
+    auto num_added = gnc_pricedb_add_prices (pdb, prices);
+    if (num_added != pending.size())
+        PWARN("Only %u of %zu new prices could be added", num_added, pending.size());
+    gnc_price_list_destroy (prices);
     PINFO("Number of lines is %d, added %d, duplicated %d, replaced %d",
          (int)m_parsed_lines.size(), m_prices_added, m_prices_duplicated, m_prices_replaced);
 }
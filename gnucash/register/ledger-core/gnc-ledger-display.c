@@ -662,6 +662,9 @@ gnc_ledger_display_make_query (GNCLedgerDisplay* ld,
     qof_query_destroy (ld->query);
     ld->query = qof_query_create_for (GNC_ID_SPLIT);
 
+    /* The register re-runs this query on every refresh */
+    qof_query_set_cached (ld->query, TRUE);
+
     /* This is a bit of a hack. The number of splits should be
      * configurable, or maybe we should go back a time range instead
      * of picking a number, or maybe we should be able to exclude
@@ -563,7 +563,10 @@ flawed. see report-utilities.scm. please update reports.")
                             '()))))
 
     ;; Build a query to find all splits between the indicated dates.
+    ;; Reports ask for the same intervals over and over, so let the
+    ;; engine cache the matches.
     (qof-query-set-book query (gnc-get-current-book))
+    (qof-query-set-cached query #t)
     (xaccQueryAddAccountMatch query accounts
                               QOF-GUID-MATCH-ANY
                               QOF-QUERY-AND)
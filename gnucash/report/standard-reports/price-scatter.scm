@@ -26,6 +26,7 @@
 
 (use-modules (gnucash utilities)) 
 (use-modules (srfi srfi-1))
+(use-modules (srfi srfi-4))
 (use-modules (gnucash gnc-module))
 (use-modules (gnucash core-utils))
 (use-modules (gnucash gettext))
@@ -248,12 +249,18 @@
                 currency-accounts to-date 
                 price-commodity report-currency))
               ((pricedb)
-               (map (lambda (p)
-                      (list (gnc-price-get-time64 p)
-                            (gnc-price-get-value p)))
-                    (gnc-pricedb-get-prices
-                     (gnc-pricedb-get-db (gnc-get-current-book))
-                     price-commodity report-currency)))
+               ;; the scan only returns the prices in the date range,
+               ;; as packed vectors of times and values
+               (let* ((samples (gnc-pricedb-get-price-samples
+                                (gnc-pricedb-get-db (gnc-get-current-book))
+                                price-commodity report-currency
+                                from-date to-date))
+                      (times (first samples))
+                      (vals (second samples)))
+                 (map (lambda (i)
+                        (list (s64vector-ref times i)
+                              (f64vector-ref vals i)))
+                      (iota (s64vector-length times)))))
               )))
 
        (set! data (filter
@@ -273,11 +280,11 @@
        (if invert
 	   (set! data (map (lambda (x) 
 			     (list (first x) 
-				   (/ 1 (gnc-numeric-to-double (second x)))))
+				   (/ 1 (exact->inexact (second x)))))
 			   data))
 	   (set! data (map (lambda (x) 
 			     (list (first x) 
-				   (gnc-numeric-to-double (second x))))
+				   (exact->inexact (second x))))
 			   data)))
 
        ;; convert the dates to the weird x-axis scaling of the
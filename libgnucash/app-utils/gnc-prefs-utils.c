@@ -32,6 +32,11 @@ static QofLogModule log_module = G_LOG_DOMAIN;
 
 /* Keys used for core preferences */
 #define GNC_PREF_FILE_COMPRESSION    "file-compression"
+#define GNC_PREF_FILE_COMPRESSION_THREADS "file-compression-threads"
+#define GNC_PREF_FILE_JOURNAL        "file-journal"
+#define GNC_PREF_FILE_SNAPSHOT       "file-snapshot"
+#define GNC_PREF_FILE_BACKGROUND_SAVE "file-background-save"
+#define GNC_PREF_SQL_INSERT_BATCH_SIZE "sql-insert-batch-size"
 #define GNC_PREF_RETAIN_TYPE_NEVER   "retain-type-never"
 #define GNC_PREF_RETAIN_TYPE_DAYS    "retain-type-days"
 #define GNC_PREF_RETAIN_TYPE_FOREVER "retain-type-forever"
@@ -78,6 +83,56 @@ file_compression_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
     }
 }
 
+static void
+file_compression_threads_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gint threads = gnc_prefs_get_int(GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMPRESSION_THREADS);
+        gnc_prefs_set_file_compression_threads (threads);
+    }
+}
+
+static void
+file_journal_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gboolean file_journal = gnc_prefs_get_bool(GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_JOURNAL);
+        gnc_prefs_set_file_save_journaled (file_journal);
+    }
+}
+
+static void
+file_snapshot_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gboolean file_snapshot = gnc_prefs_get_bool(GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_SNAPSHOT);
+        gnc_prefs_set_file_save_snapshot (file_snapshot);
+    }
+}
+
+static void
+file_background_save_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gboolean file_background = gnc_prefs_get_bool(GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_BACKGROUND_SAVE);
+        gnc_prefs_set_file_save_background (file_background);
+    }
+}
+
+static void
+sql_insert_batch_size_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gint rows = gnc_prefs_get_int(GNC_PREFS_GROUP_GENERAL, GNC_PREF_SQL_INSERT_BATCH_SIZE);
+        gnc_prefs_set_sql_insert_batch_size (rows);
+    }
+}
+
 
 void gnc_prefs_init (void)
 {
@@ -89,6 +144,11 @@ void gnc_prefs_init (void)
     file_retain_changed_cb (NULL, NULL, NULL);
     file_retain_type_changed_cb (NULL, NULL, NULL);
     file_compression_changed_cb (NULL, NULL, NULL);
+    file_compression_threads_changed_cb (NULL, NULL, NULL);
+    file_journal_changed_cb (NULL, NULL, NULL);
+    file_snapshot_changed_cb (NULL, NULL, NULL);
+    file_background_save_changed_cb (NULL, NULL, NULL);
+    sql_insert_batch_size_changed_cb (NULL, NULL, NULL);
 
     /* Check for invalid retain_type (days)/retain_days (0) combo.
      * This can happen either because a user changed the preferences
@@ -122,5 +182,15 @@ void gnc_prefs_init (void)
                            file_retain_type_changed_cb, NULL);
     gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMPRESSION,
                            file_compression_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMPRESSION_THREADS,
+                           file_compression_threads_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_JOURNAL,
+                           file_journal_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_SNAPSHOT,
+                           file_snapshot_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_BACKGROUND_SAVE,
+                           file_background_save_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_SQL_INSERT_BATCH_SIZE,
+                           sql_insert_batch_size_changed_cb, NULL);
 
 }
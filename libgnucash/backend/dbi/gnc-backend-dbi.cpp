@@ -957,6 +957,9 @@ GncDbiBackend<Type>::safe_sync (QofBook* book)
     g_return_if_fail (book != nullptr);
 
     ENTER ("book=%p, primary=%p", book, m_book);
+    /* Everything is rewritten, so nothing may be left in the database. */
+    if (load_transactions_as_needed())
+        GncSqlBackend::load (m_book, LOAD_TYPE_LOAD_ALL);
     if (!conn->begin_transaction())
     {
         LEAVE("Failed to obtain a transaction.");
@@ -1000,6 +1003,9 @@ GncDbiBackend<DbType::DBI_MYSQL>::safe_sync (QofBook* book)
     g_return_if_fail (book != nullptr);
 
     ENTER ("book=%p, primary=%p", book, m_book);
+    /* Everything is rewritten, so nothing may be left in the database. */
+    if (load_transactions_as_needed())
+        GncSqlBackend::load (m_book, LOAD_TYPE_LOAD_ALL);
     if (!conn->table_operation (TableOpType::backup))
     {
         set_error(ERR_BACKEND_SERVER_ERR);
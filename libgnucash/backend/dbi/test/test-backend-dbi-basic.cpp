@@ -48,6 +48,8 @@ extern "C"
 #include "gncAddress.h"
 #include "gncCustomer.h"
 #include "gncInvoice.h"
+    /* For load_tx_as_needed */
+#include <Query.h>
     /* For version_control */
 #include <gnc-prefs.h>
 }
@@ -425,6 +427,157 @@ test_dbi_store_and_reload (Fixture* fixture, gconstpointer pData)
     qof_session_destroy (session_3);
 }
 
+/* Run the same query on a fully loaded book and on one that loads its
+ * transactions as needed, and check that they find the same splits. */
+static void
+compare_query_results (QofBook* full, QofBook* lazy, QofQuery* query)
+{
+    auto q_full = qof_query_copy (query);
+    auto q_lazy = qof_query_copy (query);
+    qof_query_set_book (q_full, full);
+    qof_query_set_book (q_lazy, lazy);
+
+    auto r_full = qof_query_run (q_full);
+    auto r_lazy = qof_query_run (q_lazy);
+    g_assert_cmpint (g_list_length (r_full), ==, g_list_length (r_lazy));
+    for (auto node = r_full; node != nullptr; node = node->next)
+    {
+        auto guid = qof_instance_get_guid (QOF_INSTANCE (node->data));
+        auto split = xaccSplitLookup (guid, lazy);
+        g_assert (split != nullptr);
+        g_assert (g_list_find (r_lazy, split) != nullptr);
+    }
+    qof_query_destroy (q_full);
+    qof_query_destroy (q_lazy);
+}
+
+static Account*
+account_with_splits (QofBook* book)
+{
+    auto accounts = gnc_account_get_descendants (gnc_book_get_root_account (book));
+    Account* retval = nullptr;
+    for (auto node = accounts; node != nullptr && retval == nullptr;
+         node = node->next)
+        if (xaccAccountGetSplitList (GNC_ACCOUNT (node->data)) != nullptr)
+            retval = GNC_ACCOUNT (node->data);
+    g_list_free (accounts);
+    return retval;
+}
+
+/* Save a session, reopen it loading transactions as needed, and check that
+ * queries load what they need to find the same results. */
+static void
+test_dbi_load_tx_as_needed (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+
+    auto msg = "[GncDbiSqlConnection::unlock_database()] There was no lock entry in the Lock table";
+    auto log_domain = nullptr;
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    auto session_2 = qof_session_new ();
+    qof_session_begin (session_2, url, FALSE, TRUE, TRUE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_2);
+    qof_book_mark_session_dirty (qof_session_get_book (session_2));
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+
+    g_setenv ("GNC_SQL_LOAD_TRANSACTIONS_AS_NEEDED", "1", TRUE);
+    auto session_3 = qof_session_new ();
+    qof_session_begin (session_3, url, TRUE, FALSE, FALSE);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    g_unsetenv ("GNC_SQL_LOAD_TRANSACTIONS_AS_NEEDED");
+
+    auto full = qof_session_get_book (session_2);
+    auto lazy = qof_session_get_book (session_3);
+    auto n_full = qof_collection_count (qof_book_get_collection (full,
+                                                                 GNC_ID_TRANS));
+    auto n_lazy = qof_collection_count (qof_book_get_collection (lazy,
+                                                                 GNC_ID_TRANS));
+    g_assert_cmpint (n_lazy, <, n_full);
+
+    auto acct = account_with_splits (full);
+    g_assert (acct != nullptr);
+    auto split = static_cast<Split*>(xaccAccountGetSplitList (acct)->data);
+    auto trans = xaccSplitGetParent (split);
+
+    /* Account */
+    auto query = qof_query_create_for (GNC_ID_SPLIT);
+    xaccQueryAddSingleAccountMatch (query, acct, QOF_QUERY_AND);
+    compare_query_results (full, lazy, query);
+
+    /* Account and date, and their inversion */
+    xaccQueryAddDateMatchTT (query, TRUE, xaccTransGetDate (trans), FALSE, 0,
+                             QOF_QUERY_AND);
+    compare_query_results (full, lazy, query);
+    auto inverted = qof_query_invert (query);
+    compare_query_results (full, lazy, inverted);
+    qof_query_destroy (inverted);
+    qof_query_destroy (query);
+
+    /* Description, memo, amount and reconcile state */
+    query = qof_query_create_for (GNC_ID_SPLIT);
+    xaccQueryAddDescriptionMatch (query, xaccTransGetDescription (trans), FALSE,
+                                  FALSE, QOF_COMPARE_CONTAINS, QOF_QUERY_AND);
+    compare_query_results (full, lazy, query);
+    xaccQueryAddMemoMatch (query, xaccSplitGetMemo (split), TRUE, FALSE,
+                           QOF_COMPARE_EQUAL, QOF_QUERY_OR);
+    compare_query_results (full, lazy, query);
+    qof_query_destroy (query);
+
+    query = qof_query_create_for (GNC_ID_SPLIT);
+    xaccQueryAddValueMatch (query, xaccSplitGetValue (split),
+                            QOF_NUMERIC_MATCH_ANY, QOF_COMPARE_EQUAL,
+                            QOF_QUERY_AND);
+    xaccQueryAddClearedMatch (query, CLEARED_NO, QOF_QUERY_OR);
+    compare_query_results (full, lazy, query);
+    qof_query_destroy (query);
+
+    /* The last few splits by date */
+    query = qof_query_create_for (GNC_ID_SPLIT);
+    xaccQueryAddSingleAccountMatch (query, acct, QOF_QUERY_AND);
+    qof_query_set_sort_order (query,
+                              g_slist_prepend (g_slist_prepend (nullptr,
+                                                                (gpointer)TRANS_DATE_POSTED),
+                                               (gpointer)SPLIT_TRANS),
+                              nullptr, nullptr);
+    qof_query_set_max_results (query, 2);
+    compare_query_results (full, lazy, query);
+
+    /* The same with a regular expression, which isn't translated to SQL,
+     * matching the transaction of the account's oldest split. */
+    auto desc = g_regex_escape_string (xaccTransGetDescription (trans), -1);
+    auto regex = g_strdup_printf ("^%s$", desc);
+    g_free (desc);
+    xaccQueryAddDescriptionMatch (query, regex, TRUE, TRUE,
+                                  QOF_COMPARE_EQUAL, QOF_QUERY_AND);
+    compare_query_results (full, lazy, query);
+    g_free (regex);
+    qof_query_destroy (query);
+
+    /* Anything */
+    query = qof_query_create_for (GNC_ID_SPLIT);
+    compare_query_results (full, lazy, query);
+    qof_query_destroy (query);
+    g_assert_cmpint (qof_collection_count (qof_book_get_collection (lazy,
+                                                                    GNC_ID_TRANS)),
+                     ==, n_full);
+
+    qof_session_end (session_2);
+    qof_session_destroy (session_2);
+    qof_session_end (session_3);
+    qof_session_destroy (session_3);
+}
+
 /** Test the safe_save mechanism.  Beware that this test used on its
  * own doesn't ensure that the resave is done safely, only that the
  * database is intact and unchanged after the save. To observe the
@@ -655,6 +808,8 @@ create_dbi_test_suite (const char* dbm_name, const char* url)
                   test_dbi_version_control, teardown);
     GNC_TEST_ADD (subsuite, "business_store_and_reload", Fixture, url,
                   setup_business, test_dbi_version_control, teardown);
+    GNC_TEST_ADD (subsuite, "load_tx_as_needed", Fixture, url, setup,
+                  test_dbi_load_tx_as_needed, teardown);
     g_free (subsuite);
 
 }
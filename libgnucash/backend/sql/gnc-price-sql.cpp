@@ -39,6 +39,9 @@ extern "C"
 #endif
 }
 
+#include <algorithm>
+#include <string>
+
 #include "gnc-sql-connection.hpp"
 #include "gnc-sql-backend.hpp"
 #include "gnc-sql-object-backend.hpp"
@@ -110,20 +113,19 @@ GncSqlPriceBackend::load_all (GncSqlBackend* sql_be)
         if (result->begin() == result->end())
             return;
 
-        GNCPrice* pPrice;
+        PriceList* prices = nullptr;
 
-        gnc_pricedb_set_bulk_update (pPriceDB, TRUE);
         for (auto row : *result)
         {
-            pPrice = load_single_price (sql_be, row);
+            auto pPrice = load_single_price (sql_be, row);
 
             if (pPrice != NULL)
-            {
-                (void)gnc_pricedb_add_price (pPriceDB, pPrice);
-                gnc_price_unref (pPrice);
-            }
+                prices = g_list_prepend (prices, pPrice);
         }
+        gnc_pricedb_set_bulk_update (pPriceDB, TRUE);
+        (void)gnc_pricedb_add_prices (pPriceDB, prices);
         gnc_pricedb_set_bulk_update (pPriceDB, FALSE);
+        gnc_price_list_destroy (prices);
 	std::string pkey(col_table[0]->name());
         sql = "SELECT DISTINCT ";
 	sql += pkey + " FROM " TABLE_NAME;
@@ -202,6 +204,38 @@ GncSqlPriceBackend::commit (GncSqlBackend* sql_be, QofInstance* inst)
     return is_ok;
 }
 
+/* Keep the statements well below the limits of the SQL servers. */
+#define PRICE_DELETE_BATCH_SIZE 500
+
+bool
+GncSqlPriceBackend::delete_prices (GncSqlBackend* sql_be,
+                                   const std::vector<GncGUID>& guids)
+{
+    g_return_val_if_fail (sql_be != NULL, false);
+
+    for (size_t start = 0; start < guids.size();
+         start += PRICE_DELETE_BATCH_SIZE)
+    {
+        auto end = std::min (guids.size(), start + PRICE_DELETE_BATCH_SIZE);
+        std::string sql ("DELETE FROM " TABLE_NAME " WHERE guid IN (");
+        for (auto i = start; i < end; ++i)
+        {
+            char guid_buf[GUID_ENCODING_LENGTH + 1];
+            guid_to_string_buff (&guids[i], guid_buf);
+            if (i > start)
+                sql += ",";
+            sql += "'";
+            sql += guid_buf;
+            sql += "'";
+        }
+        sql += ")";
+        auto stmt = sql_be->create_statement_from_sql (sql);
+        if (stmt == nullptr || sql_be->execute_nonselect_statement (stmt) == -1)
+            return false;
+    }
+    return true;
+}
+
 static gboolean
 write_price (GNCPrice* p, gpointer data)
 {
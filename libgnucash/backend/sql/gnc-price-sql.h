@@ -39,6 +39,10 @@ public:
     void create_tables(GncSqlBackend*) override;
     bool commit (GncSqlBackend* sql_be, QofInstance* inst) override;
     bool write(GncSqlBackend*) override;
+    /** Delete the prices with these GUIDs with as few statements as
+     * possible. */
+    bool delete_prices (GncSqlBackend* sql_be,
+                        const std::vector<GncGUID>& guids);
 };
 
 #endif /* GNC_PRICE_SQL_H */
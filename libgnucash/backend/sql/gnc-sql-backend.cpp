@@ -41,6 +41,7 @@ extern "C"
 #include "gnc-sql-backend.hpp"
 #include "gnc-sql-object-backend.hpp"
 #include "gnc-sql-column-table-entry.hpp"
+#include "gnc-sql-insert-batch.hpp"
 #include "gnc-sql-result.hpp"
 
 #include "gnc-account-sql.h"
@@ -81,12 +82,15 @@ static EntryVec version_table
 
 GncSqlBackend::GncSqlBackend(GncSqlConnection *conn, QofBook* book) :
     QofBackend {}, m_conn{conn}, m_book{book}, m_loading{false},
-    m_in_query{false}, m_is_pristine_db{false}
+    m_in_query{false}, m_is_pristine_db{false},
+    m_load_tx_as_needed{g_getenv("GNC_SQL_LOAD_TRANSACTIONS_AS_NEEDED") != nullptr}
 {
     if (conn != nullptr)
         connect (conn);
 }
 
+GncSqlBackend::~GncSqlBackend() = default;
+
 void
 GncSqlBackend::connect(GncSqlConnection *conn) noexcept
 {
@@ -111,6 +115,7 @@ GncSqlBackend::create_statement_from_sql(const std::string& str) const noexcept
 GncSqlResultPtr
 GncSqlBackend::execute_select_statement(const GncSqlStatementPtr& stmt) const noexcept
 {
+    flush_insert_batch();
     auto result = m_conn->execute_select_statement(stmt);
     if (result == nullptr)
     {
@@ -123,6 +128,7 @@ GncSqlBackend::execute_select_statement(const GncSqlStatementPtr& stmt) const no
 int
 GncSqlBackend::execute_nonselect_statement(const GncSqlStatementPtr& stmt) const noexcept
 {
+    flush_insert_batch();
     auto result = m_conn->execute_nonselect_statement(stmt);
     if (result == -1)
     {
@@ -285,6 +291,9 @@ GncSqlBackend::load (QofBook* book, QofBackendLoadType loadType)
         for (auto type : fixed_load_order)
         {
             num_done++;
+            /* Left for run_query() */
+            if (m_load_tx_as_needed && type == GNC_ID_TRANS)
+                continue;
             auto obe = m_backend_registry.get_object_backend(type);
             if (obe)
             {
@@ -311,12 +320,26 @@ GncSqlBackend::load (QofBook* book, QofBackendLoadType loadType)
 
         gnc_account_foreach_descendant(root, (AccountCb)xaccAccountCommitEdit,
                                        nullptr);
+
+        /* The scheduled transactions need their templates. */
+        if (m_load_tx_as_needed)
+        {
+            auto templates = gnc_account_get_descendants (gnc_book_get_template_root (book));
+            for (auto node = templates; node != nullptr; node = node->next)
+                gnc_sql_transaction_load_tx_for_account (this,
+                                                         GNC_ACCOUNT(node->data));
+            g_list_free (templates);
+        }
+        else
+            m_all_tx_loaded = true;
     }
-    else if (loadType == LOAD_TYPE_LOAD_ALL)
+    else if (loadType == LOAD_TYPE_LOAD_ALL && !m_all_tx_loaded)
     {
         // Load all transactions
         auto obe = m_backend_registry.get_object_backend (GNC_ID_TRANS);
         obe->load_all (this);
+        m_all_tx_loaded = true;
+        m_fetched_queries.clear();
     }
 
     m_loading = FALSE;
@@ -338,6 +361,55 @@ GncSqlBackend::load (QofBook* book, QofBackendLoadType loadType)
 
 /* ================================================================= */
 
+void*
+GncSqlBackend::compile_query(QofQuery* query)
+{
+    if (!m_load_tx_as_needed || m_all_tx_loaded)
+        return nullptr;
+    return gnc_sql_compile_tx_query (this, query);
+}
+
+void
+GncSqlBackend::run_query(void* compiled)
+{
+    g_return_if_fail (compiled != nullptr);
+
+    if (m_all_tx_loaded)
+        return;
+
+    ENTER ("compiled=%p", compiled);
+    auto query = static_cast<GncSqlTxQuery*>(compiled);
+    auto selector = gnc_sql_tx_query_selector (this, query);
+    if (selector.empty())
+    {
+        load (m_book, LOAD_TYPE_LOAD_ALL);
+        LEAVE ("loaded all transactions");
+        return;
+    }
+    /* We hold the lock, so a selector that has been run can't find any
+     * transaction that isn't in the book already. */
+    if (!m_fetched_queries.insert(selector).second)
+    {
+        LEAVE ("already fetched");
+        return;
+    }
+
+    m_loading = true;
+    m_in_query = true;
+    gnc_sql_transaction_load_tx_for_selector (this, selector);
+    m_in_query = false;
+    m_loading = false;
+    LEAVE ("");
+}
+
+void
+GncSqlBackend::free_query(void* compiled)
+{
+    delete static_cast<GncSqlTxQuery*>(compiled);
+}
+
+/* ================================================================= */
+
 bool
 GncSqlBackend::write_account_tree(Account* root)
 {
@@ -462,7 +534,13 @@ GncSqlBackend::sync(QofBook* book)
 
     /* Save all contents */
     m_book = book;
+    m_all_tx_loaded = true;
     auto is_ok = m_conn->begin_transaction();
+    /* Everything is inserted into empty tables, so the rows can go in
+     * multi-row INSERTs. */
+    if (is_ok)
+        m_insert_batch.reset (new GncSqlInsertBatch (m_conn,
+                                  std::max (gnc_prefs_get_sql_insert_batch_size (), 1)));
 
     // FIXME: should write the set of commodities that are used
     // write_commodities(sql_be, book);
@@ -493,6 +571,11 @@ GncSqlBackend::sync(QofBook* book)
             std::get<1>(entry)->write (this);
     }
     if (is_ok)
+    {
+        is_ok = flush_insert_batch();
+    }
+    m_insert_batch.reset();
+    if (is_ok)
     {
         is_ok = m_conn->commit_transaction();
     }
@@ -520,10 +603,12 @@ GncSqlBackend::sync(QofBook* book)
 void
 GncSqlBackend::begin(QofInstance* inst)
 {
-    //g_return_if_fail (inst != NULL);
+    g_return_if_fail (inst != NULL);
 
-    //ENTER (" ");
-    //LEAVE ("");
+    /* Editing the PriceDB brackets bulk changes to its prices, like
+     * gnc_pricedb_remove_old_prices(). */
+    if (!m_loading && strcmp (inst->e_type, GNC_ID_PRICEDB) == 0)
+        m_in_price_batch = true;
 }
 
 void
@@ -578,11 +663,21 @@ GncSqlBackend::commit (QofInstance* inst)
     // The engine has a PriceDB object but it isn't in the database
     if (strcmp (inst->e_type, "PriceDB") == 0)
     {
+        if (m_in_price_batch)
+            delete_pending_prices();
         qof_instance_mark_clean (inst);
         qof_book_mark_session_saved (m_book);
         return;
     }
 
+    if (m_in_price_batch && qof_instance_get_destroying (inst) &&
+        strcmp (inst->e_type, GNC_ID_PRICE) == 0)
+    {
+        m_pending_price_deletes.push_back (*qof_instance_get_guid (inst));
+        qof_instance_mark_clean (inst);
+        return;
+    }
+
     ENTER (" ");
 
     is_dirty = qof_instance_get_dirty_flag (inst);
@@ -641,6 +736,45 @@ GncSqlBackend::commit (QofInstance* inst)
 }
 
 
+bool
+GncSqlBackend::flush_insert_batch() const noexcept
+{
+    if (m_insert_batch == nullptr)
+        return true;
+    if (m_insert_batch->flush())
+        return true;
+    qof_backend_set_error ((QofBackend*)this, ERR_BACKEND_SERVER_ERR);
+    return false;
+}
+
+void
+GncSqlBackend::delete_pending_prices() noexcept
+{
+    m_in_price_batch = false;
+    if (m_pending_price_deletes.empty())
+        return;
+
+    ENTER ("%zu prices", m_pending_price_deletes.size());
+    auto obe = std::dynamic_pointer_cast<GncSqlPriceBackend>(
+        m_backend_registry.get_object_backend(GNC_ID_PRICE));
+    if (!m_conn->begin_transaction ())
+    {
+        PERR ("begin_transaction failed\n");
+    }
+    else if (obe == nullptr || !obe->delete_prices (this, m_pending_price_deletes))
+    {
+        (void)m_conn->rollback_transaction ();
+        set_error (ERR_BACKEND_SERVER_ERR);
+    }
+    else
+    {
+        (void)m_conn->commit_transaction ();
+        qof_book_mark_session_saved (m_book);
+    }
+    m_pending_price_deletes.clear();
+    LEAVE ("");
+}
+
 /**
  * Sees if the version table exists, and if it does, loads the info into
  * the version hash table.  Otherwise, it creates an empty version table.
@@ -839,6 +973,11 @@ GncSqlBackend::do_db_operation (E_DB_OPERATION op, const char* table_name,
     g_return_val_if_fail (obj_name != nullptr, false);
     g_return_val_if_fail (pObject != nullptr, false);
 
+    if (op == OP_DB_INSERT && m_insert_batch)
+        return m_insert_batch->add_row (table_name,
+                                        get_object_values (obj_name, pObject,
+                                                           table));
+
     switch(op)
     {
         case  OP_DB_INSERT:
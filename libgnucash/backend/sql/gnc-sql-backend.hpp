@@ -33,6 +33,7 @@ extern "C"
 #include <exception>
 #include <sstream>
 #include <vector>
+#include <unordered_set>
 #include <qof-backend.hpp>
 
 class GncSqlColumnTableEntry;
@@ -43,6 +44,7 @@ using GncSqlObjectBackendPtr = std::shared_ptr<GncSqlObjectBackend>;
 using OBEEntry = std::tuple<std::string, GncSqlObjectBackendPtr>;
 using OBEVec = std::vector<OBEEntry>;
 class GncSqlConnection;
+class GncSqlInsertBatch;
 class GncSqlStatement;
 using GncSqlStatementPtr = std::unique_ptr<GncSqlStatement>;
 class GncSqlResult;
@@ -66,7 +68,7 @@ class GncSqlBackend : public QofBackend
 {
 public:
     GncSqlBackend(GncSqlConnection *conn, QofBook* book);
-    virtual ~GncSqlBackend() = default;
+    virtual ~GncSqlBackend();
     /**
      * Load the contents of an SQL database into a book.
      *
@@ -97,6 +99,22 @@ public:
      * @param inst Object being edited
      */
     void rollback(QofInstance*) override;
+    /**
+     * Translate a split or transaction query to SQL. Does nothing unless
+     * transactions are loaded as needed.
+     *
+     * @param query The query
+     * @return The compiled query or nullptr
+     */
+    void* compile_query(QofQuery*) override;
+    /**
+     * Load the transactions that might match a query compiled by
+     * compile_query() and haven't been loaded yet.
+     *
+     * @param compiled The compiled query
+     */
+    void run_query(void*) override;
+    void free_query(void*) override;
     /** Connect the backend to a GncSqlConnection.
      * Sets up version info. Calling with nullptr clears the connection and
      * destroys the version info.
@@ -236,6 +254,18 @@ public:
     bool save_commodity(gnc_commodity* comm) noexcept;
     QofBook* book() const noexcept { return m_book; }
     void set_loading(bool loading) noexcept { m_loading = loading; }
+    /**
+     * Whether the initial load leaves out the (non-template) transactions
+     * so that queries fetch them from the database when they're run. Set from
+     * the GNC_SQL_LOAD_TRANSACTIONS_AS_NEEDED environment variable.
+     *
+     * Account balances only include the transactions loaded so far.
+     */
+    bool load_transactions_as_needed() const noexcept { return m_load_tx_as_needed; }
+    void set_load_transactions_as_needed(bool as_needed) noexcept
+    {
+        m_load_tx_as_needed = as_needed;
+    }
     bool pristine() const noexcept { return m_is_pristine_db; }
     void update_progress(double pct) const noexcept;
     void finish_progress() const noexcept;
@@ -246,6 +276,10 @@ protected:
     bool m_loading;        /**< We are performing an initial load */
     bool m_in_query;       /**< We are processing a query */
     bool m_is_pristine_db; /**< Are we saving to a new pristine db? */
+    bool m_load_tx_as_needed; /**< Leave transactions for run_query() */
+    bool m_all_tx_loaded = false; /**< All transactions are in the book */
+    std::unordered_set<std::string> m_fetched_queries; /**< Selectors already
+                                                        * run by run_query() */
     const char* m_time_format = nullptr; /**< Server-specific date-time string format */
     VersionVec m_versions;    /**< Version number for each table */
 private:
@@ -288,6 +322,17 @@ private:
     };
     ObjectBackendRegistry m_backend_registry;
     std::vector<gnc_commodity*> m_postload_commodities;
+    /** Set while the PriceDB is being edited: price deletions are collected
+     * in m_pending_price_deletes and run together when the edit is
+     * committed. */
+    bool m_in_price_batch = false;
+    std::vector<GncGUID> m_pending_price_deletes;
+    void delete_pending_prices() noexcept;
+    /** Set while sync() writes the book: inserts are collected into
+     * multi-row statements, which are written before any other statement
+     * and at the end. */
+    std::unique_ptr<GncSqlInsertBatch> m_insert_batch;
+    bool flush_insert_batch() const noexcept;
 };
 
 #endif //__GNC_SQL_BACKEND_HPP__
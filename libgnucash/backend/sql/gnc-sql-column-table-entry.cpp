@@ -389,18 +389,18 @@ GncSqlColumnTableEntryImpl<CT_TIME>::load (const GncSqlBackend* sql_be,
         try
         {
             auto val = row.get_string_at_col(m_col_name);
-            GncDateTime time(val);
-            t = static_cast<time64>(time);
-        }
-        catch (const std::invalid_argument& err)
-        {
-            if (strcmp(err.what(), "Column empty.") != 0)
+            t = gnc_iso8601_to_time64_gmt (val.c_str());
+            if (t == INT64_MAX)
             {
-                auto val = row.get_string_at_col (m_col_name);
                 PWARN("An invalid date %s was found in your database."
                       "It has been set to 1 January 1970.", val.c_str());
+                t = 0;
             }
         }
+        catch (const std::invalid_argument&)
+        {
+            /* An empty column leaves the time at 0. */
+        }
     }
     if (m_gobj_param_name != nullptr)
     {
@@ -447,10 +447,11 @@ GncSqlColumnTableEntryImpl<CT_TIME>::add_to_query(QofIdTypeConst obj_name,
     }
     if (t64 > MINTIME && t64 < MAXTIME)
     {
-        GncDateTime time(t64);
-        std::string timestr("'");
-        timestr += time.format_iso8601() + "'";
-        vec.emplace_back (std::make_pair (std::string{m_col_name}, timestr));
+        char timestr[MAX_DATE_LENGTH + 3] = "'";
+        auto end = gnc_time64_to_iso8601_buff (t64, timestr + 1);
+        strcpy (end, "'");
+        vec.emplace_back (std::make_pair (std::string{m_col_name},
+                                          std::string{timestr}));
     }
     else
     {
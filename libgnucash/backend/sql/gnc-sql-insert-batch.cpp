@@ -0,0 +1,118 @@
+/***********************************************************************\
+ * gnc-sql-insert-batch.cpp: Collect rows into multi-row INSERTs.      *
+ *                                                                     *
+ * This program is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU General Public License as      *
+ * published by the Free Software Foundation; either version 2 of      *
+ * the License, or (at your option) any later version.                 *
+ *                                                                     *
+ * This program is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the       *
+ * GNU General Public License for more details.                        *
+ *                                                                     *
+ * You should have received a copy of the GNU General Public License   *
+ * along with this program; if not, contact:                           *
+ *                                                                     *
+ * Free Software Foundation           Voice:  +1-617-542-5942          *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652          *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                      *
+\***********************************************************************/
+
+extern "C"
+{
+#include <config.h>
+#include <qof.h>
+}
+#include "gnc-sql-connection.hpp"
+#include "gnc-sql-insert-batch.hpp"
+
+static QofLogModule log_module = G_LOG_DOMAIN;
+
+/* A statement is written once its rows take this much SQL, whatever their
+ * number, to stay well below the smallest max_allowed_packet of MySQL. */
+#define MAX_STATEMENT_SIZE (512 * 1024)
+
+GncSqlInsertBatch::GncSqlInsertBatch(GncSqlConnection* conn,
+                                     unsigned int max_rows) noexcept :
+    m_conn{conn}, m_max_rows{max_rows}
+{
+}
+
+bool
+GncSqlInsertBatch::add_row(const std::string& table_name,
+                           const PairVec& values) noexcept
+{
+    std::string columns{"("};
+    std::string row{"("};
+
+    if (!m_ok)
+        return false;
+
+    for (auto const& col_value : values)
+    {
+        if (col_value != *values.begin())
+        {
+            columns += ",";
+            row += ",";
+        }
+        columns += col_value.first;
+        row += col_value.second;
+    }
+    columns += ")";
+    row += ")";
+
+    /* Rows of a table don't always have the same columns, some leave out
+     * the ones they have no value for. */
+    auto& rows = m_tables[table_name];
+    if (rows.count > 0 && rows.columns != columns && !write_rows(table_name, rows))
+        return false;
+
+    if (rows.count == 0)
+    {
+        rows.columns = std::move(columns);
+        rows.values = std::move(row);
+    }
+    else
+    {
+        rows.values += ",";
+        rows.values += row;
+    }
+    if (++rows.count >= m_max_rows || rows.values.size() >= MAX_STATEMENT_SIZE)
+        return write_rows(table_name, rows);
+    return true;
+}
+
+bool
+GncSqlInsertBatch::flush() noexcept
+{
+    for (auto& table : m_tables)
+    {
+        if (table.second.count > 0)
+            write_rows(table.first, table.second);
+    }
+    m_tables.clear();
+    return m_ok;
+}
+
+bool
+GncSqlInsertBatch::write_rows(const std::string& table_name,
+                              PendingRows& rows) noexcept
+{
+    auto count = rows.count;
+    auto sql = "INSERT INTO " + table_name + rows.columns + " VALUES" +
+        rows.values;
+
+    rows.count = 0;
+    rows.values.clear();
+    if (!m_ok)
+        return false;
+
+    auto stmt = m_conn->create_statement_from_sql(sql);
+    if (stmt == nullptr || m_conn->execute_nonselect_statement(stmt) == -1)
+    {
+        PERR ("Failed to insert %u rows into %s\n", count, table_name.c_str());
+        m_ok = false;
+    }
+    return m_ok;
+}
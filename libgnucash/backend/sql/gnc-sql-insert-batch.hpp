@@ -0,0 +1,82 @@
+/***********************************************************************\
+ * gnc-sql-insert-batch.hpp: Collect rows into multi-row INSERTs.      *
+ *                                                                     *
+ * This program is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU General Public License as      *
+ * published by the Free Software Foundation; either version 2 of      *
+ * the License, or (at your option) any later version.                 *
+ *                                                                     *
+ * This program is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the       *
+ * GNU General Public License for more details.                        *
+ *                                                                     *
+ * You should have received a copy of the GNU General Public License   *
+ * along with this program; if not, contact:                           *
+ *                                                                     *
+ * Free Software Foundation           Voice:  +1-617-542-5942          *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652          *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                      *
+\***********************************************************************/
+
+#ifndef __GNC_SQL_INSERT_BATCH_HPP__
+#define __GNC_SQL_INSERT_BATCH_HPP__
+
+#include <map>
+#include <string>
+#include <vector>
+
+class GncSqlConnection;
+using PairVec = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * Rows inserted into the tables of a GncSqlConnection, written as one
+ * INSERT ... VALUES (...),(...) statement per table for each max_rows rows
+ * instead of one statement per row.
+ *
+ * The rows of a table are inserted in the order they were added, but the
+ * tables are written in no particular order, so a batch may only be used
+ * where no row depends on a row of another table being there first.
+ * Anything else run on the connection must flush() the batch before.
+ */
+class GncSqlInsertBatch
+{
+public:
+    /** max_rows of 1 or less writes every row as it is added. */
+    GncSqlInsertBatch(GncSqlConnection* conn, unsigned int max_rows) noexcept;
+    GncSqlInsertBatch(const GncSqlInsertBatch&) = delete;
+    GncSqlInsertBatch& operator=(const GncSqlInsertBatch&) = delete;
+    ~GncSqlInsertBatch() = default;
+    /**
+     * Add a row to table_name, writing the rows collected for it if they
+     * fill a statement.
+     *
+     * @param table_name SQL table name
+     * @param values The row's column names and SQL values
+     * @return false if a statement failed
+     */
+    bool add_row(const std::string& table_name, const PairVec& values) noexcept;
+    /**
+     * Write all rows collected so far.
+     *
+     * @return false if this or any earlier statement failed
+     */
+    bool flush() noexcept;
+    bool empty() const noexcept { return m_tables.empty(); }
+
+private:
+    struct PendingRows
+    {
+        std::string columns;
+        std::string values;
+        unsigned int count = 0;
+    };
+    bool write_rows(const std::string& table_name, PendingRows& rows) noexcept;
+
+    GncSqlConnection* m_conn;
+    unsigned int m_max_rows;
+    bool m_ok = true;
+    std::map<std::string, PendingRows> m_tables;
+};
+
+#endif //__GNC_SQL_INSERT_BATCH_HPP__
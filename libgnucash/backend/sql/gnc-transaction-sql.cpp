@@ -49,10 +49,13 @@ extern "C"
 #endif
 }
 
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <locale>
 #include <string>
 #include <sstream>
-
-#include "escape.h"
+#include <vector>
 
 #include <gnc-datetime.hpp>
 #include "gnc-sql-connection.hpp"
@@ -63,8 +66,6 @@ extern "C"
 #include "gnc-commodity-sql.h"
 #include "gnc-slots-sql.h"
 
-#define SIMPLE_QUERY_COMPILATION 1
-
 static QofLogModule log_module = G_LOG_DOMAIN;
 
 #define TRANSACTION_TABLE "transactions"
@@ -149,13 +150,6 @@ GncSqlSplitBackend::GncSqlSplitBackend() :
     GncSqlObjectBackend(SPLIT_TABLE_VERSION, GNC_ID_SPLIT,
                         SPLIT_TABLE, split_col_table) {}
 
-/* These functions exist but have not been tested.
-   #if LOAD_TRANSACTIONS_AS_NEEDED
-   compile_split_query,
-   run_split_query,
-   free_split_query,
-*/
-
 /* ================================================================= */
 
 static  gpointer
@@ -724,173 +718,559 @@ GncSqlTransBackend::load_all (GncSqlBackend* sql_be)
                                    nullptr);
 }
 
-static void
-convert_query_comparison_to_sql (QofQueryPredData* pPredData,
-                                 gboolean isInverted, std::stringstream& sql)
-{
-    if (pPredData->how == QOF_COMPARE_LT
-        || (isInverted && pPredData->how == QOF_COMPARE_GTE))
-        sql << "<";
-    else if (pPredData->how == QOF_COMPARE_LTE
-             || (isInverted && pPredData->how == QOF_COMPARE_GT))
-        sql << "<=";
-    else if (pPredData->how == QOF_COMPARE_EQUAL
-             || (isInverted && pPredData->how == QOF_COMPARE_NEQ))
-        sql << "=";
-    else if (pPredData->how == QOF_COMPARE_GT
-             || (isInverted && pPredData->how == QOF_COMPARE_LTE))
-        sql << ">";
-    else if (pPredData->how == QOF_COMPARE_GTE
-             || (isInverted && pPredData->how == QOF_COMPARE_LT))
-        sql << ">=";
-    else if (pPredData->how == QOF_COMPARE_NEQ
-             || (isInverted && pPredData->how == QOF_COMPARE_EQUAL))
-        sql <<  "~=";
-    else
+/* ================================================================= */
+/* Query compilation
+ *
+ * When transactions are loaded as needed a split or transaction query is
+ * turned into a condition on the rows of the splits table (alias s) joined
+ * with the transactions table (alias t), and the transactions having a
+ * matching row are loaded before the engine runs the query.  The condition
+ * only needs to select a superset of the query's results, since the engine
+ * still checks every object, so a term is translated only as far as that can
+ * be done exactly or by erring on the side of loading too much.  Terms that
+ * can't be translated drop out of their AND group, and an OR group with no
+ * terms left matches every row.  Only a query whose terms were all translated
+ * exactly may be cut off at its max_results-th row in SQL, otherwise rows
+ * the engine rejects could push out older matches.
+ */
+
+/* Where the query parameters live, with paths relative to a split. */
+static const struct
+{
+    std::vector<std::string> path;
+    const char* column;
+    const char* type;
+} query_columns[]
+{
+    {{QOF_PARAM_GUID}, "s.guid", QOF_TYPE_GUID},
+    {{SPLIT_ACCOUNT, QOF_PARAM_GUID}, "s.account_guid", QOF_TYPE_GUID},
+    {{SPLIT_ACCOUNT_GUID}, "s.account_guid", QOF_TYPE_GUID},
+    {{SPLIT_MEMO}, "s.memo", QOF_TYPE_STRING},
+    {{SPLIT_ACTION}, "s.action", QOF_TYPE_STRING},
+    {{SPLIT_RECONCILE}, "s.reconcile_state", QOF_TYPE_CHAR},
+    {{SPLIT_DATE_RECONCILED}, "s.reconcile_date", QOF_TYPE_DATE},
+    {{SPLIT_VALUE}, "s.value", QOF_TYPE_NUMERIC},
+    {{SPLIT_AMOUNT}, "s.quantity", QOF_TYPE_NUMERIC},
+    {{SPLIT_TRANS, QOF_PARAM_GUID}, "t.guid", QOF_TYPE_GUID},
+    {{SPLIT_TRANS, TRANS_NUM}, "t.num", QOF_TYPE_STRING},
+    {{SPLIT_TRANS, TRANS_DESCRIPTION}, "t.description", QOF_TYPE_STRING},
+    {{SPLIT_TRANS, TRANS_DATE_POSTED}, "t.post_date", QOF_TYPE_DATE},
+    {{SPLIT_TRANS, TRANS_DATE_ENTERED}, "t.enter_date", QOF_TYPE_DATE},
+    /* The accounts of all of the transaction's splits, see
+     * xaccQueryAddAccountMatch(). */
+    {{SPLIT_TRANS, TRANS_SPLITLIST, SPLIT_ACCOUNT_GUID}, SPLIT_TABLE,
+     QOF_TYPE_GUID},
+};
+
+/* Dates compared by day are widened by this much on either side. */
+#define QUERY_DAY_MARGIN (2 * 86400)
+/* Amounts are compared as floating point with this much slack; the engine
+ * considers amounts equal if they agree to four decimal places. */
+#define QUERY_AMOUNT_MARGIN 0.0002
+
+static const char*
+query_column_type (const char* column)
+{
+    for (const auto& entry : query_columns)
+        if (strcmp (entry.column, column) == 0)
+            return entry.type;
+    return nullptr;
+}
+
+static const char*
+query_path_column (QofQueryParamList* param_path, bool for_splits)
+{
+    std::vector<std::string> path;
+    if (!for_splits)
+        path.emplace_back (SPLIT_TRANS);
+    for (auto node = param_path; node != nullptr; node = node->next)
+        path.emplace_back (static_cast<const char*>(node->data));
+
+    for (const auto& entry : query_columns)
+        if (entry.path == path)
+            return entry.column;
+    return nullptr;
+}
+
+static QofQueryCompare
+invert_query_comparison (QofQueryCompare how)
+{
+    switch (how)
     {
-        PERR ("Unknown comparison type\n");
-        sql << "??";
+    case QOF_COMPARE_LT:
+        return QOF_COMPARE_GTE;
+    case QOF_COMPARE_LTE:
+        return QOF_COMPARE_GT;
+    case QOF_COMPARE_EQUAL:
+        return QOF_COMPARE_NEQ;
+    case QOF_COMPARE_GT:
+        return QOF_COMPARE_LTE;
+    case QOF_COMPARE_GTE:
+        return QOF_COMPARE_LT;
+    case QOF_COMPARE_NEQ:
+        return QOF_COMPARE_EQUAL;
+    case QOF_COMPARE_CONTAINS:
+        return QOF_COMPARE_NCONTAINS;
+    case QOF_COMPARE_NCONTAINS:
+        return QOF_COMPARE_CONTAINS;
     }
+    return how;
 }
 
-static void
-convert_query_term_to_sql (const GncSqlBackend* sql_be, const gchar* fieldName,
-                           QofQueryTerm* pTerm, std::stringstream& sql)
+static std::string
+format_query_double (double val)
 {
-    QofQueryPredData* pPredData;
-    gboolean isInverted;
+    std::ostringstream str;
+    str.imbue (std::locale::classic());
+    str << std::setprecision (std::numeric_limits<double>::max_digits10)
+        << val;
+    return str.str();
+}
 
-    g_return_if_fail (pTerm != NULL);
+static std::string
+format_query_time (time64 t)
+{
+    if (t <= MINTIME || t >= MAXTIME)
+        return "";
+    char timestr[MAX_DATE_LENGTH + 1];
+    gnc_time64_to_iso8601_buff (t, timestr);
+    return "'" + std::string{timestr} + "'";
+}
+
+static std::string
+guid_list_to_sql (GList* guids)
+{
+    std::string sql;
+    for (auto node = guids; node != nullptr; node = node->next)
+    {
+        if (!sql.empty())
+            sql += ",";
+        sql += "'" + gnc::GUID(*static_cast<GncGUID*>(node->data)).to_string()
+            + "'";
+    }
+    return sql;
+}
 
-    pPredData = qof_query_term_get_pred_data (pTerm);
-    isInverted = qof_query_term_is_inverted (pTerm);
+static std::string
+convert_guid_term_to_sql (const std::string& column, query_guid_t pdata,
+                          bool inverted)
+{
+    auto guids = guid_list_to_sql (pdata->guids);
+    if (guids.empty())
+        return "";
 
-    if (g_strcmp0 (pPredData->type_name, QOF_TYPE_GUID) == 0)
+    if (column == SPLIT_TABLE)
     {
-        query_guid_t guid_data = (query_guid_t)pPredData;
-        GList* guid_entry;
-        sql << "(" << fieldName;
+        /* The transaction must have a split in each of the accounts, so it
+         * has at least one in one of them. */
+        if (pdata->options != QOF_GUID_MATCH_ALL || inverted)
+            return "";
+        const std::string stkey(split_col_table[1]->name());
+        const std::string sakey(split_col_table[2]->name());
+        return "t.guid IN (SELECT " + stkey + " FROM " SPLIT_TABLE " WHERE " +
+            sakey + " IN (" + guids + "))";
+    }
 
-        switch (guid_data->options)
-        {
-        case QOF_GUID_MATCH_ANY:
-            sql << (isInverted ? " NOT IN (" : " IN (");
-            break;
+    bool any;
+    if (pdata->options == QOF_GUID_MATCH_ANY)
+        any = !inverted;
+    else if (pdata->options == QOF_GUID_MATCH_NONE)
+        any = inverted;
+    else
+        return "";
+    return column + (any ? " IN (" : " NOT IN (") + guids + ")";
+}
 
-        case QOF_GUID_MATCH_NONE:
-            sql << (isInverted ? " IN (" : " NOT IN (");
-            break;
+static std::string
+convert_char_term_to_sql (const GncSqlBackend* sql_be,
+                          const std::string& column, query_char_t pdata,
+                          bool inverted)
+{
+    bool any;
+    if (pdata->options == QOF_CHAR_MATCH_ANY)
+        any = !inverted;
+    else if (pdata->options == QOF_CHAR_MATCH_NONE)
+        any = inverted;
+    else
+        return "";
 
-        default:
-            PERR ("Unexpected GncGUID match type: %d\n", guid_data->options);
-        }
+    std::string chars;
+    for (auto c = pdata->char_list; *c != '\0'; ++c)
+    {
+        if (!chars.empty())
+            chars += ",";
+        chars += sql_be->quote_string (std::string(1, *c));
+    }
+    if (chars.empty())
+        return "";
+    return column + (any ? " IN (" : " NOT IN (") + chars + ")";
+}
 
-        for (guid_entry = guid_data->guids; guid_entry != NULL;
-             guid_entry = guid_entry->next)
-        {
-            gchar guid_buf[GUID_ENCODING_LENGTH + 1];
+static std::string
+convert_string_term_to_sql (const GncSqlBackend* sql_be,
+                            const std::string& column, query_string_t pdata,
+                            bool inverted)
+{
+    /* Negations of string matches would have to be exact, which they can't
+     * be with every database's collation. Regular expressions are left to
+     * the engine. */
+    if (pdata->is_regex || inverted)
+        return "";
 
-            if (guid_entry != guid_data->guids) sql << ",";
-            (void)guid_to_string_buff (static_cast<GncGUID*> (guid_entry->data),
-                                       guid_buf);
-            sql << guid_buf;
-        }
-        sql << "))";
+    std::string value{pdata->matchstring ? pdata->matchstring : ""};
+    auto nocase = pdata->options == QOF_STRING_MATCH_CASEINSENSITIVE;
+    auto col = "COALESCE(" + column + ", '')";
 
+    if (pdata->pd.how == QOF_COMPARE_EQUAL)
+    {
+        /* The engine compares case-insensitive strings by collation. */
+        if (nocase)
+            return "";
+        return col + " = " + sql_be->quote_string (value);
     }
-    else if (g_strcmp0 (pPredData->type_name, QOF_TYPE_CHAR) == 0)
+    if (pdata->pd.how != QOF_COMPARE_CONTAINS)
+        return "";
+
+    /* LIKE ignores the case of ASCII letters in SQLite and, with the usual
+     * collations, in MySQL, so it can stand in for strstr() there. The
+     * engine folds the case of all of Unicode, which LOWER() can't be relied
+     * on to do, so only ASCII patterns are matched case-insensitively.
+     * Compatibility characters such as ligatures in the stored text aren't
+     * decomposed like qof_utf8_substr_nocase() does. */
+    if (nocase)
     {
-        query_char_t char_data = (query_char_t)pPredData;
-        int i;
+        if (!g_str_is_ascii (value.c_str()))
+            return "";
+        auto lower = g_ascii_strdown (value.c_str(), -1);
+        value = lower;
+        g_free (lower);
+        col = "LOWER(" + col + ")";
+    }
 
-        if (isInverted) sql <<  "NOT(";
-        if (char_data->options == QOF_CHAR_MATCH_NONE) sql << "NOT ";
-        sql << "(";
-        for (i = 0; char_data->char_list[i] != '\0'; i++)
-        {
-            if (i != 0) sql << " OR ";
-            sql << fieldName << " = '" << char_data->char_list[i] << "'";
-        }
-        sql << ") ";
-        if (isInverted) sql << ") ";
+    std::string pattern{"%"};
+    for (auto c : value)
+    {
+        if (c == '!' || c == '%' || c == '_')
+            pattern += '!';
+        pattern += c;
     }
-    else if (g_strcmp0 (pPredData->type_name, QOF_TYPE_STRING) == 0)
+    pattern += "%";
+    return col + " LIKE " + sql_be->quote_string (pattern) + " ESCAPE '!'";
+}
+
+static std::string
+convert_date_term_to_sql (const std::string& column, query_date_t pdata,
+                          bool inverted)
+{
+    auto how = inverted ? invert_query_comparison (pdata->pd.how)
+        : pdata->pd.how;
+    time64 margin = pdata->options == QOF_DATE_MATCH_DAY ? QUERY_DAY_MARGIN : 0;
+    auto lower = format_query_time (pdata->date - margin);
+    auto upper = format_query_time (pdata->date + margin);
+    if (lower.empty() || upper.empty())
+        return "";
+
+    std::string sql;
+    switch (how)
     {
-        query_string_t string_data = (query_string_t)pPredData;
-        sqlEscape* escape = sqlEscape_new ();
+    case QOF_COMPARE_LT:
+        sql = column + (margin ? " <= " : " < ") + upper;
+        break;
+    case QOF_COMPARE_LTE:
+        sql = column + " <= " + upper;
+        break;
+    case QOF_COMPARE_GT:
+        sql = column + (margin ? " >= " : " > ") + lower;
+        break;
+    case QOF_COMPARE_GTE:
+        sql = column + " >= " + lower;
+        break;
+    case QOF_COMPARE_EQUAL:
+        sql = column + " >= " + lower + " AND " + column + " <= " + upper;
+        break;
+    default:
+        return "";
+    }
+    /* Missing dates are replaced when the object is loaded. */
+    return column + " IS NULL OR (" + sql + ")";
+}
 
-        if (isInverted ||  pPredData->how == QOF_COMPARE_NEQ)
-            sql << "NOT(";
-        sql << fieldName;
-        if (string_data->is_regex ||
-            string_data->options == QOF_STRING_MATCH_CASEINSENSITIVE)
-        {
-            PWARN ("String is_regex || option = QOF_STRING_MATCH_INSENSITIVE\n");
-        }
-//          sql << " ~" ;
-//      } else {
-        sql << " =";
-//      }
-//      if( string_data->options == QOF_STRING_MATCH_CASEINSENSITIVE ) {
-//          sql+= "*";
-//      }
-        sql << "'" << sqlEscapeString (escape, string_data->matchstring) << "'";
-        if (pPredData->how == QOF_COMPARE_NEQ) sql << ")";
-        if (isInverted) sql << ")";
-        sqlEscape_destroy (escape);
+static std::string
+convert_numeric_term_to_sql (const std::string& column, query_numeric_t pdata,
+                             bool inverted)
+{
+    /* The engine compares the absolute value of the amount. */
+    auto num = column + "_num";
+    auto val = "ABS(1.0 * " + num + " / NULLIF(" + column + "_denom, 0))";
+    auto amount = gnc_numeric_to_double (pdata->amount);
+    auto below = format_query_double (amount - QUERY_AMOUNT_MARGIN);
+    auto above = format_query_double (amount + QUERY_AMOUNT_MARGIN);
+
+    std::string sign;
+    if (pdata->options == QOF_NUMERIC_MATCH_CREDIT)
+        sign = num + " <= 0";
+    else if (pdata->options == QOF_NUMERIC_MATCH_DEBIT)
+        sign = num + " >= 0";
+    /* The negation of the sign test and the comparison is an OR of their
+     * negations; leave that to the engine. */
+    if (inverted && !sign.empty())
+        return "";
+
+    auto how = inverted ? invert_query_comparison (pdata->pd.how)
+        : pdata->pd.how;
+    std::string sql;
+    switch (how)
+    {
+    case QOF_COMPARE_LT:
+    case QOF_COMPARE_LTE:
+        sql = val + " <= " + above;
+        break;
+    case QOF_COMPARE_GT:
+    case QOF_COMPARE_GTE:
+        sql = val + " >= " + below;
+        break;
+    case QOF_COMPARE_EQUAL:
+        amount = fabs (amount);
+        sql = val + " >= " + format_query_double (amount - QUERY_AMOUNT_MARGIN) +
+            " AND " + val + " <= " +
+            format_query_double (amount + QUERY_AMOUNT_MARGIN);
+        break;
+    default:
+        break;
+    }
+    if (sign.empty())
+        return sql;
+    if (sql.empty())
+        return sign;
+    return sign + " AND " + sql;
+}
+
+/**
+ * Translates a query term into an SQL condition selecting at least the rows
+ * that match it.
+ *
+ * @param exact Set to whether the condition selects exactly those rows.
+ * String matches depend on the database's collation and amounts are compared
+ * with some slack, so those are never exact.
+ * @return The condition, or an empty string if it would select every row.
+ */
+static std::string
+convert_query_term_to_sql (const GncSqlBackend* sql_be,
+                           const std::string& column, QofQueryTerm* pTerm,
+                           bool& exact)
+{
+    exact = false;
+    g_return_val_if_fail (pTerm != NULL, "");
+
+    auto pPredData = qof_query_term_get_pred_data (pTerm);
+    bool isInverted = qof_query_term_is_inverted (pTerm);
+    auto type = query_column_type (column.c_str());
 
+    if (g_strcmp0 (pPredData->type_name, type) != 0)
+        return "";
+    if (g_strcmp0 (type, QOF_TYPE_GUID) == 0)
+    {
+        exact = column != SPLIT_TABLE;
+        return convert_guid_term_to_sql (column, (query_guid_t)pPredData,
+                                         isInverted);
     }
-    else
+    if (g_strcmp0 (type, QOF_TYPE_CHAR) == 0)
+    {
+        exact = true;
+        return convert_char_term_to_sql (sql_be, column, (query_char_t)pPredData,
+                                         isInverted);
+    }
+    if (g_strcmp0 (type, QOF_TYPE_STRING) == 0)
+        return convert_string_term_to_sql (sql_be, column,
+                                           (query_string_t)pPredData,
+                                           isInverted);
+    if (g_strcmp0 (type, QOF_TYPE_DATE) == 0)
     {
-        sql << "(" << fieldName;
-        convert_query_comparison_to_sql (pPredData, isInverted, sql);
+        exact = ((query_date_t)pPredData)->options != QOF_DATE_MATCH_DAY;
+        return convert_date_term_to_sql (column, (query_date_t)pPredData,
+                                         isInverted);
+    }
+    if (g_strcmp0 (type, QOF_TYPE_NUMERIC) == 0)
+        return convert_numeric_term_to_sql (column, (query_numeric_t)pPredData,
+                                            isInverted);
+    return "";
+}
 
-        if (strcmp (pPredData->type_name, QOF_TYPE_NUMERIC) == 0)
-        {
-            query_numeric_t pData = (query_numeric_t)pPredData;
-            sql << gnc_numeric_to_double (pData->amount);
-        }
-        else if (g_strcmp0 (pPredData->type_name, QOF_TYPE_DATE) == 0)
-        {
-            query_date_t date_data = (query_date_t)pPredData;
+GncSqlTxQuery*
+gnc_sql_compile_tx_query (const GncSqlBackend* sql_be, QofQuery* query)
+{
+    g_return_val_if_fail (sql_be != NULL, nullptr);
+    g_return_val_if_fail (query != NULL, nullptr);
+
+    auto search_for = qof_query_get_search_for (query);
+    bool for_splits;
+    if (g_strcmp0 (search_for, GNC_ID_SPLIT) == 0)
+        for_splits = true;
+    else if (g_strcmp0 (search_for, GNC_ID_TRANS) == 0)
+        for_splits = false;
+    else
+        return nullptr;
 
-            GncDateTime time(date_data->date);
-            sql << time.format_iso8601();
-        }
-        else if (strcmp (pPredData->type_name, QOF_TYPE_INT32) == 0)
+    auto compiled = new GncSqlTxQuery;
+    compiled->for_splits = for_splits;
+
+    /* The terms are an OR of ANDs. */
+    std::string where;
+    bool exact = true;
+    for (auto or_node = qof_query_get_terms (query); or_node != nullptr;
+         or_node = or_node->next)
+    {
+        std::string and_sql;
+        for (auto and_node = static_cast<GList*>(or_node->data);
+             and_node != nullptr; and_node = and_node->next)
         {
-            query_int32_t pData = (query_int32_t)pPredData;
-            sql << pData->val;
+            auto term = static_cast<QofQueryTerm*>(and_node->data);
+            auto column =
+                query_path_column (qof_query_term_get_param_path (term),
+                                   for_splits);
+            if (column == nullptr)
+            {
+                exact = false;
+                continue;
+            }
+            bool term_exact;
+            auto sql = convert_query_term_to_sql (sql_be, column, term,
+                                                  term_exact);
+            if (sql.empty())
+            {
+                exact = false;
+                continue;
+            }
+            exact = exact && term_exact;
+            if (!and_sql.empty())
+                and_sql += " AND ";
+            and_sql += "(" + sql + ")";
         }
-        else if (strcmp (pPredData->type_name, QOF_TYPE_INT64) == 0)
+        if (and_sql.empty())
         {
-            query_int64_t pData = (query_int64_t)pPredData;
-            sql << pData->val;
+            where.clear();
+            break;
         }
-        else if (strcmp (pPredData->type_name, QOF_TYPE_DOUBLE) == 0)
+        if (!where.empty())
+            where += " OR ";
+        where += "(" + and_sql + ")";
+    }
+    compiled->where = where;
+
+    /* A query keeping only its last max_results results can be cut off at
+     * the sort key of the max_results-th row if it's sorted by a date and
+     * the condition selects just its results. */
+    auto max_results = qof_query_get_max_results (query);
+    if (max_results > 0 && exact)
+    {
+        QofQuerySort *primary, *secondary, *tertiary;
+        qof_query_get_sorts (query, &primary, &secondary, &tertiary);
+        auto column =
+            query_path_column (qof_query_sort_get_param_path (primary),
+                               for_splits);
+        if (column != nullptr &&
+            g_strcmp0 (query_column_type (column), QOF_TYPE_DATE) == 0)
         {
-            query_double_t pData = (query_double_t)pPredData;
-            sql << pData->val;
+            compiled->sort_column = column;
+            compiled->increasing = qof_query_sort_get_increasing (primary);
+            compiled->max_results = max_results;
         }
-        else if (strcmp (pPredData->type_name, QOF_TYPE_BOOLEAN) == 0)
+    }
+    return compiled;
+}
+
+/* The sort key of the max_results-th row from the end, widened by a margin
+ * for sorts by day, or an empty string if there are fewer rows. */
+static std::string
+tx_query_sort_bound (GncSqlBackend* sql_be, const GncSqlTxQuery* query,
+                     const std::string& from)
+{
+    const auto& column = query->sort_column;
+    auto name = column.substr (column.find ('.') + 1);
+    std::string sql{"SELECT " + column + " FROM " + from + " WHERE " +
+        column + " IS NOT NULL"};
+    if (!query->where.empty())
+        sql += " AND (" + query->where + ")";
+    sql += " ORDER BY " + column + (query->increasing ? " DESC" : " ASC") +
+        " LIMIT 1 OFFSET " + std::to_string (query->max_results - 1);
+
+    auto stmt = sql_be->create_statement_from_sql (sql);
+    if (stmt == nullptr)
+        return "";
+    auto result = sql_be->execute_select_statement (stmt);
+    if (result == nullptr || result->begin() == result->end())
+        return "";
+
+    auto row = *result->begin();
+    time64 t;
+    try
+    {
+        t = row.get_time64_at_col (name.c_str());
+    }
+    catch (std::invalid_argument&)
+    {
+        try
         {
-            query_boolean_t pData = (query_boolean_t)pPredData;
-            sql << pData->val;
+            t = gnc_iso8601_to_time64_gmt (row.get_string_at_col (name.c_str()).c_str());
         }
-        else
+        catch (const std::exception&)
         {
-            PERR ("Unknown query predicate type: %s\n", pPredData->type_name);
+            return "";
         }
+        if (t == INT64_MAX)
+            return "";
+    }
 
-        sql << ")";
+    auto bound = format_query_time (query->increasing ? t - QUERY_DAY_MARGIN
+                                    : t + QUERY_DAY_MARGIN);
+    if (bound.empty())
+        return "";
+    return column + " IS NULL OR " + column +
+        (query->increasing ? " >= " : " <= ") + bound;
+}
+
+std::string
+gnc_sql_tx_query_selector (GncSqlBackend* sql_be, const GncSqlTxQuery* query)
+{
+    g_return_val_if_fail (sql_be != NULL, "");
+    g_return_val_if_fail (query != NULL, "");
+
+    const std::string tpkey(tx_col_table[0]->name());
+    const std::string stkey(split_col_table[1]->name());
+    std::string from, key;
+    if (query->for_splits)
+    {
+        from = SPLIT_TABLE " s INNER JOIN " TRANSACTION_TABLE " t ON s." +
+            stkey + " = t." + tpkey;
+        key = "s." + stkey;
+    }
+    else
+    {
+        from = TRANSACTION_TABLE " t";
+        key = "t." + tpkey;
+    }
+
+    auto where = query->where;
+    if (!query->sort_column.empty())
+    {
+        auto bound = tx_query_sort_bound (sql_be, query, from);
+        if (!bound.empty())
+            where = where.empty() ? bound : "(" + where + ") AND (" + bound + ")";
     }
+    if (where.empty())
+        return "";
+    return "(SELECT DISTINCT " + key + " FROM " + from + " WHERE " + where + ")";
 }
 
-typedef struct
+void
+gnc_sql_transaction_load_tx_for_selector (GncSqlBackend* sql_be,
+                                          const std::string& selector)
 {
-    GncSqlStatementPtr stmt;
-    gboolean has_been_run;
-} split_query_info_t;
+    g_return_if_fail (sql_be != NULL);
+    g_return_if_fail (!selector.empty());
+
+    query_transactions (sql_be, selector);
+}
 
 /* ----------------------------------------------------------------- */
 typedef struct
@@ -35,6 +35,8 @@ extern "C"
 #include "qof.h"
 #include "Account.h"
 }
+#include <string>
+
 class GncSqlTransBackend : public GncSqlObjectBackend
 {
 public:
@@ -61,6 +63,53 @@ public:
  */
 void gnc_sql_transaction_load_tx_for_account (GncSqlBackend* sql_be,
                                               Account* account);
+
+/**
+ * A split or transaction query translated to SQL by
+ * gnc_sql_compile_tx_query().
+ */
+struct GncSqlTxQuery
+{
+    bool for_splits = true;  /**< Searching for splits, else transactions */
+    std::string where;       /**< Condition on the splits (s) and
+                              * transactions (t) tables, empty for all rows */
+    std::string sort_column; /**< Date column the results are cut off by */
+    bool increasing = true;  /**< Sort direction of sort_column */
+    int max_results = -1;    /**< Number of results kept by the query */
+};
+
+/**
+ * Translates a split or transaction query into SQL. The translation selects
+ * at least the rows that match the query, but may select more.
+ *
+ * @param sql_be SQL backend
+ * @param query The query
+ * @return The translation, to be freed with delete, or nullptr if the query
+ * doesn't search for splits or transactions.
+ */
+GncSqlTxQuery* gnc_sql_compile_tx_query (const GncSqlBackend* sql_be,
+                                         QofQuery* query);
+
+/**
+ * Creates a subselect of the guids of the transactions that might match a
+ * compiled query, for gnc_sql_transaction_load_tx_for_selector().
+ *
+ * @param sql_be SQL backend
+ * @param query Compiled query
+ * @return The subselect, or an empty string if any transaction might match.
+ */
+std::string gnc_sql_tx_query_selector (GncSqlBackend* sql_be,
+                                       const GncSqlTxQuery* query);
+
+/**
+ * Loads the transactions selected by a subselect of transaction guids, along
+ * with their splits and slots.
+ *
+ * @param sql_be SQL backend
+ * @param selector Subselect
+ */
+void gnc_sql_transaction_load_tx_for_selector (GncSqlBackend* sql_be,
+                                               const std::string& selector);
 typedef struct
 {
     Account* acct;
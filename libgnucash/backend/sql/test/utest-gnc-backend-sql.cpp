@@ -30,6 +30,7 @@ extern "C"
 /* Add specific headers for this class */
 #include "../gnc-sql-connection.hpp"
 #include "../gnc-sql-backend.hpp"
+#include "../gnc-sql-insert-batch.hpp"
 #include "../gnc-sql-result.hpp"
 
 static const gchar* suitename = "/backend/sql/gnc-backend-sql";
@@ -125,6 +126,31 @@ private:
     GncMockSqlResult m_result;
 };
 
+class GncMockSqlTextStatement : public GncSqlStatement
+{
+public:
+    GncMockSqlTextStatement(const std::string& sql) : m_sql{sql} {}
+    const char* to_sql() const { return m_sql.c_str(); }
+    void add_where_cond (QofIdTypeConst, const PairVec&) {}
+private:
+    std::string m_sql;
+};
+
+/* Records the statements it is given instead of running them. */
+class GncRecordingSqlConnection : public GncMockSqlConnection
+{
+public:
+    int execute_nonselect_statement (const GncSqlStatementPtr& stmt)
+        noexcept override {
+        m_statements.push_back (stmt->to_sql());
+        return m_fail ? -1 : 1; }
+    GncSqlStatementPtr create_statement_from_sql (const std::string& sql)
+        const noexcept override {
+        return std::unique_ptr<GncSqlStatement>(new GncMockSqlTextStatement(sql)); }
+    std::vector<std::string> m_statements;
+    bool m_fail = false;
+};
+
 /* gnc_sql_init
 void
 gnc_sql_init (GncSqlBackend* sql_be)// C: 1 */
@@ -744,6 +770,61 @@ GncSqlBackend::do_db_operation (GncSqlBackend* sql_be,// C: 22 in 12 */
 test_gnc_sql_do_db_operation (Fixture *fixture, gconstpointer pData)
 {
 }*/
+static void
+test_insert_batch (void)
+{
+    GncRecordingSqlConnection conn;
+    GncSqlInsertBatch batch{&conn, 2};
+    auto& stmts = conn.m_statements;
+    const char* msg =
+        "[GncSqlInsertBatch::write_rows()] Failed to insert 2 rows into t\n";
+    GLogLevelFlags loglevel = static_cast<decltype (loglevel)>
+                              (G_LOG_LEVEL_CRITICAL | G_LOG_FLAG_FATAL);
+    const char* logdomain = "gnc.backend.sql";
+    TestErrorStruct check = { loglevel, const_cast<char*> (logdomain),
+                              const_cast<char*> (msg), 0
+                            };
+    guint hdlr;
+
+    /* Rows are written when a table has max_rows of them... */
+    g_assert (batch.add_row ("t", {{"guid", "'a'"}, {"name", "'x'"}}));
+    g_assert (batch.add_row ("u", {{"guid", "'b'"}}));
+    g_assert_cmpint (stmts.size(), ==, 0);
+    g_assert (batch.add_row ("t", {{"guid", "'c'"}, {"name", "'y'"}}));
+    g_assert_cmpint (stmts.size(), ==, 1);
+    g_assert_cmpstr (stmts[0].c_str(), ==,
+                     "INSERT INTO t(guid,name) VALUES('a','x'),('c','y')");
+
+    /* ...or the next row has other columns... */
+    g_assert (batch.add_row ("t", {{"guid", "'d'"}}));
+    g_assert (batch.add_row ("t", {{"guid", "'e'"}, {"name", "'z'"}}));
+    g_assert_cmpint (stmts.size(), ==, 2);
+    g_assert_cmpstr (stmts[1].c_str(), ==, "INSERT INTO t(guid) VALUES('d')");
+
+    /* ...or the batch is flushed. */
+    g_assert (batch.flush());
+    g_assert (batch.empty());
+    g_assert_cmpint (stmts.size(), ==, 4);
+    g_assert_cmpstr (stmts[2].c_str(), ==,
+                     "INSERT INTO t(guid,name) VALUES('e','z')");
+    g_assert_cmpstr (stmts[3].c_str(), ==, "INSERT INTO u(guid) VALUES('b')");
+
+    /* A failed statement fails the rest of the batch. */
+    test_add_error (&check);
+    hdlr = g_log_set_handler (logdomain, loglevel,
+                              (GLogFunc)test_list_handler, NULL);
+    g_test_log_set_fatal_handler ((GTestLogFatalFunc)test_list_handler, NULL);
+    conn.m_fail = true;
+    g_assert (batch.add_row ("t", {{"guid", "'f'"}}));
+    g_assert (!batch.add_row ("t", {{"guid", "'g'"}}));
+    g_assert (!batch.add_row ("u", {{"guid", "'h'"}}));
+    g_assert (!batch.flush());
+    g_assert_cmpint (stmts.size(), ==, 5);
+    g_assert_cmpint (check.hits, ==, 1);
+
+    g_log_remove_handler (logdomain, hdlr);
+    test_clear_error_list ();
+}
 /* gnc_sql_get_sql_value
 gchar*
 gnc_sql_get_sql_value (const GncSqlConnection* conn, const GValue* value)// C: 1 */
@@ -915,6 +996,7 @@ test_suite_gnc_backend_sql (void)
 // GNC_TEST_ADD (suitename, "gnc sql append guid list to sql", Fixture, nullptr, test_gnc_sql_append_guid_list_to_sql,  teardown);
 // GNC_TEST_ADD (suitename, "gnc sql object is it in db", Fixture, nullptr, test_gnc_sql_object_is_it_in_db,  teardown);
 // GNC_TEST_ADD (suitename, "gnc sql do db operation", Fixture, nullptr, test_gnc_sql_do_db_operation,  teardown);
+    GNC_TEST_ADD_FUNC (suitename, "insert batch", test_insert_batch);
 // GNC_TEST_ADD (suitename, "gnc sql get sql value", Fixture, nullptr, test_gnc_sql_get_sql_value,  teardown);
 // GNC_TEST_ADD (suitename, "build insert statement", Fixture, nullptr, test_build_insert_statement,  teardown);
 // GNC_TEST_ADD (suitename, "build update statement", Fixture, nullptr, test_build_update_statement,  teardown);
@@ -35,9 +35,12 @@ extern "C"
 #include "sixtp-parsers.h"
 #include "sixtp-dom-parsers.h"
 #include "sixtp-dom-generators.h"
+#include "sixtp-sax-builder.hpp"
 #include "io-gncxml-gen.h"
 #include "io-gncxml-v2.h"
 
+#include <vector>
+
 /* This static indicates the debugging module that this .o belongs to.  */
 static QofLogModule log_module = GNC_MOD_IO;
 
@@ -78,150 +81,211 @@ static QofLogModule log_module = GNC_MOD_IO;
 /****************************************************************************/
 /* <price>
 
-  restores a price.  Does so via a walk of the XML tree in memory.
-  Returns a GNCPrice * in result.
+  restores a price.  Does so straight from the SAX events, without an
+  XML tree in memory.  Returns a GNCPrice * in result.
 
   Right now, a price is legitimate even if all of it's fields are not
   set.  We may need to change that later, but at the moment.
 
 */
 
-static gboolean
-price_parse_xml_sub_node (GNCPrice* p, xmlNodePtr sub_node, QofBook* book)
+enum price_sax_element
+{
+    PRICE_SAX_IGNORED,
+    PRICE_SAX_ID,
+    PRICE_SAX_COMMODITY,
+    PRICE_SAX_CURRENCY,
+    PRICE_SAX_TIME,
+    PRICE_SAX_SOURCE,
+    PRICE_SAX_TYPE,
+    PRICE_SAX_VALUE,
+    PRICE_SAX_TS_DATE,
+    PRICE_SAX_CMDTY_SPACE,
+    PRICE_SAX_CMDTY_ID,
+};
+
+static const struct
+{
+    const char* tag;
+    price_sax_element element;
+} price_sax_tags[] =
+{
+    { "price:id", PRICE_SAX_ID },
+    { "price:commodity", PRICE_SAX_COMMODITY },
+    { "price:currency", PRICE_SAX_CURRENCY },
+    { "price:time", PRICE_SAX_TIME },
+    { "price:source", PRICE_SAX_SOURCE },
+    { "price:type", PRICE_SAX_TYPE },
+    { "price:value", PRICE_SAX_VALUE },
+};
+
+class PriceSaxBuilder : public GncSaxBuilder
 {
-    if (!p || !sub_node) return FALSE;
+public:
+    PriceSaxBuilder (QofBook* book);
+    ~PriceSaxBuilder ();
+    void start_element (const gchar* tag, gchar** attrs) override;
+    void end_element (const gchar* tag) override;
+    gboolean finish (gxpf_data* gdata, const gchar* tag,
+                     gpointer* result) override;
+
+private:
+    QofBook* m_book;
+    GNCPrice* m_price;
+    std::vector<price_sax_element> m_elements;
+    gboolean m_has_children = FALSE;
+    gboolean m_ok = TRUE;
+    gboolean m_guid_ok = FALSE;
+    GncSaxTime m_time;
+    GncSaxCommodityRef m_commodity;
+};
+
+PriceSaxBuilder::PriceSaxBuilder (QofBook* book) : m_book {book}
+{
+    m_price = gnc_price_create (book);
+    gnc_price_begin_edit (m_price);
+}
 
-    gnc_price_begin_edit (p);
-    if (g_strcmp0 ("price:id", (char*)sub_node->name) == 0)
-    {
-        GncGUID* c = dom_tree_to_guid (sub_node);
-        if (!c) return FALSE;
-        gnc_price_set_guid (p, c);
-        guid_free (c);
-    }
-    else if (g_strcmp0 ("price:commodity", (char*)sub_node->name) == 0)
-    {
-        gnc_commodity* c = dom_tree_to_commodity_ref (sub_node, book);
-        if (!c) return FALSE;
-        gnc_price_set_commodity (p, c);
-    }
-    else if (g_strcmp0 ("price:currency", (char*)sub_node->name) == 0)
-    {
-        gnc_commodity* c = dom_tree_to_commodity_ref (sub_node, book);
-        if (!c) return FALSE;
-        gnc_price_set_currency (p, c);
-    }
-    else if (g_strcmp0 ("price:time", (char*)sub_node->name) == 0)
-    {
-        time64 time = dom_tree_to_time64 (sub_node);
-        if (!dom_tree_valid_time64 (time, sub_node->name)) time = 0;
-        gnc_price_set_time64 (p, time);
-    }
-    else if (g_strcmp0 ("price:source", (char*)sub_node->name) == 0)
-    {
-        char* text = dom_tree_to_text (sub_node);
-        if (!text) return FALSE;
-        gnc_price_set_source_string (p, text);
-        g_free (text);
-    }
-    else if (g_strcmp0 ("price:type", (char*)sub_node->name) == 0)
-    {
-        char* text = dom_tree_to_text (sub_node);
-        if (!text) return FALSE;
-        gnc_price_set_typestr (p, text);
-        g_free (text);
-    }
-    else if (g_strcmp0 ("price:value", (char*)sub_node->name) == 0)
+PriceSaxBuilder::~PriceSaxBuilder ()
+{
+    if (m_price)
     {
-        gnc_numeric* value = dom_tree_to_gnc_numeric (sub_node);
-        if (!value) return FALSE;
-        gnc_price_set_value (p, *value);
-        g_free (value);
+        gnc_price_commit_edit (m_price);
+        gnc_price_unref (m_price);
     }
-    gnc_price_commit_edit (p);
-    return TRUE;
 }
 
-static gboolean
-price_parse_xml_end_handler (gpointer data_for_children,
-                             GSList* data_from_children,
-                             GSList* sibling_data,
-                             gpointer parent_data,
-                             gpointer global_data,
-                             gpointer* result,
-                             const gchar* tag)
+void
+PriceSaxBuilder::start_element (const gchar* tag, gchar** attrs)
 {
-    gboolean ok = TRUE;
-    xmlNodePtr price_xml = (xmlNodePtr) data_for_children;
-    xmlNodePtr child;
-    GNCPrice* p = NULL;
-    gxpf_data* gdata = static_cast<decltype (gdata)> (global_data);
-    QofBook* book = static_cast<decltype (book)> (gdata->bookdata);
-
-    /* we haven't been handed the *top* level node yet... */
-    if (parent_data) return TRUE;
+    auto element = PRICE_SAX_IGNORED;
 
-    *result = NULL;
-
-    if (!price_xml) return FALSE;
-    if (price_xml->next)
-    {
-        ok = FALSE;
-        goto cleanup_and_exit;
-    }
-    if (price_xml->prev)
+    m_has_children = TRUE;
+    if (m_elements.empty ())
     {
-        ok = FALSE;
-        goto cleanup_and_exit;
+        for (auto& t : price_sax_tags)
+            if (g_strcmp0 (tag, t.tag) == 0)
+            {
+                element = t.element;
+                break;
+            }
     }
-    if (!price_xml->xmlChildrenNode)
+    else
     {
-        ok = FALSE;
-        goto cleanup_and_exit;
+        switch (m_elements.back ())
+        {
+        case PRICE_SAX_COMMODITY:
+        case PRICE_SAX_CURRENCY:
+            if (g_strcmp0 ("cmdty:space", tag) == 0)
+                element = PRICE_SAX_CMDTY_SPACE;
+            else if (g_strcmp0 ("cmdty:id", tag) == 0)
+                element = PRICE_SAX_CMDTY_ID;
+            break;
+        case PRICE_SAX_TIME:
+            if (g_strcmp0 ("ts:date", tag) == 0)
+                element = PRICE_SAX_TS_DATE;
+            break;
+        default:
+            break;
+        }
     }
 
-    p = gnc_price_create (book);
-    if (!p)
+    switch (element)
     {
-        ok = FALSE;
-        goto cleanup_and_exit;
+    case PRICE_SAX_ID:
+        m_guid_ok = sax_attrs_guid_type (tag, attrs);
+        break;
+    case PRICE_SAX_COMMODITY:
+    case PRICE_SAX_CURRENCY:
+        m_commodity.reset ();
+        break;
+    case PRICE_SAX_TIME:
+        m_time.reset ();
+        break;
+    default:
+        break;
     }
+    m_elements.push_back (element);
+}
+
+void
+PriceSaxBuilder::end_element (const gchar* tag)
+{
+    auto element = m_elements.back ();
+    m_elements.pop_back ();
 
-    for (child = price_xml->xmlChildrenNode; child; child = child->next)
+    switch (element)
     {
-        switch (child->type)
+    case PRICE_SAX_ID:
+        if (m_guid_ok)
         {
-        case XML_COMMENT_NODE:
-        case XML_TEXT_NODE:
-            break;
-        case XML_ELEMENT_NODE:
-            if (!price_parse_xml_sub_node (p, child, book))
-            {
-                ok = FALSE;
-                goto cleanup_and_exit;
-            }
-            break;
-        default:
-            PERR ("Unknown node type (%d) while parsing gnc-price xml.", child->type);
-            child = NULL;
-            ok = FALSE;
-            goto cleanup_and_exit;
-            break;
+            auto guid = sax_text_to_guid (text ());
+            gnc_price_set_guid (m_price, &guid);
         }
+        else
+            m_ok = FALSE;
+        break;
+    case PRICE_SAX_CMDTY_SPACE:
+        m_commodity.set_space (text ());
+        break;
+    case PRICE_SAX_CMDTY_ID:
+        m_commodity.set_id (text ());
+        break;
+    case PRICE_SAX_COMMODITY:
+    case PRICE_SAX_CURRENCY:
+    {
+        auto c = m_commodity.lookup (m_book);
+        if (!c)
+            m_ok = FALSE;
+        else if (element == PRICE_SAX_COMMODITY)
+            gnc_price_set_commodity (m_price, c);
+        else
+            gnc_price_set_currency (m_price, c);
+        break;
     }
-
-cleanup_and_exit:
-    if (ok)
+    case PRICE_SAX_TS_DATE:
+        m_time.set_date (text ());
+        break;
+    case PRICE_SAX_TIME:
+        gnc_price_set_time64 (m_price, m_time.get (tag));
+        break;
+    case PRICE_SAX_SOURCE:
+        gnc_price_set_source_string (m_price, text ());
+        break;
+    case PRICE_SAX_TYPE:
+        gnc_price_set_typestr (m_price, text ());
+        break;
+    case PRICE_SAX_VALUE:
     {
-        *result = p;
+        gnc_numeric value;
+        if (!sixtp_string_to_gnc_numeric (text (), &value))
+            value = gnc_numeric_zero ();
+        gnc_price_set_value (m_price, value);
+        break;
     }
-    else
+    default:
+        break;
+    }
+}
+
+gboolean
+PriceSaxBuilder::finish (gxpf_data* gdata, const gchar* tag,
+                         gpointer* result)
+{
+    auto p = m_price;
+
+    m_price = nullptr;
+    gnc_price_commit_edit (p);
+
+    /* An empty <price/> is an error, as it was for the DOM parser. */
+    if (!m_ok || (!m_has_children && !has_text ()))
     {
-        *result = NULL;
         gnc_price_unref (p);
+        return FALSE;
     }
-    xmlFreeNode (price_xml);
-    return ok;
+
+    *result = p;
+    return TRUE;
 }
 
 static void
@@ -233,9 +297,8 @@ cleanup_gnc_price (sixtp_child_result* result)
 static sixtp*
 gnc_price_parser_new (void)
 {
-    return sixtp_dom_parser_new (price_parse_xml_end_handler,
-                                 cleanup_gnc_price,
-                                 cleanup_gnc_price);
+    return sixtp_sax_parser_new<PriceSaxBuilder> (cleanup_gnc_price,
+                                                  cleanup_gnc_price);
 }
 
 
@@ -250,6 +313,9 @@ gnc_price_parser_new (void)
    result: GNCPriceDB*
 
    start: create new GNCPriceDB*, and leave in *data_for_children.
+   after-child: count the price; it stays in data_from_children.
+   end: add the prices in data_from_children to the GNCPriceDB* in one
+        batch.
    cleanup-result: destroy GNCPriceDB*
    result-fail: destroy GNCPriceDB*
 
@@ -299,7 +365,6 @@ pricedb_after_child_handler (gpointer data_for_children,
         GNCPrice* p = (GNCPrice*) child_result->data;
 
         g_return_val_if_fail (p, FALSE);
-        gnc_pricedb_add_price (db, p);
         gd->counter.prices_loaded++;
         sixtp_run_callback (gd, "prices");
         return TRUE;
@@ -331,6 +396,18 @@ pricedb_v2_end_handler (
 {
     GNCPriceDB* db = static_cast<decltype (db)> (*result);
     gxpf_data* gdata = (gxpf_data*)global_data;
+    PriceList* prices = NULL;
+
+    /* The child results are kept newest first until this frame is
+       popped, which also unrefs the prices. */
+    for (GSList* node = data_from_children; node; node = node->next)
+    {
+        sixtp_child_result* cr = static_cast<decltype (cr)> (node->data);
+        if (is_child_result_from_node_named (cr, "price") && cr->data)
+            prices = g_list_prepend (prices, cr->data);
+    }
+    gnc_pricedb_add_prices (db, prices);
+    g_list_free (prices);
 
     if (parent_data)
     {
@@ -41,6 +41,7 @@ extern "C"
 #include "sixtp-utils.h"
 #include "sixtp-dom-parsers.h"
 #include "sixtp-dom-generators.h"
+#include "sixtp-sax-builder.hpp"
 
 #include "gnc-xml.h"
 
@@ -48,6 +49,11 @@ extern "C"
 
 #include "sixtp-dom-parsers.h"
 
+#include <vector>
+
+/* This static indicates the debugging module that this .o belongs to.  */
+static QofLogModule log_module = GNC_MOD_IO;
+
 const gchar* transaction_version_string = "2.0.0";
 
 static void
@@ -192,6 +198,91 @@ gnc_transaction_dom_tree_create (Transaction* trn)
     return ret;
 }
 
+/* The streaming writer: produces the same bytes as dumping the trees built
+ * by split_to_dom_tree and gnc_transaction_dom_tree_create. */
+static void
+split_to_xml (GncXmlWriter& writer, const gchar* tag, Split* spl,
+              const GncSplitLots* lots)
+{
+    writer.start_element (tag);
+
+    guid_to_xml (writer, "split:id", xaccSplitGetGUID (spl));
+
+    auto memo = xaccSplitGetMemo (spl);
+    if (memo && g_strcmp0 (memo, "") != 0)
+        writer.checked_text_element ("split:memo", memo);
+
+    auto action = xaccSplitGetAction (spl);
+    if (action && g_strcmp0 (action, "") != 0)
+        writer.checked_text_element ("split:action", action);
+
+    char tmp[2];
+    tmp[0] = xaccSplitGetReconcile (spl);
+    tmp[1] = '\0';
+    writer.text_element ("split:reconciled-state", tmp);
+
+    auto reconciled = xaccSplitGetDateReconciled (spl);
+    if (reconciled)
+        time64_to_xml (writer, "split:reconcile-date", reconciled);
+
+    auto value = xaccSplitGetValue (spl);
+    gnc_numeric_to_xml (writer, "split:value", &value);
+    auto amount = xaccSplitGetAmount (spl);
+    gnc_numeric_to_xml (writer, "split:quantity", &amount);
+
+    guid_to_xml (writer, "split:account",
+                 xaccAccountGetGUID (xaccSplitGetAccount (spl)));
+
+    const GncGUID* lot_guid = nullptr;
+    if (lots)
+    {
+        auto found = lots->find (spl);
+        if (found != lots->end ())
+            lot_guid = &found->second;
+    }
+    else if (GNCLot* lot = xaccSplitGetLot (spl))
+        lot_guid = gnc_lot_get_guid (lot);
+    if (lot_guid)
+        guid_to_xml (writer, "split:lot", lot_guid);
+
+    qof_instance_slots_to_xml (writer, "split:slots", QOF_INSTANCE (spl));
+
+    writer.end_element (tag);
+}
+
+void
+gnc_transaction_xml_write (GncXmlWriter& writer, Transaction* trn,
+                           const GncSplitLots* lots)
+{
+    writer.start_element ("gnc:transaction", "version",
+                          transaction_version_string);
+
+    guid_to_xml (writer, "trn:id", xaccTransGetGUID (trn));
+
+    commodity_ref_to_xml (writer, "trn:currency", xaccTransGetCurrency (trn));
+
+    auto num = xaccTransGetNum (trn);
+    if (num && g_strcmp0 (num, "") != 0)
+        writer.checked_text_element ("trn:num", num);
+
+    time64_to_xml (writer, "trn:date-posted", xaccTransRetDatePosted (trn));
+    time64_to_xml (writer, "trn:date-entered", xaccTransRetDateEntered (trn));
+
+    auto description = xaccTransGetDescription (trn);
+    if (description)
+        writer.checked_text_element ("trn:description", description);
+
+    qof_instance_slots_to_xml (writer, "trn:slots", QOF_INSTANCE (trn));
+
+    writer.start_element ("trn:splits");
+    for (auto n = xaccTransGetSplitList (trn); n; n = n->next)
+        split_to_xml (writer, "trn:split", static_cast<Split*> (n->data),
+                      lots);
+    writer.end_element ("trn:splits");
+
+    writer.end_element ("gnc:transaction");
+}
+
 /***********************************************************************/
 
 struct split_pdata
@@ -572,42 +663,6 @@ struct dom_tree_handler trn_dom_handlers[] =
     { NULL, NULL, 0, 0 },
 };
 
-static gboolean
-gnc_transaction_end_handler (gpointer data_for_children,
-                             GSList* data_from_children, GSList* sibling_data,
-                             gpointer parent_data, gpointer global_data,
-                             gpointer* result, const gchar* tag)
-{
-    Transaction* trn = NULL;
-    xmlNodePtr tree = (xmlNodePtr)data_for_children;
-    gxpf_data* gdata = (gxpf_data*)global_data;
-
-    if (parent_data)
-    {
-        return TRUE;
-    }
-
-    /* OK.  For some messed up reason this is getting called again with a
-       NULL tag.  So we ignore those cases */
-    if (!tag)
-    {
-        return TRUE;
-    }
-
-    g_return_val_if_fail (tree, FALSE);
-
-    trn = dom_tree_to_transaction (tree,
-                                   static_cast<QofBook*> (gdata->bookdata));
-    if (trn != NULL)
-    {
-        gdata->cb (tag, gdata->parsedata, trn);
-    }
-
-    xmlFreeNode (tree);
-
-    return trn != NULL;
-}
-
 Transaction*
 dom_tree_to_transaction (xmlNodePtr node, QofBook* book)
 {
@@ -641,8 +696,376 @@ dom_tree_to_transaction (xmlNodePtr node, QofBook* book)
     return trn;
 }
 
+/***********************************************************************/
+/* Build the transaction straight from the SAX events, with the same
+   results as dom_tree_to_transaction() but without the tree. */
+
+enum trn_sax_element
+{
+    TRN_SAX_IGNORED,
+    TRN_SAX_TRANSACTION,
+    TRN_SAX_ID,
+    TRN_SAX_CURRENCY,
+    TRN_SAX_NUM,
+    TRN_SAX_DATE_POSTED,
+    TRN_SAX_DATE_ENTERED,
+    TRN_SAX_DESCRIPTION,
+    TRN_SAX_SLOTS,
+    TRN_SAX_SPLITS,
+    TRN_SAX_SPLIT,
+    TRN_SAX_SPLIT_ID,
+    TRN_SAX_SPLIT_MEMO,
+    TRN_SAX_SPLIT_ACTION,
+    TRN_SAX_SPLIT_RECONCILED_STATE,
+    TRN_SAX_SPLIT_RECONCILE_DATE,
+    TRN_SAX_SPLIT_VALUE,
+    TRN_SAX_SPLIT_QUANTITY,
+    TRN_SAX_SPLIT_ACCOUNT,
+    TRN_SAX_SPLIT_LOT,
+    TRN_SAX_SPLIT_SLOTS,
+    TRN_SAX_TS_DATE,
+    TRN_SAX_CMDTY_SPACE,
+    TRN_SAX_CMDTY_ID,
+};
+
+struct trn_sax_tag
+{
+    const char* tag;
+    trn_sax_element element;
+    int required;
+};
+
+/* Same tags and required flags as trn_dom_handlers and spl_dom_handlers. */
+static const trn_sax_tag trn_sax_tags[] =
+{
+    { "trn:id", TRN_SAX_ID, 1 },
+    { "trn:currency", TRN_SAX_CURRENCY, 0 },
+    { "trn:num", TRN_SAX_NUM, 0 },
+    { "trn:date-posted", TRN_SAX_DATE_POSTED, 1 },
+    { "trn:date-entered", TRN_SAX_DATE_ENTERED, 1 },
+    { "trn:description", TRN_SAX_DESCRIPTION, 0 },
+    { "trn:slots", TRN_SAX_SLOTS, 0 },
+    { "trn:splits", TRN_SAX_SPLITS, 1 },
+    { NULL, TRN_SAX_IGNORED, 0 },
+};
+
+static const trn_sax_tag spl_sax_tags[] =
+{
+    { "split:id", TRN_SAX_SPLIT_ID, 1 },
+    { "split:memo", TRN_SAX_SPLIT_MEMO, 0 },
+    { "split:action", TRN_SAX_SPLIT_ACTION, 0 },
+    { "split:reconciled-state", TRN_SAX_SPLIT_RECONCILED_STATE, 1 },
+    { "split:reconcile-date", TRN_SAX_SPLIT_RECONCILE_DATE, 0 },
+    { "split:value", TRN_SAX_SPLIT_VALUE, 1 },
+    { "split:quantity", TRN_SAX_SPLIT_QUANTITY, 1 },
+    { "split:account", TRN_SAX_SPLIT_ACCOUNT, 1 },
+    { "split:lot", TRN_SAX_SPLIT_LOT, 0 },
+    { "split:slots", TRN_SAX_SPLIT_SLOTS, 0 },
+    { NULL, TRN_SAX_IGNORED, 0 },
+};
+
+/* Find tag in tags and note it in *gotten, a bit per entry. */
+static trn_sax_element
+trn_sax_lookup (const trn_sax_tag* tags, const gchar* tag, guint* gotten)
+{
+    for (guint i = 0; tags[i].tag; i++)
+        if (g_strcmp0 (tag, tags[i].tag) == 0)
+        {
+            *gotten |= 1 << i;
+            return tags[i].element;
+        }
+    PERR ("Unhandled tag: %s", tag ? tag : "(null)");
+    return TRN_SAX_IGNORED;
+}
+
+static gboolean
+trn_sax_all_gotten (const trn_sax_tag* tags, guint gotten)
+{
+    gboolean ret = TRUE;
+    for (guint i = 0; tags[i].tag; i++)
+        if (tags[i].required && ! (gotten & (1 << i)))
+        {
+            PERR ("Not defined and it should be: %s", tags[i].tag);
+            ret = FALSE;
+        }
+    return ret;
+}
+
+class TransactionSaxBuilder : public GncSaxBuilder
+{
+public:
+    TransactionSaxBuilder (QofBook* book);
+    ~TransactionSaxBuilder ();
+    void start_element (const gchar* tag, gchar** attrs) override;
+    void end_element (const gchar* tag) override;
+    gboolean finish (gxpf_data* gdata, const gchar* tag,
+                     gpointer* result) override;
+
+private:
+    void end_split ();
+    void set_split_account (const GncGUID* id);
+    void set_split_lot (const GncGUID* id);
+
+    QofBook* m_book;
+    Transaction* m_trn;
+    Split* m_split = nullptr;
+    std::vector<trn_sax_element> m_elements;
+    guint m_trn_gotten = 0;
+    guint m_split_gotten = 0;
+    gboolean m_ok = TRUE;
+    gboolean m_split_ok = TRUE;
+    gboolean m_guid_ok = FALSE;
+    GncSaxTime m_time;
+    GncSaxCommodityRef m_currency;
+    GncSaxSlotsReader m_slots;
+};
+
+TransactionSaxBuilder::TransactionSaxBuilder (QofBook* book) : m_book {book}
+{
+    m_trn = xaccMallocTransaction (book);
+    xaccTransBeginEdit (m_trn);
+}
+
+TransactionSaxBuilder::~TransactionSaxBuilder ()
+{
+    /* Only left over if the parse failed half way. */
+    if (m_split)
+        xaccSplitDestroy (m_split);
+    if (m_trn)
+    {
+        xaccTransDestroy (m_trn);
+        xaccTransCommitEdit (m_trn);
+    }
+}
+
+void
+TransactionSaxBuilder::start_element (const gchar* tag, gchar** attrs)
+{
+    if (m_slots.active ())
+    {
+        m_slots.start_element (tag, attrs);
+        return;
+    }
+
+    auto parent = m_elements.empty () ? TRN_SAX_TRANSACTION : m_elements.back ();
+    auto element = TRN_SAX_IGNORED;
+
+    switch (parent)
+    {
+    case TRN_SAX_TRANSACTION:
+        element = trn_sax_lookup (trn_sax_tags, tag, &m_trn_gotten);
+        if (element == TRN_SAX_IGNORED)
+            m_ok = FALSE;
+        break;
+    case TRN_SAX_SPLITS:
+        if (g_strcmp0 ("trn:split", tag) == 0)
+            element = TRN_SAX_SPLIT;
+        break;
+    case TRN_SAX_SPLIT:
+        element = trn_sax_lookup (spl_sax_tags, tag, &m_split_gotten);
+        if (element == TRN_SAX_IGNORED)
+            m_split_ok = FALSE;
+        break;
+    case TRN_SAX_CURRENCY:
+        if (g_strcmp0 ("cmdty:space", tag) == 0)
+            element = TRN_SAX_CMDTY_SPACE;
+        else if (g_strcmp0 ("cmdty:id", tag) == 0)
+            element = TRN_SAX_CMDTY_ID;
+        break;
+    case TRN_SAX_DATE_POSTED:
+    case TRN_SAX_DATE_ENTERED:
+    case TRN_SAX_SPLIT_RECONCILE_DATE:
+        if (g_strcmp0 ("ts:date", tag) == 0)
+            element = TRN_SAX_TS_DATE;
+        break;
+    default:
+        break;
+    }
+
+    switch (element)
+    {
+    case TRN_SAX_ID:
+    case TRN_SAX_SPLIT_ID:
+    case TRN_SAX_SPLIT_ACCOUNT:
+    case TRN_SAX_SPLIT_LOT:
+        m_guid_ok = sax_attrs_guid_type (tag, attrs);
+        break;
+    case TRN_SAX_CURRENCY:
+        m_currency.reset ();
+        break;
+    case TRN_SAX_DATE_POSTED:
+    case TRN_SAX_DATE_ENTERED:
+    case TRN_SAX_SPLIT_RECONCILE_DATE:
+        m_time.reset ();
+        break;
+    case TRN_SAX_SLOTS:
+        m_slots.begin (qof_instance_get_slots (QOF_INSTANCE (m_trn)));
+        break;
+    case TRN_SAX_SPLIT:
+        m_split = xaccMallocSplit (m_book);
+        m_split_gotten = 0;
+        m_split_ok = TRUE;
+        break;
+    case TRN_SAX_SPLIT_SLOTS:
+        m_slots.begin (qof_instance_get_slots (QOF_INSTANCE (m_split)));
+        break;
+    default:
+        break;
+    }
+    m_elements.push_back (element);
+}
+
+void
+TransactionSaxBuilder::set_split_account (const GncGUID* id)
+{
+    auto account = xaccAccountLookup (id, m_book);
+    if (!account && gnc_transaction_xml_v2_testing &&
+        !guid_equal (id, guid_null ()))
+    {
+        account = xaccMallocAccount (m_book);
+        xaccAccountSetGUID (account, id);
+        xaccAccountSetCommoditySCU (account,
+                                    xaccSplitGetAmount (m_split).denom);
+    }
+
+    xaccAccountInsertSplit (account, m_split);
+}
+
+void
+TransactionSaxBuilder::set_split_lot (const GncGUID* id)
+{
+    auto lot = gnc_lot_lookup (id, m_book);
+    if (!lot && gnc_transaction_xml_v2_testing &&
+        !guid_equal (id, guid_null ()))
+    {
+        lot = gnc_lot_new (m_book);
+        gnc_lot_set_guid (lot, *id);
+    }
+
+    gnc_lot_add_split (lot, m_split);
+}
+
+void
+TransactionSaxBuilder::end_split ()
+{
+    if (m_split_ok && trn_sax_all_gotten (spl_sax_tags, m_split_gotten))
+        xaccTransAppendSplit (m_trn, m_split);
+    else
+        xaccSplitDestroy (m_split);
+    m_split = nullptr;
+}
+
+void
+TransactionSaxBuilder::end_element (const gchar* tag)
+{
+    if (m_slots.active () && !m_slots.end_element (text ()))
+        return;
+
+    auto element = m_elements.back ();
+    m_elements.pop_back ();
+
+    switch (element)
+    {
+    case TRN_SAX_ID:
+    case TRN_SAX_SPLIT_ID:
+    case TRN_SAX_SPLIT_ACCOUNT:
+    case TRN_SAX_SPLIT_LOT:
+    {
+        if (!m_guid_ok)
+            break;
+        auto guid = sax_text_to_guid (text ());
+        if (element == TRN_SAX_ID)
+            xaccTransSetGUID (m_trn, &guid);
+        else if (element == TRN_SAX_SPLIT_ID)
+            xaccSplitSetGUID (m_split, &guid);
+        else if (element == TRN_SAX_SPLIT_ACCOUNT)
+            set_split_account (&guid);
+        else
+            set_split_lot (&guid);
+        break;
+    }
+    case TRN_SAX_CMDTY_SPACE:
+        m_currency.set_space (text ());
+        break;
+    case TRN_SAX_CMDTY_ID:
+        m_currency.set_id (text ());
+        break;
+    case TRN_SAX_CURRENCY:
+        xaccTransSetCurrency (m_trn, m_currency.lookup (m_book));
+        break;
+    case TRN_SAX_TS_DATE:
+        m_time.set_date (text ());
+        break;
+    case TRN_SAX_DATE_POSTED:
+        xaccTransSetDatePostedSecs (m_trn, m_time.get (tag));
+        break;
+    case TRN_SAX_DATE_ENTERED:
+        xaccTransSetDateEnteredSecs (m_trn, m_time.get (tag));
+        break;
+    case TRN_SAX_NUM:
+        xaccTransSetNum (m_trn, text ());
+        break;
+    case TRN_SAX_DESCRIPTION:
+        xaccTransSetDescription (m_trn, text ());
+        break;
+    case TRN_SAX_SPLIT:
+        end_split ();
+        break;
+    case TRN_SAX_SPLIT_MEMO:
+        xaccSplitSetMemo (m_split, text ());
+        break;
+    case TRN_SAX_SPLIT_ACTION:
+        xaccSplitSetAction (m_split, text ());
+        break;
+    case TRN_SAX_SPLIT_RECONCILED_STATE:
+        xaccSplitSetReconcile (m_split, text ()[0]);
+        break;
+    case TRN_SAX_SPLIT_RECONCILE_DATE:
+        xaccSplitSetDateReconciledSecs (m_split, m_time.get (tag));
+        break;
+    case TRN_SAX_SPLIT_VALUE:
+    case TRN_SAX_SPLIT_QUANTITY:
+    {
+        gnc_numeric num;
+        if (!sixtp_string_to_gnc_numeric (text (), &num))
+            num = gnc_numeric_zero ();
+        if (element == TRN_SAX_SPLIT_VALUE)
+            xaccSplitSetValue (m_split, num);
+        else
+            xaccSplitSetAmount (m_split, num);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+gboolean
+TransactionSaxBuilder::finish (gxpf_data* gdata, const gchar* tag,
+                               gpointer* result)
+{
+    auto trn = m_trn;
+
+    m_trn = nullptr;
+    if (!trn_sax_all_gotten (trn_sax_tags, m_trn_gotten))
+        m_ok = FALSE;
+    xaccTransCommitEdit (trn);
+
+    if (!m_ok)
+    {
+        PERR ("Failed to read a transaction");
+        xaccTransBeginEdit (trn);
+        xaccTransDestroy (trn);
+        xaccTransCommitEdit (trn);
+        return FALSE;
+    }
+
+    gdata->cb (tag, gdata->parsedata, trn);
+    return TRUE;
+}
+
 sixtp*
 gnc_transaction_sixtp_parser_create (void)
 {
-    return sixtp_dom_parser_new (gnc_transaction_end_handler, NULL, NULL);
+    return sixtp_sax_parser_new<TransactionSaxBuilder> ();
 }
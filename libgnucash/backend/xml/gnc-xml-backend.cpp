@@ -27,6 +27,10 @@ extern "C"
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#ifdef HAVE_LINUX_FS_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <regex.h>
@@ -34,19 +38,28 @@ extern "C"
 #include <gnc-engine.h> //for GNC_MOD_BACKEND
 #include <gnc-uri-utils.h>
 #include <TransLog.h>
+#include <Transaction.h>
 #include <gnc-prefs.h>
+#include <gnc-hooks.h>
 
 }
 
+#include <algorithm>
 #include <sstream>
+#include <vector>
 
 #include "gnc-xml-backend.hpp"
+#include "gnc-xml-background-save.hpp"
+#include "gnc-xml-snapshot.hpp"
 #include "gnc-backend-xml.h"
 #include "io-gncxml-v2.h"
 #include "io-gncxml.h"
 
 #define XML_URI_PREFIX "xml://"
 #define FILE_URI_PREFIX "file://"
+/* A journal isn't compacted before it reaches this size, however small the
+ * data file. */
+#define JOURNAL_MIN_COMPACT (64 * 1024)
 static QofLogModule log_module = GNC_MOD_BACKEND;
 
 bool
@@ -105,10 +118,14 @@ GncXmlBackend::check_path (const char* fullpath, bool create)
     return true;
 }
 
+/* session_end() has waited for any save in the background. */
+GncXmlBackend::~GncXmlBackend() = default;
+
 void
 GncXmlBackend::session_begin(QofSession* session, const char* book_id,
                        bool ignore_lock, bool create, bool force)
 {
+    m_session = session;
     /* Make sure the directory is there */
     m_fullpath = gnc_uri_get_path (book_id);
 
@@ -128,7 +145,7 @@ GncXmlBackend::session_begin(QofSession* session, const char* book_id,
     if (!check_path(m_fullpath.c_str(), create))
         return;
     m_dirname = g_path_get_dirname (m_fullpath.c_str());
-
+    m_journal.set_datafile (m_fullpath);
 
 
     /* ---------------------------------------------------- */
@@ -170,12 +187,28 @@ GncXmlBackend::session_begin(QofSession* session, const char* book_id,
 void
 GncXmlBackend::session_end()
 {
+    finish_background_save ();
+
     if (m_book && qof_book_is_readonly (m_book))
     {
         set_error(ERR_BACKEND_READONLY);
         return;
     }
 
+    /* Fold the change journal into the data file while we still hold the
+     * lock, so that the next load doesn't have to replay it.  Unsaved
+     * changes stay out of the data file, and after a Save As the book
+     * belongs to another backend. */
+    if (m_book && qof_book_get_backend (m_book) == this &&
+        !m_lockfile.empty() && m_journal.exists() &&
+        !qof_book_session_not_saved (m_book))
+    {
+        /* There is no one left to show the progress to. */
+        m_percentage = nullptr;
+        if (write_to_file (true) && m_journal_clean)
+            PINFO ("Compacted the journal %s", m_journal.path().c_str());
+    }
+
     if (!m_linkfile.empty())
         g_unlink (m_linkfile.c_str());
 
@@ -200,8 +233,14 @@ GncXmlBackend::session_end()
 
     m_dirname.clear();
     m_fullpath.clear();
+    m_old_files.clear();
+    m_old_files_scanned = false;
     m_lockfile.clear();
     m_linkfile.clear();
+    m_journal.set_datafile ({});
+    m_journal_trans.clear();
+    m_journal_full = false;
+    m_journal_clean = false;
 }
 
 static QofBookFileType
@@ -243,18 +282,45 @@ GncXmlBackend::load(QofBook* book, QofBackendLoadType loadType)
 
     error = ERR_BACKEND_NO_ERR;
     m_book = book;
+    /* Nothing loaded needs saving again. */
+    m_loading = true;
 
     int rc;
+    GncSnapshotLoad snapshot;
     switch (determine_file_type (m_fullpath))
     {
     case GNC_BOOK_XML2_FILE:
-        rc = qof_session_load_from_xml_file_v2 (this, book,
-                                                     GNC_BOOK_XML2_FILE);
+        snapshot = m_snapshot_failed ? GNC_SNAPSHOT_NONE :
+            qof_session_load_from_xml_snapshot_v2 (this, book);
+        if (snapshot == GNC_SNAPSHOT_FAILED)
+        {
+            /* The snapshot is only a cache: drop it and have the session
+             * throw away what it built so the data file is parsed into an
+             * empty book. */
+            PWARN ("Unable to load the snapshot of %s", m_fullpath.c_str());
+            m_snapshot_failed = true;
+            GncXmlSnapshot::remove (m_fullpath);
+            error = ERR_FILEIO_RELOAD;
+            break;
+        }
+        rc = snapshot == GNC_SNAPSHOT_LOADED ||
+            qof_session_load_from_xml_file_v2 (this, book, GNC_BOOK_XML2_FILE);
         if (rc == FALSE)
         {
             PWARN ("Syntax error in Xml File %s", m_fullpath.c_str());
             error = ERR_FILEIO_PARSE_ERROR;
         }
+        else if (m_journal_failed)
+            m_journal_clean = !m_journal.exists();
+        else if (!load_journal (book))
+        {
+            /* Load the data file again without the journal, which is kept
+             * out of the way of the saves that would remove it. */
+            PERR ("Unable to replay the journal %s", m_journal.path().c_str());
+            m_journal_failed = true;
+            m_journal.set_aside();
+            error = ERR_FILEIO_RELOAD;
+        }
         break;
 
     case GNC_BOOK_XML2_FILE_NO_ENCODING:
@@ -301,12 +367,137 @@ GncXmlBackend::load(QofBook* book, QofBackendLoadType loadType)
         set_error(error);
     }
 
+    m_loading = false;
+    m_journal_trans.clear();
+    m_journal_full = false;
+
     /* We just got done loading, it can't possibly be dirty !! */
     qof_book_mark_session_saved (book);
 }
 
+/* Bring the book just loaded up to date with the change journal saved since
+ * the data file was last written in full.  Returns false if the journal
+ * couldn't be replayed. */
+bool
+GncXmlBackend::load_journal (QofBook* book)
+{
+    std::vector<std::string> records;
+    bool torn;
+
+    if (!m_journal.read (records, &torn))
+    {
+        /* A journal older than the data file is replaced by the next save,
+         * which is a full one. */
+        m_journal_clean = !m_journal.exists();
+        return true;
+    }
+
+    PINFO ("Replaying %" G_GSIZE_FORMAT " records from %s", records.size(),
+           m_journal.path().c_str());
+    if (!qof_session_replay_xml_journal_v2 (book, records))
+        return false;
+    /* Nothing may follow a damaged record. */
+    m_journal_clean = !torn;
+    return true;
+}
+
+/* While the data file is written in the background, an instance about to be
+ * edited has the transaction it belongs to copied first.  The worker reads
+ * the commodities of the transactions it writes, so a commodity has to wait
+ * for it. */
+void
+GncXmlBackend::begin (QofInstance* inst)
+{
+    if (!m_background || !inst)
+        return;
+    if (g_strcmp0 (inst->e_type, GNC_ID_COMMODITY) == 0)
+        finish_background_save ();
+    else
+        m_background->preserve (inst);
+}
+
+void
+GncXmlBackend::commit (QofInstance* inst)
+{
+    if (m_loading || !inst)
+        return;
+    if (!qof_instance_get_dirty_flag (inst) &&
+        !qof_instance_get_destroying (inst))
+        return;
+    if (m_background)
+        m_edited_while_saving = true;
+
+    if (g_strcmp0 (inst->e_type, GNC_ID_SPLIT) == 0)
+    {
+        auto trans = xaccSplitGetParent (GNC_SPLIT (inst));
+        if (trans)
+            m_journal_trans.insert (*qof_instance_get_guid (trans));
+    }
+    else if (g_strcmp0 (inst->e_type, GNC_ID_TRANS) == 0)
+    {
+        m_journal_trans.insert (*qof_instance_get_guid (inst));
+    }
+    else
+    {
+        m_journal_full = true;
+    }
+}
+
+/* Save the transactions changed since the last save by appending them to the
+ * change journal instead of writing the whole data file.  Returns false if
+ * the save has to be a full one. */
+bool
+GncXmlBackend::write_journal ()
+{
+    if (!gnc_prefs_get_file_save_journaled () || !m_journal_clean ||
+        m_journal_full || m_journal_trans.empty())
+        return false;
+
+    /* Every load replays the journal, so once it has grown to a quarter of
+     * the data file it is folded back in by a full write. */
+    GStatBuf statbuf;
+    if (g_stat (m_fullpath.c_str(), &statbuf) != 0 ||
+        m_journal.size() > std::max<gint64> (statbuf.st_size / 4,
+                                             JOURNAL_MIN_COMPACT))
+        return false;
+
+    std::vector<GncGUID> guids (m_journal_trans.begin(), m_journal_trans.end());
+    std::string record;
+    if (!gnc_xml_journal_record_v2 (m_book, guids, record))
+        return false;
+
+    if ((!m_journal.exists() && !m_journal.reset()) ||
+        !m_journal.append (record))
+    {
+        /* A record left half written ends the journal when it is read, so
+         * nothing more may be appended before the next full write. */
+        m_journal_clean = false;
+        return false;
+    }
+
+    PINFO ("Saved %" G_GSIZE_FORMAT " transactions to %s", guids.size(),
+           m_journal.path().c_str());
+    m_journal_trans.clear();
+    qof_book_mark_session_saved (m_book);
+    return true;
+}
+
 void
 GncXmlBackend::sync(QofBook* book)
+{
+    save_book (book, gnc_prefs_get_file_save_background ());
+}
+
+/* A safe save has finished when it returns, so it isn't done in the
+ * background. */
+void
+GncXmlBackend::safe_sync(QofBook* book)
+{
+    save_book (book, false);
+}
+
+void
+GncXmlBackend::save_book(QofBook* book, bool background)
 {
         /* We make an important assumption here, that we might want to change
      * in the future: when the user says 'save', we really save the one,
@@ -317,6 +508,9 @@ GncXmlBackend::sync(QofBook* book)
     if (m_book == nullptr) m_book = book;
     if (book != m_book) return;
 
+    /* One save at a time. */
+    finish_background_save ();
+
     if (qof_book_is_readonly (m_book))
     {
         /* Are we read-only? Don't continue in this case. */
@@ -324,7 +518,12 @@ GncXmlBackend::sync(QofBook* book)
         return;
     }
 
-    write_to_file (true);
+    if (!write_journal() && !(background && start_background_save()) &&
+        write_to_file (true))
+    {
+        m_journal_trans.clear();
+        m_journal_full = false;
+    }
     remove_old_files();
 }
 
@@ -352,11 +551,35 @@ GncXmlBackend::export_coa(QofBook* book)
     fclose(out);
 }
 
+/* A name for the file the book is written to before it replaces the data
+ * file, or an empty string if none could be made. */
+std::string
+GncXmlBackend::temp_file_name ()
+{
+    auto tmp_name = g_new (char, strlen (m_fullpath.c_str()) + 12);
+    strcpy (tmp_name, m_fullpath.c_str());
+    strcat (tmp_name, ".tmp-XXXXXX");
+
+    /* Clang static analyzer flags this as a security risk, which is
+     * theoretically true, but we can't use mkstemp because we need to
+     * open the file ourselves because of compression. None of the alternatives
+     * is any more secure.
+     */
+    if (!mktemp (tmp_name))
+    {
+        g_free (tmp_name);
+        set_error(ERR_BACKEND_MISC);
+        set_message("Failed to make temp file");
+        return {};
+    }
+    std::string retval {tmp_name};
+    g_free (tmp_name);
+    return retval;
+}
+
 bool
 GncXmlBackend::write_to_file (bool make_backup)
 {
-    QofBackendError be_err;
-
     ENTER (" book=%p file=%s", m_book, m_fullpath.c_str());
 
     if (m_book && qof_book_is_readonly (m_book))
@@ -371,21 +594,9 @@ GncXmlBackend::write_to_file (bool make_backup)
     /* XXX this is currently broken due to faulty 'Save As' logic. */
     /* if (FALSE == qof_book_session_not_saved (book)) return FALSE; */
 
-
-    auto tmp_name = g_new (char, strlen (m_fullpath.c_str()) + 12);
-    strcpy (tmp_name, m_fullpath.c_str());
-    strcat (tmp_name, ".tmp-XXXXXX");
-
-    /* Clang static analyzer flags this as a security risk, which is
-     * theoretically true, but we can't use mkstemp because we need to
-     * open the file ourselves because of compression. None of the alternatives
-     * is any more secure.
-     */
-    if (!mktemp (tmp_name))
+    auto tmp_name = temp_file_name ();
+    if (tmp_name.empty ())
     {
-        g_free (tmp_name);
-        set_error(ERR_BACKEND_MISC);
-        set_message("Failed to make temp file");
         LEAVE ("");
         return FALSE;
     }
@@ -394,142 +605,269 @@ GncXmlBackend::write_to_file (bool make_backup)
     {
         if (!backup_file ())
         {
-            g_free (tmp_name);
             LEAVE ("");
             return FALSE;
         }
     }
 
-    if (gnc_book_write_to_xml_file_v2 (m_book, tmp_name,
-                                       gnc_prefs_get_file_save_compressed ()))
+    if (!gnc_book_write_to_xml_file_v2 (m_book, tmp_name.c_str(),
+                                        gnc_prefs_get_file_save_compressed ()))
     {
-        /* Record the file's permissions before g_unlinking it */
-        GStatBuf statbuf;
-        auto rc = g_stat (m_fullpath.c_str(), &statbuf);
-        if (rc == 0)
-        {
-            /* We must never chmod the file /dev/null */
-            g_assert (g_strcmp0 (tmp_name, "/dev/null") != 0);
+        write_failed (tmp_name);
+        LEAVE ("");
+        return FALSE;
+    }
+    if (!install_file (tmp_name))
+    {
+        LEAVE ("");
+        return FALSE;
+    }
+    /* The data file now holds everything the journal did.  It goes before
+     * anything else can fail, so the journal never outlives its file. */
+    m_journal_clean = m_journal.remove();
+    save_snapshot ();
+
+    /* Since we successfully saved the book,
+     * we should mark it clean. */
+    qof_book_mark_session_saved (m_book);
+    LEAVE (" successful save of book=%p to file=%s", m_book,
+           m_fullpath.c_str());
+    return TRUE;
+}
 
-            /* Use the permissions from the original data file */
-            if (g_chmod (tmp_name, statbuf.st_mode) != 0)
-            {
-                /* set_error(ERR_BACKEND_PERM); */
-                /* set_message("Failed to chmod filename %s", tmp_name ); */
-                /* Even if the chmod did fail, the save
-                   nevertheless completed successfully. It is
-                   therefore wrong to signal the ERR_BACKEND_PERM
-                   error here which implies that the saving itself
-                   failed. Instead, we simply ignore this. */
-                PWARN ("unable to chmod filename %s: %s",
-                       tmp_name ? tmp_name : "(null)",
-                       g_strerror (errno) ? g_strerror (errno) : "");
+/* Replace the data file with tmp_name, the book just written to it. */
+bool
+GncXmlBackend::install_file (const std::string& tmp_name)
+{
+    /* Record the file's permissions before g_unlinking it */
+    GStatBuf statbuf;
+    auto rc = g_stat (m_fullpath.c_str(), &statbuf);
+    if (rc == 0)
+    {
+        /* We must never chmod the file /dev/null */
+        g_assert (g_strcmp0 (tmp_name.c_str(), "/dev/null") != 0);
+
+        /* Use the permissions from the original data file */
+        if (g_chmod (tmp_name.c_str(), statbuf.st_mode) != 0)
+        {
+            /* set_error(ERR_BACKEND_PERM); */
+            /* set_message("Failed to chmod filename %s", tmp_name ); */
+            /* Even if the chmod did fail, the save
+               nevertheless completed successfully. It is
+               therefore wrong to signal the ERR_BACKEND_PERM
+               error here which implies that the saving itself
+               failed. Instead, we simply ignore this. */
+            PWARN ("unable to chmod filename %s: %s",
+                   tmp_name.c_str(),
+                   g_strerror (errno) ? g_strerror (errno) : "");
 #if VFAT_DOESNT_SUCK  /* chmod always fails on vfat/samba fs */
-                /* g_free(tmp_name); */
-                /* return FALSE; */
+            /* return FALSE; */
 #endif
-            }
+        }
 #ifdef HAVE_CHOWN
-            /* Don't try to change the owner. Only root can do
-               that. */
-            if (chown (tmp_name, -1, statbuf.st_gid) != 0)
-            {
-                /* set_error(ERR_BACKEND_PERM); */
-                /* set_message("Failed to chown filename %s", tmp_name ); */
-                /* A failed chown doesn't mean that the saving itself
-                failed. So don't abort with an error here! */
-                PWARN ("unable to chown filename %s: %s",
-                       tmp_name ? tmp_name : "(null)",
-                       strerror (errno) ? strerror (errno) : "");
+        /* Don't try to change the owner. Only root can do
+           that. */
+        if (chown (tmp_name.c_str(), -1, statbuf.st_gid) != 0)
+        {
+            /* set_error(ERR_BACKEND_PERM); */
+            /* set_message("Failed to chown filename %s", tmp_name ); */
+            /* A failed chown doesn't mean that the saving itself
+            failed. So don't abort with an error here! */
+            PWARN ("unable to chown filename %s: %s",
+                   tmp_name.c_str(),
+                   strerror (errno) ? strerror (errno) : "");
 #if VFAT_DOESNT_SUCK /* chown always fails on vfat fs */
-                /* g_free(tmp_name);
-                return FALSE; */
+            /* return FALSE; */
 #endif
-            }
-#endif
-        }
-        if (g_unlink (m_fullpath.c_str()) != 0 && errno != ENOENT)
-        {
-            set_error(ERR_BACKEND_READONLY);
-            PWARN ("unable to unlink filename %s: %s",
-                   m_fullpath.empty() ? "(null)" : m_fullpath.c_str(),
-                   g_strerror (errno) ? g_strerror (errno) : "");
-            g_free (tmp_name);
-            LEAVE ("");
-            return FALSE;
-        }
-        if (!link_or_make_backup (tmp_name, m_fullpath))
-        {
-            set_error(ERR_FILEIO_BACKUP_ERROR);
-            std::string msg{"Failed to make backup file "};
-            set_message(msg + (m_fullpath.empty() ? "NULL" : m_fullpath));
-            g_free (tmp_name);
-            LEAVE ("");
-            return FALSE;
         }
-        if (g_unlink (tmp_name) != 0)
+#endif
+    }
+    if (g_unlink (m_fullpath.c_str()) != 0 && errno != ENOENT)
+    {
+        set_error(ERR_BACKEND_READONLY);
+        PWARN ("unable to unlink filename %s: %s",
+               m_fullpath.empty() ? "(null)" : m_fullpath.c_str(),
+               g_strerror (errno) ? g_strerror (errno) : "");
+        return FALSE;
+    }
+    if (!link_or_make_backup (tmp_name, m_fullpath))
+    {
+        set_error(ERR_FILEIO_BACKUP_ERROR);
+        std::string msg{"Failed to make backup file "};
+        set_message(msg + (m_fullpath.empty() ? "NULL" : m_fullpath));
+        return FALSE;
+    }
+    if (g_unlink (tmp_name.c_str()) != 0)
+    {
+        set_error(ERR_BACKEND_PERM);
+        PWARN ("unable to unlink temp filename %s: %s",
+               tmp_name.c_str(),
+               g_strerror (errno) ? g_strerror (errno) : "");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Clean up after the book couldn't be written to tmp_name. */
+void
+GncXmlBackend::write_failed (const std::string& tmp_name)
+{
+    QofBackendError be_err;
+
+    if (g_unlink (tmp_name.c_str()) != 0)
+    {
+        switch (errno)
         {
-            set_error(ERR_BACKEND_PERM);
-            PWARN ("unable to unlink temp filename %s: %s",
-                   tmp_name ? tmp_name : "(null)",
-                   g_strerror (errno) ? g_strerror (errno) : "");
-            g_free (tmp_name);
-            LEAVE ("");
-            return FALSE;
+        case ENOENT:     /* tmp_name doesn't exist?  Assume "RO" error */
+        case EACCES:
+        case EPERM:
+        case ENOSYS:
+        case EROFS:
+            be_err = ERR_BACKEND_READONLY;
+            break;
+        default:
+            be_err = ERR_BACKEND_MISC;
+            break;
         }
-        g_free (tmp_name);
+        set_error(be_err);
+        PWARN ("unable to unlink temp_filename %s: %s",
+               tmp_name.c_str(),
+               g_strerror (errno) ? g_strerror (errno) : "");
+        /* already in an error just flow on through */
+    }
+    else
+    {
+        /* Use a generic write error code */
+        set_error(ERR_FILEIO_WRITE_ERROR);
+        std::string msg{"Unable to write to temp file "};
+        set_message(msg + tmp_name);
+    }
+}
 
-        /* Since we successfully saved the book,
-         * we should mark it clean. */
-        qof_book_mark_session_saved (m_book);
-        LEAVE (" successful save of book=%p to file=%s", m_book,
-               m_fullpath.c_str());
-        return TRUE;
+/* The snapshot is only a cache, so failing to write it doesn't fail the
+ * save; the next load just parses the data file. */
+void
+GncXmlBackend::save_snapshot ()
+{
+    if (gnc_prefs_get_file_save_snapshot ())
+    {
+        if (!GncXmlSnapshot::write (m_book, m_fullpath))
+            PWARN ("Unable to write the snapshot of %s",
+                   m_fullpath.c_str());
     }
     else
+        GncXmlSnapshot::remove (m_fullpath);
+}
+
+/* Start writing the data file in the background.  Returns false if the book
+ * has to be written by write_to_file() instead. */
+bool
+GncXmlBackend::start_background_save ()
+{
+    auto tmp_name = temp_file_name ();
+    if (tmp_name.empty () || !backup_file ())
+        return false;
+
+    m_background.reset (new GncXmlBackgroundSave);
+    if (!m_background->start (m_book, tmp_name,
+                              gnc_prefs_get_file_save_compressed (),
+                              background_save_done, this))
     {
-        if (g_unlink (tmp_name) != 0)
-        {
-            switch (errno)
-            {
-            case ENOENT:     /* tmp_name doesn't exist?  Assume "RO" error */
-            case EACCES:
-            case EPERM:
-            case ENOSYS:
-            case EROFS:
-                be_err = ERR_BACKEND_READONLY;
-                break;
-            default:
-                be_err = ERR_BACKEND_MISC;
-                break;
-            }
-            set_error(be_err);
-            PWARN ("unable to unlink temp_filename %s: %s",
-                   tmp_name ? tmp_name : "(null)",
-                   g_strerror (errno) ? g_strerror (errno) : "");
-            /* already in an error just flow on through */
-        }
+        m_background.reset ();
+        return false;
+    }
+
+    /* What is edited from now on goes to the next save. */
+    m_background_tmp = tmp_name;
+    m_saving_trans.swap (m_journal_trans);
+    m_journal_trans.clear();
+    m_saving_full = m_journal_full;
+    m_journal_full = false;
+    m_edited_while_saving = false;
+    PINFO ("Writing %s in the background", m_fullpath.c_str());
+    return true;
+}
+
+gboolean
+GncXmlBackend::background_save_done (gpointer data)
+{
+    static_cast<GncXmlBackend*> (data)->finish_background_save ();
+    return G_SOURCE_REMOVE;
+}
+
+/* Wait for the save running in the background, if any, and put the file it
+ * wrote in place of the data file. */
+void
+GncXmlBackend::finish_background_save ()
+{
+    if (!m_background)
+        return;
+
+    auto written = m_background->finish ();
+    m_background.reset ();
+    if (!written)
+        write_failed (m_background_tmp);
+
+    if (written && install_file (m_background_tmp))
+    {
+        /* The data file now holds everything the journal did, which goes
+         * first as in write_to_file().  The book is only saved if it wasn't
+         * edited while it was written. */
+        m_journal_clean = m_journal.remove();
+        if (m_edited_while_saving)
+            GncXmlSnapshot::remove (m_fullpath);
         else
         {
-            /* Use a generic write error code */
-            set_error(ERR_FILEIO_WRITE_ERROR);
-            std::string msg{"Unable to write to temp file "};
-            set_message(msg + (tmp_name ? tmp_name : "NULL"));
+            save_snapshot ();
+            qof_book_mark_session_saved (m_book);
         }
-        g_free (tmp_name);
-        LEAVE ("");
-        return FALSE;
+        PINFO ("Wrote %s in the background", m_fullpath.c_str());
     }
-    g_free (tmp_name);
-    LEAVE ("");
-    return TRUE;
+    else
+    {
+        m_journal_trans.insert (m_saving_trans.begin(), m_saving_trans.end());
+        m_journal_full = m_journal_full || m_saving_full;
+        PWARN ("Unable to write %s in the background", m_fullpath.c_str());
+        /* The session reported the save done when it started, so the
+         * failure is reported now to whoever watches for it, through the
+         * session's error, and not left for the next save to report as its
+         * own.  The book still needs saving. */
+        qof_book_mark_session_dirty (m_book);
+        gnc_hook_run (HOOK_BOOK_SAVE_FAILED, m_session);
+        get_error();
+    }
+    m_saving_trans.clear();
+    m_background_tmp.clear();
+    remove_old_files();
+}
+
+/* Copy the rest of orig_fd to bkup_fd with copy_file_range(), which lets the
+ * kernel copy without going through user space, or share the blocks on file
+ * systems that can.  Returns false if the rest has to be copied by hand. */
+static bool
+copy_file_in_kernel (int orig_fd, int bkup_fd)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+    ssize_t count;
+
+    /* Both offsets advance, so a copy by hand can take over anywhere. */
+    do
+    {
+        count = copy_file_range (orig_fd, NULL, bkup_fd, NULL, 1 << 30, 0);
+        if (count == -1 && errno == EINTR)
+            count = 1;
+    }
+    while (count > 0);
+    return count == 0;
+#else
+    return false;
+#endif
 }
 
 static bool
 copy_file (const std::string& orig, const std::string& bkup)
 {
-    constexpr size_t buf_size = 1024;
-    char buf[buf_size];
+    constexpr size_t buf_size = 64 * 1024;
     int flags = 0;
     ssize_t count_write = 0;
     ssize_t count_read = 0;
@@ -552,33 +890,55 @@ copy_file (const std::string& orig, const std::string& bkup)
         return FALSE;
     }
 
+    /* A reflink shares the blocks of orig until either file is written,
+     * which the data file never is because saves replace it. */
+#if defined(HAVE_LINUX_FS_H) && defined(FICLONE)
+    if (ioctl (bkup_fd, FICLONE, orig_fd) == 0)
+    {
+        close (orig_fd);
+        close (bkup_fd);
+        return TRUE;
+    }
+#endif
+    if (copy_file_in_kernel (orig_fd, bkup_fd))
+    {
+        close (orig_fd);
+        return close (bkup_fd) == 0;
+    }
+
+    std::vector<char> buf (buf_size);
     do
     {
-        count_read = read (orig_fd, buf, buf_size);
-        if (count_read == -1 && errno != EINTR)
+        count_read = read (orig_fd, buf.data(), buf_size);
+        if (count_read == -1)
         {
+            if (errno == EINTR)
+                continue;
             close (orig_fd);
             close (bkup_fd);
             return FALSE;
         }
 
-        if (count_read > 0)
+        for (ssize_t done = 0; done < count_read; done += count_write)
         {
-            count_write = write (bkup_fd, buf, count_read);
+            count_write = write (bkup_fd, buf.data() + done, count_read - done);
             if (count_write == -1)
             {
+                if (errno == EINTR)
+                {
+                    count_write = 0;
+                    continue;
+                }
                 close (orig_fd);
                 close (bkup_fd);
                 return FALSE;
             }
         }
     }
-    while (count_read > 0);
+    while (count_read != 0);
 
     close (orig_fd);
-    close (bkup_fd);
-
-    return TRUE;
+    return close (bkup_fd) == 0;
 }
 
 bool
@@ -771,27 +1131,48 @@ GncXmlBackend::backup_file()
     auto backup = m_fullpath + "." + timestamp + GNC_DATAFILE_EXT;
     g_free (timestamp);
 
-    return link_or_make_backup (datafile, backup);
+    if (!link_or_make_backup (datafile, backup))
+        return false;
+    remember_old_file (backup);
+    return true;
+}
+
+/* Add name, a backup or log file of the data file, to the old files. */
+void
+GncXmlBackend::remember_old_file (const std::string& name)
+{
+    GStatBuf statbuf;
+
+    if (g_stat (name.c_str(), &statbuf) == 0)
+        m_old_files[name] = statbuf.st_mtime;
 }
 
 /*
- * Clean up any lock files from prior crashes, and clean up old
- * backup and log files.
+ * Clean up any lock files from prior crashes, and find the backup and log
+ * files the data file already has.
  */
 
 void
-GncXmlBackend::remove_old_files ()
+GncXmlBackend::scan_old_files (time64 lock_mtime)
 {
-    GStatBuf lockstatbuf, statbuf;
-
-    if (g_stat (m_lockfile.c_str(), &lockstatbuf) != 0)
-        return;
+    GStatBuf statbuf;
 
     auto dir = g_dir_open (m_dirname.c_str(), 0, NULL);
     if (!dir)
         return;
 
-    auto now = gnc_time (NULL);
+    /* To be a file generated by GnuCash, the part of the name after the data
+     * file's should consist of 1 dot followed by 14 digits (0 to 9) and
+     * one of the extensions. */
+    regex_t pattern;
+    gchar* expression = g_strdup_printf ("^\\.[[:digit:]]{14}(\\%s|\\%s|\\.xac)$",
+                                         GNC_DATAFILE_EXT, GNC_LOGFILE_EXT);
+    auto got_pattern = regcomp (&pattern, expression,
+                                REG_EXTENDED | REG_ICASE) == 0;
+    g_free (expression);
+    if (!got_pattern)
+        PWARN ("Cannot compile regex for date stamp");
+
     const char* dent;
     while ((dent = g_dir_read_name (dir)) != NULL)
     {
@@ -827,7 +1208,7 @@ GncXmlBackend::remove_old_files ()
             if ((g_strcmp0 (name, m_linkfile.c_str()) != 0) &&
                 /* Only delete lock files older than the active one */
                 (g_stat (name, &statbuf) == 0) &&
-                (statbuf.st_mtime < lockstatbuf.st_mtime))
+                (statbuf.st_mtime < lock_mtime))
             {
                 PINFO ("remove stale lock file: %s", name);
                 g_unlink (name);
@@ -837,39 +1218,56 @@ GncXmlBackend::remove_old_files ()
             continue;
         }
 
-        /* At this point we're sure the file's name is in one of these forms:
-         * <fullpath/to/datafile><anything>.gnucash
-         * <fullpath/to/datafile><anything>.xac
-         * <fullpath/to/datafile><anything>.log
-         *
-         * To be a file generated by GnuCash, the <anything> part should consist
-         * of 1 dot followed by 14 digits (0 to 9). Let's test this with a
-         * regular expression.
-         */
-        {
-            /* Find the start of the date stamp. This takes some pointer
-             * juggling, but considering the above tests, this should always
-             * be safe */
-            regex_t pattern;
-            gchar* stamp_start = name + strlen (m_fullpath.c_str());
-            gchar* expression = g_strdup_printf ("^\\.[[:digit:]]{14}(\\%s|\\%s|\\.xac)$",
-                                                 GNC_DATAFILE_EXT, GNC_LOGFILE_EXT);
-            gboolean got_date_stamp = FALSE;
-
-            if (regcomp (&pattern, expression, REG_EXTENDED | REG_ICASE) != 0)
-                PWARN ("Cannot compile regex for date stamp");
-            else if (regexec (&pattern, stamp_start, 0, NULL, 0) == 0)
-                got_date_stamp = TRUE;
-
-            regfree (&pattern);
-            g_free (expression);
-
-            if (!got_date_stamp) /* Not a gnucash created file after all... */
-            {
-                g_free (name);
-                continue;
-            }
-        }
+        /* Find the start of the date stamp. This takes some pointer
+         * juggling, but considering the above tests, this should always
+         * be safe */
+        gchar* stamp_start = name + strlen (m_fullpath.c_str());
+        if (got_pattern && regexec (&pattern, stamp_start, 0, NULL, 0) == 0)
+            remember_old_file (name);
+
+        g_free (name);
+    }
+    if (got_pattern)
+        regfree (&pattern);
+    g_dir_close (dir);
+    m_old_files_scanned = true;
+}
+
+/*
+ * Clean up old backup and log files.  The directory is only read on the
+ * first call; after that the backups backup_file() makes and the log
+ * files the transaction logger opens are added as they appear, so
+ * that a save doesn't have to go through every file next to the data file.
+ */
+
+void
+GncXmlBackend::remove_old_files ()
+{
+    GStatBuf lockstatbuf;
+
+    if (g_stat (m_lockfile.c_str(), &lockstatbuf) != 0)
+        return;
+
+    if (!m_old_files_scanned)
+        scan_old_files (lockstatbuf.st_mtime);
+
+    /* The transaction logger starts a new file when the session begins and
+     * after a Save As, and each of these is still the current one at the
+     * next save, if there is one, or found by the next session's scan. */
+    auto log_name = xaccLogGetFileName ();
+    if (log_name)
+    {
+        auto name = g_build_filename (m_dirname.c_str(), log_name, (gchar*)NULL);
+        if (g_str_has_prefix (name, m_fullpath.c_str()) &&
+            m_old_files.find (name) == m_old_files.end())
+            remember_old_file (name);
+        g_free (name);
+    }
+
+    auto now = gnc_time (NULL);
+    for (auto it = m_old_files.begin(); it != m_old_files.end();)
+    {
+        auto name = it->first.c_str();
 
         /* The file is a backup or log file. Check the user's retention preference
          * to determine if we should keep it or not
@@ -878,6 +1276,8 @@ GncXmlBackend::remove_old_files ()
         {
             PINFO ("remove stale file: %s  - reason: preference XML_RETAIN_NONE", name);
             g_unlink (name);
+            it = m_old_files.erase (it);
+            continue;
         }
         else if ((gnc_prefs_get_file_retention_policy () == XML_RETAIN_DAYS) &&
                  (gnc_prefs_get_file_retention_days () > 0))
@@ -885,21 +1285,31 @@ GncXmlBackend::remove_old_files ()
             int days;
 
             /* Is the backup file old enough to delete */
-            if (g_stat (name, &statbuf) != 0)
+            days = (int) (difftime (now, it->second) / 86400);
+
+            /* Log files are written to after they are found, so an old
+             * enough mtime is checked again before the file goes. */
+            if (days >= gnc_prefs_get_file_retention_days ())
             {
-                g_free (name);
-                continue;
+                GStatBuf statbuf;
+                if (g_stat (name, &statbuf) != 0)
+                {
+                    it = m_old_files.erase (it);
+                    continue;
+                }
+                it->second = statbuf.st_mtime;
+                days = (int) (difftime (now, it->second) / 86400);
             }
-            days = (int) (difftime (now, statbuf.st_mtime) / 86400);
 
             PINFO ("file retention = %d days", gnc_prefs_get_file_retention_days ());
             if (days >= gnc_prefs_get_file_retention_days ())
             {
                 PINFO ("remove stale file: %s  - reason: more than %d days old", name, days);
                 g_unlink (name);
+                it = m_old_files.erase (it);
+                continue;
             }
         }
-        g_free (name);
+        ++it;
     }
-    g_dir_close (dir);
 }
@@ -23,9 +23,16 @@ extern "C"
 #include <qof.h>
 }
 
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <qof-backend.hpp>
 
+#include "gnc-xml-journal.hpp"
+
+class GncXmlBackgroundSave;
+
 class GncXmlBackend : public QofBackend
 {
 public:
@@ -34,15 +41,20 @@ public:
     GncXmlBackend operator=(const GncXmlBackend&) = delete;
     GncXmlBackend(const GncXmlBackend&&) = delete;
     GncXmlBackend operator=(const GncXmlBackend&&) = delete;
-    ~GncXmlBackend() = default;
+    ~GncXmlBackend();
     void session_begin(QofSession* session, const char* book_id,
                        bool ignore_lock, bool create, bool force) override;
     void session_end() override;
     void load(QofBook* book, QofBackendLoadType loadType) override;
-    /* The XML backend isn't able to do anything with individual instances. */
+    /* Transactions about to be changed are copied for a save running in the
+     * background, changed transactions are remembered for the change
+     * journal; the XML backend isn't able to do anything else with
+     * individual instances. */
+    void begin(QofInstance* inst) override;
+    void commit(QofInstance* inst) override;
     void export_coa(QofBook*) override;
     void sync(QofBook* book) override;
-    void safe_sync(QofBook* book) override { sync(book); } // XML sync is inherently safe.
+    void safe_sync(QofBook* book) override;
     const char * get_filename() { return m_fullpath.c_str(); }
     QofBook* get_book() { return m_book; }
 
@@ -51,16 +63,63 @@ private:
     bool get_file_lock();
     bool link_or_make_backup(const std::string& orig, const std::string& bkup);
     bool backup_file();
+    void save_book(QofBook* book, bool background);
+    std::string temp_file_name();
     bool write_to_file(bool make_backup);
+    bool install_file(const std::string& tmp_name);
+    void write_failed(const std::string& tmp_name);
+    void save_snapshot();
+    bool start_background_save();
+    void finish_background_save();
+    static gboolean background_save_done(gpointer data);
+    void remember_old_file(const std::string& name);
+    void scan_old_files(time64 lock_mtime);
     void remove_old_files();
     void write_accounts(QofBook* book);
     bool check_path(const char* fullpath, bool create);
+    bool write_journal();
+    bool load_journal(QofBook* book);
+
+    struct GuidLess
+    {
+        bool operator()(const GncGUID& a, const GncGUID& b) const
+        {
+            return guid_compare(&a, &b) < 0;
+        }
+    };
 
     std::string m_dirname;
     std::string m_lockfile;
     std::string m_linkfile;
     int m_lockfd;
+    /* The backup and log files of the data file by their mtimes, once the
+     * directory has been scanned for them. */
+    std::map<std::string, time64> m_old_files;
+    bool m_old_files_scanned = false;
+
+    GncXmlJournal m_journal;
+    /* Transactions changed since the last save. */
+    std::set<GncGUID, GuidLess> m_journal_trans;
+    /* Something besides transactions changed, the next save is a full one. */
+    bool m_journal_full = false;
+    /* The journal, if any, is whole and belongs to the data file. */
+    bool m_journal_clean = false;
+    bool m_loading = false;
+    /* The snapshot failed to load, the data file is parsed instead. */
+    bool m_snapshot_failed = false;
+    /* The journal failed to replay, the data file is loaded without it. */
+    bool m_journal_failed = false;
+
+    /* The save running in the background, if any, the file it writes, and
+     * what the journal had to save when it started. */
+    std::unique_ptr<GncXmlBackgroundSave> m_background;
+    std::string m_background_tmp;
+    std::set<GncGUID, GuidLess> m_saving_trans;
+    bool m_saving_full = false;
+    /* The book was changed after the save running in the background began. */
+    bool m_edited_while_saving = false;
 
+    QofSession* m_session = nullptr;
     QofBook* m_book = nullptr;  /* The primary, main open book */
 };
 #endif // __GNC_XML_BACKEND_HPP__
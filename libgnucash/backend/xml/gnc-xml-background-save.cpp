@@ -0,0 +1,288 @@
+/********************************************************************
+ * gnc-xml-background-save.cpp: Write an XML data file while the    *
+ * book is still being edited.                                      *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+extern "C"
+{
+#include <config.h>
+#include <platform.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+
+#include "Account.h"
+#include "Transaction.h"
+#include "Split.h"
+#include "gnc-lot.h"
+}
+
+#include "gnc-xml-background-save.hpp"
+#include "gnc-xml-writer.hpp"
+#include "io-gncxml-v2.h"
+
+/* The worker writes its buffer out once it holds this much. */
+#define FLUSH_SIZE (1024 * 1024)
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+GncXmlBackgroundSave::GncXmlBackgroundSave ()
+{
+    g_mutex_init (&m_mutex);
+}
+
+GncXmlBackgroundSave::~GncXmlBackgroundSave ()
+{
+    finish ();
+    g_mutex_clear (&m_mutex);
+}
+
+static int
+collect_transaction (Transaction* t, gpointer data)
+{
+    auto trans = static_cast<std::vector<Transaction*>*> (data);
+    trans->push_back (t);
+    return 0;
+}
+
+static bool
+serialize_transaction (Transaction* trans, const GncSplitLots& lots,
+                       std::string& text)
+{
+    GncXmlWriter writer;
+
+    try
+    {
+        gnc_transaction_xml_write (writer, trans, &lots);
+    }
+    catch (std::exception& err)
+    {
+        PERR ("Failed to write a transaction: %s", err.what ());
+        return false;
+    }
+    writer.append ("\n");
+    text = writer.str ();
+    return true;
+}
+
+bool
+GncXmlBackgroundSave::start (QofBook* book, const std::string& filename,
+                             bool compress, GSourceFunc done, gpointer data)
+{
+    g_return_val_if_fail (!m_thread, false);
+
+    m_tail = tmpfile ();
+    if (!m_tail)
+    {
+        PWARN ("Unable to create a temporary file: %s", g_strerror (errno));
+        return false;
+    }
+    m_compress = compress;
+    m_out = gnc_xml_open_for_write_v2 (filename.c_str (), compress);
+
+    m_trans.clear ();
+    m_preserved.clear ();
+    xaccAccountTreeForEachTransaction (gnc_book_get_root_account (book),
+                                       collect_transaction, &m_trans);
+    m_state.assign (m_trans.size (), TransState::PENDING);
+    m_index.clear ();
+    m_index.reserve (m_trans.size ());
+    m_lots.clear ();
+    for (auto trans : m_trans)
+        for (auto node = xaccTransGetSplitList (trans); node; node = node->next)
+        {
+            auto split = static_cast<Split*> (node->data);
+            if (auto lot = xaccSplitGetLot (split))
+                m_lots.emplace (split, *gnc_lot_get_guid (lot));
+        }
+
+    /* Transactions open for editing may be changed without the backend
+     * being told again, so they're written as they are now. */
+    bool ok = m_out != nullptr;
+    for (size_t i = 0; ok && i < m_trans.size (); i++)
+    {
+        m_index.emplace (m_trans[i], i);
+        if (qof_instance_get_editlevel (m_trans[i]) > 0)
+        {
+            ok = serialize_transaction (m_trans[i], m_lots, m_preserved[i]);
+            m_state[i] = TransState::PRESERVED;
+        }
+    }
+
+    if (!ok
+        || !gnc_book_write_xml_head_v2 (book, m_out)
+        || !gnc_book_write_xml_tail_v2 (book, m_tail))
+    {
+        PWARN ("Unable to start writing %s", filename.c_str ());
+        m_trans.clear ();
+        m_state.clear ();
+        m_index.clear ();
+        m_preserved.clear ();
+        m_lots.clear ();
+        fclose (m_tail);
+        m_tail = nullptr;
+        if (m_out)
+        {
+            gnc_xml_close_for_write_v2 (m_out, compress);
+            g_unlink (filename.c_str ());
+            m_out = nullptr;
+        }
+        return false;
+    }
+
+    m_done = done;
+    m_done_data = data;
+    m_ok = false;
+    m_thread = g_thread_new ("xml_background_save", run, this);
+    return true;
+}
+
+void
+GncXmlBackgroundSave::preserve (QofInstance* inst)
+{
+    Transaction* trans;
+
+    if (!m_thread || !inst)
+        return;
+    if (g_strcmp0 (inst->e_type, GNC_ID_SPLIT) == 0)
+        trans = xaccSplitGetParent (GNC_SPLIT (inst));
+    else if (g_strcmp0 (inst->e_type, GNC_ID_TRANS) == 0)
+        trans = GNC_TRANSACTION (inst);
+    else
+        return;
+
+    g_mutex_lock (&m_mutex);
+    auto it = m_index.find (trans);
+    if (it != m_index.end () && m_state[it->second] == TransState::PENDING)
+    {
+        /* A copy that failed leaves the text empty, which fails the save. */
+        serialize_transaction (trans, m_lots, m_preserved[it->second]);
+        m_state[it->second] = TransState::PRESERVED;
+    }
+    g_mutex_unlock (&m_mutex);
+}
+
+bool
+GncXmlBackgroundSave::write_transactions ()
+{
+    GncXmlWriter writer;
+
+    for (size_t i = 0; i < m_trans.size (); i++)
+    {
+        bool ok = true;
+
+        /* The lock keeps the transaction from being edited while it's
+         * written, or has it copied before. */
+        g_mutex_lock (&m_mutex);
+        if (m_state[i] == TransState::PRESERVED)
+        {
+            auto it = m_preserved.find (i);
+            ok = !it->second.empty ();
+            writer.append (it->second.c_str ());
+            m_preserved.erase (it);
+        }
+        else
+        {
+            try
+            {
+                gnc_transaction_xml_write (writer, m_trans[i], &m_lots);
+                writer.append ("\n");
+            }
+            catch (std::exception& err)
+            {
+                PERR ("Failed to write a transaction: %s", err.what ());
+                ok = false;
+            }
+            m_state[i] = TransState::WRITTEN;
+        }
+        g_mutex_unlock (&m_mutex);
+        if (!ok)
+            return false;
+
+        auto& buf = writer.str ();
+        if (buf.size () >= FLUSH_SIZE || i + 1 == m_trans.size ())
+        {
+            if (fwrite (buf.data (), 1, buf.size (), m_out) != buf.size ()
+                || ferror (m_out))
+                return false;
+            writer.clear ();
+        }
+    }
+    return true;
+}
+
+bool
+GncXmlBackgroundSave::copy_tail ()
+{
+    char buf[64 * 1024];
+    size_t count;
+
+    rewind (m_tail);
+    while ((count = fread (buf, 1, sizeof (buf), m_tail)) > 0)
+        if (fwrite (buf, 1, count, m_out) != count)
+            return false;
+    return !ferror (m_tail) && !ferror (m_out);
+}
+
+gpointer
+GncXmlBackgroundSave::run (gpointer data)
+{
+    auto self = static_cast<GncXmlBackgroundSave*> (data);
+
+    bool ok = self->write_transactions () && self->copy_tail ();
+    fclose (self->m_tail);
+    self->m_tail = nullptr;
+    ok = gnc_xml_close_for_write_v2 (self->m_out, self->m_compress) && ok;
+    self->m_out = nullptr;
+
+    g_mutex_lock (&self->m_mutex);
+    self->m_ok = ok;
+    if (self->m_done)
+        self->m_done_source = g_idle_add (self->m_done, self->m_done_data);
+    g_mutex_unlock (&self->m_mutex);
+    return nullptr;
+}
+
+bool
+GncXmlBackgroundSave::finish ()
+{
+    if (!m_thread)
+        return m_ok;
+
+    g_thread_join (m_thread);
+    m_thread = nullptr;
+
+    /* Ended before the main loop got round to telling us, or from the
+     * callback itself. */
+    if (m_done_source)
+    {
+        auto source = g_main_context_find_source_by_id (nullptr,
+                                                        m_done_source);
+        if (source && !g_source_is_destroyed (source))
+            g_source_destroy (source);
+        m_done_source = 0;
+    }
+
+    m_trans.clear ();
+    m_state.clear ();
+    m_index.clear ();
+    m_preserved.clear ();
+    m_lots.clear ();
+    return m_ok;
+}
@@ -0,0 +1,106 @@
+/********************************************************************
+ * gnc-xml-background-save.hpp: Write an XML data file while the    *
+ * book is still being edited.                                      *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+#ifndef __GNC_XML_BACKGROUND_SAVE_HPP__
+#define __GNC_XML_BACKGROUND_SAVE_HPP__
+
+extern "C"
+{
+#include <stdio.h>
+#include <glib.h>
+#include "gnc-engine.h"
+}
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gnc-xml.h"
+
+/** The writing of a data file as the book was when it was started, done by a
+ * worker thread while the book goes on being edited.
+ *
+ * Everything but the transactions, which make up most of a book, is written
+ * when the save is started.  The transactions are written by the worker from
+ * the list taken then, and are copied on write: the backend hands each
+ * instance about to be edited to preserve(), which serializes the
+ * transaction it belongs to as it still is unless the worker has already
+ * written it, and the worker writes that copy in its place.  Transactions
+ * created after the start aren't written, and destroyed ones are written
+ * from their copy.
+ *
+ * The worker reads nothing of the book but the transactions it hasn't been
+ * handed a copy of, their splits, and the accounts' GUIDs and commodities
+ * these refer to.  The backend waits for the save to end before a commodity
+ * is edited.  A split's lot changes, and a lot is freed, without its
+ * transaction being edited, so the GUIDs of the splits' lots are taken when
+ * the save starts and written in place of the lots they have by then.
+ */
+class GncXmlBackgroundSave
+{
+public:
+    GncXmlBackgroundSave();
+    GncXmlBackgroundSave(const GncXmlBackgroundSave&) = delete;
+    GncXmlBackgroundSave& operator=(const GncXmlBackgroundSave&) = delete;
+    /** Waits for the worker. */
+    ~GncXmlBackgroundSave();
+
+    /** Write book to filename.  done is called on the main loop once the
+     * worker has finished, unless finish() was called before.  Returns false
+     * if the save couldn't be started, leaving nothing running. */
+    bool start(QofBook* book, const std::string& filename, bool compress,
+               GSourceFunc done, gpointer data);
+    /** Keep the transaction inst is or belongs to as it is now. */
+    void preserve(QofInstance* inst);
+    bool running() const { return m_thread != nullptr; }
+    /** Wait for the worker.  Returns whether the whole file was written. */
+    bool finish();
+
+private:
+    enum class TransState : char { PENDING, WRITTEN, PRESERVED };
+
+    static gpointer run(gpointer data);
+    bool write_transactions();
+    bool copy_tail();
+
+    GThread* m_thread = nullptr;
+    GMutex m_mutex;
+    FILE* m_out = nullptr;
+    FILE* m_tail = nullptr;
+    bool m_compress = false;
+    bool m_ok = false;
+    GSourceFunc m_done = nullptr;
+    gpointer m_done_data = nullptr;
+    guint m_done_source = 0;
+
+    /* The book's transactions in the order they are written, and for each
+     * whether it has been written or copied.  Guarded by m_mutex. */
+    std::vector<Transaction*> m_trans;
+    std::vector<TransState> m_state;
+    std::unordered_map<const Transaction*, size_t> m_index;
+    std::unordered_map<size_t, std::string> m_preserved;
+    /* The lots of the transactions' splits as the save started, only read
+     * once it has. */
+    GncSplitLots m_lots;
+};
+
+#endif /* __GNC_XML_BACKGROUND_SAVE_HPP__ */
@@ -0,0 +1,292 @@
+/********************************************************************
+ * gnc-xml-journal.cpp: Change journal next to an XML data file.    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+extern "C"
+{
+#include <config.h>
+#include <platform.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef G_OS_WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include <gnc-engine.h> //for GNC_MOD_BACKEND
+}
+
+#include "gnc-xml-journal.hpp"
+
+#define JOURNAL_MAGIC "gnc-journal 1"
+#define JOURNAL_RECORD "record"
+
+static QofLogModule log_module = GNC_MOD_BACKEND;
+
+void
+GncXmlJournal::set_datafile (const std::string& datafile)
+{
+    m_datafile = datafile;
+    m_path = datafile.empty () ? datafile : datafile + GNC_XML_JOURNAL_EXT;
+}
+
+bool
+GncXmlJournal::exists () const
+{
+    GStatBuf statbuf;
+
+    return !m_path.empty () && g_stat (m_path.c_str (), &statbuf) == 0;
+}
+
+gint64
+GncXmlJournal::size () const
+{
+    GStatBuf statbuf;
+
+    if (m_path.empty () || g_stat (m_path.c_str (), &statbuf) != 0)
+        return 0;
+    return statbuf.st_size;
+}
+
+/* The journal's first line names the data file by its size and the CRC-32
+ * of all of it, not by its modification time, which copying the files can
+ * change.  Every full write changes the file somewhere, not necessarily at
+ * either end or in length, and a journal that still matched would be
+ * replayed onto changes it doesn't know about.  The file is only read to
+ * load it and when the first record after a full write starts the
+ * journal. */
+#define JOURNAL_ID_BUFSIZE (64 * 1024)
+
+bool
+GncXmlJournal::datafile_id (std::string& id) const
+{
+    std::vector<Bytef> buf (JOURNAL_ID_BUFSIZE);
+    uLong crc = crc32 (0L, Z_NULL, 0);
+    gint64 total = 0;
+    int flags = 0;
+    bool ok = true;
+
+#ifdef G_OS_WIN32
+    flags = O_BINARY;
+#endif
+    auto fd = g_open (m_datafile.c_str (), O_RDONLY | flags, 0);
+    if (fd == -1)
+        return false;
+
+    while (true)
+    {
+        auto count = ::read (fd, buf.data (), buf.size ());
+        if (count == 0)
+            break;
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ok = false;
+            break;
+        }
+        crc = crc32 (crc, buf.data (), count);
+        total += count;
+    }
+    close (fd);
+    if (!ok)
+        return false;
+
+    auto str = g_strdup_printf (JOURNAL_MAGIC " %" G_GINT64_FORMAT " %08lx\n",
+                                total, crc);
+    id = str;
+    g_free (str);
+    return true;
+}
+
+bool
+GncXmlJournal::read (std::vector<std::string>& records, bool* torn) const
+{
+    gchar* contents;
+    gsize length;
+    std::string id;
+
+    *torn = false;
+    if (!exists () || !datafile_id (id))
+        return false;
+    if (!g_file_get_contents (m_path.c_str (), &contents, &length, NULL))
+    {
+        PWARN ("Unable to read the journal %s", m_path.c_str ());
+        return false;
+    }
+    if (length < id.size () || id.compare (0, id.size (), contents, id.size ()))
+    {
+        PINFO ("Journal %s is older than its data file, ignoring it",
+               m_path.c_str ());
+        g_free (contents);
+        return false;
+    }
+
+    gsize pos = id.size ();
+    while (pos < length)
+    {
+        auto line_end = static_cast<const char*> (memchr (contents + pos, '\n',
+                                                          length - pos));
+        gsize payload_len;
+        unsigned long crc;
+        int n_read = 0;
+
+        if (!line_end ||
+            sscanf (contents + pos, JOURNAL_RECORD " %" G_GSIZE_FORMAT " %8lx%n",
+                    &payload_len, &crc, &n_read) != 2 ||
+            contents + pos + n_read != line_end)
+        {
+            *torn = true;
+            break;
+        }
+        pos = line_end + 1 - contents;
+        if (payload_len > length - pos ||
+            crc32 (crc32 (0L, Z_NULL, 0), (const Bytef*) contents + pos,
+                   payload_len) != crc)
+        {
+            *torn = true;
+            break;
+        }
+        records.emplace_back (contents + pos, payload_len);
+        pos += payload_len;
+    }
+    if (*torn)
+        PWARN ("Journal %s ends with a damaged record, dropping it",
+               m_path.c_str ());
+
+    g_free (contents);
+    return true;
+}
+
+static bool
+write_and_sync (FILE* out, const std::string& head, const std::string& body)
+{
+    bool ok = fwrite (head.data (), 1, head.size (), out) == head.size () &&
+              fwrite (body.data (), 1, body.size (), out) == body.size () &&
+              fflush (out) == 0;
+#ifdef G_OS_WIN32
+    ok = ok && _commit (fileno (out)) == 0;
+#else
+    ok = ok && fsync (fileno (out)) == 0;
+#endif
+    return (fclose (out) == 0) && ok;
+}
+
+bool
+GncXmlJournal::reset ()
+{
+    std::string id;
+    auto tmp_path = m_path + ".tmp";
+
+    if (m_path.empty () || !datafile_id (id))
+        return false;
+
+    auto out = g_fopen (tmp_path.c_str (), "wb");
+    if (!out)
+    {
+        PWARN ("Unable to create the journal %s: %s", tmp_path.c_str (),
+               g_strerror (errno));
+        return false;
+    }
+    if (!write_and_sync (out, id, std::string ()))
+    {
+        PWARN ("Unable to write the journal %s: %s", tmp_path.c_str (),
+               g_strerror (errno));
+        g_unlink (tmp_path.c_str ());
+        return false;
+    }
+#ifdef G_OS_WIN32
+    /* Windows won't rename over an existing file. */
+    g_unlink (m_path.c_str ());
+#endif
+    if (g_rename (tmp_path.c_str (), m_path.c_str ()) != 0)
+    {
+        PWARN ("Unable to rename %s to %s: %s", tmp_path.c_str (),
+               m_path.c_str (), g_strerror (errno));
+        g_unlink (tmp_path.c_str ());
+        return false;
+    }
+    return true;
+}
+
+bool
+GncXmlJournal::append (const std::string& payload)
+{
+    auto out = g_fopen (m_path.c_str (), "ab");
+    if (!out)
+    {
+        PWARN ("Unable to open the journal %s: %s", m_path.c_str (),
+               g_strerror (errno));
+        return false;
+    }
+
+    auto crc = crc32 (crc32 (0L, Z_NULL, 0), (const Bytef*) payload.data (),
+                      payload.size ());
+    auto line = g_strdup_printf (JOURNAL_RECORD " %" G_GSIZE_FORMAT " %08lx\n",
+                                 payload.size (), crc);
+    std::string head {line};
+    g_free (line);
+
+    if (!write_and_sync (out, head, payload))
+    {
+        PWARN ("Unable to write to the journal %s: %s", m_path.c_str (),
+               g_strerror (errno));
+        return false;
+    }
+    return true;
+}
+
+bool
+GncXmlJournal::remove ()
+{
+    if (g_unlink (m_path.c_str ()) != 0 && errno != ENOENT)
+    {
+        PWARN ("Unable to remove the journal %s: %s", m_path.c_str (),
+               g_strerror (errno));
+        return false;
+    }
+    return true;
+}
+
+bool
+GncXmlJournal::set_aside ()
+{
+    auto failed_path = m_path + ".failed";
+
+#ifdef G_OS_WIN32
+    g_unlink (failed_path.c_str ());
+#endif
+    if (g_rename (m_path.c_str (), failed_path.c_str ()) != 0)
+    {
+        PWARN ("Unable to rename %s to %s: %s", m_path.c_str (),
+               failed_path.c_str (), g_strerror (errno));
+        return false;
+    }
+    PWARN ("Kept the journal that failed to replay as %s",
+           failed_path.c_str ());
+    return true;
+}
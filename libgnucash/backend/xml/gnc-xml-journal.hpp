@@ -0,0 +1,82 @@
+/********************************************************************
+ * gnc-xml-journal.hpp: Change journal next to an XML data file.    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+#ifndef __GNC_XML_JOURNAL_HPP__
+#define __GNC_XML_JOURNAL_HPP__
+
+extern "C"
+{
+#include <glib.h>
+}
+
+#include <string>
+#include <vector>
+
+#define GNC_XML_JOURNAL_EXT ".journal"
+
+/** The append-only file <datafile>.journal, holding the changes saved since
+ * the data file was last written in full.
+ *
+ * The first line names the data file version the journal applies to by its
+ * size and the CRC-32 of all of it.  Each record after it is
+ * one save: a line with the length and CRC-32 of the payload, then the
+ * payload, an XML document of its own.
+ * A journal whose first line doesn't match the data file is left over from
+ * before the last full write and is ignored.  A record cut short or damaged
+ * by a crash during append() ends the journal; everything before it is
+ * intact, as every append is flushed to the disk before the save reports
+ * success.
+ */
+class GncXmlJournal
+{
+public:
+    GncXmlJournal() = default;
+    GncXmlJournal(const GncXmlJournal&) = delete;
+    GncXmlJournal& operator=(const GncXmlJournal&) = delete;
+
+    void set_datafile(const std::string& datafile);
+    const std::string& path() const noexcept { return m_path; }
+    bool exists() const;
+    /** The journal's size in bytes, 0 if there is none. */
+    gint64 size() const;
+
+    /** Read the records of the journal if it applies to the data file as it
+     * is now.  Returns false if there is none or it doesn't apply; *torn is
+     * set if the last record was cut short or damaged. */
+    bool read(std::vector<std::string>& records, bool* torn) const;
+    /** Replace the journal with an empty one for the data file as it is
+     * now. */
+    bool reset();
+    /** Append a record and flush it to the disk. */
+    bool append(const std::string& payload);
+    bool remove();
+    /** Rename the journal to <journal>.failed, out of the way of the
+     * saves. */
+    bool set_aside();
+
+private:
+    bool datafile_id(std::string& id) const;
+
+    std::string m_datafile;
+    std::string m_path;
+};
+
+#endif /* __GNC_XML_JOURNAL_HPP__ */
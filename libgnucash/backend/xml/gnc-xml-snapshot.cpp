@@ -0,0 +1,1063 @@
+/********************************************************************
+ * gnc-xml-snapshot.cpp: Binary snapshot cache of an XML data file. *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+extern "C"
+{
+#include <config.h>
+#include <platform.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef G_OS_WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include "gnc-engine.h"
+#include "gnc-commodity.h"
+#include "gnc-lot.h"
+#include "Account.h"
+#include "Transaction.h"
+#include "TransactionP.h"
+#include "SplitP.h"
+#include "gnc-pricedb-p.h"
+}
+
+#include <kvp-frame.hpp>
+#include <qofinstance-p.h>
+
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "io-gncxml-v2.h"
+#include "gnc-xml-snapshot.hpp"
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+#define SNAPSHOT_MAGIC "GNCSNAP"
+#define SNAPSHOT_VERSION 1
+/* Written as is, so a snapshot from a machine of the other byte order reads
+ * back swapped and is ignored. */
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+/* The data file's tail is checked as well as its size and time, as a copy
+ * can keep both. */
+#define SNAPSHOT_TAIL_SIZE (64 * 1024)
+#define SNAPSHOT_NO_SLOTS G_MAXUINT64
+/* Deeper nesting than any book has means the slots are damaged. */
+#define SNAPSHOT_MAX_DEPTH 64
+
+enum
+{
+    SNAPSHOT_XML_BEFORE,
+    SNAPSHOT_PRICES,
+    SNAPSHOT_TRANSACTIONS,
+    SNAPSHOT_XML_AFTER,
+    SNAPSHOT_STRINGS,
+    SNAPSHOT_SLOTS,
+    SNAPSHOT_N_SECTIONS
+};
+
+struct GncSnapshotSection
+{
+    guint64 offset;
+    guint64 size;
+    guint64 count;
+};
+
+struct GncSnapshotHeader
+{
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    gint64 datafile_size;
+    gint64 datafile_mtime;
+    guint32 datafile_tail_crc;
+    /* The CRC-32 of everything after the header. */
+    guint32 body_crc;
+    GncSnapshotSection sections[SNAPSHOT_N_SECTIONS];
+};
+
+/* Strings are offsets into the string table, which starts with "", and
+ * slots offsets into the slots table.  Every section starts 8-byte aligned
+ * and the records are multiples of 8 bytes, so they are read in place. */
+struct GncSnapshotPrice
+{
+    GncGUID guid;
+    gint64 time;
+    gint64 value_num;
+    gint64 value_denom;
+    guint32 commodity_space;
+    guint32 commodity_id;
+    guint32 currency_space;
+    guint32 currency_id;
+    guint32 source;
+    guint32 type;
+};
+
+/* Each transaction is followed by its n_splits splits. */
+struct GncSnapshotTransaction
+{
+    GncGUID guid;
+    gint64 date_posted;
+    gint64 date_entered;
+    guint64 slots;
+    guint32 currency_space;
+    guint32 currency_id;
+    guint32 num;
+    guint32 description;
+    guint32 n_splits;
+    guint32 padding;
+};
+
+struct GncSnapshotSplit
+{
+    GncGUID guid;
+    GncGUID account;
+    GncGUID lot;
+    gint64 value_num;
+    gint64 value_denom;
+    gint64 amount_num;
+    gint64 amount_denom;
+    gint64 reconcile_date;
+    guint64 slots;
+    guint32 memo;
+    guint32 action;
+    gint32 reconciled;
+    guint32 padding;
+};
+
+static_assert (sizeof (GncSnapshotHeader) % 8 == 0, "misaligned header");
+static_assert (sizeof (GncSnapshotPrice) % 8 == 0, "misaligned price");
+static_assert (sizeof (GncSnapshotTransaction) % 8 == 0,
+               "misaligned transaction");
+static_assert (sizeof (GncSnapshotSplit) % 8 == 0, "misaligned split");
+
+static gint64
+file_tell (FILE* file)
+{
+#ifdef G_OS_WIN32
+    return _ftelli64 (file);
+#else
+    return ftello (file);
+#endif
+}
+
+static int
+file_seek (FILE* file, gint64 offset)
+{
+#ifdef G_OS_WIN32
+    return _fseeki64 (file, offset, SEEK_SET);
+#else
+    return fseeko (file, offset, SEEK_SET);
+#endif
+}
+
+static uLong
+crc32_buffer (uLong crc, const char* data, size_t size)
+{
+    /* crc32() takes at most 4 GiB at a time. */
+    while (size > 0)
+    {
+        uInt chunk = MIN (size, (size_t) 1 << 30);
+        crc = crc32 (crc, (const Bytef*) data, chunk);
+        data += chunk;
+        size -= chunk;
+    }
+    return crc;
+}
+
+/* Fill in the fields of header that identify the data file as it is now. */
+static bool
+datafile_id (const std::string& datafile, GncSnapshotHeader* header)
+{
+    GStatBuf statbuf;
+    std::vector<char> tail (SNAPSHOT_TAIL_SIZE);
+    int flags = 0;
+
+    if (g_stat (datafile.c_str (), &statbuf) != 0)
+        return false;
+    header->datafile_size = statbuf.st_size;
+    header->datafile_mtime = statbuf.st_mtime;
+
+#ifdef G_OS_WIN32
+    flags = O_BINARY;
+#endif
+    auto fd = g_open (datafile.c_str (), O_RDONLY | flags, 0);
+    if (fd == -1)
+        return false;
+
+    gint64 start = MAX (0, (gint64) statbuf.st_size - SNAPSHOT_TAIL_SIZE);
+    size_t filled = 0;
+    if (lseek (fd, start, SEEK_SET) == -1)
+    {
+        close (fd);
+        return false;
+    }
+    while (filled < tail.size ())
+    {
+        auto count = ::read (fd, tail.data () + filled, tail.size () - filled);
+        if (count == 0)
+            break;
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            close (fd);
+            return false;
+        }
+        filled += count;
+    }
+    close (fd);
+
+    header->datafile_tail_crc = crc32_buffer (crc32 (0L, Z_NULL, 0),
+                                              tail.data (), filled);
+    return true;
+}
+
+/* Collects the string and slots tables while the records are written. */
+class SnapshotTables
+{
+public:
+    SnapshotTables () : m_strings (1, '\0') { m_string_ids[""] = 0; }
+
+    guint32 string_ref (const char* str);
+    guint64 slots_ref (const QofInstance* inst);
+    const std::string& strings () const noexcept { return m_strings; }
+    const std::string& slots () const noexcept { return m_slots; }
+    bool ok () const noexcept { return m_ok; }
+
+private:
+    template <typename T> void put (const T& value)
+    {
+        m_slots.append (reinterpret_cast<const char*> (&value), sizeof (value));
+    }
+    void put_frame (const KvpFrame* frame);
+    void put_value (const KvpValue* value);
+
+    std::string m_strings;
+    std::unordered_map<std::string, guint32> m_string_ids;
+    std::string m_slots;
+    bool m_ok = true;
+};
+
+guint32
+SnapshotTables::string_ref (const char* str)
+{
+    if (!str || !*str)
+        return 0;
+
+    auto found = m_string_ids.find (str);
+    if (found != m_string_ids.end ())
+        return found->second;
+
+    if (m_strings.size () > G_MAXUINT32)
+    {
+        m_ok = false;
+        return 0;
+    }
+    guint32 ref = m_strings.size ();
+    m_strings.append (str);
+    m_strings.push_back ('\0');
+    m_string_ids.emplace (str, ref);
+    return ref;
+}
+
+guint64
+SnapshotTables::slots_ref (const QofInstance* inst)
+{
+    auto frame = qof_instance_get_slots (inst);
+    if (!frame || frame->empty ())
+        return SNAPSHOT_NO_SLOTS;
+
+    guint64 ref = m_slots.size ();
+    put_frame (frame);
+    return ref;
+}
+
+void
+SnapshotTables::put_frame (const KvpFrame* frame)
+{
+    auto count_pos = m_slots.size ();
+    guint32 count = 0;
+
+    put (count);
+    frame->for_each_slot_temp ([this, &count] (const char* key, KvpValue* value)
+    {
+        put (string_ref (key));
+        put_value (value);
+        count++;
+    });
+    memcpy (&m_slots[count_pos], &count, sizeof (count));
+}
+
+void
+SnapshotTables::put_value (const KvpValue* value)
+{
+    gint32 type = value->get_type ();
+
+    put (type);
+    switch (value->get_type ())
+    {
+    case KvpValue::Type::INT64:
+        put<gint64> (value->get<int64_t> ());
+        break;
+    case KvpValue::Type::DOUBLE:
+        put (value->get<double> ());
+        break;
+    case KvpValue::Type::NUMERIC:
+    {
+        auto num = value->get<gnc_numeric> ();
+        put<gint64> (num.num);
+        put<gint64> (num.denom);
+        break;
+    }
+    case KvpValue::Type::STRING:
+        put (string_ref (value->get<const char*> ()));
+        break;
+    case KvpValue::Type::GUID:
+    {
+        auto guid = value->get<GncGUID*> ();
+        put (guid ? *guid : *guid_null ());
+        break;
+    }
+    case KvpValue::Type::TIME64:
+        put<gint64> (value->get<Time64> ().t);
+        break;
+    case KvpValue::Type::GDATE:
+    {
+        auto date = value->get<GDate> ();
+        guint32 julian = g_date_valid (&date) ? g_date_get_julian (&date) : 0;
+        put (julian);
+        break;
+    }
+    case KvpValue::Type::GLIST:
+    {
+        auto list = value->get<GList*> ();
+        guint32 count = g_list_length (list);
+        put (count);
+        for (auto node = list; node; node = node->next)
+            put_value (static_cast<KvpValue*> (node->data));
+        break;
+    }
+    case KvpValue::Type::FRAME:
+    {
+        auto frame = value->get<KvpFrame*> ();
+        if (frame)
+            put_frame (frame);
+        else
+            put<guint32> (0);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static int
+snapshot_collect_transaction (Transaction* trans, gpointer data)
+{
+    auto list = static_cast<std::vector<Transaction*>*> (data);
+    list->push_back (trans);
+    return 0;
+}
+
+static gboolean
+snapshot_collect_price (GNCPrice* price, gpointer data)
+{
+    auto list = static_cast<std::vector<GNCPrice*>*> (data);
+    list->push_back (price);
+    return TRUE;
+}
+
+static bool
+write_padding (FILE* out)
+{
+    static const char zeros[8] = { 0 };
+    auto pos = file_tell (out);
+
+    return pos >= 0 && (pos % 8 == 0 || fwrite (zeros, 1, 8 - pos % 8, out) ==
+                        (size_t) (8 - pos % 8));
+}
+
+static bool
+begin_section (FILE* out, GncSnapshotSection* section)
+{
+    if (!write_padding (out))
+        return false;
+    section->offset = file_tell (out);
+    return true;
+}
+
+static bool
+end_section (FILE* out, GncSnapshotSection* section)
+{
+    auto pos = file_tell (out);
+    if (pos < 0 || ferror (out))
+        return false;
+    section->size = pos - section->offset;
+    return true;
+}
+
+static bool
+write_xml_section (FILE* out, GncSnapshotSection* section, QofBook* book,
+                   gboolean after_transactions)
+{
+    return begin_section (out, section) &&
+           gnc_book_write_snapshot_xml_v2 (book, out, after_transactions) &&
+           end_section (out, section);
+}
+
+static bool
+write_blob_section (FILE* out, GncSnapshotSection* section,
+                    const std::string& blob)
+{
+    return begin_section (out, section) &&
+           fwrite (blob.data (), 1, blob.size (), out) == blob.size () &&
+           end_section (out, section);
+}
+
+static bool
+write_prices (FILE* out, GncSnapshotSection* section, QofBook* book,
+              SnapshotTables& tables)
+{
+    std::vector<GNCPrice*> prices;
+
+    if (!begin_section (out, section))
+        return false;
+
+    gnc_pricedb_foreach_price (gnc_pricedb_get_db (book), snapshot_collect_price,
+                               &prices, TRUE);
+    for (auto price : prices)
+    {
+        GncSnapshotPrice rec;
+        auto commodity = gnc_price_get_commodity (price);
+        auto currency = gnc_price_get_currency (price);
+        auto value = gnc_price_get_value (price);
+
+        memset (&rec, 0, sizeof (rec));
+        rec.guid = *gnc_price_get_guid (price);
+        rec.time = gnc_price_get_time64 (price);
+        rec.value_num = value.num;
+        rec.value_denom = value.denom;
+        rec.commodity_space = tables.string_ref (gnc_commodity_get_namespace (commodity));
+        rec.commodity_id = tables.string_ref (gnc_commodity_get_mnemonic (commodity));
+        rec.currency_space = tables.string_ref (gnc_commodity_get_namespace (currency));
+        rec.currency_id = tables.string_ref (gnc_commodity_get_mnemonic (currency));
+        rec.source = tables.string_ref (gnc_price_get_source_string (price));
+        rec.type = tables.string_ref (gnc_price_get_typestr (price));
+        if (fwrite (&rec, sizeof (rec), 1, out) != 1)
+            return false;
+    }
+    section->count = prices.size ();
+    return end_section (out, section);
+}
+
+static bool
+write_transactions (FILE* out, GncSnapshotSection* section, QofBook* book,
+                    SnapshotTables& tables)
+{
+    std::vector<Transaction*> transactions;
+
+    if (!begin_section (out, section))
+        return false;
+
+    xaccAccountTreeForEachTransaction (gnc_book_get_root_account (book),
+                                       snapshot_collect_transaction,
+                                       &transactions);
+    for (auto trans : transactions)
+    {
+        GncSnapshotTransaction rec;
+        auto currency = xaccTransGetCurrency (trans);
+        auto splits = xaccTransGetSplitList (trans);
+
+        memset (&rec, 0, sizeof (rec));
+        rec.guid = *qof_instance_get_guid (trans);
+        rec.date_posted = xaccTransRetDatePosted (trans);
+        rec.date_entered = xaccTransRetDateEntered (trans);
+        rec.slots = tables.slots_ref (QOF_INSTANCE (trans));
+        if (currency)
+        {
+            rec.currency_space = tables.string_ref (gnc_commodity_get_namespace (currency));
+            rec.currency_id = tables.string_ref (gnc_commodity_get_mnemonic (currency));
+        }
+        rec.num = tables.string_ref (xaccTransGetNum (trans));
+        rec.description = tables.string_ref (xaccTransGetDescription (trans));
+        rec.n_splits = g_list_length (splits);
+        if (fwrite (&rec, sizeof (rec), 1, out) != 1)
+            return false;
+
+        for (auto node = splits; node; node = node->next)
+        {
+            GncSnapshotSplit srec;
+            auto split = static_cast<Split*> (node->data);
+            auto account = xaccSplitGetAccount (split);
+            auto lot = xaccSplitGetLot (split);
+            auto value = xaccSplitGetValue (split);
+            auto amount = xaccSplitGetAmount (split);
+
+            memset (&srec, 0, sizeof (srec));
+            srec.guid = *qof_instance_get_guid (split);
+            srec.account = account ? *qof_instance_get_guid (account) :
+                           *guid_null ();
+            srec.lot = lot ? *gnc_lot_get_guid (lot) : *guid_null ();
+            srec.value_num = value.num;
+            srec.value_denom = value.denom;
+            srec.amount_num = amount.num;
+            srec.amount_denom = amount.denom;
+            srec.reconcile_date = xaccSplitGetDateReconciled (split);
+            srec.slots = tables.slots_ref (QOF_INSTANCE (split));
+            srec.memo = tables.string_ref (xaccSplitGetMemo (split));
+            srec.action = tables.string_ref (xaccSplitGetAction (split));
+            srec.reconciled = xaccSplitGetReconcile (split);
+            if (fwrite (&srec, sizeof (srec), 1, out) != 1)
+                return false;
+        }
+    }
+    section->count = transactions.size ();
+    return end_section (out, section);
+}
+
+/* Read back what follows the header to checksum it. */
+static bool
+checksum_body (FILE* out, guint32* crc)
+{
+    std::vector<char> buf (64 * 1024);
+    uLong sum = crc32 (0L, Z_NULL, 0);
+    size_t count;
+
+    if (fflush (out) != 0 || file_seek (out, sizeof (GncSnapshotHeader)) != 0)
+        return false;
+    while ((count = fread (buf.data (), 1, buf.size (), out)) > 0)
+        sum = crc32 (sum, (const Bytef*) buf.data (), count);
+    if (ferror (out))
+        return false;
+    *crc = sum;
+    return true;
+}
+
+bool
+GncXmlSnapshot::write (QofBook* book, const std::string& datafile)
+{
+    auto path = datafile + GNC_XML_SNAPSHOT_EXT;
+    auto tmp_path = path + ".tmp";
+    GncSnapshotHeader header;
+    SnapshotTables tables;
+    gint64 start = g_get_monotonic_time ();
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    if (!datafile_id (datafile, &header))
+        return false;
+
+    auto out = g_fopen (tmp_path.c_str (), "w+b");
+    if (!out)
+    {
+        PWARN ("Unable to create the snapshot %s: %s", tmp_path.c_str (),
+               g_strerror (errno));
+        return false;
+    }
+
+    auto sections = header.sections;
+    bool ok = fwrite (&header, sizeof (header), 1, out) == 1 &&
+              write_xml_section (out, &sections[SNAPSHOT_XML_BEFORE], book,
+                                 FALSE) &&
+              write_prices (out, &sections[SNAPSHOT_PRICES], book, tables) &&
+              write_transactions (out, &sections[SNAPSHOT_TRANSACTIONS], book,
+                                  tables) &&
+              write_xml_section (out, &sections[SNAPSHOT_XML_AFTER], book,
+                                 TRUE) &&
+              tables.ok () &&
+              write_blob_section (out, &sections[SNAPSHOT_STRINGS],
+                                  tables.strings ()) &&
+              write_blob_section (out, &sections[SNAPSHOT_SLOTS],
+                                  tables.slots ()) &&
+              checksum_body (out, &header.body_crc) &&
+              file_seek (out, 0) == 0 &&
+              fwrite (&header, sizeof (header), 1, out) == 1;
+    if (fclose (out) != 0)
+        ok = false;
+
+    if (!ok)
+    {
+        PWARN ("Unable to write the snapshot %s", tmp_path.c_str ());
+        g_unlink (tmp_path.c_str ());
+        return false;
+    }
+#ifdef G_OS_WIN32
+    /* Windows won't rename over an existing file. */
+    g_unlink (path.c_str ());
+#endif
+    if (g_rename (tmp_path.c_str (), path.c_str ()) != 0)
+    {
+        PWARN ("Unable to rename %s to %s: %s", tmp_path.c_str (),
+               path.c_str (), g_strerror (errno));
+        g_unlink (tmp_path.c_str ());
+        return false;
+    }
+    PINFO ("Wrote the snapshot %s in %.2f s", path.c_str (),
+           (g_get_monotonic_time () - start) / 1e6);
+    return true;
+}
+
+bool
+GncXmlSnapshot::remove (const std::string& datafile)
+{
+    auto path = datafile + GNC_XML_SNAPSHOT_EXT;
+
+    if (g_unlink (path.c_str ()) != 0 && errno != ENOENT)
+    {
+        PWARN ("Unable to remove the snapshot %s: %s", path.c_str (),
+               g_strerror (errno));
+        return false;
+    }
+    return true;
+}
+
+GncXmlSnapshot::~GncXmlSnapshot ()
+{
+    close ();
+}
+
+void
+GncXmlSnapshot::close ()
+{
+    if (m_file)
+        g_mapped_file_unref (m_file);
+    m_file = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+}
+
+bool
+GncXmlSnapshot::open (const std::string& datafile)
+{
+    auto path = datafile + GNC_XML_SNAPSHOT_EXT;
+    GncSnapshotHeader expected;
+    GError* error = nullptr;
+
+    close ();
+    if (!g_file_test (path.c_str (), G_FILE_TEST_IS_REGULAR) ||
+        !datafile_id (datafile, &expected))
+        return false;
+
+    m_file = g_mapped_file_new (path.c_str (), FALSE, &error);
+    if (!m_file)
+    {
+        PWARN ("Unable to map the snapshot %s: %s", path.c_str (),
+               error->message);
+        g_error_free (error);
+        return false;
+    }
+    m_data = g_mapped_file_get_contents (m_file);
+    m_size = g_mapped_file_get_length (m_file);
+    m_header = reinterpret_cast<const GncSnapshotHeader*> (m_data);
+
+    if (m_size < sizeof (GncSnapshotHeader) ||
+        memcmp (m_header->magic, SNAPSHOT_MAGIC, sizeof (m_header->magic)) ||
+        m_header->version != SNAPSHOT_VERSION ||
+        m_header->byte_order != SNAPSHOT_BYTE_ORDER)
+    {
+        PINFO ("%s isn't a snapshot this version can read", path.c_str ());
+        close ();
+        return false;
+    }
+    if (m_header->datafile_size != expected.datafile_size ||
+        m_header->datafile_mtime != expected.datafile_mtime ||
+        m_header->datafile_tail_crc != expected.datafile_tail_crc)
+    {
+        PINFO ("The snapshot %s is older than its data file", path.c_str ());
+        close ();
+        return false;
+    }
+
+    for (auto& section : m_header->sections)
+        if (section.offset < sizeof (GncSnapshotHeader) ||
+            section.offset % 8 != 0 || section.offset > m_size ||
+            section.size > m_size - section.offset)
+        {
+            PWARN ("The snapshot %s is damaged", path.c_str ());
+            close ();
+            return false;
+        }
+
+    auto body = m_data + sizeof (GncSnapshotHeader);
+    auto sum = crc32_buffer (crc32 (0L, Z_NULL, 0), body,
+                             m_size - sizeof (GncSnapshotHeader));
+    size_t strings_size;
+    auto strings = section (SNAPSHOT_STRINGS, &strings_size);
+    if (sum != m_header->body_crc || strings_size == 0 ||
+        strings[strings_size - 1] != '\0')
+    {
+        PWARN ("The snapshot %s is damaged", path.c_str ());
+        close ();
+        return false;
+    }
+    return true;
+}
+
+const char*
+GncXmlSnapshot::section (int id, size_t* size) const
+{
+    *size = m_header->sections[id].size;
+    return m_data + m_header->sections[id].offset;
+}
+
+const char*
+GncXmlSnapshot::xml (bool after_transactions, size_t* size) const
+{
+    return section (after_transactions ? SNAPSHOT_XML_AFTER :
+                    SNAPSHOT_XML_BEFORE, size);
+}
+
+/* Turns the references of the records back into strings, commodities and
+ * slots. */
+class SnapshotResolver
+{
+public:
+    SnapshotResolver (QofBook* book, const char* strings, size_t strings_size,
+                      const char* slots, size_t slots_size) :
+        m_table {gnc_commodity_table_get_table (book)},
+        m_strings {strings}, m_strings_size {strings_size},
+        m_slots {slots}, m_slots_size {slots_size} {}
+
+    const char* string (guint32 ref)
+    {
+        if (ref >= m_strings_size)
+        {
+            m_ok = false;
+            return "";
+        }
+        return m_strings + ref;
+    }
+    gnc_commodity* commodity (guint32 space, guint32 id);
+    void slots (QofInstance* inst, guint64 ref);
+    bool ok () const noexcept { return m_ok; }
+
+private:
+    template <typename T> bool get (T& value)
+    {
+        if (sizeof (value) > m_slots_size - m_pos)
+            return m_ok = false;
+        memcpy (&value, m_slots + m_pos, sizeof (value));
+        m_pos += sizeof (value);
+        return true;
+    }
+    bool get_frame (KvpFrame* frame, int depth);
+    KvpValue* get_value (int depth);
+
+    gnc_commodity_table* m_table;
+    std::map<std::pair<guint32, guint32>, gnc_commodity*> m_commodities;
+    const char* m_strings;
+    size_t m_strings_size;
+    const char* m_slots;
+    size_t m_slots_size;
+    size_t m_pos = 0;
+    bool m_ok = true;
+};
+
+gnc_commodity*
+SnapshotResolver::commodity (guint32 space, guint32 id)
+{
+    auto key = std::make_pair (space, id);
+    auto found = m_commodities.find (key);
+    if (found != m_commodities.end ())
+        return found->second;
+
+    auto commodity = gnc_commodity_table_lookup (m_table, string (space),
+                                                 string (id));
+    if (!commodity)
+    {
+        PWARN ("Unknown commodity %s::%s", string (space), string (id));
+        m_ok = false;
+    }
+    m_commodities.emplace (key, commodity);
+    return commodity;
+}
+
+void
+SnapshotResolver::slots (QofInstance* inst, guint64 ref)
+{
+    if (ref == SNAPSHOT_NO_SLOTS)
+        return;
+    if (ref >= m_slots_size)
+    {
+        m_ok = false;
+        return;
+    }
+    m_pos = ref;
+    get_frame (qof_instance_get_slots (inst), 0);
+}
+
+bool
+SnapshotResolver::get_frame (KvpFrame* frame, int depth)
+{
+    guint32 count;
+
+    if (depth > SNAPSHOT_MAX_DEPTH || !get (count))
+        return m_ok = false;
+    for (guint32 i = 0; i < count; i++)
+    {
+        guint32 key;
+        if (!get (key))
+            return false;
+        auto key_str = string (key);
+        auto value = get_value (depth);
+        if (!m_ok)
+            return false;
+        if (value)
+            delete frame->set ({key_str}, value);
+    }
+    return true;
+}
+
+KvpValue*
+SnapshotResolver::get_value (int depth)
+{
+    gint32 type;
+
+    if (!get (type))
+        return nullptr;
+    switch (type)
+    {
+    case KvpValue::Type::INT64:
+    {
+        gint64 value;
+        return get (value) ? new KvpValue {static_cast<int64_t> (value)} :
+               nullptr;
+    }
+    case KvpValue::Type::DOUBLE:
+    {
+        double value;
+        return get (value) ? new KvpValue {value} : nullptr;
+    }
+    case KvpValue::Type::NUMERIC:
+    {
+        gint64 num, denom;
+        return get (num) && get (denom) ?
+               new KvpValue {gnc_numeric_create (num, denom)} : nullptr;
+    }
+    case KvpValue::Type::STRING:
+    {
+        guint32 ref;
+        if (!get (ref))
+            return nullptr;
+        return new KvpValue {const_cast<const char*> (g_strdup (string (ref)))};
+    }
+    case KvpValue::Type::GUID:
+    {
+        GncGUID guid;
+        if (!get (guid))
+            return nullptr;
+        auto value = guid_malloc ();
+        *value = guid;
+        return new KvpValue {value};
+    }
+    case KvpValue::Type::TIME64:
+    {
+        Time64 time;
+        return get (time.t) ? new KvpValue {time} : nullptr;
+    }
+    case KvpValue::Type::GDATE:
+    {
+        guint32 julian;
+        GDate date;
+        if (!get (julian))
+            return nullptr;
+        g_date_clear (&date, 1);
+        if (julian)
+            g_date_set_julian (&date, julian);
+        return new KvpValue {date};
+    }
+    case KvpValue::Type::GLIST:
+    {
+        guint32 count;
+        GList* list = NULL;
+        if (depth > SNAPSHOT_MAX_DEPTH || !get (count))
+        {
+            m_ok = false;
+            return nullptr;
+        }
+        for (guint32 i = 0; i < count && m_ok; i++)
+        {
+            auto value = get_value (depth + 1);
+            if (value)
+                list = g_list_prepend (list, value);
+        }
+        if (!m_ok)
+        {
+            g_list_free_full (list, [] (gpointer value)
+            {
+                delete static_cast<KvpValue*> (value);
+            });
+            return nullptr;
+        }
+        return new KvpValue {g_list_reverse (list)};
+    }
+    case KvpValue::Type::FRAME:
+    {
+        auto frame = new KvpFrame;
+        if (!get_frame (frame, depth + 1))
+        {
+            delete frame;
+            return nullptr;
+        }
+        return new KvpValue {frame};
+    }
+    default:
+        /* Nothing was written for it. */
+        return nullptr;
+    }
+}
+
+bool
+GncXmlSnapshot::load_prices (QofBook* book, PriceList** prices) const
+{
+    size_t size, strings_size, slots_size;
+    auto data = section (SNAPSHOT_PRICES, &size);
+    auto strings = section (SNAPSHOT_STRINGS, &strings_size);
+    auto slots = section (SNAPSHOT_SLOTS, &slots_size);
+    auto count = m_header->sections[SNAPSHOT_PRICES].count;
+    SnapshotResolver resolver {book, strings, strings_size, slots, slots_size};
+    PriceList* list = NULL;
+
+    *prices = NULL;
+    if (count > size / sizeof (GncSnapshotPrice))
+        return false;
+
+    auto recs = reinterpret_cast<const GncSnapshotPrice*> (data);
+    for (guint64 i = 0; i < count && resolver.ok (); i++)
+    {
+        auto& rec = recs[i];
+        auto price = gnc_price_create (book);
+
+        gnc_price_begin_edit (price);
+        gnc_price_set_guid (price, &rec.guid);
+        gnc_price_set_commodity (price, resolver.commodity (rec.commodity_space,
+                                                            rec.commodity_id));
+        gnc_price_set_currency (price, resolver.commodity (rec.currency_space,
+                                                           rec.currency_id));
+        gnc_price_set_time64 (price, rec.time);
+        gnc_price_set_source_string (price, resolver.string (rec.source));
+        gnc_price_set_typestr (price, resolver.string (rec.type));
+        gnc_price_set_value (price, gnc_numeric_create (rec.value_num,
+                                                        rec.value_denom));
+        gnc_price_commit_edit (price);
+        list = g_list_prepend (list, price);
+    }
+
+    if (!resolver.ok ())
+    {
+        g_list_free_full (list, (GDestroyNotify) gnc_price_unref);
+        return false;
+    }
+    *prices = g_list_reverse (list);
+    return true;
+}
+
+bool
+GncXmlSnapshot::load_transactions (QofBook* book,
+                                   const std::function<void(Transaction*)>& add) const
+{
+    size_t size, strings_size, slots_size;
+    auto data = section (SNAPSHOT_TRANSACTIONS, &size);
+    auto strings = section (SNAPSHOT_STRINGS, &strings_size);
+    auto slots = section (SNAPSHOT_SLOTS, &slots_size);
+    auto count = m_header->sections[SNAPSHOT_TRANSACTIONS].count;
+    SnapshotResolver resolver {book, strings, strings_size, slots, slots_size};
+    size_t pos = 0;
+
+    for (guint64 i = 0; i < count; i++)
+    {
+        if (sizeof (GncSnapshotTransaction) > size - pos)
+            return false;
+        auto rec = reinterpret_cast<const GncSnapshotTransaction*> (data + pos);
+        pos += sizeof (GncSnapshotTransaction);
+        if (rec->n_splits > (size - pos) / sizeof (GncSnapshotSplit))
+            return false;
+
+        auto trans = xaccMallocTransaction (book);
+        xaccTransBeginEdit (trans);
+        xaccTransSetGUID (trans, &rec->guid);
+        if (rec->currency_space || rec->currency_id)
+            xaccTransSetCurrency (trans, resolver.commodity (rec->currency_space,
+                                                             rec->currency_id));
+        if (rec->num)
+            xaccTransSetNum (trans, resolver.string (rec->num));
+        xaccTransSetDatePostedSecs (trans, rec->date_posted);
+        xaccTransSetDateEnteredSecs (trans, rec->date_entered);
+        xaccTransSetDescription (trans, resolver.string (rec->description));
+        resolver.slots (QOF_INSTANCE (trans), rec->slots);
+
+        auto srecs = reinterpret_cast<const GncSnapshotSplit*> (data + pos);
+        pos += rec->n_splits * sizeof (GncSnapshotSplit);
+        for (guint32 j = 0; j < rec->n_splits && resolver.ok (); j++)
+        {
+            auto& srec = srecs[j];
+            /* Like the data file's parser, a split without a known account
+             * is left without one for the scrubber to put into an orphan
+             * account. */
+            auto account = xaccAccountLookup (&srec.account, book);
+            if (!account && !guid_equal (&srec.account, guid_null ()))
+                PWARN ("A split refers to an unknown account");
+
+            auto split = xaccMallocSplit (book);
+            xaccSplitSetGUID (split, &srec.guid);
+            if (srec.memo)
+                xaccSplitSetMemo (split, resolver.string (srec.memo));
+            if (srec.action)
+                xaccSplitSetAction (split, resolver.string (srec.action));
+            xaccSplitSetReconcile (split, srec.reconciled);
+            if (srec.reconcile_date)
+                xaccSplitSetDateReconciledSecs (split, srec.reconcile_date);
+            xaccSplitSetValue (split, gnc_numeric_create (srec.value_num,
+                                                          srec.value_denom));
+            xaccSplitSetAmount (split, gnc_numeric_create (srec.amount_num,
+                                                           srec.amount_denom));
+            if (account)
+                xaccAccountInsertSplit (account, split);
+            if (!guid_equal (&srec.lot, guid_null ()))
+                gnc_lot_add_split (gnc_lot_lookup (&srec.lot, book), split);
+            resolver.slots (QOF_INSTANCE (split), srec.slots);
+            xaccTransAppendSplit (trans, split);
+        }
+
+        if (!resolver.ok ())
+        {
+            xaccTransDestroy (trans);
+            xaccTransCommitEdit (trans);
+            return false;
+        }
+        xaccTransCommitEdit (trans);
+        add (trans);
+    }
+    return true;
+}
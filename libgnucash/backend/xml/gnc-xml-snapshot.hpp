@@ -0,0 +1,86 @@
+/********************************************************************
+ * gnc-xml-snapshot.hpp: Binary snapshot cache of an XML data file. *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+#ifndef __GNC_XML_SNAPSHOT_HPP__
+#define __GNC_XML_SNAPSHOT_HPP__
+
+extern "C"
+{
+#include <glib.h>
+#include "gnc-engine.h"
+#include "gnc-pricedb.h"
+}
+
+#include <functional>
+#include <string>
+
+#define GNC_XML_SNAPSHOT_EXT ".snapshot"
+
+struct GncSnapshotHeader;
+
+/** The file <datafile>.snapshot, a copy of the book last written to the
+ * data file from which it loads without parsing the bulk of it.
+ *
+ * Prices, transactions and splits, which make up most of a book, are kept in
+ * fixed-width records that refer to a string table and to a table of
+ * binary-encoded slots; the rest of the book is kept as two small XML
+ * documents read by the usual parsers, one with the commodities and
+ * accounts the records refer to and one with the objects that refer to the
+ * transactions.  The snapshot is mapped into memory and only used if the
+ * size, modification time and tail of the data file are those it was
+ * written for and its checksum is right.
+ */
+class GncXmlSnapshot
+{
+public:
+    GncXmlSnapshot() = default;
+    GncXmlSnapshot(const GncXmlSnapshot&) = delete;
+    GncXmlSnapshot& operator=(const GncXmlSnapshot&) = delete;
+    ~GncXmlSnapshot();
+
+    /** Map the snapshot of datafile.  Returns false if there is none or it
+     * doesn't belong to the data file as it is now. */
+    bool open(const std::string& datafile);
+    /** The XML document with the part of the book before the transactions
+     * (after_transactions false) or after them. */
+    const char* xml(bool after_transactions, size_t* size) const;
+    /** Create the prices into a new list in the order they were written;
+     * the list holds a reference to each. */
+    bool load_prices(QofBook* book, PriceList** prices) const;
+    /** Create the transactions and hand each to add once committed. */
+    bool load_transactions(QofBook* book,
+                           const std::function<void(Transaction*)>& add) const;
+
+    /** Write the snapshot of book next to datafile, just written from it. */
+    static bool write(QofBook* book, const std::string& datafile);
+    static bool remove(const std::string& datafile);
+
+private:
+    void close();
+    const char* section(int id, size_t* size) const;
+
+    GMappedFile* m_file = nullptr;
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    const GncSnapshotHeader* m_header = nullptr;
+};
+
+#endif /* __GNC_XML_SNAPSHOT_HPP__ */
@@ -0,0 +1,227 @@
+/********************************************************************
+ * gnc-xml-writer.cpp: Stream XML elements into a memory buffer.    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+extern "C"
+{
+#include <config.h>
+#include <glib.h>
+#include <stdio.h>
+}
+
+#include "gnc-xml-writer.hpp"
+
+/* libxml2 indents by two spaces per level, but never by more than
+ * MAX_INDENT (60) characters. */
+static const int indent_size = 2;
+static const int max_indent_level = 30;
+
+void
+GncXmlWriter::clear() noexcept
+{
+    m_buf.clear();
+    m_level = 0;
+    m_start_open = false;
+}
+
+void
+GncXmlWriter::indent()
+{
+    auto level = m_level > max_indent_level ? max_indent_level : m_level;
+    m_buf.append(level * indent_size, ' ');
+}
+
+/* A child of the current element is about to be written: close the
+ * parent's start tag and indent the child's. */
+void
+GncXmlWriter::begin_child()
+{
+    if (m_start_open)
+    {
+        m_buf += ">\n";
+        m_start_open = false;
+    }
+    indent();
+}
+
+void
+GncXmlWriter::end_child()
+{
+    if (m_level > 0)
+        m_buf += '\n';
+}
+
+void
+GncXmlWriter::open_tag(const char* tag, const char* attr, const char* value)
+{
+    m_buf += '<';
+    m_buf += tag;
+    if (attr)
+    {
+        m_buf += ' ';
+        m_buf += attr;
+        m_buf += "=\"";
+        append_escaped_attr(value ? value : "");
+        m_buf += '"';
+    }
+}
+
+void
+GncXmlWriter::start_element(const char* tag, const char* attr,
+                            const char* value)
+{
+    begin_child();
+    open_tag(tag, attr, value);
+    m_start_open = true;
+    m_level++;
+}
+
+void
+GncXmlWriter::end_element(const char* tag)
+{
+    m_level--;
+    if (m_start_open)
+    {
+        m_buf += "/>";
+        m_start_open = false;
+    }
+    else
+    {
+        indent();
+        m_buf += "</";
+        m_buf += tag;
+        m_buf += '>';
+    }
+    end_child();
+}
+
+void
+GncXmlWriter::text_element(const char* tag, const char* text,
+                           const char* attr, const char* value)
+{
+    begin_child();
+    open_tag(tag, attr, value);
+    if (!text)
+    {
+        m_buf += "/>";
+    }
+    else
+    {
+        m_buf += '>';
+        append_escaped_text(text);
+        m_buf += "</";
+        m_buf += tag;
+        m_buf += '>';
+    }
+    end_child();
+}
+
+void
+GncXmlWriter::checked_text_element(const char* tag, const char* text,
+                                   const char* attr, const char* value)
+{
+    if (!text)
+    {
+        text_element(tag, text, attr, value);
+        return;
+    }
+    m_checked.assign(text);
+    auto val = &m_checked[0];
+    gchar* end;
+    while (!g_utf8_validate(val, -1, const_cast<const gchar**>(&end)))
+        *end = '?';
+    for (end = val; *end; ++end)
+        if (*end > 0 && *end < 0x20 && *end != 0x09 &&
+            *end != 0x0a && *end != 0x0d)
+            *end = '?';
+    text_element(tag, val, attr, value);
+}
+
+/* Same as libxml2's xmlEscapeContent(). */
+void
+GncXmlWriter::append_escaped_text(const char* text)
+{
+    auto start = text;
+    for (auto p = text; *p; ++p)
+    {
+        const char* entity;
+        switch (*p)
+        {
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '&': entity = "&amp;"; break;
+        case '\r': entity = "&#13;"; break;
+        default: continue;
+        }
+        m_buf.append(start, p - start);
+        m_buf += entity;
+        start = p + 1;
+    }
+    m_buf += start;
+}
+
+/* Same as libxml2's xmlBufAttrSerializeTxtContent() for a node without a
+ * document: besides the markup characters, whitespace other than spaces
+ * and anything outside ASCII become character references. */
+void
+GncXmlWriter::append_escaped_attr(const char* text)
+{
+    auto p = reinterpret_cast<const unsigned char*>(text);
+    while (*p)
+    {
+        const char* entity = nullptr;
+        switch (*p)
+        {
+        case '\n': entity = "&#10;"; break;
+        case '\r': entity = "&#13;"; break;
+        case '\t': entity = "&#9;"; break;
+        case '"': entity = "&quot;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '&': entity = "&amp;"; break;
+        default: break;
+        }
+        if (entity)
+        {
+            m_buf += entity;
+            ++p;
+        }
+        else if (*p >= 0x80 && p[1])
+        {
+            char ref[16];
+            auto ch = g_utf8_get_char_validated(reinterpret_cast<const gchar*>(p), -1);
+            if (ch == static_cast<gunichar>(-1) || ch == static_cast<gunichar>(-2))
+            {
+                snprintf(ref, sizeof(ref), "&#x%X;", *p);
+                ++p;
+            }
+            else
+            {
+                snprintf(ref, sizeof(ref), "&#x%X;", ch);
+                p = reinterpret_cast<const unsigned char*>(
+                    g_utf8_next_char(reinterpret_cast<const gchar*>(p)));
+            }
+            m_buf += ref;
+        }
+        else
+        {
+            m_buf += static_cast<char>(*p++);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+/********************************************************************
+ * gnc-xml-writer.hpp: Stream XML elements into a memory buffer.    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+#ifndef __GNC_XML_WRITER_HPP__
+#define __GNC_XML_WRITER_HPP__
+
+#include <string>
+
+/** Writes XML elements straight into a byte buffer, without building a
+ * libxml2 tree first.
+ *
+ * The output is byte for byte what xmlElemDump() produces for the tree the
+ * sixtp-dom-generators functions would have built: children of an element
+ * holding only elements are indented by two spaces per level and end with
+ * a newline, an element without children is written as <tag/>, and text is
+ * escaped the way libxml2 escapes it.  Like xmlElemDump() there is no
+ * newline after the outermost element.
+ *
+ * The buffer keeps its capacity across clear(), so one writer can be
+ * reused for many objects.  A writer isn't shared between threads, but
+ * several threads can each fill their own.
+ */
+class GncXmlWriter
+{
+public:
+    GncXmlWriter() = default;
+    GncXmlWriter(const GncXmlWriter&) = delete;
+    GncXmlWriter& operator=(const GncXmlWriter&) = delete;
+
+    void clear() noexcept;
+    const std::string& str() const noexcept { return m_buf; }
+    /** Append raw bytes, used to separate the outermost elements. */
+    void append(const char* text) { m_buf += text; }
+
+    /** Open an element whose content will be other elements. */
+    void start_element(const char* tag, const char* attr = nullptr,
+                       const char* value = nullptr);
+    void end_element(const char* tag);
+    /** Write an element holding only text.  A null text gives <tag/>, an
+     * empty one <tag></tag>. */
+    void text_element(const char* tag, const char* text,
+                      const char* attr = nullptr, const char* value = nullptr);
+    /** Like text_element(), but first replaces invalid UTF-8 and control
+     * characters with '?' the way checked_char_cast() does. */
+    void checked_text_element(const char* tag, const char* text,
+                              const char* attr = nullptr,
+                              const char* value = nullptr);
+
+private:
+    void begin_child();
+    void end_child();
+    void indent();
+    void open_tag(const char* tag, const char* attr, const char* value);
+    void append_escaped_text(const char* text);
+    void append_escaped_attr(const char* text);
+
+    std::string m_buf;
+    std::string m_checked;
+    int m_level = 0;
+    bool m_start_open = false;
+};
+
+#endif /* __GNC_XML_WRITER_HPP__ */
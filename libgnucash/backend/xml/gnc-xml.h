@@ -33,7 +33,10 @@ extern "C"
 #include "gnc-budget.h"
 }
 
+#include <unordered_map>
+
 #include "gnc-xml-helper.h"
+#include "gnc-xml-writer.hpp"
 #include "sixtp.h"
 
 xmlNodePtr gnc_account_dom_tree_create (Account* act, gboolean exporting,
@@ -63,6 +66,13 @@ xmlNodePtr gnc_budget_dom_tree_create (GncBudget* bgt);
 sixtp* gnc_budget_sixtp_parser_create (void);
 
 xmlNodePtr gnc_transaction_dom_tree_create (Transaction* txn);
+/* The GUIDs of the lots of the splits that are in one. */
+using GncSplitLots = std::unordered_map<const Split*, GncGUID>;
+/* Write the transaction the way xmlElemDump() would print the tree from
+ * gnc_transaction_dom_tree_create(), without building it.  With lots, the
+ * splits' lots are taken from it instead of from the splits. */
+void gnc_transaction_xml_write (GncXmlWriter& writer, Transaction* txn,
+                                const GncSplitLots* lots = nullptr);
 sixtp* gnc_transaction_sixtp_parser_create (void);
 
 sixtp* gnc_template_transaction_sixtp_parser_create (void);
@@ -59,3 +59,19 @@ gnc_xml_parse_fd (sixtp* top_parser, FILE* fd,
     return sixtp_parse_fd (top_parser, fd,
                            NULL, &gpdata, &parse_result);
 }
+
+gboolean
+gnc_xml_parse_fd_pipelined (sixtp* top_parser, FILE* fd,
+                            gxpf_callback callback, gpointer parsedata,
+                            gpointer bookdata, sixtp_parse_timing* timing)
+{
+    gpointer parse_result = NULL;
+    gxpf_data gpdata;
+
+    gpdata.cb = callback;
+    gpdata.parsedata = parsedata;
+    gpdata.bookdata = bookdata;
+
+    return sixtp_parse_fd_pipelined (top_parser, fd, NULL, &gpdata,
+                                     &parse_result, timing);
+}
@@ -53,4 +53,9 @@ gnc_xml_parse_fd (sixtp* top_parser, FILE* fd,
                   gxpf_callback callback, gpointer parsedata,
                   gpointer bookdata);
 
+gboolean
+gnc_xml_parse_fd_pipelined (sixtp* top_parser, FILE* fd,
+                            gxpf_callback callback, gpointer parsedata,
+                            gpointer bookdata, sixtp_parse_timing* timing);
+
 #endif /* IO_GNCXML_GEN_H */
@@ -54,6 +54,8 @@ extern "C"
 #include "Transaction.h"
 #include "TransactionP.h"
 #include "TransLog.h"
+#include "gncInvoiceP.h"
+#include "gnc-prefs.h"
 #if PLATFORM(WINDOWS)
 #ifdef __STRICT_ANSI_UNSET__
 #undef __STRICT_ANSI_UNSET__
@@ -67,6 +69,7 @@ extern "C"
 }
 
 #include "gnc-xml-backend.hpp"
+#include "gnc-xml-snapshot.hpp"
 #include "sixtp-parsers.h"
 #include "sixtp-utils.h"
 #include "gnc-xml.h"
@@ -74,6 +77,12 @@ extern "C"
 #include "sixtp-dom-parsers.h"
 #include "io-gncxml-v2.h"
 #include "io-gncxml-gen.h"
+#include "io-gzip.h"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <vector>
 
 /* Do not treat -Wstrict-aliasing warnings as errors because of problems of the
  * G_LOCK* macros as declared by glib.  See
@@ -95,6 +104,10 @@ typedef struct
     gchar* filename;
     gchar* perms;
     gboolean compress;
+    gint threads;
+    /* Set by the thread. */
+    gint success;
+    gint64 inflate_usec;
 } gz_thread_params_t;
 
 /* Callback structure */
@@ -127,7 +140,7 @@ static FILE* try_gz_open (const char* filename, const char* perms,
                           gboolean use_gzip,
                           gboolean compress);
 static gboolean is_gzipped_file (const gchar* name);
-static gboolean wait_for_gzip (FILE* file);
+static gboolean wait_for_gzip (FILE* file, gint64* inflate_usec = NULL);
 
 static void
 clear_up_account_commodity (
@@ -491,6 +504,17 @@ debug_print_counter_data (load_counter* data)
            data->budgets_total, data->budgets_loaded);
 }
 
+/* Log how long each stage of a load took once it is done. */
+static void
+log_load_timing (const sixtp_parse_timing* timing)
+{
+    PINFO ("Loaded in %.2f s: inflating %.2f s, parsing %.2f s "
+           "(%.2f s waiting), building %.2f s (%.2f s waiting)",
+           timing->total / 1e6, timing->inflate / 1e6,
+           timing->parse / 1e6, timing->parse_wait / 1e6,
+           timing->build / 1e6, timing->build_wait / 1e6);
+}
+
 static void
 file_rw_feedback (sixtp_gdv2* gd, const char* type)
 {
@@ -691,11 +715,61 @@ gnc_sixtp_gdv2_new (
     return gd;
 }
 
+/* Parse one of the snapshot's XML documents. */
+static gboolean
+parse_snapshot_xml (GncXmlSnapshot* snapshot, bool after_transactions,
+                    sixtp* top_parser, sixtp_gdv2* gd, QofBook* book)
+{
+    gpointer parse_result = NULL;
+    gxpf_data gpdata;
+    size_t size;
+    auto xml = snapshot->xml (after_transactions, &size);
+
+    if (size > G_MAXINT)
+        return FALSE;
+    gpdata.cb = generic_callback;
+    gpdata.parsedata = gd;
+    gpdata.bookdata = book;
+    return sixtp_parse_buffer (top_parser, const_cast<char*> (xml), size,
+                               NULL, &gpdata, &parse_result);
+}
+
+/* Load the book from its snapshot in the order it is written to the data
+ * file: the prices and transactions are built straight from the records,
+ * between the XML documents with the accounts they refer to and the
+ * business objects that refer to them. */
+static gboolean
+load_snapshot (GncXmlSnapshot* snapshot, sixtp* top_parser, sixtp_gdv2* gd,
+               QofBook* book)
+{
+    PriceList* prices;
+
+    if (!parse_snapshot_xml (snapshot, false, top_parser, gd, book))
+        return FALSE;
+
+    if (!snapshot->load_prices (book, &prices))
+        return FALSE;
+    auto db = gnc_pricedb_get_db (book);
+    gnc_pricedb_set_bulk_update (db, TRUE);
+    gnc_pricedb_add_prices (db, prices);
+    gnc_pricedb_set_bulk_update (db, FALSE);
+    gd->counter.prices_loaded += g_list_length (prices);
+    g_list_free_full (prices, (GDestroyNotify) gnc_price_unref);
+
+    if (!snapshot->load_transactions (book, [gd] (Transaction* trn)
+    {
+        add_transaction_local (gd, trn);
+    }))
+        return FALSE;
+
+    return parse_snapshot_xml (snapshot, true, top_parser, gd, book);
+}
+
 static gboolean
 qof_session_load_from_xml_file_v2_full (
     GncXmlBackend* xml_be, QofBook* book,
     sixtp_push_handler push_handler, gpointer push_user_data,
-    QofBookFileType type)
+    GncXmlSnapshot* snapshot, QofBookFileType type)
 {
     Account* root;
     sixtp_gdv2* gd;
@@ -786,6 +860,14 @@ qof_session_load_from_xml_file_v2_full (
         retval = sixtp_parse_push (top_parser, push_handler, push_user_data,
                                    NULL, &gpdata, &parse_result);
     }
+    else if (snapshot)
+    {
+        gint64 start = g_get_monotonic_time ();
+
+        retval = load_snapshot (snapshot, top_parser, gd, book);
+        gd->timing.total = g_get_monotonic_time () - start;
+        log_load_timing (&gd->timing);
+    }
     else
     {
         /* Even though libxml2 knows how to decompress zipped files, we
@@ -797,6 +879,7 @@ qof_session_load_from_xml_file_v2_full (
          const char* filename = xml_be->get_filename();
         FILE* file;
         gboolean is_compressed = is_gzipped_file (filename);
+        gint64 start = g_get_monotonic_time ();
         file = try_gz_open (filename, "r", is_compressed, FALSE);
         if (file == NULL)
         {
@@ -805,11 +888,16 @@ qof_session_load_from_xml_file_v2_full (
         }
         else
         {
-            retval = gnc_xml_parse_fd (top_parser, file,
-                                       generic_callback, gd, book);
+            /* Inflating, parsing and building the objects each get a
+             * thread. */
+            retval = gnc_xml_parse_fd_pipelined (top_parser, file,
+                                                 generic_callback, gd, book,
+                                                 &gd->timing);
             fclose (file);
             if (is_compressed)
-                wait_for_gzip (file);
+                wait_for_gzip (file, &gd->timing.inflate);
+            gd->timing.total = g_get_monotonic_time () - start;
+            log_load_timing (&gd->timing);
         }
     }
 
@@ -871,7 +959,161 @@ gboolean
 qof_session_load_from_xml_file_v2 (GncXmlBackend* xml_be, QofBook* book,
                                    QofBookFileType type)
 {
-    return qof_session_load_from_xml_file_v2_full (xml_be, book, NULL, NULL, type);
+    return qof_session_load_from_xml_file_v2_full (xml_be, book, NULL, NULL,
+                                                   NULL, type);
+}
+
+GncSnapshotLoad
+qof_session_load_from_xml_snapshot_v2 (GncXmlBackend* xml_be, QofBook* book)
+{
+    GncXmlSnapshot snapshot;
+
+    /* A snapshot that doesn't belong to the data file is ignored. */
+    if (!gnc_prefs_get_file_save_snapshot () ||
+        !snapshot.open (xml_be->get_filename ()))
+        return GNC_SNAPSHOT_NONE;
+
+    PINFO ("Loading %s from its snapshot", xml_be->get_filename ());
+    if (!qof_session_load_from_xml_file_v2_full (xml_be, book, NULL, NULL,
+                                                 &snapshot, GNC_BOOK_XML2_FILE))
+        return GNC_SNAPSHOT_FAILED;
+    return GNC_SNAPSHOT_LOADED;
+}
+
+/***********************************************************************/
+/* The change journal kept by GncXmlBackend between full saves.  Each record
+ * is a <gnc-journal> document listing the transactions one save changed:
+ * a journal:remove with the GUID of each, followed by the transaction as it
+ * is now unless it was deleted. */
+
+#define JOURNAL_TAG "gnc-journal"
+static const char* JOURNAL_REMOVE_TAG = "journal:remove";
+
+static gboolean
+journal_remove_end_handler (gpointer data_for_children,
+                            GSList* data_from_children, GSList* sibling_data,
+                            gpointer parent_data, gpointer global_data,
+                            gpointer* result, const gchar* tag)
+{
+    xmlNodePtr tree = (xmlNodePtr)data_for_children;
+    gxpf_data* gdata = (gxpf_data*)global_data;
+    GncGUID* guid;
+
+    if (parent_data) return TRUE;
+    if (!tag) return TRUE;
+
+    g_return_val_if_fail (tree, FALSE);
+
+    guid = dom_tree_to_guid (tree);
+    xmlFreeNode (tree);
+    if (!guid)
+        return FALSE;
+
+    auto ok = gdata->cb (tag, gdata->parsedata, guid);
+    guid_free (guid);
+    return ok;
+}
+
+static gboolean
+journal_callback (const char* tag, gpointer globaldata, gpointer data)
+{
+    sixtp_gdv2* gd = (sixtp_gdv2*)globaldata;
+
+    if (g_strcmp0 (tag, JOURNAL_REMOVE_TAG) == 0)
+    {
+        Transaction* trans = xaccTransLookup ((GncGUID*)data, gd->book);
+        if (trans)
+        {
+            /* The saved copy replaces the transaction even if it's read-only,
+             * as posted and voided ones are, which xaccTransDestroy would
+             * leave in place.  The invoice gets the copy back below. */
+            GncInvoice* invoice = gncInvoiceGetInvoiceFromTxn (trans);
+            if (gncInvoiceGetPostedTxn (invoice) == trans)
+                gncInvoiceReplacePostedTxn (invoice, NULL);
+
+            xaccTransBeginEdit (trans);
+            qof_instance_set_destroying (trans, TRUE);
+            xaccTransCommitEdit (trans);
+            if (xaccTransLookup ((GncGUID*)data, gd->book))
+            {
+                PWARN ("Unable to remove a transaction replaced by the journal");
+                return FALSE;
+            }
+        }
+    }
+    else if (g_strcmp0 (tag, TRANSACTION_TAG) == 0)
+    {
+        Transaction* trans = (Transaction*)data;
+        add_transaction_local (gd, trans);
+
+        GncInvoice* invoice = gncInvoiceGetInvoiceFromTxn (trans);
+        if (invoice && gncInvoiceGetPostedAcc (invoice) &&
+            !gncInvoiceGetPostedTxn (invoice))
+            gncInvoiceReplacePostedTxn (invoice, trans);
+    }
+    else
+    {
+        PWARN ("unexpected tag %s", tag);
+    }
+    return TRUE;
+}
+
+gboolean
+qof_session_replay_xml_journal_v2 (QofBook* book,
+                                   const std::vector<std::string>& records)
+{
+    sixtp_gdv2* gd;
+    sixtp* top_parser;
+    sixtp* journal_parser;
+    gxpf_data gpdata;
+    gboolean retval = TRUE;
+
+    gd = gnc_sixtp_gdv2_new (book, FALSE, NULL, NULL);
+
+    top_parser = sixtp_new ();
+    journal_parser = sixtp_new ();
+
+    if (!sixtp_add_some_sub_parsers (
+            top_parser, TRUE,
+            JOURNAL_TAG, journal_parser,
+            NULL, NULL)
+        || !sixtp_add_some_sub_parsers (
+            journal_parser, TRUE,
+            JOURNAL_REMOVE_TAG, sixtp_dom_parser_new (journal_remove_end_handler,
+                                                      NULL, NULL),
+            TRANSACTION_TAG, gnc_transaction_sixtp_parser_create (),
+            NULL, NULL))
+    {
+        g_free (gd);
+        return FALSE;
+    }
+
+    gpdata.cb = journal_callback;
+    gpdata.parsedata = gd;
+    gpdata.bookdata = book;
+
+    /* The records are replayed as they were saved: no log, no scrubbing
+     * beyond what loading a transaction does. */
+    xaccLogDisable ();
+    xaccDisableDataScrubbing ();
+    for (auto& record : records)
+    {
+        gpointer parse_result = NULL;
+
+        if (!sixtp_parse_buffer (top_parser, const_cast<char*> (record.data ()),
+                                 record.size (), NULL, &gpdata, &parse_result))
+        {
+            PWARN ("Unable to replay a journal record");
+            retval = FALSE;
+            break;
+        }
+    }
+    xaccEnableDataScrubbing ();
+    xaccLogEnable ();
+
+    sixtp_destroy (top_parser);
+    g_free (gd);
+    return retval;
 }
 
 /***********************************************************************/
@@ -958,6 +1200,8 @@ static gboolean write_template_transaction_data (FILE* out, QofBook* book,
                                                  sixtp_gdv2* gd);
 static gboolean write_schedXactions (FILE* out, QofBook* book, sixtp_gdv2* gd);
 static void write_budget (QofInstance* ent, gpointer data);
+static gboolean write_book_rest (FILE* out, QofBook* book, sixtp_gdv2* gd,
+                                 struct file_backend* be_data);
 
 static void
 write_counts(const GncXmlDataType_t& data, struct file_backend* be_data)
@@ -979,17 +1223,36 @@ write_data(const GncXmlDataType_t& data, struct file_backend* be_data)
         (data.write)(be_data->out, be_data->book);
 }
 
+/* The parts of the book write_book() writes: all of it for a data file, or
+ * one of the two XML documents of a snapshot, which keeps the prices and the
+ * transactions in records of its own between them, or the data file up to
+ * the transactions and from them on, for a save that writes the transactions
+ * in the background. */
+typedef enum
+{
+    BOOK_PART_ALL,
+    BOOK_PART_BEFORE_TRANSACTIONS,
+    BOOK_PART_AFTER_TRANSACTIONS,
+    BOOK_PART_HEAD,
+    BOOK_PART_TAIL,
+} book_part;
+
 static gboolean
-write_book (FILE* out, QofBook* book, sixtp_gdv2* gd)
+write_book (FILE* out, QofBook* book, sixtp_gdv2* gd,
+            book_part part = BOOK_PART_ALL)
 {
     struct file_backend be_data;
 
     be_data.out = out;
     be_data.book = book;
     be_data.gd = gd;
+    if (part == BOOK_PART_TAIL)
+        return write_book_rest (out, book, gd, &be_data);
     if (fprintf (out, "<%s version=\"%s\">\n", BOOK_TAG,
                  gnc_v2_book_version_string) < 0)
         return FALSE;
+    if (part == BOOK_PART_AFTER_TRANSACTIONS)
+        return write_book_rest (out, book, gd, &be_data);
     if (!write_book_parts (out, book))
         return FALSE;
 
@@ -1017,21 +1280,38 @@ write_book (FILE* out, QofBook* book, sixtp_gdv2* gd)
 
     if (ferror (out)
         || !write_commodities (out, book, gd)
-        || !write_pricedb (out, book, gd)
-        || !write_accounts (out, book, gd)
-        || !write_transactions (out, book, gd)
-        || !write_template_transaction_data (out, book, gd)
-        || !write_schedXactions (out, book, gd))
+        || (part != BOOK_PART_BEFORE_TRANSACTIONS &&
+            !write_pricedb (out, book, gd))
+        || !write_accounts (out, book, gd))
+        return FALSE;
+
+    if (part == BOOK_PART_BEFORE_TRANSACTIONS)
+        return fprintf (out, "</%s>\n", BOOK_TAG) >= 0;
+    if (part == BOOK_PART_HEAD)
+        return TRUE;
+
+    if (!write_transactions (out, book, gd))
+        return FALSE;
+
+    return write_book_rest (out, book, gd, &be_data);
+}
 
+/* Everything after the transactions, some of which refers to them. */
+static gboolean
+write_book_rest (FILE* out, QofBook* book, sixtp_gdv2* gd,
+                 struct file_backend* be_data)
+{
+    if (!write_template_transaction_data (out, book, gd)
+        || !write_schedXactions (out, book, gd))
         return FALSE;
 
     qof_collection_foreach (qof_book_get_collection (book, GNC_ID_BUDGET),
-                            write_budget, &be_data);
+                            write_budget, be_data);
     if (ferror (out))
         return FALSE;
 
     for (auto data : backend_registry)
-        write_data(data, &be_data);
+        write_data(data, be_data);
     if (ferror(out))
         return FALSE;
 
@@ -1149,53 +1429,165 @@ write_pricedb (FILE* out, QofBook* book, sixtp_gdv2* gd)
     return TRUE;
 }
 
+/* Transactions are serialized by several threads at once.  Each worker
+ * fills its own GncXmlWriter with a contiguous run of transactions; the
+ * buffers are then written out in book order and reused for the next
+ * round, so the whole book never has to be held in memory. */
+#define TRANSACTIONS_PER_WORKER 1024
+
+struct trn_write_job
+{
+    Transaction* const* trans;
+    size_t count;
+    gboolean ok;
+    GncXmlWriter writer;
+};
+
+static gpointer
+write_transaction_job (gpointer data)
+{
+    auto job = static_cast<trn_write_job*> (data);
+
+    job->writer.clear ();
+    job->ok = TRUE;
+    try
+    {
+        for (size_t i = 0; i < job->count; i++)
+        {
+            gnc_transaction_xml_write (job->writer, job->trans[i]);
+            job->writer.append ("\n");
+        }
+    }
+    catch (std::exception& err)
+    {
+        PERR ("Failed to write a transaction: %s", err.what ());
+        job->ok = FALSE;
+    }
+    return NULL;
+}
+
 static int
-xml_add_trn_data (Transaction* t, gpointer data)
+collect_transaction (Transaction* t, gpointer data)
 {
-    struct file_backend* be_data = static_cast<decltype (be_data)> (data);
-    xmlNodePtr node;
+    auto trans = static_cast<std::vector<Transaction*>*> (data);
+    trans->push_back (t);
+    return 0;
+}
+
+static gboolean
+write_transaction_list (FILE* out, const std::vector<Transaction*>& trans,
+                        sixtp_gdv2* gd)
+{
+    std::vector<trn_write_job> jobs (std::max (1u, g_get_num_processors ()));
+    std::vector<GThread*> threads;
+    size_t next = 0;
 
-    node = gnc_transaction_dom_tree_create (t);
+    while (next < trans.size ())
+    {
+        size_t used = 0;
 
-    xmlElemDump (be_data->out, NULL, node);
-    xmlFreeNode (node);
+        for (; used < jobs.size () && next < trans.size (); used++)
+        {
+            jobs[used].trans = trans.data () + next;
+            jobs[used].count = std::min (trans.size () - next,
+                                         (size_t) TRANSACTIONS_PER_WORKER);
+            next += jobs[used].count;
+        }
 
-    if (ferror (be_data->out) || fprintf (be_data->out, "\n") < 0)
-        return -1;
+        /* The first run is done on this thread while the others work. */
+        threads.clear ();
+        for (size_t i = 1; i < used; i++)
+            threads.push_back (g_thread_new ("xml_writer", write_transaction_job,
+                                             &jobs[i]));
+        write_transaction_job (&jobs[0]);
+        for (auto thread : threads)
+            g_thread_join (thread);
 
-    be_data->gd->counter.transactions_loaded++;
-    sixtp_run_callback (be_data->gd, "transaction");
-    return 0;
+        for (size_t i = 0; i < used; i++)
+        {
+            auto& buf = jobs[i].writer.str ();
+            if (!jobs[i].ok
+                || fwrite (buf.data (), 1, buf.size (), out) != buf.size ()
+                || ferror (out))
+                return FALSE;
+            for (size_t j = 0; j < jobs[i].count; j++)
+            {
+                gd->counter.transactions_loaded++;
+                sixtp_run_callback (gd, "transaction");
+            }
+        }
+    }
+    return TRUE;
 }
 
 static gboolean
 write_transactions (FILE* out, QofBook* book, sixtp_gdv2* gd)
 {
-    struct file_backend be_data;
+    std::vector<Transaction*> trans;
 
-    be_data.out = out;
-    be_data.gd = gd;
-    return 0 ==
-           xaccAccountTreeForEachTransaction (gnc_book_get_root_account (book),
-                                              xml_add_trn_data,
-                                              (gpointer) &be_data);
+    xaccAccountTreeForEachTransaction (gnc_book_get_root_account (book),
+                                       collect_transaction, &trans);
+    return write_transaction_list (out, trans, gd);
+}
+
+gboolean
+gnc_xml_journal_record_v2 (QofBook* book, const std::vector<GncGUID>& guids,
+                           std::string& record)
+{
+    GncXmlWriter writer;
+    Account* template_root = gnc_book_get_template_root (book);
+
+    writer.append ("<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n"
+                   "<" JOURNAL_TAG ">\n");
+    try
+    {
+        for (auto& guid : guids)
+        {
+            gchar guidstr[GUID_ENCODING_LENGTH + 1];
+            Transaction* trans = xaccTransLookup (&guid, book);
+
+            guid_to_string_buff (&guid, guidstr);
+            writer.text_element (JOURNAL_REMOVE_TAG, guidstr, "type", "guid");
+            writer.append ("\n");
+            if (!trans || qof_instance_get_destroying (trans))
+                continue;
+
+            /* Template transactions are written with their scheduled
+             * transactions, which the journal doesn't hold. */
+            for (GList* node = xaccTransGetSplitList (trans); node;
+                 node = node->next)
+            {
+                Account* acct = xaccSplitGetAccount ((Split*)node->data);
+                if (acct && gnc_account_get_root (acct) == template_root)
+                    return FALSE;
+            }
+            gnc_transaction_xml_write (writer, trans);
+            writer.append ("\n");
+        }
+    }
+    catch (std::exception& err)
+    {
+        PERR ("Failed to write a journal record: %s", err.what ());
+        return FALSE;
+    }
+    writer.append ("</" JOURNAL_TAG ">\n");
+    record = writer.str ();
+    return TRUE;
 }
 
 static gboolean
 write_template_transaction_data (FILE* out, QofBook* book, sixtp_gdv2* gd)
 {
     Account* ra;
-    struct file_backend be_data;
-
-    be_data.out = out;
-    be_data.gd = gd;
+    std::vector<Transaction*> trans;
 
     ra = gnc_book_get_template_root (book);
     if (gnc_account_n_descendants (ra) > 0)
     {
+        xaccAccountTreeForEachTransaction (ra, collect_transaction, &trans);
         if (fprintf (out, "<%s>\n", TEMPLATE_TRANSACTION_TAG) < 0
             || !write_account_tree (out, ra, gd)
-            || xaccAccountTreeForEachTransaction (ra, xml_add_trn_data, (gpointer)&be_data)
+            || !write_transaction_list (out, trans, gd)
             || fprintf (out, "</%s>\n", TEMPLATE_TRANSACTION_TAG) < 0)
 
             return FALSE;
@@ -1304,22 +1696,21 @@ write_v2_header (FILE* out)
     return TRUE;
 }
 
-gboolean
-gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* out)
+static gboolean
+write_book_to_filehandle (QofBook* book, FILE* out, book_part part,
+                          QofBePercentageFunc gui_display_fn)
 {
-    QofBackend* qof_be;
     sixtp_gdv2* gd;
     gboolean success = TRUE;
 
     if (!out) return FALSE;
 
-    if (!write_v2_header (out)
-        || !write_counts (out, "book", 1, NULL))
+    if (part != BOOK_PART_TAIL
+        && (!write_v2_header (out)
+            || !write_counts (out, "book", 1, NULL)))
         return FALSE;
 
-    qof_be = qof_book_get_backend (book);
-    gd = gnc_sixtp_gdv2_new (book, FALSE, file_rw_feedback,
-                             qof_be->get_percentage());
+    gd = gnc_sixtp_gdv2_new (book, FALSE, file_rw_feedback, gui_display_fn);
     gd->counter.commodities_total =
         gnc_commodity_table_get_size (gnc_commodity_table_get_table (book));
     gd->counter.accounts_total = 1 +
@@ -1332,14 +1723,46 @@ gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* out)
     gd->counter.prices_total = gnc_pricedb_get_num_prices (gnc_pricedb_get_db (
                                                                book));
 
-    if (!write_book (out, book, gd)
-        || fprintf (out, "</" GNC_V2_STRING ">\n\n") < 0)
+    if (!write_book (out, book, gd, part)
+        || (part != BOOK_PART_HEAD
+            && fprintf (out, "</" GNC_V2_STRING ">\n\n") < 0))
         success = FALSE;
 
     g_free (gd);
     return success;
 }
 
+gboolean
+gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* out)
+{
+    QofBackend* qof_be = qof_book_get_backend (book);
+
+    return write_book_to_filehandle (book, out, BOOK_PART_ALL,
+                                     qof_be->get_percentage());
+}
+
+gboolean
+gnc_book_write_snapshot_xml_v2 (QofBook* book, FILE* out,
+                                gboolean after_transactions)
+{
+    return write_book_to_filehandle (book, out,
+                                     after_transactions ?
+                                     BOOK_PART_AFTER_TRANSACTIONS :
+                                     BOOK_PART_BEFORE_TRANSACTIONS, NULL);
+}
+
+gboolean
+gnc_book_write_xml_head_v2 (QofBook* book, FILE* out)
+{
+    return write_book_to_filehandle (book, out, BOOK_PART_HEAD, NULL);
+}
+
+gboolean
+gnc_book_write_xml_tail_v2 (QofBook* book, FILE* out)
+{
+    return write_book_to_filehandle (book, out, BOOK_PART_TAIL, NULL);
+}
+
 /*
  * This function is called by the "export" code.
  */
@@ -1382,7 +1805,8 @@ gnc_book_write_accounts_to_xml_filehandle_v2 (QofBackend* qof_be, QofBook* book,
 #define BUFLEN 4096
 
 /* Compress or decompress function that is to be run in a separate thread.
- * Returns 1 on success or 0 otherwise, stuffed into a pointer type. */
+ * Returns params with success set to 1 on success or 0 otherwise and, when
+ * decompressing, the time spent in gzread(); wait_for_gzip() frees it. */
 static gpointer
 gz_thread_func (gz_thread_params_t* params)
 {
@@ -1392,6 +1816,31 @@ gz_thread_func (gz_thread_params_t* params)
     gzFile file;
     gint success = 1;
 
+    if (params->compress && params->threads != 1)
+    {
+        FILE* out = g_fopen (params->filename, "wb");
+
+        if (out == NULL)
+        {
+            g_warning ("Could not open the compressed file '%s'. The error is '%s' (errno %d)",
+                       params->filename,
+                       g_strerror (errno) ? g_strerror (errno) : "", errno);
+            success = 0;
+            goto cleanup_gz_thread_func;
+        }
+        if (!gnc_gzip_fd_to_file (params->fd, out, params->threads,
+                                  Z_DEFAULT_COMPRESSION))
+            success = 0;
+        if (fclose (out) != 0)
+        {
+            g_warning ("Could not close the compressed file '%s'. The error is '%s' (errno %d)",
+                       params->filename,
+                       g_strerror (errno) ? g_strerror (errno) : "", errno);
+            success = 0;
+        }
+        goto cleanup_gz_thread_func;
+    }
+
 #ifdef G_OS_WIN32
     {
         gchar* conv_name = g_win32_locale_filename_from_utf8 (params->filename);
@@ -1457,7 +1906,10 @@ gz_thread_func (gz_thread_params_t* params)
     {
         while (success)
         {
+            gint64 start = g_get_monotonic_time ();
+
             gzval = gzread (file, buffer, BUFLEN);
+            params->inflate_usec += g_get_monotonic_time () - start;
             if (gzval > 0)
             {
                 if (
@@ -1499,9 +1951,9 @@ cleanup_gz_thread_func:
     close (params->fd);
     g_free (params->filename);
     g_free (params->perms);
-    g_free (params);
+    params->success = success;
 
-    return GINT_TO_POINTER (success);
+    return params;
 }
 
 static FILE*
@@ -1536,6 +1988,9 @@ try_gz_open (const char* filename, const char* perms, gboolean use_gzip,
         params->filename = g_strdup (filename);
         params->perms = g_strdup (perms);
         params->compress = compress;
+        params->threads = gnc_prefs_get_file_compression_threads ();
+        params->success = 0;
+        params->inflate_usec = 0;
 
         thread = g_thread_new ("xml_thread", (GThreadFunc) gz_thread_func,
                                params);
@@ -1568,7 +2023,7 @@ try_gz_open (const char* filename, const char* perms, gboolean use_gzip,
 }
 
 static gboolean
-wait_for_gzip (FILE* file)
+wait_for_gzip (FILE* file, gint64* inflate_usec)
 {
     gboolean retval = TRUE;
 
@@ -1579,8 +2034,14 @@ wait_for_gzip (FILE* file)
                                                           file));
         if (thread)
         {
+            gz_thread_params_t* params;
+
             g_hash_table_remove (threads, file);
-            retval = GPOINTER_TO_INT (g_thread_join (thread));
+            params = static_cast<gz_thread_params_t*> (g_thread_join (thread));
+            retval = params->success;
+            if (inflate_usec)
+                *inflate_usec += params->inflate_usec;
+            g_free (params);
         }
     }
     G_UNLOCK (threads);
@@ -1588,6 +2049,29 @@ wait_for_gzip (FILE* file)
     return retval;
 }
 
+FILE*
+gnc_xml_open_for_write_v2 (const char* filename, gboolean compress)
+{
+    return try_gz_open (filename, "w", compress, TRUE);
+}
+
+gboolean
+gnc_xml_close_for_write_v2 (FILE* out, gboolean compress)
+{
+    gboolean success = TRUE;
+
+    /* Close the output stream */
+    if (fclose (out))
+        success = FALSE;
+
+    /* Optionally wait for parallel compression threads */
+    if (compress)
+        if (!wait_for_gzip (out))
+            success = FALSE;
+
+    return success;
+}
+
 gboolean
 gnc_book_write_to_xml_file_v2 (
     QofBook* book,
@@ -1597,22 +2081,16 @@ gnc_book_write_to_xml_file_v2 (
     FILE* out;
     gboolean success = TRUE;
 
-    out = try_gz_open (filename, "w", compress, TRUE);
+    out = gnc_xml_open_for_write_v2 (filename, compress);
 
     /* Try to write as much as possible */
     if (!out
         || !gnc_book_write_to_xml_filehandle_v2 (book, out))
         success = FALSE;
 
-    /* Close the output stream */
-    if (out && fclose (out))
+    if (out && !gnc_xml_close_for_write_v2 (out, compress))
         success = FALSE;
 
-    /* Optionally wait for parallel compression threads */
-    if (out && compress)
-        if (!wait_for_gzip (out))
-            success = FALSE;
-
     return success;
 }
 
@@ -1715,59 +2193,140 @@ gnc_is_xml_data_file_v2 (const gchar* name, gboolean* with_encoding)
 }
 
 
-static void
-replace_character_references (gchar* string)
+/* Replace the character references &#NNN; and &#xNN; in string, which
+ * legacy files used for bytes of their encoding, with those bytes.  Returns
+ * the new length. */
+static gsize
+replace_character_references (gchar* string, gsize len)
 {
-    gchar* cursor, *semicolon, *tail;
-    glong number;
+    const gchar* end = string + len;
+    const gchar* in = string;
+    gchar* out = string;
 
-    for (cursor = strstr (string, "&#");
-         cursor && *cursor;
-         cursor = strstr (cursor, "&#"))
+    while (in < end)
     {
-        semicolon = strchr (cursor, ';');
-        if (semicolon && *semicolon)
+        auto ref = g_strstr_len (in, end - in, "&#");
+        if (!ref)
+            break;
+
+        auto semicolon = static_cast<const gchar*> (memchr (ref, ';',
+                                                            end - ref));
+        if (!semicolon)
         {
+            PWARN ("Unclosed character reference");
+            break;
+        }
 
-            /* parse number */
-            errno = 0;
-            if (* (cursor + 2) == 'x')
-            {
-                number = strtol (cursor + 3, &tail, 16);
-            }
-            else
-            {
-                number = strtol (cursor + 2, &tail, 10);
-            }
-            if (errno || tail != semicolon || number < 0 || number > 255)
-            {
-                PWARN ("Illegal character reference");
-                return;
-            }
+        /* parse number; strtol stops at the semicolon at the latest */
+        gchar* tail;
+        glong number;
+        errno = 0;
+        if (ref + 2 < end && ref[2] == 'x')
+            number = strtol (ref + 3, &tail, 16);
+        else
+            number = strtol (ref + 2, &tail, 10);
+        if (errno || tail != semicolon || number < 0 || number > 255)
+        {
+            PWARN ("Illegal character reference");
+            break;
+        }
 
-            /* overwrite '&' with the specified character */
-            *cursor = (gchar) number;
-            cursor++;
-            if (* (semicolon + 1))
-            {
-                /* move text after semicolon the the left */
-                tail = g_strdup (semicolon + 1);
-                strcpy (cursor, tail);
-                g_free (tail);
-            }
-            else
-            {
-                /* cut here */
-                *cursor = '\0';
-            }
+        memmove (out, in, ref - in);
+        out += ref - in;
+        *out++ = (gchar) number;
+        in = semicolon + 1;
+    }
+    memmove (out, in, end - in);
+    return out + (end - in) - string;
+}
 
+static inline gboolean
+is_legacy_delimiter (gchar c)
+{
+    return c == '>' || c == ' ' || c == '<' || c == '\n' || c == '\r' ||
+           c == '\t';
+}
+
+/* The next word of a line, delimited as the encoding assistant shows them,
+ * or NULL at its end. */
+static const gchar*
+next_legacy_word (const gchar** cursor, const gchar* end, gsize* len)
+{
+    auto pos = *cursor;
+
+    while (pos < end && is_legacy_delimiter (*pos))
+        pos++;
+    if (pos == end)
+    {
+        *cursor = end;
+        return NULL;
+    }
+
+    auto start = pos;
+    while (pos < end && !is_legacy_delimiter (*pos))
+        pos++;
+    *cursor = pos;
+    *len = pos - start;
+    return start;
+}
+
+static inline gboolean
+is_ascii_word (const gchar* word, gsize len)
+{
+    for (gsize i = 0; i < len; i++)
+        if (static_cast<guchar> (word[i]) & 0x80)
+            return FALSE;
+    return TRUE;
+}
+
+#define LEGACY_BLOCK_SIZE (64 * 1024)
+
+typedef gboolean (*legacy_line_cb) (const gchar* line, gsize len,
+                                    gpointer data);
+
+/* Stream the lines of a legacy file, with its character references
+ * replaced, to line_cb, which stops the reading by returning FALSE.  The
+ * file is read in large blocks, a line never being cut in two. */
+static gboolean
+read_legacy_lines (FILE* file, legacy_line_cb line_cb, gpointer data)
+{
+    std::vector<gchar> buf (LEGACY_BLOCK_SIZE);
+    gsize filled = 0;
+
+    while (1)
+    {
+        /* a line longer than the buffer */
+        if (filled == buf.size ())
+            buf.resize (buf.size () * 2);
+
+        auto count = fread (buf.data () + filled, 1, buf.size () - filled, file);
+        if (count == 0)
+        {
+            if (ferror (file))
+                return FALSE;
+            break;
         }
-        else
+        filled += count;
+
+        auto line = buf.data ();
+        auto end = buf.data () + filled;
+        gchar* newline;
+        while ((newline = static_cast<gchar*> (memchr (line, '\n',
+                                                       end - line))))
         {
-            PWARN ("Unclosed character reference");
-            return;
+            auto len = replace_character_references (line, newline + 1 - line);
+            if (!line_cb (line, len, data))
+                return FALSE;
+            line = newline + 1;
         }
+        filled = end - line;
+        memmove (buf.data (), line, filled);
     }
+
+    if (filled == 0)
+        return TRUE;
+    return line_cb (buf.data (), replace_character_references (buf.data (),
+                                                               filled), data);
 }
 
 static void
@@ -1793,21 +2352,107 @@ typedef struct
     GIConv iconv;
 } iconv_item_type;
 
+typedef struct
+{
+    GList* iconv_list;
+    GHashTable* unique;
+    GHashTable* ambiguous;
+    GList* impossible;
+    GHashTable* processed;
+    GString* word;
+    gint n_impossible;
+} find_ambiguous_data;
+
+/* Convert each byte sequence the first time it occurs; ASCII ones need no
+ * converting. */
+static gboolean
+find_ambiguous_line (const gchar* line, gsize len, gpointer user_data)
+{
+    auto data = static_cast<find_ambiguous_data*> (user_data);
+    const gchar* cursor = line;
+    const gchar* start;
+    gsize word_len;
+
+    while ((start = next_legacy_word (&cursor, line + len, &word_len)))
+    {
+        GList* conv_list = NULL;
+        GError* error = NULL;
+
+        if (is_ascii_word (start, word_len))
+            continue;
+
+        g_string_truncate (data->word, 0);
+        g_string_append_len (data->word, start, word_len);
+        auto word = data->word->str;
+        if (g_hash_table_contains (data->processed, word))
+            continue;
+
+        /* loop through encodings */
+        for (auto iter = data->iconv_list; iter; iter = iter->next)
+        {
+            auto iconv_item = static_cast<iconv_item_type*> (iter->data);
+            auto utf8 = g_convert_with_iconv (start, word_len, iconv_item->iconv,
+                                              NULL, NULL, &error);
+            if (utf8)
+            {
+                auto conv = g_new (conv_type, 1);
+                conv->encoding = iconv_item->encoding;
+                conv->utf8_string = utf8;
+                conv_list = g_list_prepend (conv_list, conv);
+            }
+            else
+            {
+                g_error_free (error);
+                error = NULL;
+            }
+        }
+
+        /* no successful conversion */
+        if (!conv_list)
+        {
+            data->impossible = g_list_append (data->impossible,
+                                              g_strdup (word));
+            data->n_impossible++;
+        }
+
+        /* more than one successful conversion */
+        else if (conv_list->next)
+        {
+            if (data->ambiguous)
+                g_hash_table_insert (data->ambiguous, g_strdup (word),
+                                     conv_list);
+            else
+                conv_list_free (conv_list);
+        }
+
+        /* only one successful conversion */
+        else
+        {
+            if (data->unique)
+                g_hash_table_insert (data->unique, g_strdup (word),
+                                     conv_list->data);
+            else
+                conv_free (static_cast<conv_type*> (conv_list->data));
+            g_list_free (conv_list);
+        }
+
+        g_hash_table_add (data->processed, g_strdup (word));
+    }
+    return TRUE;
+}
+
 gint
 gnc_xml2_find_ambiguous (const gchar* filename, GList* encodings,
                          GHashTable** unique, GHashTable** ambiguous,
                          GList** impossible)
 {
+    find_ambiguous_data data;
+    GQuark ascii;
     FILE* file = NULL;
-    GList* iconv_list = NULL, *conv_list = NULL, *iter;
-    iconv_item_type* iconv_item = NULL, *ascii = NULL;
-    const gchar* enc;
-    GHashTable* processed = NULL;
-    gint n_impossible = 0;
-    GError* error = NULL;
     gboolean is_compressed;
     gboolean clean_return = FALSE;
 
+    memset (&data, 0, sizeof (data));
     is_compressed = is_gzipped_file (filename);
     file = try_gz_open (filename, "r", is_compressed, FALSE);
     if (file == NULL)
@@ -1816,179 +2461,52 @@ gnc_xml2_find_ambiguous (const gchar* filename, GList* encodings,
         goto cleanup_find_ambs;
     }
 
-    /* we need ascii */
-    ascii = g_new (iconv_item_type, 1);
-    ascii->encoding = g_quark_from_string ("ASCII");
-    ascii->iconv = g_iconv_open ("UTF-8", "ASCII");
-    if (ascii->iconv == (GIConv) - 1)
-    {
-        PWARN ("Unable to open ASCII ICONV conversion descriptor");
-        goto cleanup_find_ambs;
-    }
-
-    /* call iconv_open on encodings */
-    for (iter = encodings; iter; iter = iter->next)
+    /* call iconv_open on encodings; ASCII words are never looked at */
+    ascii = g_quark_from_string ("ASCII");
+    for (auto iter = encodings; iter; iter = iter->next)
     {
-        iconv_item = g_new (iconv_item_type, 1);
-        iconv_item->encoding = GPOINTER_TO_UINT (iter->data);
-        if (iconv_item->encoding == ascii->encoding)
-        {
+        GQuark encoding = GPOINTER_TO_UINT (iter->data);
+        if (encoding == ascii)
             continue;
-        }
 
-        enc = g_quark_to_string (iconv_item->encoding);
-        iconv_item->iconv = g_iconv_open ("UTF-8", enc);
-        if (iconv_item->iconv == (GIConv) - 1)
+        auto enc = g_quark_to_string (encoding);
+        auto iconv = g_iconv_open ("UTF-8", enc);
+        if (iconv == (GIConv) - 1)
         {
             PWARN ("Unable to open IConv conversion descriptor for '%s'", enc);
-            g_free (iconv_item);
             goto cleanup_find_ambs;
         }
-        else
-        {
-            iconv_list = g_list_prepend (iconv_list, iconv_item);
-        }
+        auto iconv_item = g_new (iconv_item_type, 1);
+        iconv_item->encoding = encoding;
+        iconv_item->iconv = iconv;
+        data.iconv_list = g_list_prepend (data.iconv_list, iconv_item);
     }
 
     /* prepare data containers */
     if (unique)
-        *unique = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
-                                         (GDestroyNotify) conv_free);
+        data.unique = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify) conv_free);
     if (ambiguous)
-        *ambiguous = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
-                                            (GDestroyNotify) conv_list_free);
-    if (impossible)
-        *impossible = NULL;
-    processed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-
-    /* loop through lines */
-    while (1)
-    {
-        gchar line[256], *word, *utf8;
-        gchar** word_array, **word_cursor;
-        conv_type* conv = NULL;
-
-        if (!fgets (line, sizeof (line) - 1, file))
-        {
-            if (feof (file))
-            {
-                break;
-            }
-            else
-            {
-                goto cleanup_find_ambs;
-            }
-        }
-
-        g_strchomp (line);
-        replace_character_references (line);
-        word_array = g_strsplit_set (line, "> <", 0);
-
-        /* loop through words */
-        for (word_cursor = word_array; *word_cursor; word_cursor++)
-        {
-            word = *word_cursor;
-            if (!word)
-                continue;
-
-            utf8 = g_convert_with_iconv (word, -1, ascii->iconv,
-                                         NULL, NULL, &error);
-            if (utf8)
-            {
-                /* pure ascii */
-                g_free (utf8);
-                continue;
-            }
-            g_error_free (error);
-            error = NULL;
-
-            if (g_hash_table_lookup_extended (processed, word, NULL, NULL))
-            {
-                /* already processed */
-                continue;
-            }
-
-            /* loop through encodings */
-            conv_list = NULL;
-            for (iter = iconv_list; iter; iter = iter->next)
-            {
-                iconv_item = static_cast<decltype (iconv_item)> (iter->data);
-                utf8 = g_convert_with_iconv (word, -1, iconv_item->iconv,
-                                             NULL, NULL, &error);
-                if (utf8)
-                {
-                    conv = g_new (conv_type, 1);
-                    conv->encoding = iconv_item->encoding;
-                    conv->utf8_string = utf8;
-                    conv_list = g_list_prepend (conv_list, conv);
-                }
-                else
-                {
-                    g_error_free (error);
-                    error = NULL;
-                }
-            }
+        data.ambiguous = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                (GDestroyNotify) conv_list_free);
+    data.processed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                            NULL);
+    data.word = g_string_sized_new (64);
 
-            /* no successful conversion */
-            if (!conv_list)
-            {
-                if (impossible)
-                    *impossible = g_list_append (*impossible, g_strdup (word));
-                n_impossible++;
-            }
-
-            /* more than one successful conversion */
-            else if (conv_list->next)
-            {
-                if (ambiguous)
-                {
-                    g_hash_table_insert (*ambiguous, g_strdup (word), conv_list);
-                }
-                else
-                {
-                    conv_list_free (conv_list);
-                }
-            }
-
-            /* only one successful conversion */
-            else
-            {
-                if (unique)
-                {
-                    g_hash_table_insert (*unique, g_strdup (word), conv);
-                }
-                else
-                {
-                    conv_free (conv);
-                }
-                g_list_free (conv_list);
-            }
-
-            g_hash_table_insert (processed, g_strdup (word), NULL);
-        }
-        g_strfreev (word_array);
-    }
-
-    clean_return = TRUE;
+    clean_return = read_legacy_lines (file, find_ambiguous_line, &data);
 
 cleanup_find_ambs:
 
-    if (iconv_list)
+    for (auto iter = data.iconv_list; iter; iter = iter->next)
     {
-        for (iter = iconv_list; iter; iter = iter->next)
-        {
-            if (iter->data)
-            {
-                g_iconv_close (((iconv_item_type*) iter->data)->iconv);
-                g_free (iter->data);
-            }
-        }
-        g_list_free (iconv_list);
+        g_iconv_close (((iconv_item_type*) iter->data)->iconv);
+        g_free (iter->data);
     }
-    if (processed)
-        g_hash_table_destroy (processed);
-    if (ascii)
-        g_free (ascii);
+    g_list_free (data.iconv_list);
+    if (data.processed)
+        g_hash_table_destroy (data.processed);
+    if (data.word)
+        g_string_free (data.word, TRUE);
     if (file)
     {
         fclose (file);
@@ -1996,7 +2514,16 @@ cleanup_find_ambs:
             wait_for_gzip (file);
     }
 
-    return (clean_return) ? n_impossible : -1;
+    if (unique)
+        *unique = data.unique;
+    if (ambiguous)
+        *ambiguous = data.ambiguous;
+    if (impossible)
+        *impossible = data.impossible;
+    else
+        g_list_free_full (data.impossible, g_free);
+
+    return (clean_return) ? data.n_impossible : -1;
 }
 
 typedef struct
@@ -2005,15 +2532,65 @@ typedef struct
     GHashTable* subst;
 } push_data_type;
 
+typedef struct
+{
+    xmlParserCtxtPtr xml_context;
+    GHashTable* subst;
+    GString* word;
+    GString* output;
+} subst_data;
+
+static gboolean
+flush_subst_output (subst_data* data, int terminate)
+{
+    auto ok = xmlParseChunk (data->xml_context, data->output->str,
+                             data->output->len, terminate) == 0;
+    g_string_truncate (data->output, 0);
+    return ok;
+}
+
+/* Copy the line to the output with its non-ASCII words replaced, feeding
+ * the output to the parser a block at a time. */
+static gboolean
+subst_line (const gchar* line, gsize len, gpointer user_data)
+{
+    auto data = static_cast<subst_data*> (user_data);
+    const gchar* cursor = line;
+    const gchar* copied = line;
+    const gchar* start;
+    gsize word_len;
+
+    while ((start = next_legacy_word (&cursor, line + len, &word_len)))
+    {
+        if (is_ascii_word (start, word_len))
+            continue;
+
+        g_string_truncate (data->word, 0);
+        g_string_append_len (data->word, start, word_len);
+        auto repl = static_cast<const gchar*> (g_hash_table_lookup (data->subst,
+                                                                    data->word->str));
+        if (!repl)
+            /* there is no replacement, stop here */
+            return FALSE;
+
+        g_string_append_len (data->output, copied, start - copied);
+        g_string_append (data->output, repl);
+        copied = start + word_len;
+    }
+    g_string_append_len (data->output, copied, line + len - copied);
+
+    if (data->output->len >= LEGACY_BLOCK_SIZE)
+        return flush_subst_output (data, 0);
+    return TRUE;
+}
+
 static void
 parse_with_subst_push_handler (xmlParserCtxtPtr xml_context,
                                push_data_type* push_data)
 {
     const gchar* filename;
     FILE* file = NULL;
-    GIConv ascii = (GIConv) - 1;
-    GString* output = NULL;
-    GError* error = NULL;
+    subst_data data;
     gboolean is_compressed;
 
     filename = push_data->filename;
@@ -2022,119 +2599,23 @@ parse_with_subst_push_handler (xmlParserCtxtPtr xml_context,
     if (file == NULL)
     {
         PWARN ("Unable to open file %s", filename);
-        goto cleanup_push_handler;
-    }
-
-    ascii = g_iconv_open ("UTF-8", "ASCII");
-    if (ascii == (GIConv) - 1)
-    {
-        PWARN ("Unable to open ASCII ICONV conversion descriptor");
-        goto cleanup_push_handler;
-    }
-
-    /* loop through lines */
-    while (1)
-    {
-        gchar line[256], *word, *repl, *utf8;
-        gint pos, len;
-        gchar* start, *cursor;
-
-        if (!fgets (line, sizeof (line) - 1, file))
-        {
-            if (feof (file))
-            {
-                break;
-            }
-            else
-            {
-                goto cleanup_push_handler;
-            }
-        }
-
-        replace_character_references (line);
-        output = g_string_new (line);
-
-        /* loop through words */
-        cursor = output->str;
-        pos = 0;
-        while (1)
-        {
-            /* ignore delimiters */
-            while (*cursor == '>' || *cursor == ' ' || *cursor == '<' ||
-                   *cursor == '\n')
-            {
-                cursor++;
-                pos += 1;
-            }
-
-            if (!*cursor)
-                /* welcome to EOL */
-                break;
-
-            /* search for a delimiter */
-            start = cursor;
-            len = 0;
-            while (*cursor && *cursor != '>' && *cursor != ' ' && *cursor != '<' &&
-                   *cursor != '\n')
-            {
-                cursor++;
-                len++;
-            }
-
-            utf8 = g_convert_with_iconv (start, len, ascii, NULL, NULL, &error);
-
-            if (utf8)
-            {
-                /* pure ascii */
-                g_free (utf8);
-                pos += len;
-            }
-            else
-            {
-                g_error_free (error);
-                error = NULL;
-
-                word = g_strndup (start, len);
-                repl = static_cast<decltype (repl)> (g_hash_table_lookup (push_data->subst,
-                                                                          word));
-                g_free (word);
-                if (repl)
-                {
-                    /* there is a replacement */
-                    output = g_string_insert (g_string_erase (output, pos, len),
-                                              pos, repl);
-                    pos += strlen (repl);
-                    cursor = output->str + pos;
-                }
-                else
-                {
-                    /* there is no replacement, return immediately */
-                    goto cleanup_push_handler;
-                }
-            }
-        }
-
-        if (xmlParseChunk (xml_context, output->str, output->len, 0) != 0)
-        {
-            goto cleanup_push_handler;
-        }
+        return;
     }
 
-    /* last chunk */
-    xmlParseChunk (xml_context, "", 0, 1);
+    data.xml_context = xml_context;
+    data.subst = push_data->subst;
+    data.word = g_string_sized_new (64);
+    data.output = g_string_sized_new (2 * LEGACY_BLOCK_SIZE);
 
-cleanup_push_handler:
+    /* the last chunk ends the document */
+    if (read_legacy_lines (file, subst_line, &data))
+        flush_subst_output (&data, 1);
 
-    if (output)
-        g_string_free (output, TRUE);
-    if (ascii != (GIConv) - 1)
-        g_iconv_close (ascii);
-    if (file)
-    {
-        fclose (file);
-        if (is_compressed)
-            wait_for_gzip (file);
-    }
+    g_string_free (data.word, TRUE);
+    g_string_free (data.output, TRUE);
+    fclose (file);
+    if (is_compressed)
+        wait_for_gzip (file);
 }
 
 gboolean
@@ -2149,7 +2630,7 @@ gnc_xml2_parse_with_subst (GncXmlBackend* xml_be, QofBook* book, GHashTable* sub
 
     success = qof_session_load_from_xml_file_v2_full (
                   xml_be, book, (sixtp_push_handler) parse_with_subst_push_handler,
-                  push_data, GNC_BOOK_XML2_FILE);
+                  push_data, NULL, GNC_BOOK_XML2_FILE);
     g_free (push_data);
 
     if (success)
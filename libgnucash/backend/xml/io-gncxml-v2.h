@@ -41,6 +41,7 @@ extern "C"
 }
 #include "gnc-backend-xml.h"
 #include "sixtp.h"
+#include <string>
 #include <vector>
 
 class GncXmlBackend;
@@ -88,10 +89,46 @@ typedef struct
 gboolean qof_session_load_from_xml_file_v2 (GncXmlBackend*, QofBook*,
                                             QofBookFileType);
 
+typedef enum
+{
+    GNC_SNAPSHOT_LOADED,
+    GNC_SNAPSHOT_NONE,          /**< no current snapshot, the book is untouched */
+    GNC_SNAPSHOT_FAILED,        /**< part of the book was built before the
+                                     snapshot failed to load */
+} GncSnapshotLoad;
+
+/** Read the book from the snapshot of an XML v2 data file, if it has a
+ * current one, instead of parsing the file; see GncXmlSnapshot. */
+GncSnapshotLoad qof_session_load_from_xml_snapshot_v2 (GncXmlBackend*,
+                                                       QofBook*);
+
+/** Apply the records of a change journal to a book just loaded from the data
+ * file the journal belongs to. */
+gboolean qof_session_replay_xml_journal_v2 (QofBook* book,
+                                            const std::vector<std::string>& records);
+
 /* write all book info to a file */
 gboolean gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* fh);
 gboolean gnc_book_write_to_xml_file_v2 (QofBook* book, const char* filename,
                                         gboolean compress);
+/** Write the part of the book a snapshot keeps as XML: everything before the
+ * transactions but the prices, or everything after them. */
+gboolean gnc_book_write_snapshot_xml_v2 (QofBook* book, FILE* fh,
+                                         gboolean after_transactions);
+/** The data file up to its transactions, without the closing tags, and the
+ * rest of it after them; see GncXmlBackgroundSave. */
+gboolean gnc_book_write_xml_head_v2 (QofBook* book, FILE* fh);
+gboolean gnc_book_write_xml_tail_v2 (QofBook* book, FILE* fh);
+/** Open a data file for writing, compressed by a thread of its own if
+ * compress is set, and close it again, waiting for that thread. */
+FILE* gnc_xml_open_for_write_v2 (const char* filename, gboolean compress);
+gboolean gnc_xml_close_for_write_v2 (FILE* fh, gboolean compress);
+
+/** Write a change journal record for the transactions with the given GUIDs.
+ * Returns FALSE if one of them can only be saved with a full write. */
+gboolean gnc_xml_journal_record_v2 (QofBook* book,
+                                    const std::vector<GncGUID>& guids,
+                                    std::string& record);
 
 /** write just the commodities and accounts to a file */
 gboolean gnc_book_write_accounts_to_xml_filehandle_v2 (QofBackend* be,
@@ -0,0 +1,263 @@
+/********************************************************************
+ * io-gzip.cpp -- gzip compression on several threads               *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+extern "C"
+{
+#include <config.h>
+
+#include <glib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#include <zlib.h>
+}
+
+#include "io-gzip.h"
+
+#include <deque>
+#include <vector>
+
+#define GZIP_BLOCK_SIZE (128 * 1024)
+#define GZIP_DICT_SIZE (32 * 1024)
+
+/* One block of input and, once done is set, its deflated bytes.  The
+   first dict_len bytes of in are the dictionary, the rest the data. */
+struct gzip_block
+{
+    std::vector<Bytef> in;
+    size_t dict_len;
+    std::vector<Bytef> out;
+    uLong crc;
+    gboolean done;
+    gboolean ok;
+};
+
+struct gzip_shared
+{
+    GMutex mutex;
+    GCond cond;
+    int level;
+};
+
+static gboolean
+gzip_deflate_block (gzip_block* block, int level)
+{
+    z_stream strm;
+    uInt len = block->in.size () - block->dict_len;
+    size_t produced = 0;
+    int ret;
+
+    memset (&strm, 0, sizeof (strm));
+    if (deflateInit2 (&strm, level, Z_DEFLATED, -MAX_WBITS, 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK)
+        return FALSE;
+
+    if (block->dict_len &&
+        deflateSetDictionary (&strm, block->in.data (),
+                              block->dict_len) != Z_OK)
+    {
+        deflateEnd (&strm);
+        return FALSE;
+    }
+
+    strm.next_in = block->in.data () + block->dict_len;
+    strm.avail_in = len;
+    /* A sync flush adds an empty stored block that deflateBound() doesn't
+       count; it ends the block on a byte boundary without ending the
+       stream. */
+    block->out.resize (deflateBound (&strm, len) + 16);
+    do
+    {
+        if (produced == block->out.size ())
+            block->out.resize (block->out.size () * 2);
+        strm.next_out = block->out.data () + produced;
+        strm.avail_out = block->out.size () - produced;
+        ret = deflate (&strm, Z_SYNC_FLUSH);
+        produced = block->out.size () - strm.avail_out;
+    }
+    while (ret == Z_OK && strm.avail_out == 0);
+    deflateEnd (&strm);
+
+    if (ret != Z_OK && ret != Z_BUF_ERROR)
+        return FALSE;
+
+    block->out.resize (produced);
+    block->crc = crc32 (crc32 (0L, Z_NULL, 0),
+                        block->in.data () + block->dict_len, len);
+    return TRUE;
+}
+
+static void
+gzip_block_func (gpointer data, gpointer user_data)
+{
+    auto block = static_cast<gzip_block*> (data);
+    auto shared = static_cast<gzip_shared*> (user_data);
+    auto ok = gzip_deflate_block (block, shared->level);
+
+    g_mutex_lock (&shared->mutex);
+    block->ok = ok;
+    block->done = TRUE;
+    g_cond_broadcast (&shared->cond);
+    g_mutex_unlock (&shared->mutex);
+}
+
+/* Fill the data part of the block from fd, stopping early only at the end
+   of the input.  Returns the number of bytes read or -1. */
+static gssize
+gzip_read_block (int fd, gzip_block* block)
+{
+    size_t filled = 0;
+
+    block->in.resize (block->dict_len + GZIP_BLOCK_SIZE);
+    while (filled < GZIP_BLOCK_SIZE)
+    {
+        auto bytes = read (fd, block->in.data () + block->dict_len + filled,
+                           GZIP_BLOCK_SIZE - filled);
+        if (bytes == 0)
+            break;
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            g_warning ("Could not read from pipe. The error is '%s' (errno %d)",
+                       g_strerror (errno) ? g_strerror (errno) : "", errno);
+            return -1;
+        }
+        filled += bytes;
+    }
+    block->in.resize (block->dict_len + filled);
+    return filled;
+}
+
+static void
+gzip_put_le32 (Bytef* buf, uLong value)
+{
+    for (int i = 0; i < 4; i++)
+        buf[i] = (value >> (8 * i)) & 0xff;
+}
+
+gboolean
+gnc_gzip_fd_to_file (int fd, FILE* out, guint n_threads, int level)
+{
+    /* Magic, deflate, no flags, no time, default extra flags, Unix. */
+    static const Bytef header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+    /* An empty final block with fixed codes, which ends the stream. */
+    static const Bytef last_block[2] = { 0x03, 0x00 };
+    std::deque<gzip_block*> pending;
+    std::vector<Bytef> dict;
+    gzip_shared shared;
+    GThreadPool* pool;
+    uLong crc = crc32 (0L, Z_NULL, 0);
+    uLong total = 0;
+    gboolean success = TRUE;
+    gboolean at_end = FALSE;
+    Bytef trailer[8];
+
+    if (n_threads == 0)
+        n_threads = g_get_num_processors ();
+
+    g_mutex_init (&shared.mutex);
+    g_cond_init (&shared.cond);
+    shared.level = level;
+    pool = g_thread_pool_new (gzip_block_func, &shared, n_threads, FALSE,
+                              NULL);
+
+    if (fwrite (header, 1, sizeof (header), out) != sizeof (header))
+        success = FALSE;
+
+    while (success && !(at_end && pending.empty ()))
+    {
+        /* Keep every thread busy and one more block of each queued, then
+           write the oldest block as soon as it is done. */
+        if (!at_end && pending.size () < 2 * n_threads)
+        {
+            auto block = new gzip_block;
+            block->in = dict;
+            block->dict_len = dict.size ();
+            block->done = FALSE;
+            block->ok = FALSE;
+
+            auto bytes = gzip_read_block (fd, block);
+            if (bytes <= 0)
+            {
+                delete block;
+                at_end = TRUE;
+                if (bytes < 0)
+                    success = FALSE;
+                continue;
+            }
+            at_end = bytes < GZIP_BLOCK_SIZE;
+
+            auto keep = MIN (block->in.size (), (size_t) GZIP_DICT_SIZE);
+            dict.assign (block->in.end () - keep, block->in.end ());
+
+            pending.push_back (block);
+            g_thread_pool_push (pool, block, NULL);
+            continue;
+        }
+
+        auto block = pending.front ();
+        pending.pop_front ();
+
+        g_mutex_lock (&shared.mutex);
+        while (!block->done)
+            g_cond_wait (&shared.cond, &shared.mutex);
+        g_mutex_unlock (&shared.mutex);
+
+        auto len = block->in.size () - block->dict_len;
+        if (!block->ok)
+        {
+            g_warning ("Could not compress a block of %" G_GSIZE_FORMAT
+                       " bytes", len);
+            success = FALSE;
+        }
+        else if (fwrite (block->out.data (), 1, block->out.size (), out) !=
+                 block->out.size ())
+        {
+            g_warning ("Could not write the compressed file. The error is '%s' (errno %d)",
+                       g_strerror (errno) ? g_strerror (errno) : "", errno);
+            success = FALSE;
+        }
+        crc = crc32_combine (crc, block->crc, len);
+        total += len;
+        delete block;
+    }
+
+    /* Let the threads finish what they have before freeing the blocks. */
+    g_thread_pool_free (pool, FALSE, TRUE);
+    for (auto block : pending)
+        delete block;
+    g_mutex_clear (&shared.mutex);
+    g_cond_clear (&shared.cond);
+
+    if (!success)
+        return FALSE;
+
+    gzip_put_le32 (trailer, crc);
+    gzip_put_le32 (trailer + 4, total & 0xffffffffUL);
+    if (fwrite (last_block, 1, sizeof (last_block), out) != sizeof (last_block)
+        || fwrite (trailer, 1, sizeof (trailer), out) != sizeof (trailer))
+        return FALSE;
+
+    return TRUE;
+}
@@ -0,0 +1,45 @@
+/********************************************************************
+ * io-gzip.h -- gzip compression on several threads                 *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+
+#ifndef IO_GZIP_H
+#define IO_GZIP_H
+extern "C"
+{
+#include <stdio.h>
+#include <glib.h>
+}
+
+/** Compress everything that can be read from fd into a gzip file written
+ * to out.
+ *
+ * The input is cut into blocks of 128 KiB which are deflated independently
+ * on up to n_threads threads (0 means one per processor), each primed with
+ * the 32 KiB of input before it.  The blocks end on a byte boundary and are
+ * written in order, so the result is one ordinary deflate stream that any
+ * gzip tool can read, only a little larger than a serial gzwrite() gives.
+ *
+ * Returns FALSE if reading, compressing or writing failed.  Neither fd nor
+ * out is closed.
+ */
+gboolean gnc_gzip_fd_to_file (int fd, FILE* out, guint n_threads, int level);
+
+#endif /* IO_GZIP_H */
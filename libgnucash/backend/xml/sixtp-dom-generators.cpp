@@ -26,6 +26,7 @@ extern "C"
 
 #include <config.h>
 #include <glib.h>
+#include <string.h>
 
 #include <gnc-date.h>
 }
@@ -136,14 +137,15 @@ xmlNodePtr
 time64_to_dom_tree (const char* tag, const time64 time)
 {
     xmlNodePtr ret;
+    char date_str[MAX_DATE_LENGTH + 8];
     g_return_val_if_fail (time != INT64_MAX, NULL);
-    auto date_str = GncDateTime(time).format_iso8601();
-    if (date_str.empty())
+    auto end = gnc_time64_to_iso8601_buff (time, date_str);
+    if (end == date_str)
         return NULL;
-    date_str += " +0000"; //Tack on a UTC offset to mollify GnuCash for Android
+    strcpy (end, " +0000"); //Tack on a UTC offset to mollify GnuCash for Android
     ret = xmlNewNode (NULL, BAD_CAST tag);
     xmlNewTextChild (ret, NULL, BAD_CAST "ts:date",
-                     checked_char_cast (const_cast<char*>(date_str.c_str())));
+                     checked_char_cast (date_str));
     return ret;
 }
 
@@ -336,3 +338,185 @@ qof_instance_slots_to_dom_tree (const char* tag, const QofInstance* inst)
     frame->for_each_slot_temp (&add_kvp_slot, ret);
     return ret;
 }
+
+/***********************************************************************/
+/* Streaming generators.  These mirror the functions above node for node,
+ * so keep them in step when the file format changes. */
+
+void
+guid_to_xml (GncXmlWriter& writer, const char* tag, const GncGUID* gid)
+{
+    char guid_str[GUID_ENCODING_LENGTH + 1];
+
+    if (!guid_to_string_buff (gid, guid_str))
+    {
+        PERR ("guid_to_string_buff failed\n");
+        return;
+    }
+    writer.text_element (tag, guid_str, "type", "guid");
+}
+
+void
+commodity_ref_to_xml (GncXmlWriter& writer, const char* tag,
+                      const gnc_commodity* c)
+{
+    g_return_if_fail (c);
+
+    if (!gnc_commodity_get_namespace (c) || !gnc_commodity_get_mnemonic (c))
+        return;
+    writer.start_element (tag);
+    writer.checked_text_element ("cmdty:space", gnc_commodity_get_namespace (c));
+    writer.checked_text_element ("cmdty:id", gnc_commodity_get_mnemonic (c));
+    writer.end_element (tag);
+}
+
+void
+time64_to_xml (GncXmlWriter& writer, const char* tag, time64 time,
+               const char* type)
+{
+    char date_str[MAX_DATE_LENGTH + 8];
+    g_return_if_fail (time != INT64_MAX);
+    auto end = gnc_time64_to_iso8601_buff (time, date_str);
+    if (end == date_str)
+        return;
+    strcpy (end, " +0000"); //Tack on a UTC offset to mollify GnuCash for Android
+    writer.start_element (tag, type ? "type" : nullptr, type);
+    writer.checked_text_element ("ts:date", date_str);
+    writer.end_element (tag);
+}
+
+void
+gdate_to_xml (GncXmlWriter& writer, const char* tag, const GDate* date,
+              const char* type)
+{
+    gchar date_str[512];
+
+    g_return_if_fail (date);
+    g_date_strftime (date_str, sizeof (date_str), "%Y-%m-%d", date);
+    writer.start_element (tag, type ? "type" : nullptr, type);
+    writer.checked_text_element ("gdate", date_str);
+    writer.end_element (tag);
+}
+
+/* xmlNodeAddContent() and xmlNodeSetContent() don't add a text node for an
+ * empty string, so the element comes out as <tag/>. */
+static void
+content_to_xml (GncXmlWriter& writer, const char* tag, const char* content,
+                const char* type = nullptr)
+{
+    writer.text_element (tag, content && *content ? content : nullptr,
+                         type ? "type" : nullptr, type);
+}
+
+void
+gnc_numeric_to_xml (GncXmlWriter& writer, const char* tag,
+                    const gnc_numeric* num)
+{
+    gchar* numstr;
+
+    g_return_if_fail (num);
+
+    numstr = gnc_numeric_to_string (*num);
+    g_return_if_fail (numstr);
+    content_to_xml (writer, tag, numstr);
+    g_free (numstr);
+}
+
+static void add_kvp_slot_xml (const char* key, KvpValue* value, void* data);
+
+static void
+add_kvp_value_xml (GncXmlWriter& writer, const gchar* tag, KvpValue* val)
+{
+    switch (val->get_type ())
+    {
+    case KvpValue::Type::STRING:
+        writer.checked_text_element (tag, val->get<const char*> (),
+                                     "type", "string");
+        break;
+    case KvpValue::Type::INT64:
+    {
+        auto str = g_strdup_printf ("%" G_GINT64_FORMAT, val->get<int64_t> ());
+        content_to_xml (writer, tag, str, "integer");
+        g_free (str);
+        break;
+    }
+    case KvpValue::Type::DOUBLE:
+    {
+        auto str = double_to_string (val->get<double> ());
+        content_to_xml (writer, tag, str, "double");
+        g_free (str);
+        break;
+    }
+    case KvpValue::Type::NUMERIC:
+    {
+        auto str = gnc_numeric_to_string (val->get<gnc_numeric> ());
+        content_to_xml (writer, tag, str, "numeric");
+        g_free (str);
+        break;
+    }
+    case KvpValue::Type::GUID:
+    {
+        gchar guidstr[GUID_ENCODING_LENGTH + 1];
+        guid_to_string_buff (val->get<GncGUID*> (), guidstr);
+        content_to_xml (writer, tag, guidstr, "guid");
+        break;
+    }
+    /* Note: The type attribute must remain 'timespec' to maintain
+     * compatibility.
+     */
+    case KvpValue::Type::TIME64:
+        time64_to_xml (writer, tag, val->get<Time64> ().t, "timespec");
+        break;
+    case KvpValue::Type::GDATE:
+    {
+        auto d = val->get<GDate> ();
+        gdate_to_xml (writer, tag, &d, "gdate");
+        break;
+    }
+    case KvpValue::Type::GLIST:
+        writer.start_element (tag, "type", "list");
+        for (auto cursor = val->get<GList*> (); cursor; cursor = cursor->next)
+            add_kvp_value_xml (writer, "slot:value",
+                               static_cast<KvpValue*> (cursor->data));
+        writer.end_element (tag);
+        break;
+    case KvpValue::Type::FRAME:
+    {
+        auto frame = val->get<KvpFrame*> ();
+        auto data = &writer;
+        writer.start_element (tag, "type", "frame");
+        if (frame)
+            frame->for_each_slot_temp (&add_kvp_slot_xml, data);
+        writer.end_element (tag);
+        break;
+    }
+    default:
+        writer.text_element (tag, nullptr);
+        break;
+    }
+}
+
+static void
+add_kvp_slot_xml (const char* key, KvpValue* value, void* data)
+{
+    auto writer = static_cast<GncXmlWriter*> (data);
+
+    writer->start_element ("slot");
+    writer->checked_text_element ("slot:key", key);
+    add_kvp_value_xml (*writer, "slot:value", value);
+    writer->end_element ("slot");
+}
+
+void
+qof_instance_slots_to_xml (GncXmlWriter& writer, const char* tag,
+                           const QofInstance* inst)
+{
+    KvpFrame* frame = qof_instance_get_slots (inst);
+    auto data = &writer;
+    if (!frame || frame->empty())
+        return;
+
+    writer.start_element (tag);
+    frame->for_each_slot_temp (&add_kvp_slot_xml, data);
+    writer.end_element (tag);
+}
@@ -34,6 +34,7 @@ extern "C"
 }
 
 #include "gnc-xml-helper.h"
+#include "gnc-xml-writer.hpp"
 
 xmlNodePtr text_to_dom_tree (const char* tag, const char* str);
 xmlNodePtr int_to_dom_tree (const char* tag, gint64 val);
@@ -50,4 +51,19 @@ xmlNodePtr recurrence_to_dom_tree (const gchar* tag, const Recurrence* r);
 
 gchar* double_to_string (double value);
 
+/* Streaming counterparts of the generators above: each writes exactly what
+ * xmlElemDump() would print for the node the matching *_dom_tree function
+ * returns, and nothing where that function would return NULL. */
+void guid_to_xml (GncXmlWriter& writer, const char* tag, const GncGUID* gid);
+void commodity_ref_to_xml (GncXmlWriter& writer, const char* tag,
+                           const gnc_commodity* c);
+void time64_to_xml (GncXmlWriter& writer, const char* tag, time64 time,
+                    const char* type = nullptr);
+void gdate_to_xml (GncXmlWriter& writer, const char* tag, const GDate* date,
+                   const char* type = nullptr);
+void gnc_numeric_to_xml (GncXmlWriter& writer, const char* tag,
+                         const gnc_numeric* num);
+void qof_instance_slots_to_xml (GncXmlWriter& writer, const char* tag,
+                                const QofInstance* inst);
+
 #endif /* _SIXTP_DOM_GENERATORS_H_ */
@@ -37,6 +37,45 @@ extern "C"
 
 static QofLogModule log_module = GNC_MOD_IO;
 
+/* The text of a node's single text child where libxml2 keeps it, or else a
+   copy from xmlNodeGetContent() in *copy for xmlFree(). */
+static const char*
+node_text (xmlNodePtr node, xmlChar** copy)
+{
+    *copy = NULL;
+    if (!node)
+        return NULL;
+    if (node->type == XML_TEXT_NODE && !node->next)
+        return (const char*) node->content;
+    *copy = xmlNodeGetContent (node);
+    return (const char*) *copy;
+}
+
+/* The text dom_tree_to_text() returns, parsed by the converters where
+   libxml2 keeps it when the tree has a single text node. */
+class DomTreeText
+{
+public:
+    explicit DomTreeText (xmlNodePtr tree)
+    {
+        auto child = tree->xmlChildrenNode;
+        if (child && !child->next && child->type == XML_TEXT_NODE &&
+            child->content)
+            m_text = (const gchar*) child->content;
+        else
+            m_text = m_copy = dom_tree_to_text (tree);
+    }
+    DomTreeText (const DomTreeText&) = delete;
+    DomTreeText& operator= (const DomTreeText&) = delete;
+    ~DomTreeText () { g_free (m_copy); }
+
+    const gchar* get () const noexcept { return m_text; }
+
+private:
+    const gchar* m_text = nullptr;
+    gchar* m_copy = nullptr;
+};
+
 GncGUID*
 dom_tree_to_guid (xmlNodePtr node)
 {
@@ -54,20 +93,21 @@ dom_tree_to_guid (xmlNodePtr node)
     }
 
     {
-        char* type;
-
-        type = (char*)xmlNodeGetContent (node->properties->xmlAttrPropertyValue);
+        xmlChar* type_copy;
+        auto type = node_text (node->properties->xmlAttrPropertyValue,
+                               &type_copy);
 
         /* handle new and guid the same for the moment */
         if ((g_strcmp0 ("guid", type) == 0) || (g_strcmp0 ("new", type) == 0))
         {
             auto gid = guid_new ();
-            char* guid_str;
+            xmlChar* guid_copy;
+            auto guid_str = node_text (node->xmlChildrenNode, &guid_copy);
 
-            guid_str = (char*)xmlNodeGetContent (node->xmlChildrenNode);
-            string_to_guid (guid_str, gid);
-            xmlFree (guid_str);
-            xmlFree (type);
+            if (guid_str)
+                sixtp_string_to_guid (guid_str, gid);
+            xmlFree (guid_copy);
+            xmlFree (type_copy);
             return gid;
         }
         else
@@ -76,7 +116,7 @@ dom_tree_to_guid (xmlNodePtr node)
                   type ? type : "(null)",
                   node->properties->name ?
                   (char*) node->properties->name : "(null)");
-            xmlFree (type);
+            xmlFree (type_copy);
             return NULL;
         }
     }
@@ -85,17 +125,14 @@ dom_tree_to_guid (xmlNodePtr node)
 static KvpValue*
 dom_tree_to_integer_kvp_value (xmlNodePtr node)
 {
-    gchar* text;
+    DomTreeText text {node};
     gint64 daint;
     KvpValue* ret = NULL;
 
-    text = dom_tree_to_text (node);
-
-    if (string_to_gint64 (text, &daint))
+    if (text.get () && string_to_gint64 (text.get (), &daint))
     {
         ret = new KvpValue {daint};
     }
-    g_free (text);
 
     return ret;
 }
@@ -103,16 +140,9 @@ dom_tree_to_integer_kvp_value (xmlNodePtr node)
 gboolean
 dom_tree_to_integer (xmlNodePtr node, gint64* daint)
 {
-    gchar* text;
-    gboolean ret;
-
-    text = dom_tree_to_text (node);
-
-    ret = string_to_gint64 (text, daint);
-
-    g_free (text);
+    DomTreeText text {node};
 
-    return ret;
+    return text.get () && string_to_gint64 (text.get (), daint);
 }
 
 gboolean
@@ -129,17 +159,16 @@ dom_tree_to_guint16 (xmlNodePtr node, guint16* i)
 gboolean
 dom_tree_to_guint (xmlNodePtr node, guint* i)
 {
-    gchar* text, *endptr;
-    gboolean ret;
+    DomTreeText text {node};
+    gchar* endptr;
 
-    text = dom_tree_to_text (node);
+    if (!text.get ())
+        return FALSE;
     /* In spite of the strange string_to_gint64 function, I'm just
        going to use strtoul here until someone shows me the error of
        my ways. -CAS */
-    *i = (guint) strtoul (text, &endptr, 0);
-    ret = (endptr != text);
-    g_free (text);
-    return ret;
+    *i = (guint) strtoul (text.get (), &endptr, 0);
+    return (endptr != text.get ());
 }
 
 gboolean
@@ -168,19 +197,15 @@ dom_tree_to_boolean (xmlNodePtr node, gboolean* b)
 static KvpValue*
 dom_tree_to_double_kvp_value (xmlNodePtr node)
 {
-    gchar* text;
+    DomTreeText text {node};
     double dadoub;
     KvpValue* ret = NULL;
 
-    text = dom_tree_to_text (node);
-
-    if (string_to_double (text, &dadoub))
+    if (text.get () && string_to_double (text.get (), &dadoub))
     {
         ret = new KvpValue {dadoub};
     }
 
-    g_free (text);
-
     return ret;
 }
 
@@ -514,15 +539,14 @@ dom_tree_to_text (xmlNodePtr tree)
 gnc_numeric*
 dom_tree_to_gnc_numeric (xmlNodePtr node)
 {
-    gchar* content = dom_tree_to_text (node);
-    if (!content)
+    DomTreeText content {node};
+    if (!content.get ())
         return NULL;
 
     gnc_numeric *ret = g_new (gnc_numeric, 1);
 
-    if (!string_to_gnc_numeric (content, ret))
+    if (!sixtp_string_to_gnc_numeric (content.get (), ret))
 	*ret = gnc_numeric_zero ();
-    g_free (content);
     return ret;
 }
 
@@ -561,14 +585,13 @@ dom_tree_to_time64 (xmlNodePtr node)
                 }
                 else
                 {
-                    gchar* content = dom_tree_to_text (n);
-                    if (!content)
+                    DomTreeText content {n};
+                    if (!content.get ())
                     {
                         return INT64_MAX;
                     }
 
-                    ret = gnc_iso8601_to_time64_gmt (content);
-                    g_free (content);
+                    ret = gnc_iso8601_to_time64_gmt (content.get ());
                     seen = TRUE;
                 }
             }
@@ -0,0 +1,547 @@
+/********************************************************************
+ * sixtp-sax-builder.cpp: Build engine objects from SAX events.     *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+extern "C"
+{
+#include <config.h>
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <gnc-engine.h>
+}
+
+#include "gnc-xml-helper.h"
+#include "sixtp-utils.h"
+#include "sixtp-dom-parsers.h"
+#include "sixtp-sax-builder.hpp"
+#include <kvp-frame.hpp>
+#include <utility>
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+const char*
+GncSaxBuilder::text ()
+{
+    return reinterpret_cast<const char*> (checked_char_cast (&m_text[0]));
+}
+
+/* The builder is handed down to every element below the object's own, so
+   the same handlers serve the whole sub-tree. */
+gboolean
+sixtp_sax_child_start_handler (gpointer parent_data,
+                               gpointer* data_for_children,
+                               const gchar* tag, gchar** attrs)
+{
+    auto builder = static_cast<GncSaxBuilder*> (parent_data);
+
+    builder->clear_text ();
+    builder->start_element (tag, attrs);
+    *data_for_children = builder;
+    return TRUE;
+}
+
+static gboolean
+sax_chars_handler (GSList* sibling_data, gpointer parent_data,
+                   gpointer global_data, gpointer* result,
+                   const char* text, int length)
+{
+    if (parent_data && length > 0)
+        static_cast<GncSaxBuilder*> (parent_data)->add_text (text, length);
+    return TRUE;
+}
+
+static gboolean
+sax_end_handler (gpointer data_for_children,
+                 GSList* data_from_children, GSList* sibling_data,
+                 gpointer parent_data, gpointer global_data,
+                 gpointer* result, const gchar* tag)
+{
+    auto builder = static_cast<GncSaxBuilder*> (data_for_children);
+
+    if (parent_data)
+    {
+        builder->end_element (tag);
+        builder->clear_text ();
+        return TRUE;
+    }
+
+    /* When this parser is the top level one it's called once more, with
+       a NULL tag, at the end of the document. */
+    if (!tag || !builder)
+        return TRUE;
+
+    *result = NULL;
+    auto ok = builder->finish (static_cast<gxpf_data*> (global_data), tag,
+                               result);
+    delete builder;
+    return ok;
+}
+
+static void
+sax_fail_handler (gpointer data_for_children,
+                  GSList* data_from_children,
+                  GSList* sibling_data,
+                  gpointer parent_data,
+                  gpointer global_data,
+                  gpointer* result,
+                  const gchar* tag)
+{
+    /* Only the frame of the object's own element has the builder in
+       *result. */
+    if (*result)
+        delete static_cast<GncSaxBuilder*> (*result);
+    *result = NULL;
+}
+
+sixtp*
+sixtp_sax_parser_new (sixtp_start_handler starter,
+                      sixtp_result_handler cleanup_result_by_default_func,
+                      sixtp_result_handler cleanup_result_on_fail_func)
+{
+    sixtp* top_level;
+
+    g_return_val_if_fail (starter, NULL);
+
+    if (! (top_level =
+               sixtp_set_any (sixtp_new (), FALSE,
+                              SIXTP_START_HANDLER_ID, starter,
+                              SIXTP_CHARACTERS_HANDLER_ID, sax_chars_handler,
+                              SIXTP_END_HANDLER_ID, sax_end_handler,
+                              SIXTP_FAIL_HANDLER_ID, sax_fail_handler,
+                              SIXTP_NO_MORE_HANDLERS)))
+    {
+        return NULL;
+    }
+
+    if (cleanup_result_by_default_func)
+        sixtp_set_cleanup_result (top_level, cleanup_result_by_default_func);
+
+    if (cleanup_result_on_fail_func)
+        sixtp_set_result_fail (top_level, cleanup_result_on_fail_func);
+
+    if (!sixtp_add_sub_parser (top_level, SIXTP_MAGIC_CATCHER, top_level))
+    {
+        sixtp_destroy (top_level);
+        return NULL;
+    }
+
+    return top_level;
+}
+
+/***********************************************************************/
+
+gboolean
+sax_attrs_guid_type (const gchar* tag, gchar** attrs)
+{
+    if (!attrs || !attrs[0])
+        return FALSE;
+
+    if (strcmp (attrs[0], "type") != 0)
+    {
+        PERR ("Unknown attribute for id tag: %s", attrs[0]);
+        return FALSE;
+    }
+
+    /* handle new and guid the same for the moment */
+    if (g_strcmp0 ("guid", attrs[1]) != 0 && g_strcmp0 ("new", attrs[1]) != 0)
+    {
+        PERR ("Unknown type %s for attribute type for tag %s",
+              attrs[1] ? attrs[1] : "(null)", tag ? tag : "(null)");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+GncGUID
+sax_text_to_guid (const char* text)
+{
+    GncGUID guid;
+
+    if (!sixtp_string_to_guid (text, &guid))
+        guid_replace (&guid);
+    return guid;
+}
+
+void
+GncSaxTime::set_date (const char* text)
+{
+    if (m_seen)
+    {
+        m_twice = true;
+        return;
+    }
+    m_time = gnc_iso8601_to_time64_gmt (text);
+    m_seen = true;
+}
+
+time64
+GncSaxTime::get (const gchar* tag) const
+{
+    if (!m_seen)
+        PERR ("no ts:date node found.");
+
+    auto time = raw ();
+    if (!dom_tree_valid_time64 (time, BAD_CAST tag))
+        time = 0;
+    return time;
+}
+
+void
+GncSaxCommodityRef::reset () noexcept
+{
+    m_space.clear ();
+    m_id.clear ();
+    m_has_space = m_has_id = false;
+    m_ok = true;
+}
+
+void
+GncSaxCommodityRef::set_space (const char* text)
+{
+    if (m_has_space)
+        m_ok = false;
+    m_space = text;
+    m_has_space = true;
+}
+
+void
+GncSaxCommodityRef::set_id (const char* text)
+{
+    if (m_has_id)
+        m_ok = false;
+    m_id = text;
+    m_has_id = true;
+}
+
+/* Unlike dom_tree_to_commodity_ref() this looks the commodity up directly
+   instead of creating and destroying a temporary one. */
+gnc_commodity*
+GncSaxCommodityRef::lookup (QofBook* book)
+{
+    gnc_commodity* ret = NULL;
+
+    auto table = gnc_commodity_table_get_table (book);
+    g_return_val_if_fail (table != NULL, NULL);
+
+    if (m_ok && m_has_space && m_has_id)
+    {
+        g_strstrip (&m_space[0]);
+        g_strstrip (&m_id[0]);
+        ret = gnc_commodity_table_lookup (table, m_space.c_str (),
+                                          m_id.c_str ());
+    }
+
+    g_return_val_if_fail (ret != NULL, NULL);
+    return ret;
+}
+
+/***********************************************************************/
+/* slots */
+
+static void
+kvp_value_delete (gpointer value)
+{
+    delete static_cast<KvpValue*> (value);
+}
+
+GncSaxSlotsReader::~GncSaxSlotsReader ()
+{
+    clear ();
+}
+
+void
+GncSaxSlotsReader::clear () noexcept
+{
+    /* The bottom node's frame belongs to the instance. */
+    for (size_t i = m_nodes.size (); i > 1; i--)
+    {
+        auto& node = m_nodes[i - 1];
+        delete node.value;
+        delete node.frame;
+        g_list_free_full (node.list, kvp_value_delete);
+    }
+    m_nodes.clear ();
+}
+
+void
+GncSaxSlotsReader::push (NodeKind kind, ValueType type)
+{
+    m_nodes.emplace_back ();
+    auto& node = m_nodes.back ();
+    node.kind = kind;
+    node.type = type;
+    node.frame = NULL;
+    node.list = NULL;
+    node.has_key = false;
+    node.value = NULL;
+    node.time.reset ();
+    g_date_clear (&node.date, 1);
+    node.date_ok = false;
+    node.date_seen = false;
+}
+
+void
+GncSaxSlotsReader::begin (KvpFrame* frame)
+{
+    clear ();
+    push (SLOTS_NODE_FRAME);
+    m_nodes.back ().frame = frame;
+}
+
+void
+GncSaxSlotsReader::push_value (gchar** attrs)
+{
+    /* Note: The type attribute must remain 'timespec' to maintain
+       compatibility. */
+    static const struct
+    {
+        const gchar* tag;
+        ValueType type;
+    } value_types[] =
+    {
+        { "integer", SLOTS_VALUE_INTEGER },
+        { "double", SLOTS_VALUE_DOUBLE },
+        { "numeric", SLOTS_VALUE_NUMERIC },
+        { "string", SLOTS_VALUE_STRING },
+        { "guid", SLOTS_VALUE_GUID },
+        { "timespec", SLOTS_VALUE_TIMESPEC },
+        { "gdate", SLOTS_VALUE_GDATE },
+        { "list", SLOTS_VALUE_LIST },
+        { "frame", SLOTS_VALUE_FRAME },
+    };
+    const gchar* type_name = NULL;
+    auto type = SLOTS_VALUE_UNKNOWN;
+
+    for (auto attr = attrs; attr && attr[0]; attr += 2)
+        if (strcmp (attr[0], "type") == 0)
+        {
+            type_name = attr[1];
+            break;
+        }
+    for (auto& vt : value_types)
+        if (g_strcmp0 (type_name, vt.tag) == 0)
+        {
+            type = vt.type;
+            break;
+        }
+
+    push (SLOTS_NODE_VALUE, type);
+    if (type == SLOTS_VALUE_FRAME)
+        m_nodes.back ().frame = new KvpFrame;
+}
+
+void
+GncSaxSlotsReader::start_element (const gchar* tag, gchar** attrs)
+{
+    auto& parent = m_nodes.back ();
+    auto kind = SLOTS_NODE_IGNORED;
+
+    switch (parent.kind)
+    {
+    case SLOTS_NODE_FRAME:
+        if (g_strcmp0 (tag, "slot") == 0)
+            kind = SLOTS_NODE_SLOT;
+        break;
+
+    case SLOTS_NODE_SLOT:
+        if (g_strcmp0 (tag, "slot:key") == 0)
+            kind = SLOTS_NODE_KEY;
+        else if (g_strcmp0 (tag, "slot:value") == 0)
+            kind = SLOTS_NODE_VALUE;
+        break;
+
+    case SLOTS_NODE_VALUE:
+        switch (parent.type)
+        {
+        case SLOTS_VALUE_FRAME:
+            if (g_strcmp0 (tag, "slot") == 0)
+                kind = SLOTS_NODE_SLOT;
+            break;
+        case SLOTS_VALUE_LIST:
+            /* Every element of a list is a value, whatever its name. */
+            kind = SLOTS_NODE_VALUE;
+            break;
+        case SLOTS_VALUE_TIMESPEC:
+            if (g_strcmp0 (tag, "ts:date") == 0)
+                kind = SLOTS_NODE_DATE;
+            break;
+        case SLOTS_VALUE_GDATE:
+            if (g_strcmp0 (tag, "gdate") == 0)
+                kind = SLOTS_NODE_DATE;
+            break;
+        default:
+            break;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (kind == SLOTS_NODE_VALUE)
+        push_value (attrs);
+    else
+        push (kind);
+}
+
+KvpValue*
+GncSaxSlotsReader::value_from_node (Node& node, const char* text)
+{
+    KvpValue* ret = NULL;
+
+    switch (node.type)
+    {
+    case SLOTS_VALUE_INTEGER:
+    {
+        gint64 i;
+        if (string_to_gint64 (text, &i))
+            ret = new KvpValue {i};
+        break;
+    }
+    case SLOTS_VALUE_DOUBLE:
+    {
+        double d;
+        if (string_to_double (text, &d))
+            ret = new KvpValue {d};
+        break;
+    }
+    case SLOTS_VALUE_NUMERIC:
+    {
+        gnc_numeric n;
+        if (!sixtp_string_to_gnc_numeric (text, &n))
+            n = gnc_numeric_zero ();
+        ret = new KvpValue {n};
+        break;
+    }
+    case SLOTS_VALUE_STRING:
+    {
+        const gchar* str = g_strdup (text);
+        ret = new KvpValue {str};
+        break;
+    }
+    case SLOTS_VALUE_GUID:
+    {
+        auto guid = sax_text_to_guid (text);
+        ret = new KvpValue {guid_copy (&guid)};
+        break;
+    }
+    case SLOTS_VALUE_TIMESPEC:
+        ret = new KvpValue {Time64 {node.time.raw ()}};
+        break;
+    case SLOTS_VALUE_GDATE:
+        if (!node.date_seen)
+            PWARN ("no gdate node found.");
+        else if (node.date_ok)
+            ret = new KvpValue {node.date};
+        break;
+    case SLOTS_VALUE_LIST:
+        ret = new KvpValue {g_list_reverse (node.list)};
+        node.list = NULL;
+        break;
+    case SLOTS_VALUE_FRAME:
+        ret = new KvpValue {node.frame};
+        node.frame = NULL;
+        break;
+    default:
+        /* FIXME: deal with unknown type tag here */
+        break;
+    }
+    return ret;
+}
+
+gboolean
+GncSaxSlotsReader::end_element (const char* text)
+{
+    if (m_nodes.size () == 1)
+    {
+        m_nodes.clear ();
+        return TRUE;
+    }
+
+    /* Pop the node by moving it out, the parent is then m_nodes.back(). */
+    auto node = std::move (m_nodes.back ());
+    m_nodes.pop_back ();
+    auto& parent = m_nodes.back ();
+
+    switch (node.kind)
+    {
+    case SLOTS_NODE_KEY:
+        parent.key = text;
+        parent.has_key = true;
+        break;
+
+    case SLOTS_NODE_DATE:
+        if (parent.type == SLOTS_VALUE_TIMESPEC)
+        {
+            parent.time.set_date (text);
+        }
+        else if (parent.date_seen)
+        {
+            parent.date_ok = false;
+        }
+        else
+        {
+            gint year, month, day;
+
+            parent.date_seen = true;
+            if (sscanf (text, "%d-%d-%d", &year, &month, &day) == 3)
+            {
+                g_date_set_dmy (&parent.date, day,
+                                static_cast<GDateMonth> (month), year);
+                parent.date_ok = g_date_valid (&parent.date);
+                if (!parent.date_ok)
+                    PWARN ("invalid date");
+            }
+        }
+        break;
+
+    case SLOTS_NODE_VALUE:
+    {
+        auto value = value_from_node (node, text);
+        if (!value)
+            break;
+        if (parent.kind == SLOTS_NODE_SLOT)
+        {
+            delete parent.value;
+            parent.value = value;
+        }
+        else
+        {
+            parent.list = g_list_prepend (parent.list, value);
+        }
+        break;
+    }
+
+    case SLOTS_NODE_SLOT:
+        if (node.has_key && node.value)
+        {
+            //We're deleting the old KvpValue returned by replace_nc().
+            delete parent.frame->set ({node.key}, node.value);
+            node.value = NULL;
+        }
+        delete node.value;
+        break;
+
+    default:
+        break;
+    }
+    return FALSE;
+}
@@ -0,0 +1,227 @@
+/********************************************************************
+ * sixtp-sax-builder.hpp: Build engine objects from SAX events.     *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+#ifndef __SIXTP_SAX_BUILDER_HPP__
+#define __SIXTP_SAX_BUILDER_HPP__
+
+extern "C"
+{
+#include <glib.h>
+#include "qof.h"
+#include "gnc-commodity.h"
+}
+
+#include <string>
+#include <vector>
+
+#include "sixtp.h"
+#include "io-gncxml-gen.h"
+
+/** Builds one engine object straight from the SAX events of its element,
+ * where sixtp_dom_parser_new() would first copy the whole sub-tree into a
+ * libxml2 tree and then walk that.
+ *
+ * The parser made by sixtp_sax_parser_new() creates the builder when the
+ * object's element opens, calls start_element() and end_element() for
+ * every element below it and finish() when it closes.  Character data is
+ * collected per element: in end_element() text() holds what was read since
+ * the last start or end tag, which for the leaf elements of the file format
+ * is the whole content.
+ */
+class GncSaxBuilder
+{
+public:
+    GncSaxBuilder() = default;
+    GncSaxBuilder(const GncSaxBuilder&) = delete;
+    GncSaxBuilder& operator=(const GncSaxBuilder&) = delete;
+    virtual ~GncSaxBuilder() = default;
+
+    virtual void start_element (const gchar* tag, gchar** attrs) = 0;
+    virtual void end_element (const gchar* tag) = 0;
+    /** The object's own element closed.  Hand the object on, either to
+     * gdata->cb or in *result as a child result, and return whether it
+     * could be built. */
+    virtual gboolean finish (gxpf_data* gdata, const gchar* tag,
+                             gpointer* result) = 0;
+
+    void add_text (const char* text, int length) { m_text.append (text, length); }
+    void clear_text () noexcept { m_text.clear (); }
+
+protected:
+    /** The character data, cleaned up by checked_char_cast() like the DOM
+     * parser does. */
+    const char* text ();
+    bool has_text () const noexcept { return !m_text.empty (); }
+
+private:
+    std::string m_text;
+};
+
+gboolean sixtp_sax_child_start_handler (gpointer parent_data,
+                                        gpointer* data_for_children,
+                                        const gchar* tag, gchar** attrs);
+
+sixtp* sixtp_sax_parser_new (sixtp_start_handler starter,
+                             sixtp_result_handler cleanup_result_by_default_func,
+                             sixtp_result_handler cleanup_result_on_fail_func);
+
+template <class Builder> gboolean
+sixtp_sax_start_handler (GSList* sibling_data, gpointer parent_data,
+                         gpointer global_data, gpointer* data_for_children,
+                         gpointer* result, const gchar* tag, gchar** attrs)
+{
+    if (parent_data)
+        return sixtp_sax_child_start_handler (parent_data, data_for_children,
+                                              tag, attrs);
+
+    auto gdata = static_cast<gxpf_data*> (global_data);
+    GncSaxBuilder* builder = new Builder (static_cast<QofBook*> (gdata->bookdata));
+    /* *result keeps the builder for the fail handler until finish(). */
+    *data_for_children = builder;
+    *result = builder;
+    return TRUE;
+}
+
+/** Create a parser that builds an object of type Builder from the element
+ * it is registered for.  Builder must derive from GncSaxBuilder and take
+ * the book in its constructor. */
+template <class Builder> sixtp*
+sixtp_sax_parser_new (sixtp_result_handler cleanup_result_by_default_func = nullptr,
+                      sixtp_result_handler cleanup_result_on_fail_func = nullptr)
+{
+    return sixtp_sax_parser_new (sixtp_sax_start_handler<Builder>,
+                                 cleanup_result_by_default_func,
+                                 cleanup_result_on_fail_func);
+}
+
+/** Check that an id element carries type="guid" (or "new") the way
+ * dom_tree_to_guid() requires. */
+gboolean sax_attrs_guid_type (const gchar* tag, gchar** attrs);
+/** Parse the text of an id element.  Like dom_tree_to_guid(), text that
+ * isn't a GUID gives a random one. */
+GncGUID sax_text_to_guid (const char* text);
+
+/** Collects the <ts:date> child of a date element, see dom_tree_to_time64(). */
+class GncSaxTime
+{
+public:
+    void reset () noexcept { m_time = INT64_MAX; m_seen = m_twice = false; }
+    void set_date (const char* text);
+    /** The time, INT64_MAX if there was no single valid date. */
+    time64 raw () const noexcept { return m_twice ? INT64_MAX : m_time; }
+    /** The time, or 0 after warning about a missing or bad date. */
+    time64 get (const gchar* tag) const;
+
+private:
+    time64 m_time = INT64_MAX;
+    bool m_seen = false;
+    bool m_twice = false;
+};
+
+/** Collects the <cmdty:space> and <cmdty:id> children of a commodity
+ * reference, see dom_tree_to_commodity_ref(). */
+class GncSaxCommodityRef
+{
+public:
+    void reset () noexcept;
+    void set_space (const char* text);
+    void set_id (const char* text);
+    /** The referenced commodity from the book's table, or NULL. */
+    gnc_commodity* lookup (QofBook* book);
+
+private:
+    std::string m_space;
+    std::string m_id;
+    bool m_has_space = false;
+    bool m_has_id = false;
+    bool m_ok = true;
+};
+
+/** Reads the <slot> elements below a slots element into a KvpFrame, with
+ * the same results as dom_tree_create_instance_slots(). */
+class GncSaxSlotsReader
+{
+public:
+    GncSaxSlotsReader() = default;
+    GncSaxSlotsReader(const GncSaxSlotsReader&) = delete;
+    GncSaxSlotsReader& operator=(const GncSaxSlotsReader&) = delete;
+    ~GncSaxSlotsReader();
+
+    /** The slots element opened; the slots go into frame. */
+    void begin (KvpFrame* frame);
+    bool active () const noexcept { return !m_nodes.empty (); }
+    void start_element (const gchar* tag, gchar** attrs);
+    /** Returns TRUE when this closed the slots element itself. */
+    gboolean end_element (const char* text);
+
+private:
+    enum NodeKind
+    {
+        SLOTS_NODE_IGNORED,
+        SLOTS_NODE_FRAME,
+        SLOTS_NODE_SLOT,
+        SLOTS_NODE_KEY,
+        SLOTS_NODE_VALUE,
+        SLOTS_NODE_DATE,
+    };
+
+    enum ValueType
+    {
+        SLOTS_VALUE_UNKNOWN,
+        SLOTS_VALUE_INTEGER,
+        SLOTS_VALUE_DOUBLE,
+        SLOTS_VALUE_NUMERIC,
+        SLOTS_VALUE_STRING,
+        SLOTS_VALUE_GUID,
+        SLOTS_VALUE_TIMESPEC,
+        SLOTS_VALUE_GDATE,
+        SLOTS_VALUE_LIST,
+        SLOTS_VALUE_FRAME,
+    };
+
+    struct Node
+    {
+        NodeKind kind;
+        ValueType type;
+        /* The frame of a slots element or of a "frame" value. */
+        KvpFrame* frame;
+        /* The items of a "list" value, last one first. */
+        GList* list;
+        /* The key and value of a <slot>. */
+        std::string key;
+        bool has_key;
+        KvpValue* value;
+        /* The date of a "timespec" or "gdate" value. */
+        GncSaxTime time;
+        GDate date;
+        bool date_ok;
+        bool date_seen;
+    };
+
+    void push (NodeKind kind, ValueType type = SLOTS_VALUE_UNKNOWN);
+    void push_value (gchar** attrs);
+    KvpValue* value_from_node (Node& node, const char* text);
+    void clear () noexcept;
+
+    std::vector<Node> m_nodes;
+};
+
+#endif /* __SIXTP_SAX_BUILDER_HPP__ */
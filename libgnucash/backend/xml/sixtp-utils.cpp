@@ -162,6 +162,50 @@ string_to_double (const char* str, double* result)
 /*********/
 /* gint64
  */
+
+/* Parse the decimal integer at *cursor, with an optional '-', and move
+   *cursor past it.  FALSE if there are no digits or the value doesn't fit
+   a gint64. */
+static gboolean
+parse_decimal (const gchar** cursor, gint64* v)
+{
+    const gchar* pos = *cursor;
+    gboolean negative = (*pos == '-');
+    guint64 value = 0;
+
+    if (negative)
+        pos++;
+    const gchar* digits = pos;
+    while (*pos >= '0' && *pos <= '9')
+    {
+        guint digit = *pos - '0';
+        if (value > (G_MAXUINT64 - digit) / 10)
+            return FALSE;
+        value = value * 10 + digit;
+        pos++;
+    }
+    if (pos == digits ||
+        value > (guint64) G_MAXINT64 + (negative ? 1 : 0))
+        return FALSE;
+
+    if (!negative)
+        *v = value;
+    else if (value > (guint64) G_MAXINT64)
+        *v = G_MININT64;
+    else
+        *v = - (gint64) value;
+    *cursor = pos;
+    return TRUE;
+}
+
+static const gchar*
+skip_space (const gchar* str)
+{
+    while (isspace (* (unsigned char*)str))
+        str++;
+    return str;
+}
+
 /* Maybe there should be a comment here explaining why this function
    doesn't call g_ascii_strtoull, because it's not so obvious. -CAS */
 gboolean
@@ -173,6 +217,19 @@ string_to_gint64 (const gchar* str, gint64* v)
 
     g_return_val_if_fail (str, FALSE);
 
+    /* Plain decimals, all the file format writes, are parsed by hand;
+       sscanf is left with the overflowing values it saturates. */
+    const gchar* cursor = skip_space (str);
+    gint64 value;
+    if (*cursor == '+' && cursor[1] != '-')
+        cursor++;
+    if (parse_decimal (&cursor, &value))
+    {
+        if (v)
+            *v = value;
+        return *skip_space (cursor) == '\0';
+    }
+
     /* must use "<" here because %n's effects aren't well defined */
     if (sscanf (str, " " QOF_SCANF_LLD "%n", &v_in, &num_read) < 1)
     {
@@ -222,6 +279,68 @@ string_to_gint32 (const gchar* str, gint32* v)
     return (TRUE);
 }
 
+/*************/
+/* gnc_numeric
+ */
+
+gboolean
+sixtp_string_to_gnc_numeric (const gchar* str, gnc_numeric* n)
+{
+    g_return_val_if_fail (str, FALSE);
+
+    /* The num/denom the file format writes is parsed where it is; the
+       engine's parser, which copies the string for its regexes, gets
+       everything else. */
+    const gchar* cursor = skip_space (str);
+    gint64 num, denom;
+    if (parse_decimal (&cursor, &num))
+    {
+        while (*cursor == ' ' || *cursor == '\t')
+            cursor++;
+        if (*cursor++ == '/')
+        {
+            while (*cursor == ' ' || *cursor == '\t')
+                cursor++;
+            if (*cursor != '-' && parse_decimal (&cursor, &denom) &&
+                denom > 0 && *skip_space (cursor) == '\0')
+            {
+                *n = gnc_numeric_create (num, denom);
+                return TRUE;
+            }
+        }
+    }
+    return string_to_gnc_numeric (str, n);
+}
+
+/******/
+/* guid
+ */
+
+gboolean
+sixtp_string_to_guid (const gchar* str, GncGUID* guid)
+{
+    g_return_val_if_fail (str, FALSE);
+
+    /* The 32 hex digits the file format writes are parsed where they are,
+       the other forms string_to_guid() accepts by it. */
+    GncGUID parsed;
+    int i;
+    for (i = 0; i < GUID_DATA_SIZE; i++)
+    {
+        int high = g_ascii_xdigit_value (str[2 * i]);
+        int low = high < 0 ? -1 : g_ascii_xdigit_value (str[2 * i + 1]);
+        if (low < 0)
+            break;
+        parsed.reserved[i] = (high << 4) | low;
+    }
+    if (i == GUID_DATA_SIZE && str[2 * GUID_DATA_SIZE] == '\0')
+    {
+        *guid = parsed;
+        return TRUE;
+    }
+    return string_to_guid (str, guid);
+}
+
 /************/
 /* hex string
  */
@@ -548,7 +667,7 @@ generic_guid_end_handler (gpointer data_for_children,
         return (FALSE);
     }
 
-    ok = string_to_guid (txt, gid);
+    ok = sixtp_string_to_guid (txt, gid);
     g_free (txt);
 
     if (!ok)
@@ -614,7 +733,7 @@ generic_gnc_numeric_end_handler (gpointer data_for_children,
         num = g_new (gnc_numeric, 1);
         if (num)
         {
-            if (string_to_gnc_numeric (txt, num))
+            if (sixtp_string_to_gnc_numeric (txt, num))
             {
                 ok = TRUE;
                 *result = num;
@@ -68,6 +68,12 @@ gboolean string_to_gint64 (const gchar* str, gint64* v);
 
 gboolean string_to_gint32 (const gchar* str, gint32* v);
 
+/** Like string_to_gnc_numeric() and string_to_guid(), without allocating
+ * for the forms the file format writes. */
+gboolean sixtp_string_to_gnc_numeric (const gchar* str, gnc_numeric* n);
+
+gboolean sixtp_string_to_guid (const gchar* str, GncGUID* guid);
+
 gboolean hex_string_to_binary (const gchar* str,  void** v, guint64* data_len);
 
 gboolean generic_return_chars_end_handler (gpointer data_for_children,
@@ -41,6 +41,8 @@ extern "C"
 #include "sixtp-parsers.h"
 #include "sixtp-stack.h"
 
+#include <vector>
+
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "gnc.backend.file.sixtp"
 
@@ -383,12 +385,10 @@ sixtp_add_some_sub_parsers (sixtp* tochange, int cleanup, ...)
 
 /************************************************************************/
 
-void
-sixtp_sax_start_handler (void* user_data,
-                         const xmlChar* name,
-                         const xmlChar** attrs)
+static void
+sixtp_sax_start_frame (sixtp_sax_data* pdata, const xmlChar* name,
+                       const xmlChar** attrs, int line, int col)
 {
-    sixtp_sax_data* pdata = (sixtp_sax_data*) user_data;
     sixtp_stack_frame* current_frame = NULL;
     sixtp* current_parser = NULL;
     sixtp* next_parser = NULL;
@@ -452,8 +452,8 @@ sixtp_sax_start_handler (void* user_data,
     /* now allocate the new stack frame and shift to it */
     new_frame = sixtp_stack_frame_new (next_parser, g_strdup ((char*) name));
 
-    new_frame->line = xmlSAX2GetLineNumber (pdata->saxParserCtxt);
-    new_frame->col  = xmlSAX2GetColumnNumber (pdata->saxParserCtxt);
+    new_frame->line = line;
+    new_frame->col  = col;
 
     pdata->stack = g_slist_prepend (pdata->stack, (gpointer) new_frame);
 
@@ -470,6 +470,18 @@ sixtp_sax_start_handler (void* user_data,
     }
 }
 
+void
+sixtp_sax_start_handler (void* user_data,
+                         const xmlChar* name,
+                         const xmlChar** attrs)
+{
+    sixtp_sax_data* pdata = (sixtp_sax_data*) user_data;
+
+    sixtp_sax_start_frame (pdata, name, attrs,
+                           xmlSAX2GetLineNumber (pdata->saxParserCtxt),
+                           xmlSAX2GetColumnNumber (pdata->saxParserCtxt));
+}
+
 void
 sixtp_sax_characters_handler (void* user_data, const xmlChar* text, int len)
 {
@@ -796,6 +808,306 @@ sixtp_parse_fd (sixtp* sixtp,
     return ret;
 }
 
+/* A pipelined parse runs libxml2 on a parser thread, which records the SAX
+ * events into batches.  Full batches go to the calling thread through one
+ * queue and come back for reuse through another, so at most
+ * SIXTP_PIPELINE_BATCHES of them exist and the parser can't run far ahead
+ * of the handlers. */
+#define SIXTP_PIPELINE_BATCH_SIZE (256 * 1024)
+#define SIXTP_PIPELINE_BATCHES 8
+
+typedef enum
+{
+    SIXTP_EVENT_START,
+    SIXTP_EVENT_CHARS,
+    SIXTP_EVENT_END,
+} sixtp_event_type;
+
+typedef struct
+{
+    sixtp_event_type type;
+    /* Offset of the tag or text in the batch's bytes. */
+    gsize text;
+    /* Length of the text, or the number of attribute names and values. */
+    int len;
+    /* Index of the first attribute in the batch's attrs. */
+    gsize attrs;
+    int line;
+    int col;
+} sixtp_event;
+
+struct sixtp_event_batch
+{
+    std::vector<sixtp_event> events;
+    std::vector<char> bytes;
+    std::vector<gsize> attrs;
+    gboolean last;
+    int parse_ret;
+};
+
+typedef struct
+{
+    xmlSAXHandler handler;
+    xmlParserCtxtPtr ctxt;
+    FILE* fd;
+    GAsyncQueue* full;
+    GAsyncQueue* empty;
+    sixtp_event_batch* batch;
+    gint64 parse_wait;
+    gint64 parse;
+} sixtp_pipeline;
+
+static gsize
+sixtp_pipeline_add_text (sixtp_event_batch* batch, const char* text, int len)
+{
+    gsize offset = batch->bytes.size ();
+
+    batch->bytes.insert (batch->bytes.end (), text, text + len);
+    batch->bytes.push_back ('\0');
+    return offset;
+}
+
+static void
+sixtp_pipeline_add_event (sixtp_pipeline* pipeline, sixtp_event& event)
+{
+    gint64 start;
+
+    pipeline->batch->events.push_back (event);
+    if (pipeline->batch->bytes.size () < SIXTP_PIPELINE_BATCH_SIZE)
+        return;
+
+    g_async_queue_push (pipeline->full, pipeline->batch);
+    start = g_get_monotonic_time ();
+    pipeline->batch = static_cast<sixtp_event_batch*>
+                      (g_async_queue_pop (pipeline->empty));
+    pipeline->parse_wait += g_get_monotonic_time () - start;
+}
+
+static void
+sixtp_pipeline_start_handler (void* user_data, const xmlChar* name,
+                              const xmlChar** attrs)
+{
+    sixtp_pipeline* pipeline = (sixtp_pipeline*) user_data;
+    sixtp_event_batch* batch = pipeline->batch;
+    sixtp_event event;
+
+    event.type = SIXTP_EVENT_START;
+    event.text = sixtp_pipeline_add_text (batch, (const char*) name,
+                                          strlen ((const char*) name));
+    event.len = 0;
+    event.attrs = batch->attrs.size ();
+    for (; attrs && attrs[event.len]; event.len++)
+    {
+        const char* attr = (const char*) attrs[event.len];
+        batch->attrs.push_back (sixtp_pipeline_add_text (batch, attr,
+                                                         strlen (attr)));
+    }
+    event.line = xmlSAX2GetLineNumber (pipeline->ctxt);
+    event.col = xmlSAX2GetColumnNumber (pipeline->ctxt);
+    sixtp_pipeline_add_event (pipeline, event);
+}
+
+static void
+sixtp_pipeline_characters_handler (void* user_data, const xmlChar* text,
+                                   int len)
+{
+    sixtp_pipeline* pipeline = (sixtp_pipeline*) user_data;
+    sixtp_event event;
+
+    event.type = SIXTP_EVENT_CHARS;
+    event.text = sixtp_pipeline_add_text (pipeline->batch, (const char*) text,
+                                          len);
+    event.len = len;
+    event.attrs = 0;
+    event.line = event.col = 0;
+    sixtp_pipeline_add_event (pipeline, event);
+}
+
+static void
+sixtp_pipeline_end_handler (void* user_data, const xmlChar* name)
+{
+    sixtp_pipeline* pipeline = (sixtp_pipeline*) user_data;
+    sixtp_event event;
+
+    event.type = SIXTP_EVENT_END;
+    event.text = sixtp_pipeline_add_text (pipeline->batch, (const char*) name,
+                                          strlen ((const char*) name));
+    event.len = 0;
+    event.attrs = 0;
+    event.line = event.col = 0;
+    sixtp_pipeline_add_event (pipeline, event);
+}
+
+/* Waiting for the (de)compression thread counts as waiting, not parsing. */
+static int
+sixtp_pipeline_read (void* context, char* buffer, int len)
+{
+    sixtp_pipeline* pipeline = (sixtp_pipeline*) context;
+    gint64 start = g_get_monotonic_time ();
+    int ret;
+
+    ret = sixtp_parser_read (pipeline->fd, buffer, len);
+    pipeline->parse_wait += g_get_monotonic_time () - start;
+    return ret;
+}
+
+static gpointer
+sixtp_pipeline_thread_func (gpointer data)
+{
+    sixtp_pipeline* pipeline = (sixtp_pipeline*) data;
+    gint64 start = g_get_monotonic_time ();
+    int parse_ret;
+
+    pipeline->batch = static_cast<sixtp_event_batch*>
+                      (g_async_queue_pop (pipeline->empty));
+    parse_ret = xmlParseDocument (pipeline->ctxt);
+
+    pipeline->batch->last = TRUE;
+    pipeline->batch->parse_ret = parse_ret;
+    pipeline->parse = g_get_monotonic_time () - start - pipeline->parse_wait;
+    g_async_queue_push (pipeline->full, pipeline->batch);
+    return NULL;
+}
+
+static void
+sixtp_pipeline_replay (sixtp_sax_data* pdata, sixtp_event_batch* batch,
+                       std::vector<const xmlChar*>& attrs)
+{
+    for (auto& event : batch->events)
+    {
+        const xmlChar* text = (const xmlChar*) &batch->bytes[event.text];
+
+        switch (event.type)
+        {
+        case SIXTP_EVENT_START:
+            attrs.clear ();
+            for (int i = 0; i < event.len; i++)
+                attrs.push_back ((const xmlChar*)
+                                 &batch->bytes[batch->attrs[event.attrs + i]]);
+            attrs.push_back (NULL);
+            sixtp_sax_start_frame (pdata, text,
+                                   event.len ? attrs.data () : NULL,
+                                   event.line, event.col);
+            break;
+        case SIXTP_EVENT_CHARS:
+            sixtp_sax_characters_handler (pdata, text, event.len);
+            break;
+        case SIXTP_EVENT_END:
+            sixtp_sax_end_handler (pdata, text);
+            break;
+        }
+    }
+}
+
+gboolean
+sixtp_parse_fd_pipelined (sixtp* sixtp,
+                          FILE* fd,
+                          gpointer data_for_top_level,
+                          gpointer global_data,
+                          gpointer* parse_result,
+                          sixtp_parse_timing* timing)
+{
+    sixtp_parser_context* ctxt;
+    sixtp_pipeline pipeline;
+    sixtp_event_batch* batch;
+    std::vector<const xmlChar*> attrs;
+    GThread* thread;
+    gint64 build = 0, build_wait = 0, start;
+    gboolean last = FALSE;
+    int parse_ret = -1;
+
+    if (! (ctxt = sixtp_context_new (sixtp, global_data, data_for_top_level)))
+    {
+        g_critical ("sixtp_context_new returned null");
+        return FALSE;
+    }
+    ctxt->data.bad_xml_parser = sixtp_dom_parser_new (gnc_bad_xml_end_handler,
+                                                      NULL, NULL);
+
+    memset (&pipeline, 0, sizeof (pipeline));
+    pipeline.handler.startElement = sixtp_pipeline_start_handler;
+    pipeline.handler.endElement = sixtp_pipeline_end_handler;
+    pipeline.handler.characters = sixtp_pipeline_characters_handler;
+    pipeline.handler.getEntity = sixtp_sax_get_entity_handler;
+    pipeline.fd = fd;
+    pipeline.full = g_async_queue_new ();
+    pipeline.empty = g_async_queue_new ();
+    for (int i = 0; i < SIXTP_PIPELINE_BATCHES; i++)
+        g_async_queue_push (pipeline.empty, new sixtp_event_batch ());
+
+    xmlInitParser ();
+    pipeline.ctxt = xmlCreateIOParserCtxt (&pipeline.handler, &pipeline,
+                                           sixtp_pipeline_read,
+                                           NULL /*no close */, &pipeline,
+                                           XML_CHAR_ENCODING_NONE);
+    thread = NULL;
+    if (pipeline.ctxt)
+        thread = g_thread_new ("xml_parse_thread", sixtp_pipeline_thread_func,
+                               &pipeline);
+    if (!thread)
+    {
+        g_warning ("Could not start the XML parser thread.");
+        ctxt->data.parsing_ok = FALSE;
+        last = TRUE;
+    }
+
+    while (!last)
+    {
+        start = g_get_monotonic_time ();
+        batch = static_cast<sixtp_event_batch*>
+                (g_async_queue_pop (pipeline.full));
+        build_wait += g_get_monotonic_time () - start;
+
+        start = g_get_monotonic_time ();
+        sixtp_pipeline_replay (&ctxt->data, batch, attrs);
+        build += g_get_monotonic_time () - start;
+
+        last = batch->last;
+        parse_ret = batch->parse_ret;
+        batch->events.clear ();
+        batch->bytes.clear ();
+        batch->attrs.clear ();
+        g_async_queue_push (pipeline.empty, batch);
+    }
+    if (thread)
+        g_thread_join (thread);
+
+    while ((batch = static_cast<sixtp_event_batch*>
+                    (g_async_queue_try_pop (pipeline.empty))))
+        delete batch;
+    g_async_queue_unref (pipeline.full);
+    g_async_queue_unref (pipeline.empty);
+    if (pipeline.ctxt)
+        xmlFreeParserCtxt (pipeline.ctxt);
+
+    if (timing)
+    {
+        timing->parse += pipeline.parse;
+        timing->parse_wait += pipeline.parse_wait;
+        timing->build += build;
+        timing->build_wait += build_wait;
+    }
+
+    sixtp_context_run_end_handler (ctxt);
+
+    if (parse_ret == 0 && ctxt->data.parsing_ok)
+    {
+        if (parse_result)
+            *parse_result = ctxt->top_frame->frame_data;
+        sixtp_context_destroy (ctxt);
+        return TRUE;
+    }
+    else
+    {
+        if (parse_result)
+            *parse_result = NULL;
+        if (g_slist_length (ctxt->data.stack) > 1)
+            sixtp_handle_catastrophe (&ctxt->data);
+        sixtp_context_destroy (ctxt);
+        return FALSE;
+    }
+}
+
 gboolean
 sixtp_parse_buffer (sixtp* sixtp,
                     char* bufp,
@@ -61,10 +61,23 @@ typedef struct
     int budgets_loaded;
 } load_counter;
 
+/** Microseconds spent in each stage of a pipelined load, see
+ * sixtp_parse_fd_pipelined(). */
+typedef struct
+{
+    gint64 inflate;     /* decompressing, on the gzip thread */
+    gint64 parse;       /* tokenizing, on the parser thread */
+    gint64 parse_wait;  /* parser thread waiting for input or a free batch */
+    gint64 build;       /* running the handlers, on the calling thread */
+    gint64 build_wait;  /* calling thread waiting for parsed events */
+    gint64 total;
+} sixtp_parse_timing;
+
 struct sixtp_gdv2
 {
     QofBook* book;
     load_counter counter;
+    sixtp_parse_timing timing;
     countCallbackFn countCallback;
     QofBePercentageFunc gui_display_fn;
     gboolean exporting;
@@ -224,6 +237,14 @@ gboolean sixtp_parse_file (sixtp* sixtp, const char* filename,
 gboolean sixtp_parse_fd (sixtp* sixtp, FILE* fd,
                          gpointer data_for_top_level, gpointer global_data,
                          gpointer* parse_result);
+/** Like sixtp_parse_fd(), but libxml2 tokenizes the input on a thread of its
+ * own and hands the events in batches to the calling thread, which runs the
+ * handlers.  The stage times are added to *timing if it isn't NULL. */
+gboolean sixtp_parse_fd_pipelined (sixtp* sixtp, FILE* fd,
+                                   gpointer data_for_top_level,
+                                   gpointer global_data,
+                                   gpointer* parse_result,
+                                   sixtp_parse_timing* timing);
 gboolean sixtp_parse_buffer (sixtp* sixtp, char* bufp, int bufsz,
                              gpointer data_for_top_level, gpointer global_data,
                              gpointer* parse_result);
@@ -0,0 +1,214 @@
+/********************************************************************\
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+/* Check that the parallel compressor writes files gzread() gives back
+ * unchanged.  Given an uncompressed data file as argument, it also times
+ * a serial gzwrite() against the parallel compressor on it. */
+extern "C"
+{
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+}
+
+#include "io-gzip.h"
+#include "test-stuff.h"
+
+#include <string>
+
+static std::string
+make_input (size_t size)
+{
+    static const char* words[] =
+    {
+        "<trn:split>", "<split:value>1234/100</split:value>", "Groceries",
+        "\n  ", "<ts:date>2017-03-01 10:59:00 +0000</ts:date>", "</trn:split>"
+    };
+    std::string data;
+    guint32 seed = 42;
+
+    /* Repetitive like a data file, with some noise so that blocks differ. */
+    while (data.size () < size)
+    {
+        seed = seed * 1103515245 + 12345;
+        data += words[(seed >> 16) % G_N_ELEMENTS (words)];
+        if ((seed >> 8) % 7 == 0)
+            data += static_cast<char> (seed >> 24);
+    }
+    data.resize (size);
+    return data;
+}
+
+static gboolean
+write_file (const gchar* name, const std::string& data)
+{
+    return g_file_set_contents (name, data.data (), data.size (), NULL);
+}
+
+static gboolean
+compress_file (const gchar* in_name, const gchar* out_name, guint threads)
+{
+    int fd = g_open (in_name, O_RDONLY, 0);
+    FILE* out = g_fopen (out_name, "wb");
+    gboolean ok = fd >= 0 && out != NULL &&
+                  gnc_gzip_fd_to_file (fd, out, threads, Z_DEFAULT_COMPRESSION);
+
+    if (fd >= 0)
+        close (fd);
+    if (out && fclose (out) != 0)
+        ok = FALSE;
+    return ok;
+}
+
+static gboolean
+serial_compress_file (const gchar* in_name, const gchar* out_name)
+{
+    gchar* contents;
+    gsize length;
+    gzFile file;
+    gboolean ok;
+
+    if (!g_file_get_contents (in_name, &contents, &length, NULL))
+        return FALSE;
+    file = gzopen (out_name, "wb");
+    ok = file != NULL &&
+         (length == 0 || gzwrite (file, contents, length) == (int) length);
+    if (file && gzclose (file) != Z_OK)
+        ok = FALSE;
+    g_free (contents);
+    return ok;
+}
+
+static std::string
+read_gzip (const gchar* name, gboolean* ok)
+{
+    gzFile file = gzopen (name, "rb");
+    std::string data;
+    char buffer[8192];
+    int bytes;
+
+    *ok = file != NULL;
+    if (!file)
+        return data;
+    while ((bytes = gzread (file, buffer, sizeof (buffer))) > 0)
+        data.append (buffer, bytes);
+    if (bytes < 0 || gzclose (file) != Z_OK)
+        *ok = FALSE;
+    return data;
+}
+
+static void
+test_round_trip (const gchar* dir, size_t size, guint threads)
+{
+    gchar* in_name = g_build_filename (dir, "in.xml", NULL);
+    gchar* out_name = g_build_filename (dir, "out.xml.gz", NULL);
+    std::string data = make_input (size);
+    gboolean ok = FALSE;
+
+    if (!write_file (in_name, data) ||
+        !compress_file (in_name, out_name, threads))
+    {
+        failure_args ("gzip compress", __FILE__, __LINE__,
+                      "%" G_GSIZE_FORMAT " bytes on %u threads", size, threads);
+    }
+    else
+    {
+        std::string back = read_gzip (out_name, &ok);
+        do_test_args (ok && back == data, "gzip round trip", __FILE__, __LINE__,
+                      "%" G_GSIZE_FORMAT " bytes on %u threads", size, threads);
+    }
+    g_unlink (in_name);
+    g_unlink (out_name);
+    g_free (in_name);
+    g_free (out_name);
+}
+
+static void
+test_gzip (void)
+{
+    gchar* dir = g_dir_make_tmp ("test-io-gzip-XXXXXX", NULL);
+    static const size_t sizes[] =
+    {
+        0, 1, 32 * 1024, 128 * 1024 - 1, 128 * 1024, 128 * 1024 + 1,
+        1000 * 1000 + 17
+    };
+    static const guint threads[] = { 0, 1, 2, 3, 8 };
+
+    if (!dir)
+    {
+        failure ("gzip temporary directory");
+        return;
+    }
+    for (auto size : sizes)
+        for (auto n : threads)
+            test_round_trip (dir, size, n);
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+static void
+time_file (const gchar* name)
+{
+    gchar* out_name = g_strconcat (name, ".test-io-gzip.gz", NULL);
+    struct stat info;
+    gint64 start, serial, parallel;
+    long serial_size = 0;
+
+    if (g_stat (name, &info) != 0)
+    {
+        failure_args ("gzip timing", __FILE__, __LINE__, "can't read %s", name);
+        g_free (out_name);
+        return;
+    }
+
+    start = g_get_monotonic_time ();
+    do_test (serial_compress_file (name, out_name), "serial gzwrite");
+    serial = g_get_monotonic_time () - start;
+    if (g_stat (out_name, &info) == 0)
+        serial_size = info.st_size;
+
+    start = g_get_monotonic_time ();
+    do_test (compress_file (name, out_name, 0), "parallel gzip");
+    parallel = g_get_monotonic_time () - start;
+
+    printf ("%s: serial gzwrite %.3f s, %ld bytes; "
+            "parallel on %u threads %.3f s, %ld bytes\n",
+            name, serial / 1e6, serial_size, g_get_num_processors (),
+            parallel / 1e6,
+            g_stat (out_name, &info) == 0 ? (long) info.st_size : 0L);
+    g_unlink (out_name);
+    g_free (out_name);
+}
+
+int
+main (int argc, char** argv)
+{
+    test_gzip ();
+    if (argc > 1)
+        time_file (argv[1]);
+    print_test_results ();
+    exit (get_rv ());
+}
@@ -0,0 +1,339 @@
+/********************************************************************
+ * test-sixtp-converters.cpp: Check and time the scalar converters  *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+/* Checks that the converters the loaders use parse what the engine's
+ * converters parse.  Given a directory of data files as argument, it also
+ * runs both over the splits of the files in it and prints the time per
+ * split: before, with the copy dom_tree_to_text() made and the engine's
+ * converters, and after, parsing the text where it is.  Built with
+ * COUNT_ALLOCATIONS defined on glibc, it prints the allocations per split
+ * too and checks that there are none after. */
+
+extern "C"
+{
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "gnc-engine.h"
+}
+
+#include "sixtp-utils.h"
+#include "test-stuff.h"
+
+#include <string>
+#include <vector>
+
+#if defined(__GLIBC__) && defined(COUNT_ALLOCATIONS)
+/* Count the allocations by standing in for glibc's malloc. */
+extern "C"
+{
+    void* __libc_malloc (size_t size);
+    void* __libc_calloc (size_t nmemb, size_t size);
+    void* __libc_realloc (void* ptr, size_t size);
+    void __libc_free (void* ptr);
+}
+
+static gsize n_allocations = 0;
+
+extern "C" void*
+malloc (size_t size)
+{
+    n_allocations++;
+    return __libc_malloc (size);
+}
+
+extern "C" void*
+calloc (size_t nmemb, size_t size)
+{
+    n_allocations++;
+    return __libc_calloc (nmemb, size);
+}
+
+extern "C" void*
+realloc (void* ptr, size_t size)
+{
+    n_allocations++;
+    return __libc_realloc (ptr, size);
+}
+
+extern "C" void
+free (void* ptr)
+{
+    __libc_free (ptr);
+}
+#define COUNTS_ALLOCATIONS TRUE
+#else
+static gsize n_allocations = 0;
+#define COUNTS_ALLOCATIONS FALSE
+#endif
+
+#define BENCH_ROUNDS 50
+
+static const char* numeric_strings[] =
+{
+    "234500/100", "-5/1", " 7 / 3 ", "7\t/\t3\n", "0/1", "12", "-12",
+    "1.25", "-0.5", "0x10/0x2", "0x10/2", "16/0x2", "5/0", "abc", "",
+    "9223372036854775807/1", "9223372036854775808/1",
+    "-9223372036854775808/1", "3/-1", "+3/1", "3/1x", "- 3/1",
+    NULL
+};
+
+static const char* guid_strings[] =
+{
+    "be0a8539128014e1f0d247eb54e8b07a", "BE0A8539128014E1F0D247EB54E8B07A",
+    "be0a8539-1280-14e1-f0d2-47eb54e8b07a",
+    "{be0a8539-1280-14e1-f0d2-47eb54e8b07a}",
+    "be0a8539128014e1f0d247eb54e8b07", "be0a8539128014e1f0d247eb54e8b07a0",
+    "be0a8539128014e1f0d247eb54e8b07z", " be0a8539128014e1f0d247eb54e8b07a",
+    "", NULL
+};
+
+static gboolean
+same_numeric (const char* str)
+{
+    gnc_numeric fast = gnc_numeric_zero (), slow = gnc_numeric_zero ();
+    gboolean fast_ok = sixtp_string_to_gnc_numeric (str, &fast);
+    gboolean slow_ok = string_to_gnc_numeric (str, &slow);
+
+    return fast_ok == slow_ok && (!fast_ok || (fast.num == slow.num &&
+                                               fast.denom == slow.denom));
+}
+
+static gboolean
+same_guid (const char* str)
+{
+    GncGUID fast, slow;
+    memset (&fast, 0, sizeof (fast));
+    memset (&slow, 0, sizeof (slow));
+    gboolean fast_ok = sixtp_string_to_guid (str, &fast);
+    gboolean slow_ok = string_to_guid (str, &slow);
+
+    return fast_ok == slow_ok && (!fast_ok || guid_equal (&fast, &slow));
+}
+
+static void
+test_same_results (void)
+{
+    for (int i = 0; numeric_strings[i]; i++)
+        do_test_args (same_numeric (numeric_strings[i]), "numeric",
+                      __FILE__, __LINE__, "with string '%s'",
+                      numeric_strings[i]);
+    for (int i = 0; guid_strings[i]; i++)
+        do_test_args (same_guid (guid_strings[i]), "guid",
+                      __FILE__, __LINE__, "with string '%s'", guid_strings[i]);
+}
+
+static void
+test_gint64 (void)
+{
+    static const struct
+    {
+        const char* str;
+        gboolean ok;
+        gint64 value;
+    } cases[] =
+    {
+        { "0", TRUE, 0 },
+        { " -12 \n", TRUE, -12 },
+        { "+5", TRUE, 5 },
+        { "+-5", FALSE, 0 },
+        { "9223372036854775807", TRUE, G_MAXINT64 },
+        { "-9223372036854775808", TRUE, G_MININT64 },
+        { "12a", FALSE, 12 },
+        { "", FALSE, 0 },
+        { " ", FALSE, 0 },
+    };
+
+    for (auto& c : cases)
+    {
+        gint64 value = 0;
+        gboolean ok = string_to_gint64 (c.str, &value);
+        do_test_args (ok == c.ok && (!ok || value == c.value), "gint64",
+                      __FILE__, __LINE__, "with string '%s'", c.str);
+    }
+}
+
+/* The text of every element opened by open_tag. */
+static void
+collect_texts (const char* contents, const char* open_tag,
+               std::vector<std::string>& texts)
+{
+    auto len = strlen (open_tag);
+
+    for (auto pos = strstr (contents, open_tag); pos;
+         pos = strstr (pos, open_tag))
+    {
+        pos += len;
+        auto end = strchr (pos, '<');
+        if (!end)
+            break;
+        texts.emplace_back (pos, end - pos);
+    }
+}
+
+static size_t
+count_splits (const char* contents)
+{
+    size_t n = 0;
+    for (auto pos = strstr (contents, "<trn:split>"); pos;
+         pos = strstr (pos + 1, "<trn:split>"))
+        n++;
+    return n;
+}
+
+struct BenchResult
+{
+    gsize allocations;
+    gint64 usec;
+};
+
+static BenchResult
+convert_copying (const std::vector<std::string>& numerics,
+                 const std::vector<std::string>& guids)
+{
+    gnc_numeric num;
+    GncGUID guid;
+    auto allocations = n_allocations;
+    auto start = g_get_monotonic_time ();
+
+    for (auto& text : numerics)
+    {
+        auto copy = g_strdup (text.c_str ());
+        string_to_gnc_numeric (copy, &num);
+        g_free (copy);
+    }
+    for (auto& text : guids)
+    {
+        auto copy = g_strdup (text.c_str ());
+        string_to_guid (copy, &guid);
+        g_free (copy);
+    }
+    return { n_allocations - allocations, g_get_monotonic_time () - start };
+}
+
+static BenchResult
+convert_in_place (const std::vector<std::string>& numerics,
+                  const std::vector<std::string>& guids)
+{
+    gnc_numeric num;
+    GncGUID guid;
+    auto allocations = n_allocations;
+    auto start = g_get_monotonic_time ();
+
+    for (auto& text : numerics)
+        sixtp_string_to_gnc_numeric (text.c_str (), &num);
+    for (auto& text : guids)
+        sixtp_string_to_guid (text.c_str (), &guid);
+    return { n_allocations - allocations, g_get_monotonic_time () - start };
+}
+
+static void
+bench_file (const char* filename, const char* basename)
+{
+    gchar* contents;
+    std::vector<std::string> numerics, guids;
+
+    if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+        failure_args ("read", __FILE__, __LINE__, "%s", filename);
+        return;
+    }
+
+    auto n_splits = count_splits (contents);
+    collect_texts (contents, "<split:value>", numerics);
+    collect_texts (contents, "<split:quantity>", numerics);
+    collect_texts (contents, "<split:id type=\"guid\">", guids);
+    collect_texts (contents, "<split:account type=\"guid\">", guids);
+    g_free (contents);
+    if (n_splits == 0)
+        return;
+
+    gboolean same = TRUE;
+    for (auto& text : numerics)
+        same = same && same_numeric (text.c_str ());
+    for (auto& text : guids)
+        same = same && same_guid (text.c_str ());
+    do_test_args (same, "same results", __FILE__, __LINE__, "in %s", basename);
+
+    BenchResult before {0, 0}, after {0, 0};
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        auto copying = convert_copying (numerics, guids);
+        auto in_place = convert_in_place (numerics, guids);
+        before.allocations += copying.allocations;
+        before.usec += copying.usec;
+        after.allocations += in_place.allocations;
+        after.usec += in_place.usec;
+    }
+
+    double per_split = BENCH_ROUNDS * n_splits;
+    if (COUNTS_ALLOCATIONS)
+    {
+        printf ("%-28s %5" G_GSIZE_FORMAT " splits: %6.1f -> %4.1f allocations, "
+                "%7.0f -> %5.0f ns per split\n", basename, n_splits,
+                before.allocations / per_split, after.allocations / per_split,
+                1000.0 * before.usec / per_split,
+                1000.0 * after.usec / per_split);
+        do_test_args (after.allocations == 0, "no allocations",
+                      __FILE__, __LINE__, "in %s", basename);
+    }
+    else
+        printf ("%-28s %5" G_GSIZE_FORMAT " splits: %7.0f -> %5.0f ns per split\n",
+                basename, n_splits, 1000.0 * before.usec / per_split,
+                1000.0 * after.usec / per_split);
+}
+
+static void
+bench_files (const char* directory)
+{
+    const gchar* name;
+
+    auto dir = g_dir_open (directory, 0, NULL);
+    if (!dir)
+    {
+        failure_args ("open", __FILE__, __LINE__, "%s", directory);
+        return;
+    }
+    while ((name = g_dir_read_name (dir)))
+    {
+        if (!g_str_has_suffix (name, ".gml2"))
+            continue;
+        auto filename = g_build_filename (directory, name, NULL);
+        bench_file (filename, name);
+        g_free (filename);
+    }
+    g_dir_close (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    qof_log_init ();
+    test_same_results ();
+    test_gint64 ();
+    if (argc > 1)
+        bench_files (argv[1]);
+    fflush (stdout);
+    print_test_results ();
+    exit (get_rv ());
+}
@@ -0,0 +1,199 @@
+/********************************************************************
+ * test-xml-background-save.cpp: Test saving a book in the          *
+ * background while it's being edited.                              *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or   *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+extern "C"
+{
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <cashobjects.h>
+#include <TransLog.h>
+#include <gnc-engine.h>
+#include <gnc-prefs.h>
+#include <gnc-lot.h>
+#include <Account.h>
+#include <Transaction.h>
+}
+
+#include <test-stuff.h>
+
+#define GNC_LIB_NAME "gncmod-backend-xml"
+#define GNC_LIB_REL_PATH "xml"
+
+#define N_TRANSACTIONS 2000
+
+static gchar* tmpdir;
+
+static Account*
+add_account (QofBook* book, gnc_commodity* currency, const char* name,
+             GNCAccountType type)
+{
+    auto acc = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetName (acc, name);
+    xaccAccountSetType (acc, type);
+    xaccAccountSetCommodity (acc, currency);
+    gnc_account_append_child (gnc_book_get_root_account (book), acc);
+    xaccAccountCommitEdit (acc);
+    return acc;
+}
+
+/* Add a transaction from expenses to bank, the bank split in lot. */
+static void
+add_transaction (QofBook* book, gnc_commodity* currency, Account* bank,
+                 Account* expenses, GNCLot* lot, int i)
+{
+    auto trans = xaccMallocTransaction (book);
+    auto value = gnc_numeric_create (i + 1, 100);
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetCurrency (trans, currency);
+    xaccTransSetDatePostedSecsNormalized (trans, gnc_time (NULL) - i * 86400);
+    xaccTransSetDescription (trans, "In a lot");
+
+    auto split = xaccMallocSplit (book);
+    xaccSplitSetParent (split, trans);
+    xaccSplitSetAccount (split, bank);
+    xaccSplitSetValue (split, value);
+    xaccSplitSetAmount (split, value);
+    gnc_lot_add_split (lot, split);
+
+    split = xaccMallocSplit (book);
+    xaccSplitSetParent (split, trans);
+    xaccSplitSetAccount (split, expenses);
+    xaccSplitSetValue (split, gnc_numeric_neg (value));
+    xaccSplitSetAmount (split, gnc_numeric_neg (value));
+    xaccTransCommitEdit (trans);
+}
+
+/* The file is written with the lots the splits were in when the save
+ * started, whatever happens to the lots before the worker gets to them. */
+static void
+test_free_lot (const char* filename)
+{
+    auto session = qof_session_new ();
+
+    qof_session_begin (session, filename, FALSE, TRUE, TRUE);
+    auto book = qof_session_get_book (session);
+    auto currency = gnc_commodity_table_lookup (
+        gnc_commodity_table_get_table (book), GNC_COMMODITY_NS_CURRENCY, "USD");
+    auto bank = add_account (book, currency, "Bank", ACCT_TYPE_BANK);
+    auto expenses = add_account (book, currency, "Expenses",
+                                 ACCT_TYPE_EXPENSE);
+    auto lot = gnc_lot_new (book);
+    GncGUID lot_guid = *gnc_lot_get_guid (lot);
+
+    for (int i = 0; i < N_TRANSACTIONS; i++)
+        add_transaction (book, currency, bank, expenses, lot, i);
+
+    /* The save goes on in the background once it returns. */
+    qof_session_save (session, NULL);
+    do_test_args (qof_session_get_error (session) == ERR_BACKEND_NO_ERR,
+                  "start the save", __FILE__, __LINE__, "qof error=%d",
+                  qof_session_get_error (session));
+    gnc_lot_destroy (lot);
+    /* Waits for the save and puts the file in place. */
+    qof_session_end (session);
+    do_test_args (qof_session_get_error (session) == ERR_BACKEND_NO_ERR,
+                  "finish the save", __FILE__, __LINE__, "qof error=%d",
+                  qof_session_get_error (session));
+    qof_session_destroy (session);
+
+    session = qof_session_new ();
+    qof_session_begin (session, filename, FALSE, FALSE, FALSE);
+    qof_session_load (session, NULL);
+    do_test_args (qof_session_get_error (session) == ERR_BACKEND_NO_ERR,
+                  "load the file", __FILE__, __LINE__, "qof error=%d",
+                  qof_session_get_error (session));
+
+    book = qof_session_get_book (session);
+    bank = gnc_account_lookup_by_name (gnc_book_get_root_account (book),
+                                       "Bank");
+    do_test (bank != NULL, "bank account loaded");
+    lot = gnc_lot_lookup (&lot_guid, book);
+    do_test (lot != NULL, "the freed lot is in the file");
+
+    int in_lot = 0;
+    for (auto node = bank ? xaccAccountGetSplitList (bank) : NULL; node;
+         node = node->next)
+        if (xaccSplitGetLot (static_cast<Split*> (node->data)) == lot)
+            in_lot++;
+    do_test_args (lot && in_lot == N_TRANSACTIONS, "splits written in the lot",
+                  __FILE__, __LINE__, "%d of %d splits in the lot", in_lot,
+                  N_TRANSACTIONS);
+
+    qof_session_end (session);
+    qof_session_destroy (session);
+}
+
+static void
+remove_tmpdir (void)
+{
+    auto dir = g_dir_open (tmpdir, 0, NULL);
+    const gchar* entry;
+
+    while (dir && (entry = g_dir_read_name (dir)) != NULL)
+    {
+        auto path = g_build_filename (tmpdir, entry, (gchar*)NULL);
+        g_unlink (path);
+        g_free (path);
+    }
+    if (dir)
+        g_dir_close (dir);
+    g_rmdir (tmpdir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_setenv ("GNC_UNINSTALLED", "1", TRUE);
+    qof_init ();
+    cashobjects_register ();
+    do_test (qof_load_backend_library (GNC_LIB_REL_PATH, GNC_LIB_NAME),
+             " loading gnc-backend-xml GModule failed");
+    xaccLogDisable ();
+
+    gnc_prefs_set_file_save_compressed (FALSE);
+    gnc_prefs_set_file_save_snapshot (FALSE);
+    gnc_prefs_set_file_save_background (TRUE);
+
+    tmpdir = g_dir_make_tmp ("test-xml-background-save-XXXXXX", NULL);
+    if (!tmpdir)
+    {
+        failure ("unable to make a temporary directory");
+    }
+    else
+    {
+        auto filename = g_build_filename (tmpdir, "free-lot.gnucash",
+                                          (gchar*)NULL);
+        test_free_lot (filename);
+        g_free (filename);
+        remove_tmpdir ();
+        g_free (tmpdir);
+    }
+
+    print_test_results ();
+    qof_close ();
+    exit (get_rv ());
+}
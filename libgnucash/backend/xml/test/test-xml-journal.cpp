@@ -0,0 +1,472 @@
+/********************************************************************
+ * test-xml-journal.cpp: Test the change journal kept between full  *
+ * saves of an XML data file.                                       *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or   *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+extern "C"
+{
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <cashobjects.h>
+#include <TransLog.h>
+#include <gnc-engine.h>
+#include <gnc-prefs.h>
+#include <Account.h>
+#include <Transaction.h>
+#include <gncCustomer.h>
+#include <gncEntry.h>
+#include <gncInvoice.h>
+#include <gncOwner.h>
+}
+
+#include <string>
+#include <vector>
+
+#include <test-stuff.h>
+#include "gnc-xml-journal.hpp"
+
+#define GNC_LIB_NAME "gncmod-backend-xml"
+#define GNC_LIB_REL_PATH "xml"
+
+static gchar* tmpdir;
+
+static gboolean
+journal_exists (const char* filename)
+{
+    auto path = std::string {filename} + GNC_XML_JOURNAL_EXT;
+    return g_file_test (path.c_str (), G_FILE_TEST_EXISTS);
+}
+
+static void
+copy_file (const std::string& from, const std::string& to)
+{
+    gchar* contents;
+    gsize length;
+
+    do_test (g_file_get_contents (from.c_str (), &contents, &length, NULL) &&
+             g_file_set_contents (to.c_str (), contents, length, NULL),
+             "copy a file");
+    g_free (contents);
+}
+
+/* A record cut short by a crash ends the journal, what came before it is
+ * read back as it was appended. */
+static void
+test_framing (const char* filename)
+{
+    GncXmlJournal journal;
+    std::vector<std::string> records;
+    bool torn;
+
+    g_file_set_contents (filename, "<gnc-v2/>\n", -1, NULL);
+    journal.set_datafile (filename);
+    do_test (journal.reset (), "start a journal");
+    do_test (journal.read (records, &torn) && records.empty () && !torn,
+             "read an empty journal");
+
+    do_test (journal.append ("<gnc-journal>first</gnc-journal>\n") &&
+             journal.append ("<gnc-journal>second</gnc-journal>\n"),
+             "append two records");
+    records.clear ();
+    do_test (journal.read (records, &torn), "read the journal");
+    do_test_args (records.size () == 2 && !torn, "both records read",
+                  __FILE__, __LINE__, "%d records, torn %d",
+                  (int)records.size (), torn);
+    do_test (records.size () == 2 &&
+             records[1] == "<gnc-journal>second</gnc-journal>\n",
+             "record read as appended");
+
+    gchar* contents;
+    gsize length;
+    g_file_get_contents (journal.path ().c_str (), &contents, &length, NULL);
+    g_file_set_contents (journal.path ().c_str (), contents, length - 5, NULL);
+    g_free (contents);
+
+    records.clear ();
+    do_test (journal.read (records, &torn), "read the torn journal");
+    do_test_args (records.size () == 1 && torn, "torn record dropped",
+                  __FILE__, __LINE__, "%d records, torn %d",
+                  (int)records.size (), torn);
+    do_test (records.size () == 1 &&
+             records[0] == "<gnc-journal>first</gnc-journal>\n",
+             "record before the torn one kept");
+
+    journal.remove ();
+}
+
+/* A journal only applies to the data file it was started for, however
+ * little the file changed since. */
+static void
+test_stale (const char* filename)
+{
+    GncXmlJournal journal;
+    std::vector<std::string> records;
+    bool torn;
+
+    std::string data (200 * 1024, 'a');
+    g_file_set_contents (filename, data.c_str (), data.size (), NULL);
+    journal.set_datafile (filename);
+    do_test (journal.reset () && journal.append ("<gnc-journal/>\n"),
+             "start a journal");
+    do_test (journal.read (records, &torn), "journal matches its data file");
+
+    /* The same length, an edit in the middle of the file. */
+    data[data.size () / 2] = 'b';
+    g_file_set_contents (filename, data.c_str (), data.size (), NULL);
+    records.clear ();
+    do_test (!journal.read (records, &torn) && records.empty (),
+             "journal of another data file ignored");
+
+    journal.remove ();
+}
+
+static Account*
+add_account (QofBook* book, gnc_commodity* currency, const char* name,
+             GNCAccountType type)
+{
+    auto acc = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetName (acc, name);
+    xaccAccountSetType (acc, type);
+    xaccAccountSetCommodity (acc, currency);
+    gnc_account_append_child (gnc_book_get_root_account (book), acc);
+    xaccAccountCommitEdit (acc);
+    return acc;
+}
+
+static Transaction*
+add_transaction (QofBook* book, gnc_commodity* currency, Account* from,
+                 Account* to, const char* description, int amount)
+{
+    auto trans = xaccMallocTransaction (book);
+    auto value = gnc_numeric_create (amount, 100);
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetCurrency (trans, currency);
+    xaccTransSetDatePostedSecsNormalized (trans, gnc_time (NULL));
+    xaccTransSetDescription (trans, description);
+
+    auto split = xaccMallocSplit (book);
+    xaccSplitSetParent (split, trans);
+    xaccSplitSetAccount (split, to);
+    xaccSplitSetValue (split, value);
+    xaccSplitSetAmount (split, value);
+
+    split = xaccMallocSplit (book);
+    xaccSplitSetParent (split, trans);
+    xaccSplitSetAccount (split, from);
+    xaccSplitSetValue (split, gnc_numeric_neg (value));
+    xaccSplitSetAmount (split, gnc_numeric_neg (value));
+    xaccTransCommitEdit (trans);
+    return trans;
+}
+
+static GncInvoice*
+post_invoice (QofBook* book, gnc_commodity* currency, Account* receivable,
+              Account* income)
+{
+    auto customer = gncCustomerCreate (book);
+    gncCustomerSetID (customer, "000001");
+    gncCustomerSetName (customer, "Customer");
+    gncCustomerSetCurrency (customer, currency);
+
+    GncOwner owner;
+    gncOwnerInitCustomer (&owner, customer);
+
+    auto invoice = gncInvoiceCreate (book);
+    gncInvoiceSetID (invoice, "000001");
+    gncInvoiceSetOwner (invoice, &owner);
+    gncInvoiceSetCurrency (invoice, currency);
+    gncInvoiceSetDateOpened (invoice, gnc_time (NULL));
+
+    auto entry = gncEntryCreate (book);
+    gncEntrySetDate (entry, gnc_time (NULL));
+    gncEntrySetDescription (entry, "Entry");
+    gncEntrySetQuantity (entry, gnc_numeric_create (1, 1));
+    gncEntrySetInvPrice (entry, gnc_numeric_create (10000, 100));
+    gncEntrySetInvAccount (entry, income);
+    gncEntrySetInvTaxable (entry, FALSE);
+    gncInvoiceAddEntry (invoice, entry);
+
+    gncInvoicePostToAccount (invoice, receivable, gnc_time (NULL),
+                             gnc_time (NULL), "Posted", TRUE, FALSE);
+    return invoice;
+}
+
+static void
+save (QofSession* session, const char* what)
+{
+    qof_session_save (session, NULL);
+    do_test_args (qof_session_get_error (session) == ERR_BACKEND_NO_ERR,
+                  what, __FILE__, __LINE__, "qof error=%d",
+                  qof_session_get_error (session));
+}
+
+static QofSession*
+load_book (const char* filename)
+{
+    auto session = qof_session_new ();
+
+    qof_session_begin (session, filename, FALSE, FALSE, FALSE);
+    qof_session_load (session, NULL);
+    do_test_args (qof_session_get_error (session) == ERR_BACKEND_NO_ERR,
+                  "load book", __FILE__, __LINE__, "qof error=%d for %s",
+                  qof_session_get_error (session), filename);
+    return session;
+}
+
+/* The transactions the journal replays, by GUID. */
+struct Replayed
+{
+    GncGUID changed;
+    GncGUID deleted;
+    GncGUID voided;
+    GncGUID invoice;
+};
+
+static void
+check_balances (QofBook* saved, QofBook* loaded)
+{
+    static const char* names[] = {"Bank", "Expenses", "Receivable", "Income"};
+
+    for (auto name : names)
+    {
+        auto saved_acc = gnc_account_lookup_by_name (
+            gnc_book_get_root_account (saved), name);
+        auto loaded_acc = gnc_account_lookup_by_name (
+            gnc_book_get_root_account (loaded), name);
+        auto saved_balance = xaccAccountGetBalance (saved_acc);
+        auto loaded_balance = loaded_acc ? xaccAccountGetBalance (loaded_acc)
+            : gnc_numeric_zero ();
+
+        do_test_args (loaded_acc &&
+                      gnc_numeric_equal (saved_balance, loaded_balance) &&
+                      g_list_length (xaccAccountGetSplitList (saved_acc)) ==
+                      g_list_length (xaccAccountGetSplitList (loaded_acc)),
+                      "account replayed", __FILE__, __LINE__,
+                      "%s balance %s, expected %s", name,
+                      gnc_num_dbg_to_string (loaded_balance),
+                      gnc_num_dbg_to_string (saved_balance));
+    }
+}
+
+static void
+check_replayed (QofBook* saved, QofBook* loaded, const Replayed& guids)
+{
+    check_balances (saved, loaded);
+
+    auto trans = xaccTransLookup (&guids.changed, loaded);
+    do_test (trans && g_strcmp0 (xaccTransGetDescription (trans),
+                                 "Changed") == 0,
+             "changed transaction replayed");
+    do_test (!xaccTransLookup (&guids.deleted, loaded),
+             "deleted transaction replayed");
+    trans = xaccTransLookup (&guids.voided, loaded);
+    do_test (trans && !xaccTransGetVoidStatus (trans),
+             "voided and unvoided transaction replayed");
+
+    auto invoice = gncInvoiceLookup (loaded, &guids.invoice);
+    trans = gncInvoiceGetPostedTxn (invoice);
+    do_test (trans && xaccTransGetReadOnly (trans) &&
+             g_strcmp0 (xaccTransGetNotes (trans), "Journaled") == 0,
+             "posted transaction replayed");
+    do_test (trans && trans == xaccTransLookup (qof_instance_get_guid (trans),
+                                                loaded),
+             "invoice holds the replayed transaction");
+}
+
+/* Changed, deleted and read-only transactions are saved to the journal,
+ * which the next load replays and the end of the session folds into the
+ * data file. */
+static void
+test_replay (const char* filename)
+{
+    auto session = qof_session_new ();
+    Replayed guids;
+
+    qof_session_begin (session, filename, FALSE, TRUE, TRUE);
+    auto book = qof_session_get_book (session);
+    auto currency = gnc_commodity_table_lookup (
+        gnc_commodity_table_get_table (book), GNC_COMMODITY_NS_CURRENCY, "USD");
+    auto bank = add_account (book, currency, "Bank", ACCT_TYPE_BANK);
+    auto expenses = add_account (book, currency, "Expenses",
+                                 ACCT_TYPE_EXPENSE);
+    auto receivable = add_account (book, currency, "Receivable",
+                                   ACCT_TYPE_RECEIVABLE);
+    auto income = add_account (book, currency, "Income", ACCT_TYPE_INCOME);
+
+    auto changed = add_transaction (book, currency, expenses, bank,
+                                    "To change", 100);
+    auto deleted = add_transaction (book, currency, expenses, bank,
+                                    "To delete", 200);
+    auto voided = add_transaction (book, currency, expenses, bank,
+                                   "To void", 400);
+    auto invoice = post_invoice (book, currency, receivable, income);
+    guids.changed = *qof_instance_get_guid (changed);
+    guids.deleted = *qof_instance_get_guid (deleted);
+    guids.voided = *qof_instance_get_guid (voided);
+    guids.invoice = *qof_instance_get_guid (invoice);
+    save (session, "save in full");
+    do_test (!journal_exists (filename), "no journal after a full save");
+
+    xaccTransBeginEdit (changed);
+    xaccTransSetDescription (changed, "Changed");
+    xaccSplitSetValue (xaccTransGetSplit (changed, 0),
+                       gnc_numeric_create (150, 100));
+    xaccSplitSetAmount (xaccTransGetSplit (changed, 0),
+                        gnc_numeric_create (150, 100));
+    xaccSplitSetValue (xaccTransGetSplit (changed, 1),
+                       gnc_numeric_create (-150, 100));
+    xaccSplitSetAmount (xaccTransGetSplit (changed, 1),
+                        gnc_numeric_create (-150, 100));
+    xaccTransCommitEdit (changed);
+    xaccTransBeginEdit (deleted);
+    xaccTransDestroy (deleted);
+    xaccTransCommitEdit (deleted);
+    xaccTransVoid (voided, "Voided");
+    save (session, "save to the journal");
+    do_test (journal_exists (filename), "journal after saving a transaction");
+
+    /* Both are read-only when these are saved. */
+    xaccTransSetNotes (gncInvoiceGetPostedTxn (invoice), "Journaled");
+    xaccTransUnvoid (voided);
+    save (session, "save read-only transactions to the journal");
+
+    /* A copy is loaded with the journal, the session keeps the lock on the
+     * original. */
+    auto copy = g_build_filename (tmpdir, "replay-copy.gnucash", (gchar*)NULL);
+    copy_file (filename, copy);
+    copy_file (std::string {filename} + GNC_XML_JOURNAL_EXT,
+               std::string {copy} + GNC_XML_JOURNAL_EXT);
+    auto loaded = load_book (copy);
+    check_replayed (book, qof_session_get_book (loaded), guids);
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+    g_free (copy);
+
+    qof_session_end (session);
+    do_test (!journal_exists (filename), "journal compacted at session end");
+    loaded = load_book (filename);
+    check_replayed (book, qof_session_get_book (loaded), guids);
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+    qof_session_destroy (session);
+}
+
+/* A save that can't go to the journal writes the data file and removes the
+ * journal. */
+static void
+test_compact (const char* filename)
+{
+    auto session = qof_session_new ();
+
+    qof_session_begin (session, filename, FALSE, TRUE, TRUE);
+    auto book = qof_session_get_book (session);
+    auto currency = gnc_commodity_table_lookup (
+        gnc_commodity_table_get_table (book), GNC_COMMODITY_NS_CURRENCY, "USD");
+    auto bank = add_account (book, currency, "Bank", ACCT_TYPE_BANK);
+    auto expenses = add_account (book, currency, "Expenses",
+                                 ACCT_TYPE_EXPENSE);
+    add_transaction (book, currency, expenses, bank, "Full", 100);
+    save (session, "save in full");
+
+    add_transaction (book, currency, expenses, bank, "Journaled", 200);
+    save (session, "save to the journal");
+    do_test (journal_exists (filename), "journal after saving a transaction");
+
+    xaccAccountSetName (bank, "Checking");
+    save (session, "save an account");
+    do_test (!journal_exists (filename), "journal compacted by a full save");
+    qof_session_end (session);
+    qof_session_destroy (session);
+
+    auto loaded = load_book (filename);
+    auto checking = gnc_account_lookup_by_name (
+        gnc_book_get_root_account (qof_session_get_book (loaded)), "Checking");
+    do_test (checking &&
+             g_list_length (xaccAccountGetSplitList (checking)) == 2,
+             "journaled transaction in the data file");
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+}
+
+static void
+run_test (void (*test) (const char*), const char* name)
+{
+    auto filename = g_build_filename (tmpdir, name, (gchar*)NULL);
+    test (filename);
+    g_free (filename);
+}
+
+static void
+remove_tmpdir (void)
+{
+    auto dir = g_dir_open (tmpdir, 0, NULL);
+    const gchar* entry;
+
+    while (dir && (entry = g_dir_read_name (dir)) != NULL)
+    {
+        auto path = g_build_filename (tmpdir, entry, (gchar*)NULL);
+        g_unlink (path);
+        g_free (path);
+    }
+    if (dir)
+        g_dir_close (dir);
+    g_rmdir (tmpdir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_setenv ("GNC_UNINSTALLED", "1", TRUE);
+    qof_init ();
+    cashobjects_register ();
+    do_test (qof_load_backend_library (GNC_LIB_REL_PATH, GNC_LIB_NAME),
+             " loading gnc-backend-xml GModule failed");
+    xaccLogDisable ();
+
+    gnc_prefs_set_file_save_compressed (FALSE);
+    gnc_prefs_set_file_save_snapshot (FALSE);
+    gnc_prefs_set_file_save_background (FALSE);
+    gnc_prefs_set_file_save_journaled (TRUE);
+
+    tmpdir = g_dir_make_tmp ("test-xml-journal-XXXXXX", NULL);
+    if (!tmpdir)
+    {
+        failure ("unable to make a temporary directory");
+    }
+    else
+    {
+        run_test (test_framing, "framing.gnucash");
+        run_test (test_stale, "stale.gnucash");
+        run_test (test_replay, "replay.gnucash");
+        run_test (test_compact, "compact.gnucash");
+        remove_tmpdir ();
+        g_free (tmpdir);
+    }
+
+    print_test_results ();
+    qof_close ();
+    exit (get_rv ());
+}
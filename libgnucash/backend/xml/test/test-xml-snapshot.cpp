@@ -0,0 +1,442 @@
+/********************************************************************
+ * test-xml-snapshot.cpp: Test loading a book from its snapshot.    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or   *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+/* Each test saves a book with the snapshot on and loads it again, after
+ * changing the name of an account near the head of the data file without
+ * changing its size, times or tail: the name the book loads with tells
+ * whether it came from the snapshot or from parsing the data file. */
+extern "C"
+{
+#include <config.h>
+#include <string.h>
+#include <utime.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include <cashobjects.h>
+#include <TransLog.h>
+#include <gnc-engine.h>
+#include <gnc-prefs.h>
+#include <Account.h>
+#include <Transaction.h>
+#include <TransactionP.h>
+}
+
+#include <test-stuff.h>
+
+#define GNC_LIB_NAME "gncmod-backend-xml"
+#define GNC_LIB_REL_PATH "xml"
+
+#define MARKER_SAVED "Marker saved"
+#define MARKER_EDITED "Marker edits"
+#define N_TRANSACTIONS 500
+/* The part of the data file the snapshot checks besides its size. */
+#define DATAFILE_TAIL_SIZE (64 * 1024)
+
+/* The start of a snapshot and its transaction records, as written by
+ * gnc-xml-snapshot.cpp. */
+struct SnapshotHeader
+{
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    gint64 datafile_size;
+    gint64 datafile_mtime;
+    guint32 datafile_tail_crc;
+    guint32 body_crc;
+    struct
+    {
+        guint64 offset;
+        guint64 size;
+        guint64 count;
+    } sections[6];
+};
+#define SNAPSHOT_TRANSACTIONS 2
+
+struct SnapshotTransaction
+{
+    GncGUID guid;
+    gint64 date_posted;
+    gint64 date_entered;
+    guint64 slots;
+    guint32 currency_space;
+    guint32 currency_id;
+    guint32 num;
+    guint32 description;
+    guint32 n_splits;
+    guint32 padding;
+};
+
+static gchar* tmpdir;
+
+static void
+add_transaction (QofBook* book, gnc_commodity* currency, Account* from,
+                 Account* to, int i)
+{
+    auto trans = xaccMallocTransaction (book);
+    auto value = gnc_numeric_create (i + 1, 100);
+    auto description = g_strdup_printf ("Transaction %d", i);
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetCurrency (trans, currency);
+    xaccTransSetDatePostedSecsNormalized (trans, gnc_time (NULL) - i * 86400);
+    xaccTransSetDescription (trans, description);
+    g_free (description);
+
+    auto split = xaccMallocSplit (book);
+    xaccSplitSetParent (split, trans);
+    xaccSplitSetAccount (split, to);
+    xaccSplitSetValue (split, value);
+    xaccSplitSetAmount (split, value);
+
+    /* With from NULL the other split is left out of any account. */
+    split = xaccMallocSplit (book);
+    xaccSplitSetParent (split, trans);
+    if (from)
+        xaccSplitSetAccount (split, from);
+    xaccSplitSetValue (split, gnc_numeric_neg (value));
+    xaccSplitSetAmount (split, gnc_numeric_neg (value));
+    xaccTransCommitEdit (trans);
+}
+
+static Account*
+add_account (QofBook* book, gnc_commodity* currency, const char* name,
+             GNCAccountType type)
+{
+    auto acc = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetName (acc, name);
+    xaccAccountSetType (acc, type);
+    xaccAccountSetCommodity (acc, currency);
+    gnc_account_append_child (gnc_book_get_root_account (book), acc);
+    xaccAccountCommitEdit (acc);
+    return acc;
+}
+
+/* Save a new book to filename, which also writes its snapshot.  The
+ * session is returned ended, with the book to compare with. */
+static QofSession*
+save_book (const char* filename, gboolean orphan)
+{
+    auto session = qof_session_new ();
+
+    qof_session_begin (session, filename, FALSE, TRUE, TRUE);
+    auto book = qof_session_get_book (session);
+    auto currency = gnc_commodity_table_lookup (
+        gnc_commodity_table_get_table (book), GNC_COMMODITY_NS_CURRENCY, "USD");
+    auto marker = add_account (book, currency, MARKER_SAVED, ACCT_TYPE_BANK);
+    auto expenses = add_account (book, currency, "Expenses",
+                                 ACCT_TYPE_EXPENSE);
+
+    for (int i = 0; i < N_TRANSACTIONS; i++)
+        add_transaction (book, currency, marker, expenses, i);
+    if (orphan)
+    {
+        /* Keep the commit from scrubbing the orphan split. */
+        xaccDisableDataScrubbing ();
+        add_transaction (book, currency, NULL, expenses, N_TRANSACTIONS);
+        xaccEnableDataScrubbing ();
+    }
+
+    qof_session_save (session, NULL);
+    do_test_args (qof_session_get_error (session) == ERR_BACKEND_NO_ERR,
+                  "save book", __FILE__, __LINE__, "qof error=%d for %s",
+                  qof_session_get_error (session), filename);
+    qof_session_end (session);
+    return session;
+}
+
+static QofSession*
+load_book (const char* filename)
+{
+    auto session = qof_session_new ();
+
+    qof_session_begin (session, filename, FALSE, FALSE, FALSE);
+    qof_session_load (session, NULL);
+    do_test_args (qof_session_get_error (session) == ERR_BACKEND_NO_ERR,
+                  "load book", __FILE__, __LINE__, "qof error=%d for %s",
+                  qof_session_get_error (session), filename);
+    return session;
+}
+
+/* Rename the marker account in the data file, keeping its size, times and
+ * tail as they were if keep_id, so that the snapshot still belongs to it. */
+static void
+edit_datafile (const char* filename, gboolean keep_id)
+{
+    gchar* contents;
+    gsize length;
+    GStatBuf statbuf;
+
+    if (!g_file_get_contents (filename, &contents, &length, NULL) ||
+        g_stat (filename, &statbuf) != 0)
+    {
+        failure_args ("edit data file", __FILE__, __LINE__,
+                      "unable to read %s", filename);
+        return;
+    }
+
+    auto marker = g_strstr_len (contents, length, MARKER_SAVED);
+    do_test (marker && contents + length - marker > 2 * DATAFILE_TAIL_SIZE,
+             "marker account at the head of the data file");
+    if (marker)
+        memcpy (marker, MARKER_EDITED, strlen (MARKER_EDITED));
+
+    if (keep_id)
+    {
+        struct utimbuf times = { statbuf.st_atime, statbuf.st_mtime };
+        g_file_set_contents (filename, contents, length, NULL);
+        g_utime (filename, &times);
+    }
+    else
+    {
+        auto edited = g_strconcat (contents, "\n", NULL);
+        g_file_set_contents (filename, edited, length + 1, NULL);
+        g_free (edited);
+    }
+    g_free (contents);
+}
+
+/* Make the snapshot's records refer to a string it doesn't have without
+ * it failing its checksum. */
+static void
+damage_snapshot_records (const char* snapshot)
+{
+    gchar* contents;
+    gsize length;
+
+    if (!g_file_get_contents (snapshot, &contents, &length, NULL))
+    {
+        failure_args ("damage snapshot", __FILE__, __LINE__,
+                      "unable to read %s", snapshot);
+        return;
+    }
+
+    auto header = reinterpret_cast<SnapshotHeader*> (contents);
+    auto section = header->sections[SNAPSHOT_TRANSACTIONS];
+    do_test (section.count > 0 &&
+             section.offset + sizeof (SnapshotTransaction) <= length,
+             "snapshot has transactions");
+    auto trans = reinterpret_cast<SnapshotTransaction*> (contents +
+                                                         section.offset);
+    trans->description = G_MAXUINT32;
+    header->body_crc = crc32 (crc32 (0L, Z_NULL, 0),
+                              (const Bytef*) contents + sizeof (SnapshotHeader),
+                              length - sizeof (SnapshotHeader));
+    g_file_set_contents (snapshot, contents, length, NULL);
+    g_free (contents);
+}
+
+/* Flip the last byte of the snapshot, which its checksum covers. */
+static void
+damage_snapshot (const char* snapshot)
+{
+    gchar* contents;
+    gsize length;
+
+    if (!g_file_get_contents (snapshot, &contents, &length, NULL) || !length)
+    {
+        failure_args ("damage snapshot", __FILE__, __LINE__,
+                      "unable to read %s", snapshot);
+        return;
+    }
+    contents[length - 1] ^= 0xff;
+    g_file_set_contents (snapshot, contents, length, NULL);
+    g_free (contents);
+}
+
+static void
+compare_transaction (QofInstance* inst, gpointer data)
+{
+    auto trans = GNC_TRANSACTION (inst);
+    auto book = static_cast<QofBook*> (data);
+    auto loaded = xaccTransLookup (qof_instance_get_guid (inst), book);
+
+    if (!loaded || !xaccTransEqual (trans, loaded, TRUE, TRUE, FALSE, FALSE))
+    {
+        failure_args ("compare transactions", __FILE__, __LINE__,
+                      "%s differs", xaccTransGetDescription (trans));
+        return;
+    }
+    for (auto node = xaccTransGetSplitList (trans); node; node = node->next)
+    {
+        auto split = static_cast<Split*> (node->data);
+        auto loaded_split = xaccSplitLookup (qof_instance_get_guid (split),
+                                             book);
+        if (!guid_equal (xaccAccountGetGUID (xaccSplitGetAccount (split)),
+                         xaccAccountGetGUID (xaccSplitGetAccount (loaded_split))))
+            failure_args ("compare transactions", __FILE__, __LINE__,
+                          "a split of %s has another account",
+                          xaccTransGetDescription (trans));
+    }
+}
+
+static void
+check_book (QofSession* saved, QofSession* loaded, const char* marker,
+            const char* test)
+{
+    auto saved_book = qof_session_get_book (saved);
+    auto book = qof_session_get_book (loaded);
+    auto saved_trans = qof_book_get_collection (saved_book, GNC_ID_TRANS);
+
+    do_test_args (gnc_account_lookup_by_name (gnc_book_get_root_account (book),
+                                              marker) != NULL,
+                  test, __FILE__, __LINE__, "no account %s", marker);
+    do_test_args (qof_collection_count (saved_trans) ==
+                  qof_collection_count (qof_book_get_collection (book,
+                                                                 GNC_ID_TRANS)),
+                  test, __FILE__, __LINE__, "transactions missing");
+    qof_collection_foreach (saved_trans, compare_transaction, book);
+}
+
+static void
+test_round_trip (const char* filename, const char* snapshot)
+{
+    auto saved = save_book (filename, TRUE);
+    do_test (g_file_test (snapshot, G_FILE_TEST_IS_REGULAR),
+             "save writes the snapshot");
+    edit_datafile (filename, TRUE);
+
+    auto loaded = load_book (filename);
+    check_book (saved, loaded, MARKER_SAVED, "load from the snapshot");
+    do_test (g_file_test (snapshot, G_FILE_TEST_IS_REGULAR),
+             "the snapshot is kept");
+
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+    qof_session_destroy (saved);
+}
+
+static void
+test_stale (const char* filename, const char* snapshot)
+{
+    auto saved = save_book (filename, FALSE);
+    edit_datafile (filename, FALSE);
+
+    auto loaded = load_book (filename);
+    check_book (saved, loaded, MARKER_EDITED, "stale snapshot is ignored");
+
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+    qof_session_destroy (saved);
+}
+
+static void
+test_corrupt (const char* filename, const char* snapshot)
+{
+    auto saved = save_book (filename, FALSE);
+    damage_snapshot (snapshot);
+    edit_datafile (filename, TRUE);
+
+    auto loaded = load_book (filename);
+    check_book (saved, loaded, MARKER_EDITED, "corrupt snapshot is ignored");
+
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+    qof_session_destroy (saved);
+}
+
+/* A snapshot that fails part way through loading leaves nothing of what it
+ * built in the book loaded from the data file instead. */
+static void
+test_damaged_records (const char* filename, const char* snapshot)
+{
+    auto saved = save_book (filename, FALSE);
+    damage_snapshot_records (snapshot);
+    edit_datafile (filename, TRUE);
+
+    auto loaded = load_book (filename);
+    check_book (saved, loaded, MARKER_EDITED, "failed snapshot falls back");
+    do_test (gnc_account_lookup_by_name (
+                 gnc_book_get_root_account (qof_session_get_book (loaded)),
+                 MARKER_SAVED) == NULL,
+             "nothing is left of the failed snapshot");
+    do_test (!g_file_test (snapshot, G_FILE_TEST_EXISTS),
+             "the failed snapshot is removed");
+
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+    qof_session_destroy (saved);
+}
+
+static void
+run_test (void (*test) (const char*, const char*), const char* name)
+{
+    auto filename = g_build_filename (tmpdir, name, (gchar*)NULL);
+    auto snapshot = g_strconcat (filename, ".snapshot", NULL);
+
+    test (filename, snapshot);
+    g_free (snapshot);
+    g_free (filename);
+}
+
+static void
+remove_tmpdir (void)
+{
+    auto dir = g_dir_open (tmpdir, 0, NULL);
+    const gchar* entry;
+
+    while (dir && (entry = g_dir_read_name (dir)) != NULL)
+    {
+        auto path = g_build_filename (tmpdir, entry, (gchar*)NULL);
+        g_unlink (path);
+        g_free (path);
+    }
+    if (dir)
+        g_dir_close (dir);
+    g_rmdir (tmpdir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_setenv ("GNC_UNINSTALLED", "1", TRUE);
+    qof_init ();
+    cashobjects_register ();
+    do_test (qof_load_backend_library (GNC_LIB_REL_PATH, GNC_LIB_NAME),
+             " loading gnc-backend-xml GModule failed");
+    xaccLogDisable ();
+
+    gnc_prefs_set_file_save_compressed (FALSE);
+    gnc_prefs_set_file_save_background (FALSE);
+    gnc_prefs_set_file_save_snapshot (TRUE);
+
+    tmpdir = g_dir_make_tmp ("test-xml-snapshot-XXXXXX", NULL);
+    if (!tmpdir)
+    {
+        failure ("unable to make a temporary directory");
+    }
+    else
+    {
+        run_test (test_round_trip, "round-trip.gnucash");
+        run_test (test_stale, "stale.gnucash");
+        run_test (test_corrupt, "corrupt.gnucash");
+        run_test (test_damaged_records, "damaged-records.gnucash");
+        remove_tmpdir ();
+        g_free (tmpdir);
+    }
+
+    print_test_results ();
+    qof_close ();
+    exit (get_rv ());
+}
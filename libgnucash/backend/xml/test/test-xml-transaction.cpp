@@ -441,6 +441,22 @@ test_transaction (void)
             success_args ("transaction_xml", __FILE__, __LINE__, "%d", i);
         }
 
+        {
+            /* The streaming writer must print exactly what the tree dumps. */
+            GncXmlWriter writer;
+            xmlBufferPtr buf = xmlBufferCreate ();
+
+            gnc_transaction_xml_write (writer, ran_trn);
+            xmlNodeDump (buf, NULL, test_node, 0, 1);
+            if (writer.str () != (const char*) xmlBufferContent (buf))
+                failure_args ("transaction_xml", __FILE__, __LINE__,
+                              "streamed transaction differs from the tree:\n%s\n%s",
+                              writer.str ().c_str (), xmlBufferContent (buf));
+            else
+                success_args ("transaction_xml_write", __FILE__, __LINE__, "%d", i);
+            xmlBufferFree (buf);
+        }
+
         filename1 = g_strdup_printf ("test_file_XXXXXX");
 
         fd = g_mkstemp (filename1);
@@ -34,6 +34,11 @@ static gboolean extras_enabled    = FALSE;
 static gboolean use_compression   = TRUE; // This is also the default in the prefs backend
 static gint file_retention_policy = 1;    // 1 = "days", the default in the prefs backend
 static gint file_retention_days   = 30;   // This is also the default in the prefs backend
+static gint file_compression_threads = 0; // 0 = one per processor, the default in the prefs backend
+static gboolean use_journal       = TRUE; // This is also the default in the prefs backend
+static gboolean use_snapshot      = TRUE; // This is also the default in the prefs backend
+static gboolean use_background    = TRUE; // This is also the default in the prefs backend
+static gint sql_insert_batch_size = 250;  // This is also the default in the prefs backend
 
 PrefsBackend *prefsbackend = NULL;
 
@@ -89,6 +94,66 @@ gnc_prefs_set_file_save_compressed(gboolean compressed)
     use_compression = compressed;
 }
 
+gint
+gnc_prefs_get_file_compression_threads(void)
+{
+    return file_compression_threads;
+}
+
+void
+gnc_prefs_set_file_compression_threads(gint threads)
+{
+    file_compression_threads = threads < 0 ? 0 : threads;
+}
+
+gboolean
+gnc_prefs_get_file_save_journaled(void)
+{
+    return use_journal;
+}
+
+void
+gnc_prefs_set_file_save_journaled(gboolean journaled)
+{
+    use_journal = journaled;
+}
+
+gboolean
+gnc_prefs_get_file_save_snapshot(void)
+{
+    return use_snapshot;
+}
+
+void
+gnc_prefs_set_file_save_snapshot(gboolean snapshot)
+{
+    use_snapshot = snapshot;
+}
+
+gboolean
+gnc_prefs_get_file_save_background(void)
+{
+    return use_background;
+}
+
+void
+gnc_prefs_set_file_save_background(gboolean background)
+{
+    use_background = background;
+}
+
+gint
+gnc_prefs_get_sql_insert_batch_size(void)
+{
+    return sql_insert_batch_size;
+}
+
+void
+gnc_prefs_set_sql_insert_batch_size(gint rows)
+{
+    sql_insert_batch_size = rows;
+}
+
 gint
 gnc_prefs_get_file_retention_policy(void)
 {
@@ -109,6 +109,31 @@ void gnc_prefs_set_extra(gboolean enabled);
 gboolean gnc_prefs_get_file_save_compressed(void);
 void gnc_prefs_set_file_save_compressed(gboolean compressed);
 
+/** The number of threads compressing the data file, 0 meaning one per
+ *  processor and 1 a plain serial gzip stream. */
+gint gnc_prefs_get_file_compression_threads(void);
+void gnc_prefs_set_file_compression_threads(gint threads);
+
+/** Whether saving an XML data file may append the changed transactions to
+ *  a journal next to it instead of writing the whole file. */
+gboolean gnc_prefs_get_file_save_journaled(void);
+void gnc_prefs_set_file_save_journaled(gboolean journaled);
+
+/** Whether saving an XML data file also writes a binary snapshot of the book
+ *  next to it, from which the next load builds the book without parsing. */
+gboolean gnc_prefs_get_file_save_snapshot(void);
+void gnc_prefs_set_file_save_snapshot(gboolean snapshot);
+
+/** Whether saving an XML data file writes the transactions in a worker
+ *  thread while the book goes on being edited. */
+gboolean gnc_prefs_get_file_save_background(void);
+void gnc_prefs_set_file_save_background(gboolean background);
+
+/** The number of rows saving a book to a database inserts into a table with
+ *  each statement, 1 or less meaning one statement per row. */
+gint gnc_prefs_get_sql_insert_batch_size(void);
+void gnc_prefs_set_sql_insert_batch_size(gint rows);
+
 gint gnc_prefs_get_file_retention_policy(void);
 void gnc_prefs_set_file_retention_policy(gint policy);
 
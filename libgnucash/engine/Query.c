@@ -538,6 +538,21 @@ xaccQueryAddClosingTransMatch(QofQuery *q, gboolean value, QofQueryOp op)
     qof_query_add_boolean_match(q, param_list, value, op);
 }
 
+/*******************************************************************
+ *  xaccQueryEnableTextIndex
+ *******************************************************************/
+
+void
+xaccQueryEnableTextIndex (QofBook *book)
+{
+    g_return_if_fail (book);
+
+    qof_text_index_enable (book, GNC_ID_TRANS, TRANS_DESCRIPTION);
+    qof_text_index_enable (book, GNC_ID_TRANS, TRANS_NOTES);
+    qof_text_index_enable (book, GNC_ID_SPLIT, SPLIT_MEMO);
+    qof_text_index_enable (book, GNC_ID_SPLIT, SPLIT_ACTION);
+}
+
 /*******************************************************************
  *  xaccQueryGetEarliestDateFound
  *******************************************************************/
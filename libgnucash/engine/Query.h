@@ -179,6 +179,13 @@ void xaccQueryAddClearedMatch(QofQuery * q, cleared_match_t how, QofQueryOp op);
 void xaccQueryAddGUIDMatch(QofQuery * q, const GncGUID *guid,
                            QofIdType id_type, QofQueryOp op);
 
+/** Build text indexes over the transaction descriptions and notes and
+ * the split memos and actions of the book, so that string matches on
+ * them only check the splits that can possibly match.  The indexes are
+ * maintained from then on until the book is destroyed, and built again
+ * after changes made while events were suspended. */
+void xaccQueryEnableTextIndex (QofBook *book);
+
 
 /*******************************************************************
  *  compatibility interface with old QofQuery API
@@ -288,21 +288,262 @@ xaccSplitScrub (Split *split)
 
 /* ================================================================ */
 
+/* Transactions are checked for problems in parallel if there are at least
+ * this many per thread; the repairs are made in the main thread. */
+#define SCRUB_MIN_TRANS_PER_WORKER 1024
+
+/* Returns TRUE if TransScrubOrphansFast(), xaccTransScrubCurrency() or
+ * xaccTransScrubImbalance() might change the transaction.  This only reads
+ * the transaction, its splits, their accounts and commodities, so several
+ * threads may run it at once as long as nothing is being edited.  It must
+ * stay in step with those functions: returning TRUE needlessly only costs
+ * time, but returning FALSE for a transaction that needs repair leaves it
+ * broken.
+ */
+static gboolean
+trans_needs_scrub (const Transaction *trans, gboolean use_trading)
+{
+    gnc_commodity *currency = trans->common_currency;
+    gnc_numeric imbal = gnc_numeric_zero ();
+    gnc_numeric imbal_trading = gnc_numeric_zero ();
+    gboolean multi_commodity = FALSE;
+    MonetaryList *imbal_list = NULL;
+    GList *node;
+
+    /* xaccTransScrubCurrency() */
+    if (!currency || !gnc_commodity_is_currency (currency))
+        return TRUE;
+
+    for (node = trans->splits; node; node = node->next)
+    {
+        const Split *split = node->data;
+        gnc_commodity *acc_commodity;
+
+        /* TransScrubOrphansFast() */
+        if (!split->acc)
+            return TRUE;
+
+        /* xaccSplitScrub(), from xaccTransScrubImbalance() */
+        if (gnc_numeric_check (split->value) || gnc_numeric_check (split->amount))
+            return TRUE;
+        acc_commodity = xaccAccountGetCommodity (split->acc);
+        if (!acc_commodity)
+            return TRUE;
+
+        /* Both xaccSplitScrub() and xaccTransScrubCurrency() set the amount
+         * of a split in the transaction's currency to its value. */
+        if (gnc_commodity_equiv (acc_commodity, currency))
+        {
+            if (!gnc_numeric_equal (split->amount, split->value))
+                return TRUE;
+        }
+        else
+            multi_commodity = TRUE;
+
+        /* xaccTransIsBalanced() */
+        if (use_trading && xaccAccountGetType (split->acc) == ACCT_TYPE_TRADING)
+            imbal_trading = gnc_numeric_add (imbal_trading, split->value,
+                                             GNC_DENOM_AUTO, GNC_HOW_DENOM_EXACT);
+        else
+            imbal = gnc_numeric_add (imbal, split->value,
+                                     GNC_DENOM_AUTO, GNC_HOW_DENOM_EXACT);
+    }
+
+    if (!gnc_numeric_zero_p (imbal) || !gnc_numeric_zero_p (imbal_trading))
+        return TRUE;
+    if (!use_trading || !multi_commodity)
+        return FALSE;
+
+    /* The values balance, so with trading accounts the amounts in each
+     * commodity have to balance as well, see xaccTransGetImbalance(). */
+    for (node = trans->splits; node; node = node->next)
+    {
+        const Split *split = node->data;
+        imbal_list = gnc_monetary_list_add_value (imbal_list,
+                                                  xaccAccountGetCommodity (split->acc),
+                                                  split->amount);
+    }
+    imbal_list = gnc_monetary_list_delete_zeros (imbal_list);
+    if (imbal_list)
+    {
+        gnc_monetary_list_free (imbal_list);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+typedef struct
+{
+    GPtrArray *trans;       /* All of the transactions to check */
+    guint start, end;       /* The range this thread checks */
+    gboolean use_trading;
+    gboolean *needs_scrub;  /* Result for each transaction */
+} ScrubCheckPartition;
+
+static gpointer
+scrub_check_partition (gpointer data)
+{
+    ScrubCheckPartition *part = data;
+    guint i;
+
+    for (i = part->start; i < part->end; i++)
+        part->needs_scrub[i] =
+            trans_needs_scrub (g_ptr_array_index (part->trans, i),
+                               part->use_trading);
+    return NULL;
+}
+
+/* Fill needs_scrub with trans_needs_scrub() for each transaction, using a
+ * thread per processor for large sets. */
+static void
+scrub_check_transactions (GPtrArray *trans, gboolean use_trading,
+                          gboolean *needs_scrub,
+                          QofPercentageFunc percentagefunc)
+{
+    const char *message = _( "Looking for imbalances in transaction %u of %u");
+    guint n_workers, i;
+    ScrubCheckPartition *parts;
+    GThread **threads;
+
+    n_workers = MIN (g_get_num_processors (),
+                     trans->len / SCRUB_MIN_TRANS_PER_WORKER);
+    if (n_workers < 2)
+    {
+        for (i = 0; i < trans->len; i++)
+        {
+            if (i % 100 == 0 && percentagefunc)
+            {
+                char *progress_msg = g_strdup_printf (message, i, trans->len);
+                (percentagefunc)(progress_msg, (100 * i) / trans->len);
+                g_free (progress_msg);
+            }
+            needs_scrub[i] = trans_needs_scrub (g_ptr_array_index (trans, i),
+                                                use_trading);
+        }
+        return;
+    }
+
+    /* The progress callback may run the GUI's main loop, and so edit the
+     * transactions the threads are reading, so it isn't called again until
+     * they are done. */
+    if (percentagefunc)
+    {
+        char *progress_msg = g_strdup_printf (message, 0, trans->len);
+        (percentagefunc)(progress_msg, 0);
+        g_free (progress_msg);
+    }
+
+    PINFO ("Checking %u transactions with %u threads", trans->len, n_workers);
+    parts = g_new0 (ScrubCheckPartition, n_workers);
+    threads = g_new0 (GThread*, n_workers);
+    for (i = 0; i < n_workers; i++)
+    {
+        parts[i].trans = trans;
+        parts[i].start = (guint) ((guint64) trans->len * i / n_workers);
+        parts[i].end = (guint) ((guint64) trans->len * (i + 1) / n_workers);
+        parts[i].use_trading = use_trading;
+        parts[i].needs_scrub = needs_scrub;
+        threads[i] = g_thread_try_new ("scrub-check", scrub_check_partition,
+                                       &parts[i], NULL);
+        if (!threads[i])
+            scrub_check_partition (&parts[i]);
+    }
+
+    for (i = 0; i < n_workers; i++)
+        if (threads[i])
+            g_thread_join (threads[i]);
+    g_free (threads);
+    g_free (parts);
+}
+
+/* Scrub every transaction with a split in one of the accounts once: find
+ * the ones that need it, then repair just those. */
+static void
+scrub_imbalance_in_accounts (GList *accounts, Account *root,
+                             QofPercentageFunc percentagefunc)
+{
+    const char *message = _( "Repairing imbalanced transaction %u of %u");
+    GHashTable *seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GPtrArray *trans = g_ptr_array_new ();
+    gboolean *needs_scrub;
+    guint i, n_repairs = 0, repaired = 0;
+    GList *node, *snode;
+
+    for (node = accounts; node; node = node->next)
+    {
+        for (snode = xaccAccountGetSplitList (node->data); snode;
+             snode = snode->next)
+        {
+            Transaction *t = xaccSplitGetParent (snode->data);
+            if (t && !g_hash_table_contains (seen, t))
+            {
+                g_hash_table_add (seen, t);
+                g_ptr_array_add (trans, t);
+            }
+        }
+    }
+    g_hash_table_destroy (seen);
+
+    if (trans->len == 0)
+    {
+        g_ptr_array_free (trans, TRUE);
+        return;
+    }
+
+    needs_scrub = g_new0 (gboolean, trans->len);
+    scrub_check_transactions (trans,
+                              qof_book_use_trading_accounts (gnc_account_get_book (root)),
+                              needs_scrub, percentagefunc);
+
+    for (i = 0; i < trans->len; i++)
+        if (needs_scrub[i])
+            n_repairs++;
+    PINFO ("%u of %u transactions need repair", n_repairs, trans->len);
+
+    for (i = 0; i < trans->len; i++)
+    {
+        Transaction *t = g_ptr_array_index (trans, i);
+
+        if (!needs_scrub[i])
+            continue;
+
+        if (repaired % 10 == 0 && percentagefunc)
+        {
+            char *progress_msg = g_strdup_printf (message, repaired, n_repairs);
+            (percentagefunc)(progress_msg, (100 * repaired) / n_repairs);
+            g_free (progress_msg);
+        }
+
+        TransScrubOrphansFast (t, root);
+        xaccTransScrubCurrency (t);
+        xaccTransScrubImbalance (t, root, NULL);
+        repaired++;
+    }
+
+    g_free (needs_scrub);
+    g_ptr_array_free (trans, TRUE);
+}
+
 void
 xaccAccountTreeScrubImbalance (Account *acc, QofPercentageFunc percentagefunc)
 {
-    xaccAccountScrubImbalance (acc, percentagefunc);
-    gnc_account_foreach_descendant(acc,
-                                   (AccountCb)xaccAccountScrubImbalance, percentagefunc);
+    GList *accounts;
+
+    if (!acc) return;
+
+    accounts = g_list_prepend (gnc_account_get_descendants (acc), acc);
+    scrub_imbalance_in_accounts (accounts, gnc_account_get_root (acc),
+                                 percentagefunc);
+    g_list_free (accounts);
+    if (percentagefunc)
+        (percentagefunc)(NULL, -1.0);
 }
 
 void
 xaccAccountScrubImbalance (Account *acc, QofPercentageFunc percentagefunc)
 {
-    GList *node, *splits;
+    GList *accounts;
     const char *str;
-    const char *message = _( "Looking for imbalances in account %s: %u of %u");
-    gint split_count = 0, curr_split_no = 0;
 
     if (!acc) return;
 
@@ -310,36 +551,21 @@ xaccAccountScrubImbalance (Account *acc, QofPercentageFunc percentagefunc)
     str = str ? str : "(null)";
     PINFO ("Looking for imbalances in account %s \n", str);
 
-    splits = xaccAccountGetSplitList(acc);
-    split_count = g_list_length (splits);
-    for (node = splits; node; node = node->next)
-    {
-        Split *split = node->data;
-        Transaction *trans = xaccSplitGetParent(split);
-
-        PINFO("Start processing split %d of %d",
-              curr_split_no + 1, split_count);
-
-        if (curr_split_no % 100 == 0)
-        {
-            char *progress_msg = g_strdup_printf (message, str, curr_split_no, split_count);
-            (percentagefunc)(progress_msg, (100 * curr_split_no) / split_count);
-            g_free (progress_msg);
-        }
-
-        TransScrubOrphansFast (xaccSplitGetParent (split),
-                               gnc_account_get_root (acc));
-        (percentagefunc)(NULL, 0.0);
-
-        xaccTransScrubCurrency(trans);
+    accounts = g_list_prepend (NULL, acc);
+    scrub_imbalance_in_accounts (accounts, gnc_account_get_root (acc),
+                                 percentagefunc);
+    g_list_free (accounts);
+    if (percentagefunc)
+        (percentagefunc)(NULL, -1.0);
+}
 
-        xaccTransScrubImbalance (trans, gnc_account_get_root (acc), NULL);
+void
+xaccBookScrubImbalance (QofBook *book, QofPercentageFunc percentagefunc)
+{
+    if (!book) return;
 
-        PINFO("Finished processing split %d of %d",
-              curr_split_no + 1, split_count);
-        curr_split_no++;
-    }
-    (percentagefunc)(NULL, -1.0);
+    xaccAccountTreeScrubImbalance (gnc_book_get_root_account (book),
+                                   percentagefunc);
 }
 
 static Split *
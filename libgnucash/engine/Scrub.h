@@ -108,8 +108,17 @@ void xaccAccountTreeScrubSplits (Account *account);
  */
 void xaccTransScrubImbalance (Transaction *trans, Account *root,
                               Account *parent);
+
+/** The account, account tree and book versions also fix orphan splits
+ *    and missing currencies, like xaccTransScrubOrphans() and
+ *    xaccTransScrubCurrency() do.  Each transaction is visited once even
+ *    if it has several splits in the accounts.  The transactions are first
+ *    checked in parallel, without changing them, and only those that need
+ *    it are then repaired.  Nothing else may edit the book meanwhile.
+ */
 void xaccAccountScrubImbalance (Account *acc, QofPercentageFunc percentagefunc);
 void xaccAccountTreeScrubImbalance (Account *acc, QofPercentageFunc percentagefunc);
+void xaccBookScrubImbalance (QofBook *book, QofPercentageFunc percentagefunc);
 
 /** The xaccTransScrubCurrency method fixes transactions without a
  * common_currency by looking for the most commonly used currency
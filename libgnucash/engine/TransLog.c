@@ -152,6 +152,12 @@ xaccFileIsCurrentLog (const gchar *name)
     return result;
 }
 
+const gchar *
+xaccLogGetFileName (void)
+{
+    return trans_log ? trans_log_name : NULL;
+}
+
 /********************************************************************\
 \********************************************************************/
 
@@ -81,6 +81,10 @@ void    xaccLogSetBaseName (const char *);
 /** Test a filename to see if it is the name of the current logfile */
 gboolean xaccFileIsCurrentLog (const gchar *name);
 
+/** The name of the current logfile without its directory, or NULL if no
+ *  logfile is open. */
+const gchar *xaccLogGetFileName (void);
+
 #endif /* XACC_TRANS_LOG_H */
 /** @} */
 /** @} */
@@ -2207,12 +2207,12 @@ xaccTransSetIsClosingTxn (Transaction *trans, gboolean is_closing)
         g_value_init (&v, G_TYPE_INT64);
         g_value_set_int64 (&v, 1);
         qof_instance_set_kvp (QOF_INSTANCE (trans), &v, 1, trans_is_closing_str);
-        trans->isClosingTxn_cached = 1;
+        g_atomic_int_set (&trans->isClosingTxn_cached, 1);
     }
     else
     {
         qof_instance_set_kvp (QOF_INSTANCE (trans), NULL, 1, trans_is_closing_str);
-        trans->isClosingTxn_cached = 0;
+        g_atomic_int_set (&trans->isClosingTxn_cached, 0);
     }
     qof_instance_set_dirty(QOF_INSTANCE(trans));
     xaccTransCommitEdit(trans);
@@ -2369,18 +2369,23 @@ xaccTransGetNotes (const Transaction *trans)
 gboolean
 xaccTransGetIsClosingTxn (const Transaction *trans)
 {
+    Transaction* trans_nonconst = (Transaction*) trans;
+    gint is_closing;
+
     if (!trans) return FALSE;
-    if (trans->isClosingTxn_cached == -1)
+    /* Queries may run this from several threads at once, see qofquery.cpp. */
+    is_closing = g_atomic_int_get (&trans_nonconst->isClosingTxn_cached);
+    if (is_closing == -1)
     {
-        Transaction* trans_nonconst = (Transaction*) trans;
         GValue v = G_VALUE_INIT;
         qof_instance_get_kvp (QOF_INSTANCE (trans), &v, 1, trans_is_closing_str);
         if (G_VALUE_HOLDS_INT64 (&v))
-            trans_nonconst->isClosingTxn_cached = (g_value_get_int64 (&v) ? 1 : 0);
+            is_closing = (g_value_get_int64 (&v) ? 1 : 0);
         else
-            trans_nonconst->isClosingTxn_cached = 0;
+            is_closing = 0;
+        g_atomic_int_set (&trans_nonconst->isClosingTxn_cached, is_closing);
     }
-    return (trans->isClosingTxn_cached == 1)
+    return (is_closing == 1)
             ? TRUE
             : FALSE;
 }
@@ -183,7 +183,78 @@ functions. */
 %typemap(in) char * action;
 
 %include <policy.h>
+
+/* gnc-pricedb-lookup-latest-before-matrix takes a list of dates and returns
+ * a list with one list of values per commodity; the matrix is freed here. */
+%typemap(in) (const time64 *dates, guint n_dates) {
+  SCM list = $input;
+  guint i = 0;
+
+  $2 = scm_to_uint (scm_length (list));
+  $1 = g_new (time64, $2);
+  for (; !scm_is_null (list); list = SCM_CDR (list))
+    $1[i++] = scm_to_int64 (SCM_CAR (list));
+}
+%typemap(freearg) (const time64 *dates, guint n_dates) "g_free ($1);"
+
+%typemap(out) GNCPriceMatrix * {
+  SCM rows = SCM_EOL;
+  guint row, col;
+
+  for (row = 0; $1 && row < $1->n_commodities; row++)
+  {
+    SCM values = SCM_EOL;
+    for (col = 0; col < $1->n_dates; col++)
+      values = scm_cons (gnc_numeric_to_scm (gnc_price_matrix_get_value ($1, row, col)),
+                         values);
+    rows = scm_cons (scm_reverse (values), rows);
+  }
+  gnc_price_matrix_free ($1);
+  $result = scm_reverse (rows);
+}
+%ignore gnc_price_matrix_get_value;
+%ignore gnc_price_matrix_free;
+
+/* The price samples come back as a list of SRFI-4 vectors: (times values
+ * min max avg counts), the last four being #f for a plain range scan. */
+%{
+static SCM
+price_samples_doubles_to_scm (const double *values, guint len)
+{
+    double *copy;
+
+    if (!values)
+        return SCM_BOOL_F;
+    copy = malloc (len * sizeof (double));
+    memcpy (copy, values, len * sizeof (double));
+    return scm_take_f64vector (copy, len);
+}
+%}
+%typemap(out) GNCPriceSamples * {
+  gint64 *times = malloc ($1->len * sizeof (gint64));
+  SCM counts = SCM_BOOL_F;
+
+  memcpy (times, $1->times, $1->len * sizeof (gint64));
+  if ($1->counts)
+  {
+    guint32 *copy = malloc ($1->len * sizeof (guint32));
+    memcpy (copy, $1->counts, $1->len * sizeof (guint32));
+    counts = scm_take_u32vector (copy, $1->len);
+  }
+  $result = scm_list_n (scm_take_s64vector (times, $1->len),
+                        price_samples_doubles_to_scm ($1->values, $1->len),
+                        price_samples_doubles_to_scm ($1->min, $1->len),
+                        price_samples_doubles_to_scm ($1->max, $1->len),
+                        price_samples_doubles_to_scm ($1->avg, $1->len),
+                        counts, SCM_UNDEFINED);
+  gnc_price_samples_free ($1);
+}
+%ignore gnc_price_samples_free;
+
 %include <gnc-pricedb.h>
+%clear (const time64 *dates, guint n_dates);
+%clear GNCPriceMatrix *;
+%clear GNCPriceSamples *;
 
 QofSession * qof_session_new (void);
 QofBook * qof_session_get_book (QofSession *session);
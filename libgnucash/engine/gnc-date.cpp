@@ -1113,11 +1113,153 @@ gnc_date_timestamp (void)
  */
 
 #define ISO_DATE_FORMAT "%d-%d-%d %d:%d:%lf%s"
+
+/* The backends write and read back "YYYY-MM-DD HH:MM:SS", optionally
+ * followed by a zone offset, for every split and price. The functions below
+ * handle that layout by hand and leave everything else to GncDateTime, whose
+ * regular expressions and time zone objects cost far more than the
+ * conversion itself. */
+static constexpr time64 iso_last_time = MAXTIME + 86399; // 9999-12-31 23:59:59
+
+/* Days since 1970-01-01 of the proleptic Gregorian date; see
+ * http://howardhinnant.github.io/date_algorithms.html */
+static int64_t
+days_from_civil (int64_t year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    auto era = (year >= 0 ? year : year - 399) / 400;
+    auto yoe = static_cast<unsigned>(year - era * 400);
+    auto doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    auto doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+static void
+civil_from_days (int64_t days, int64_t *year, unsigned *month, unsigned *day)
+{
+    days += 719468;
+    auto era = (days >= 0 ? days : days - 146096) / 146097;
+    auto doe = static_cast<unsigned>(days - era * 146097);
+    auto yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    auto doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    auto mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = static_cast<int64_t>(yoe) + era * 400 + (*month <= 2);
+}
+
+static bool
+parse_iso_digits (const char *str, int n_digits, int *value)
+{
+    *value = 0;
+    for (int i = 0; i < n_digits; ++i)
+    {
+        if (str[i] < '0' || str[i] > '9')
+            return false;
+        *value = *value * 10 + (str[i] - '0');
+    }
+    return true;
+}
+
+static int
+iso_days_in_month (int month, int year)
+{
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    return days[month - 1] + (month == 2 && leap);
+}
+
+static char*
+put_iso_digits (char *buff, int n_digits, unsigned value)
+{
+    for (int i = n_digits - 1; i >= 0; --i, value /= 10)
+        buff[i] = '0' + value % 10;
+    return buff + n_digits;
+}
+
+static bool
+iso_space (char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+        c == '\v' || c == '\f';
+}
+
+/* Parse "YYYY-MM-DD HH:MM:SS", optional white space and an optional offset
+ * of the form +HH, +HHMM or +HH:MM, or a bare YYYYMMDDHHMMSS. Returns false
+ * for anything else, including fractional seconds, or for a time outside the
+ * supported range, so that the caller falls back to GncDateTime. */
+static bool
+fast_iso8601_to_time64 (const char *str, time64 *time)
+{
+    int year, month, day, hour, min, sec;
+    if (!parse_iso_digits (str, 4, &year))
+        return false;
+    auto delimited = str[4] == '-';
+    if (delimited)
+    {
+        if (!parse_iso_digits (str + 5, 2, &month) || str[7] != '-' ||
+            !parse_iso_digits (str + 8, 2, &day) || str[10] != ' ' ||
+            !parse_iso_digits (str + 11, 2, &hour) || str[13] != ':' ||
+            !parse_iso_digits (str + 14, 2, &min) || str[16] != ':' ||
+            !parse_iso_digits (str + 17, 2, &sec))
+            return false;
+    }
+    /* YYYYMMDDHHMMSS, which older SQL databases hold. */
+    else if (!parse_iso_digits (str + 4, 2, &month) ||
+             !parse_iso_digits (str + 6, 2, &day) ||
+             !parse_iso_digits (str + 8, 2, &hour) ||
+             !parse_iso_digits (str + 10, 2, &min) ||
+             !parse_iso_digits (str + 12, 2, &sec))
+        return false;
+    if (year < 1400 || month < 1 || month > 12 || day < 1 ||
+        day > iso_days_in_month (month, year) ||
+        hour > 23 || min > 59 || sec > 59)
+        return false;
+
+    auto cursor = str + (delimited ? 19 : 14);
+    while (iso_space (*cursor))
+        ++cursor;
+
+    int offset = 0;
+    if (delimited && (*cursor == '+' || *cursor == '-'))
+    {
+        int sign = *cursor == '-' ? -1 : 1, off_hour, off_min = 0;
+        if (!parse_iso_digits (cursor + 1, 2, &off_hour))
+            return false;
+        cursor += 3;
+        if (*cursor)
+        {
+            if (*cursor == ':')
+                ++cursor;
+            if (!parse_iso_digits (cursor, 2, &off_min))
+                return false;
+            cursor += 2;
+        }
+        if (off_min > 59)
+            return false;
+        offset = sign * (off_hour * 3600 + off_min * 60);
+        /* Leave what boost's posix_time_zone rejects to it, as well as the
+         * offsets under an hour that GncDateTime treats specially (Bug
+         * 767824). */
+        if (offset < -12 * 3600 || offset > 14 * 3600 ||
+            (offset != 0 && offset > -3600 && offset < 3600))
+            return false;
+    }
+    if (*cursor)
+        return false;
+
+    *time = days_from_civil (year, month, day) * 86400 +
+        hour * 3600 + min * 60 + sec - offset;
+    return *time >= MINTIME && *time <= iso_last_time;
+}
+
 time64
 gnc_iso8601_to_time64_gmt(const char *cstr)
 {
     time64 time;
     if (!cstr) return INT64_MAX;
+    if (fast_iso8601_to_time64 (cstr, &time))
+        return time;
     try
     {
         GncDateTime gncdt(cstr);
@@ -1144,6 +1286,31 @@ gnc_time64_to_iso8601_buff (time64 time, char * buff)
     constexpr size_t max_iso_date_length = 32;
 
     if (! buff) return NULL;
+    if (time >= MINTIME && time <= iso_last_time)
+    {
+        auto days = time / 86400, secs = time % 86400;
+        if (secs < 0)
+        {
+            --days;
+            secs += 86400;
+        }
+        int64_t year;
+        unsigned month, day;
+        civil_from_days (days, &year, &month, &day);
+        auto end = put_iso_digits (buff, 4, year);
+        *end++ = '-';
+        end = put_iso_digits (end, 2, month);
+        *end++ = '-';
+        end = put_iso_digits (end, 2, day);
+        *end++ = ' ';
+        end = put_iso_digits (end, 2, secs / 3600);
+        *end++ = ':';
+        end = put_iso_digits (end, 2, secs / 60 % 60);
+        *end++ = ':';
+        end = put_iso_digits (end, 2, secs % 60);
+        *end = '\0';
+        return end;
+    }
     try
     {
         GncDateTime gncdt(time);
@@ -281,6 +281,9 @@ gnc_hooks_init(void)
                     "Run before file close.  Hook args: <gnc:Session*>");
     gnc_hook_create(HOOK_BOOK_SAVED, 1,
                     "Run after file saved.  Hook args: <gnc:Session*>");
+    gnc_hook_create(HOOK_BOOK_SAVE_FAILED, 1,
+                    "Run when a save that went on after the file was reported"
+                    " saved fails.  Hook args: <gnc:Session*>");
 
     LEAVE("");
 }
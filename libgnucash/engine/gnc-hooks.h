@@ -65,5 +65,6 @@ void gnc_hooks_init(void);
 #define HOOK_BOOK_OPENED	"hook_book_opened"
 #define HOOK_BOOK_CLOSED	"hook_book_closed"
 #define HOOK_BOOK_SAVED		"hook_book_saved"
+#define HOOK_BOOK_SAVE_FAILED	"hook_book_save_failed"
 
 #endif /* GNC_HOOKS_H */
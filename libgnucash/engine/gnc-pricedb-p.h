@@ -57,7 +57,12 @@ struct gnc_price_db_s
     QofInstance inst;              /* globally unique object identifier */
     GHashTable *commodity_hash;
     gboolean bulk_update;		 /* TRUE while reading XML file, etc. */
-    gboolean reset_nth_price_cache;
+    GHashTable *commodity_views;   /* All prices of a commodity, sorted */
+    GHashTable *conversion_cache;  /* Prices for indirect conversions */
+    guint conversion_cache_hits;
+    guint conversion_cache_misses;
+    GHashTable *rate_tables;       /* Cached price graph searches */
+    GHashTable *price_graphs;      /* Cached price graph edges by time */
 };
 
 struct _GncPriceDBClass
@@ -29,6 +29,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "gnc-date.h"
+#include "gnc-event.h"
 #include "gnc-pricedb-p.h"
 #include <qofinstance-p.h>
 
@@ -40,9 +41,10 @@ static gboolean remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup);
 static GNCPrice *lookup_nearest_in_time(GNCPriceDB *db, const gnc_commodity *c,
                                         const gnc_commodity *currency,
                                         time64 t, gboolean sameday);
+static void conversion_cache_invalidate(GNCPriceDB *db);
 static gboolean
 pricedb_pricelist_traversal(GNCPriceDB *db,
-                            gboolean (*f)(GList *p, gpointer user_data),
+                            gboolean (*f)(GPtrArray *p, gpointer user_data),
                             gpointer user_data);
 
 enum
@@ -578,6 +580,8 @@ gnc_price_set_value(GNCPrice *p, gnc_numeric value)
         p->value = value;
         gnc_price_set_dirty(p);
         gnc_price_commit_edit (p);
+        if (p->db)
+            conversion_cache_invalidate (p->db);
     }
 }
 
@@ -822,24 +826,354 @@ gnc_price_list_equal(PriceList *prices1, PriceList *prices2)
     return TRUE;
 }
 
+/* ==================================================================== */
+/* price series functions
+
+   Inside the price DB the prices of one commodity in one currency are
+   kept in a GPtrArray, a "price series", sorted the same way as a
+   PriceList: newest first.  That lets the lookups by date do a binary
+   search instead of walking a list.  The series holds a reference to
+   each of its prices.
+ */
+
+/* Returns the index of the first price in the series that is at or before
+ * t, or strictly before t if strict is TRUE.  Returns series->len if all
+ * of the prices are later than that.
+ */
+static guint
+price_series_index_before (const GPtrArray *series, time64 t, gboolean strict)
+{
+    guint lo = 0, hi = series->len;
+
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        time64 price_t = gnc_price_get_time64 (g_ptr_array_index (series, mid));
+
+        if (price_t < t || (!strict && price_t == t))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+/* A price is a duplicate if the series has another one on the same day with
+ * the same value, see price_list_is_duplicate().  Prices on the same day are
+ * next to each other, so only the neighbours of index need to be checked.
+ */
+static gboolean
+price_series_is_duplicate (const GPtrArray *series, guint index, GNCPrice *p)
+{
+    time64 day = time64CanonicalDayTime (gnc_price_get_time64 (p));
+    gnc_numeric value = gnc_price_get_value (p);
+    guint i;
+
+    for (i = index; i > 0; --i)
+    {
+        GNCPrice *other = g_ptr_array_index (series, i - 1);
+        if (time64CanonicalDayTime (gnc_price_get_time64 (other)) != day)
+            break;
+        if (gnc_numeric_equal (gnc_price_get_value (other), value))
+            return TRUE;
+    }
+    for (i = index; i < series->len; ++i)
+    {
+        GNCPrice *other = g_ptr_array_index (series, i);
+        if (time64CanonicalDayTime (gnc_price_get_time64 (other)) != day)
+            break;
+        if (gnc_numeric_equal (gnc_price_get_value (other), value))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* The series equivalent of gnc_price_list_insert().  Returns FALSE if p was
+ * a duplicate and wasn't inserted.
+ */
+static gboolean
+price_series_insert (GPtrArray *series, GNCPrice *p, gboolean check_dupl)
+{
+    guint lo = 0, hi = series->len;
+
+    gnc_price_ref (p);
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+
+        if (compare_prices_by_date (g_ptr_array_index (series, mid), p) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (check_dupl && price_series_is_duplicate (series, lo, p))
+        return FALSE;
+
+    g_ptr_array_insert (series, lo, p);
+    return TRUE;
+}
+
+/* The series equivalent of gnc_price_list_remove().  Returns FALSE if p
+ * wasn't in the series.
+ */
+static gboolean
+price_series_remove (GPtrArray *series, GNCPrice *p)
+{
+    time64 t = gnc_price_get_time64 (p);
+    guint i;
+
+    for (i = price_series_index_before (series, t, FALSE); i < series->len; ++i)
+    {
+        GNCPrice *other = g_ptr_array_index (series, i);
+        if (other == p)
+        {
+            g_ptr_array_remove_index (series, i);
+            gnc_price_unref (p);
+            return TRUE;
+        }
+        if (gnc_price_get_time64 (other) != t)
+            return FALSE;
+    }
+    return FALSE;
+}
+
+/* Returns a PriceList with the prices of the series.  The prices are not
+ * reffed, so free it with g_list_free().
+ */
+static PriceList *
+price_series_to_list (const GPtrArray *series)
+{
+    PriceList *result = NULL;
+    guint i;
+
+    for (i = series->len; i > 0; --i)
+        result = g_list_prepend (result, g_ptr_array_index (series, i - 1));
+    return result;
+}
+
+/* ==================================================================== */
+/* Commodity views
+
+   Each commodity with prices also has a view: an array of all of its
+   prices in any currency, sorted like the series.  It gives
+   gnc_pricedb_nth_price() constant time access and
+   gnc_pricedb_price_index() a binary search, and is updated along with
+   the series rather than rebuilt.  The series hold the references, the
+   views don't.
+ */
+
+/* Returns the index in view at which p is or would be inserted. */
+static guint
+price_view_position (const GPtrArray *view, const GNCPrice *p)
+{
+    guint lo = 0, hi = view->len;
+
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+
+        if (compare_prices_by_date (g_ptr_array_index (view, mid), p) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void
+pricedb_view_insert (GNCPriceDB *db, GNCPrice *p)
+{
+    GPtrArray *view = g_hash_table_lookup (db->commodity_views, p->commodity);
+
+    if (!view)
+    {
+        view = g_ptr_array_new ();
+        g_hash_table_insert (db->commodity_views, p->commodity, view);
+    }
+    g_ptr_array_insert (view, price_view_position (view, p), p);
+}
+
+static void
+pricedb_view_remove (GNCPriceDB *db, GNCPrice *p)
+{
+    GPtrArray *view = g_hash_table_lookup (db->commodity_views, p->commodity);
+    guint i;
+
+    if (!view) return;
+    i = price_view_position (view, p);
+    if (i < view->len && g_ptr_array_index (view, i) == p)
+        g_ptr_array_remove_index (view, i);
+    if (view->len == 0)
+        g_hash_table_remove (db->commodity_views, p->commodity);
+}
+
+/* Takes the prices in drop out of the view of commodity and merges in add,
+ * which must be sorted, in a single pass. */
+static void
+pricedb_view_merge (GNCPriceDB *db, gnc_commodity *commodity,
+                    const GPtrArray *add, GHashTable *drop)
+{
+    GPtrArray *view = g_hash_table_lookup (db->commodity_views, commodity);
+    GPtrArray *merged;
+    guint i, j, kept;
+
+    if (!view)
+    {
+        if (add->len == 0) return;
+        view = g_ptr_array_new ();
+        g_hash_table_insert (db->commodity_views, commodity, view);
+    }
+
+    if (g_hash_table_size (drop) > 0)
+    {
+        for (i = 0, kept = 0; i < view->len; i++)
+            if (!g_hash_table_contains (drop, g_ptr_array_index (view, i)))
+                view->pdata[kept++] = g_ptr_array_index (view, i);
+        g_ptr_array_set_size (view, kept);
+    }
+
+    if (add->len > 0)
+    {
+        merged = g_ptr_array_sized_new (view->len + add->len);
+        for (i = 0, j = 0; j < add->len; j++)
+        {
+            GNCPrice *p = g_ptr_array_index (add, j);
+
+            while (i < view->len &&
+                   compare_prices_by_date (g_ptr_array_index (view, i), p) < 0)
+                g_ptr_array_add (merged, g_ptr_array_index (view, i++));
+            g_ptr_array_add (merged, p);
+        }
+        for (; i < view->len; i++)
+            g_ptr_array_add (merged, g_ptr_array_index (view, i));
+        /* Replacing the value frees the old view. */
+        g_hash_table_insert (db->commodity_views, commodity, merged);
+        view = merged;
+    }
+
+    if (view->len == 0)
+        g_hash_table_remove (db->commodity_views, commodity);
+}
+
 /* ==================================================================== */
 /* GNCPriceDB functions
 
    Structurally a GNCPriceDB contains a hash mapping price commodities
    (of type gnc_commodity*) to hashes mapping price currencies (of
-   type gnc_commodity*) to GNCPrice lists (see gnc-pricedb.h for a
-   description of GNCPrice lists).  The top-level key is the commodity
-   you want the prices for, and the second level key is the commodity
-   that the value is expressed in terms of.
+   type gnc_commodity*) to price series (see above).  The top-level key
+   is the commodity you want the prices for, and the second level key is
+   the commodity that the value is expressed in terms of.
+ */
+
+/* The conversion cache remembers the pair of prices that
+   indirect_balance_conversion() found for converting between two
+   commodities at a given time, or that it found none.  The rate tables
+   of the price graph (see below) are cached the same way, keyed by the
+   commodity they start from, and so are the graph's edges, keyed by the
+   time alone, so that a search from another commodity doesn't have to walk
+   every price series again.  All of them are emptied whenever a price is
+   added, removed or changes value.
  */
 
+/* Drop the caches once they're this big, reports asking for many different
+   dates would otherwise grow them without bound. */
+#define CONVERSION_CACHE_MAX_ENTRIES 10000
+#define RATE_TABLE_CACHE_MAX_ENTRIES 1000
+#define PRICE_GRAPH_CACHE_MAX_ENTRIES 100
+
+typedef struct
+{
+    const gnc_commodity *from;
+    const gnc_commodity *to;
+    time64 t;                   /* INT64_MAX for the latest prices */
+} ConversionKey;
+
+typedef struct
+{
+    GNCPrice *from;             /* Both NULL if there's no conversion */
+    GNCPrice *to;
+    time64 expires;             /* When a newer price becomes the latest */
+} ConversionEntry;
+
+static guint
+conversion_key_hash (gconstpointer key)
+{
+    const ConversionKey *k = key;
+    return g_direct_hash (k->from) ^ (g_direct_hash (k->to) << 1) ^
+        g_int64_hash (&k->t);
+}
+
+static gboolean
+conversion_key_equal (gconstpointer a, gconstpointer b)
+{
+    const ConversionKey *ka = a, *kb = b;
+    return ka->from == kb->from && ka->to == kb->to && ka->t == kb->t;
+}
+
+static void
+conversion_entry_free (gpointer data)
+{
+    ConversionEntry *entry = data;
+    gnc_price_unref (entry->from);
+    gnc_price_unref (entry->to);
+    g_free (entry);
+}
+
+typedef struct
+{
+    GHashTable *rates;          /* gnc_commodity* -> RateEntry* */
+    time64 expires;             /* When a newer price becomes the latest */
+} RateTable;
+
+typedef struct
+{
+    gnc_numeric rate;           /* Units of this commodity per unit of the
+                                 * table's commodity */
+    guint hops;                 /* Number of prices used */
+    time64 staleness;           /* Largest distance of one of them from the
+                                 * table's time */
+} RateEntry;
+
+static void
+rate_table_free (gpointer data)
+{
+    RateTable *table = data;
+    g_hash_table_destroy (table->rates);
+    g_free (table);
+}
+
+typedef struct
+{
+    GHashTable *edges;          /* gnc_commodity* -> GArray of PriceEdge */
+    time64 expires;             /* When a newer price becomes the latest */
+} PriceGraph;
+
+static void
+price_graph_free (gpointer data)
+{
+    PriceGraph *graph = data;
+    g_hash_table_destroy (graph->edges);
+    g_free (graph);
+}
+
+static void
+conversion_cache_invalidate (GNCPriceDB *db)
+{
+    if (db->conversion_cache)
+        g_hash_table_remove_all (db->conversion_cache);
+    if (db->rate_tables)
+        g_hash_table_remove_all (db->rate_tables);
+    if (db->price_graphs)
+        g_hash_table_remove_all (db->price_graphs);
+}
+
 /* GObject Initialization */
 QOF_GOBJECT_IMPL(gnc_pricedb, GNCPriceDB, QOF_TYPE_INSTANCE);
 
 static void
 gnc_pricedb_init(GNCPriceDB* pdb)
 {
-    pdb->reset_nth_price_cache = FALSE;
 }
 
 static void
@@ -882,6 +1216,17 @@ gnc_pricedb_create(QofBook * book)
 
     result->commodity_hash = g_hash_table_new(NULL, NULL);
     g_return_val_if_fail (result->commodity_hash, NULL);
+    result->commodity_views = g_hash_table_new_full (NULL, NULL, NULL,
+                                                     (GDestroyNotify) g_ptr_array_unref);
+    result->conversion_cache = g_hash_table_new_full (conversion_key_hash,
+                                                      conversion_key_equal,
+                                                      g_free,
+                                                      conversion_entry_free);
+    result->rate_tables = g_hash_table_new_full (conversion_key_hash,
+                                                 conversion_key_equal,
+                                                 g_free, rate_table_free);
+    result->price_graphs = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                                  g_free, price_graph_free);
     return result;
 }
 
@@ -890,18 +1235,18 @@ destroy_pricedb_currency_hash_data(gpointer key,
                                    gpointer data,
                                    gpointer user_data)
 {
-    GList *price_list = (GList *) data;
-    GList *node;
-    GNCPrice *p;
+    GPtrArray *series = (GPtrArray *) data;
+    guint i;
 
-    for (node = price_list; node; node = node->next)
+    for (i = 0; i < series->len; i++)
     {
-        p = node->data;
+        GNCPrice *p = g_ptr_array_index (series, i);
 
         p->db = NULL;
+        gnc_price_unref (p);
     }
 
-    gnc_price_list_destroy(price_list);
+    g_ptr_array_free (series, TRUE);
 }
 
 static void
@@ -929,6 +1274,18 @@ gnc_pricedb_destroy(GNCPriceDB *db)
     }
     g_hash_table_destroy (db->commodity_hash);
     db->commodity_hash = NULL;
+    if (db->commodity_views)
+        g_hash_table_destroy (db->commodity_views);
+    db->commodity_views = NULL;
+    if (db->conversion_cache)
+        g_hash_table_destroy (db->conversion_cache);
+    db->conversion_cache = NULL;
+    if (db->rate_tables)
+        g_hash_table_destroy (db->rate_tables);
+    db->rate_tables = NULL;
+    if (db->price_graphs)
+        g_hash_table_destroy (db->price_graphs);
+    db->price_graphs = NULL;
     /* qof_instance_release (&db->inst); */
     g_object_unref(db);
 }
@@ -1011,7 +1368,7 @@ pricedb_equal_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
     GNCPriceDBEqualData *equal_data = user_data;
     gnc_commodity *currency = key;
-    GList *price_list1 = val;
+    GList *price_list1 = price_series_to_list (val);
     GList *price_list2;
 
     price_list2 = gnc_pricedb_get_prices (equal_data->db2,
@@ -1021,6 +1378,7 @@ pricedb_equal_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
     if (!gnc_price_list_equal (price_list1, price_list2))
         equal_data->equal = FALSE;
 
+    g_list_free (price_list1);
     gnc_price_list_destroy (price_list2);
 }
 
@@ -1070,7 +1428,7 @@ add_price(GNCPriceDB *db, GNCPrice *p)
 {
     /* This function will use p, adding a ref, so treat p as read-only
        if this function succeeds. */
-    GList *price_list;
+    GPtrArray *series;
     gnc_commodity *commodity;
     gnc_commodity *currency;
     GHashTable *currency_hash;
@@ -1131,21 +1489,16 @@ add_price(GNCPriceDB *db, GNCPrice *p)
         g_hash_table_insert(db->commodity_hash, commodity, currency_hash);
     }
 
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    if (!gnc_price_list_insert(&price_list, p, !db->bulk_update))
-    {
-        LEAVE ("gnc_price_list_insert failed");
-        return FALSE;
-    }
-
-    if (!price_list)
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
-        LEAVE (" no price list");
-        return FALSE;
+        series = g_ptr_array_new();
+        g_hash_table_insert(currency_hash, currency, series);
     }
-
-    g_hash_table_insert(currency_hash, currency, price_list);
+    if (price_series_insert(series, p, !db->bulk_update))
+        pricedb_view_insert(db, p);
     p->db = db;
+    conversion_cache_invalidate(db);
 
     qof_event_gen (&p->inst, QOF_EVENT_ADD, NULL);
 
@@ -1188,100 +1541,461 @@ gnc_pricedb_add_price(GNCPriceDB *db, GNCPrice *p)
     return TRUE;
 }
 
-/* remove_price() is a utility; its only function is to remove the price
- * from the double-hash tables.
+/* ==================================================================== */
+/* Bulk insertion.  gnc_pricedb_add_prices() gives the same result as
+ * calling gnc_pricedb_add_price() on each price of a batch in turn, but
+ * sorts the prices of each series once and merges them into it in a
+ * single pass instead of inserting them one by one.
  */
 
+typedef struct
+{
+    GPtrArray *add;             /* reffed prices to merge into the series */
+    GHashTable *drop;           /* prices to take out of the series */
+} PriceBatch;
+
+typedef struct
+{
+    const gnc_commodity *a;
+    const gnc_commodity *b;
+    time64 day;
+} PriceDayKey;
+
+static guint
+price_day_key_hash (gconstpointer key)
+{
+    const PriceDayKey *k = key;
+    return g_direct_hash (k->a) ^ (g_direct_hash (k->b) * 31) ^
+        g_int64_hash (&k->day);
+}
+
 static gboolean
-remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)
+price_day_key_equal (gconstpointer a, gconstpointer b)
 {
-    GList *price_list;
-    gnc_commodity *commodity;
-    gnc_commodity *currency;
-    GHashTable *currency_hash;
+    const PriceDayKey *ka = a, *kb = b;
+    return ka->a == kb->a && ka->b == kb->b && ka->day == kb->day;
+}
 
-    if (!db || !p) return FALSE;
-    ENTER ("db=%p, pr=%p dirty=%d destroying=%d",
-           db, p, qof_instance_get_dirty_flag(p),
-           qof_instance_get_destroying(p));
+/* gnc_pricedb_lookup_day_t64() doesn't care which way round the commodity
+ * and the currency are, so neither does the key. */
+static PriceDayKey *
+price_day_key_new (GNCPrice *p)
+{
+    PriceDayKey *key = g_new (PriceDayKey, 1);
+    const gnc_commodity *commodity = gnc_price_get_commodity (p);
+    const gnc_commodity *currency = gnc_price_get_currency (p);
 
-    commodity = gnc_price_get_commodity(p);
-    if (!commodity)
-    {
-        LEAVE (" no commodity");
-        return FALSE;
-    }
-    currency = gnc_price_get_currency(p);
-    if (!currency)
+    key->a = commodity < currency ? commodity : currency;
+    key->b = commodity < currency ? currency : commodity;
+    key->day = time64CanonicalDayTime (gnc_price_get_time64 (p));
+    return key;
+}
+
+static void
+price_batch_free (gpointer data)
+{
+    PriceBatch *batch = data;
+    guint i;
+
+    for (i = 0; i < batch->add->len; i++)
+        gnc_price_unref (g_ptr_array_index (batch->add, i));
+    g_ptr_array_free (batch->add, TRUE);
+    g_hash_table_destroy (batch->drop);
+    g_free (batch);
+}
+
+static PriceBatch *
+price_batch_lookup (GHashTable *batches, gnc_commodity *commodity,
+                    gnc_commodity *currency)
+{
+    GHashTable *currency_batches = g_hash_table_lookup (batches, commodity);
+    PriceBatch *batch;
+
+    if (!currency_batches)
     {
-        LEAVE (" no currency");
-        return FALSE;
+        currency_batches = g_hash_table_new_full (NULL, NULL, NULL,
+                                                  price_batch_free);
+        g_hash_table_insert (batches, commodity, currency_batches);
     }
-    if (!db->commodity_hash)
+    batch = g_hash_table_lookup (currency_batches, currency);
+    if (!batch)
     {
-        LEAVE (" no commodity hash");
-        return FALSE;
+        batch = g_new (PriceBatch, 1);
+        batch->add = g_ptr_array_new ();
+        batch->drop = g_hash_table_new (NULL, NULL);
+        g_hash_table_insert (currency_batches, currency, batch);
     }
+    return batch;
+}
 
-    currency_hash = g_hash_table_lookup(db->commodity_hash, commodity);
+static gint
+compare_price_ptrs_by_date (gconstpointer a, gconstpointer b)
+{
+    return compare_prices_by_date (*(GNCPrice * const *) a,
+                                   *(GNCPrice * const *) b);
+}
+
+/* Merges a batch into the series of commodity in currency.  The dropped
+ * prices are taken out first, then the sorted new prices are merged in,
+ * skipping the ones that price_series_insert() would consider duplicates
+ * if check_dupl is set.  The prices that were merged are left in
+ * batch->add with the references they had; the skipped ones are removed
+ * from it.  Empty series and currency hashes are removed from the db.
+ */
+static void
+pricedb_merge_series (GNCPriceDB *db, gnc_commodity *commodity,
+                      gnc_commodity *currency, PriceBatch *batch,
+                      gboolean check_dupl)
+{
+    GHashTable *currency_hash;
+    GPtrArray *series, *merged;
+    guint i, j, kept;
+
+    currency_hash = g_hash_table_lookup (db->commodity_hash, commodity);
     if (!currency_hash)
     {
-        LEAVE (" no currency hash");
-        return FALSE;
+        currency_hash = g_hash_table_new (NULL, NULL);
+        g_hash_table_insert (db->commodity_hash, commodity, currency_hash);
     }
-
-    qof_event_gen (&p->inst, QOF_EVENT_REMOVE, NULL);
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    gnc_price_ref(p);
-    if (!gnc_price_list_remove(&price_list, p))
+    series = g_hash_table_lookup (currency_hash, currency);
+    if (!series)
     {
-        gnc_price_unref(p);
-        LEAVE (" cannot remove price list");
-        return FALSE;
+        series = g_ptr_array_new ();
+        g_hash_table_insert (currency_hash, currency, series);
     }
 
-    /* if the price list is empty, then remove this currency from the
-       commodity hash */
-    if (price_list)
+    if (g_hash_table_size (batch->drop) > 0)
     {
-        g_hash_table_insert(currency_hash, currency, price_list);
+        for (i = 0, kept = 0; i < series->len; i++)
+        {
+            GNCPrice *p = g_ptr_array_index (series, i);
+            if (g_hash_table_contains (batch->drop, p))
+                gnc_price_unref (p);
+            else
+                series->pdata[kept++] = p;
+        }
+        g_ptr_array_set_size (series, kept);
     }
-    else
+
+    merged = g_ptr_array_sized_new (series->len + batch->add->len);
+    for (i = 0, j = 0, kept = 0; j < batch->add->len; j++)
     {
-        g_hash_table_remove(currency_hash, currency);
+        GNCPrice *p = g_ptr_array_index (batch->add, j);
 
-        if (cleanup)
+        while (i < series->len &&
+               compare_prices_by_date (g_ptr_array_index (series, i), p) < 0)
+            g_ptr_array_add (merged, g_ptr_array_index (series, i++));
+
+        if (check_dupl && price_series_is_duplicate (series, i, p))
         {
-            /* chances are good that this commodity had only one currency.
-             * If there are no currencies, we may as well destroy the
-             * commodity too. */
-            guint num_currencies = g_hash_table_size (currency_hash);
-            if (0 == num_currencies)
-            {
-                g_hash_table_remove (db->commodity_hash, commodity);
-                g_hash_table_destroy (currency_hash);
-            }
+            gnc_price_unref (p);
+            continue;
         }
+        gnc_price_ref (p);
+        g_ptr_array_add (merged, p);
+        batch->add->pdata[kept++] = p;
     }
+    g_ptr_array_set_size (batch->add, kept);
+    for (; i < series->len; i++)
+        g_ptr_array_add (merged, g_ptr_array_index (series, i));
+    g_ptr_array_free (series, TRUE);
 
-    gnc_price_unref(p);
-    LEAVE ("db=%p, pr=%p", db, p);
-    return TRUE;
+    if (merged->len > 0)
+    {
+        g_hash_table_insert (currency_hash, currency, merged);
+        return;
+    }
+
+    g_ptr_array_free (merged, TRUE);
+    g_hash_table_remove (currency_hash, currency);
+    if (g_hash_table_size (currency_hash) == 0)
+    {
+        g_hash_table_remove (db->commodity_hash, commodity);
+        g_hash_table_destroy (currency_hash);
+    }
 }
 
-gboolean
-gnc_pricedb_remove_price(GNCPriceDB *db, GNCPrice *p)
+/* Checks a deduplicated winner of the batch against the price already in
+ * the db for its day, the way add_price() does.  Returns FALSE if the price
+ * in the db takes precedence, otherwise schedules it for removal.
+ */
+static gboolean
+price_batch_check_db (GNCPriceDB *db, GHashTable *batches, GNCPrice *p)
 {
-    gboolean rc;
-    char datebuff[MAX_DATE_LENGTH + 1];
-    memset(datebuff, 0, sizeof(datebuff));
-    if (!db || !p) return FALSE;
-    ENTER ("db=%p, pr=%p dirty=%d destroying=%d",
-           db, p, qof_instance_get_dirty_flag(p),
-           qof_instance_get_destroying(p));
+    GNCPrice *old_price = gnc_pricedb_lookup_day_t64 (db, p->commodity,
+                                                      p->currency, p->tmspec);
+    PriceBatch *batch;
 
-    gnc_price_ref(p);
-    qof_print_date_buff(datebuff, sizeof(datebuff), gnc_price_get_time64 (p));
+    if (!old_price)
+        return TRUE;
+    if (old_price == p || p->source > old_price->source)
+    {
+        gnc_price_unref (old_price);
+        return FALSE;
+    }
+    batch = price_batch_lookup (batches, old_price->commodity,
+                                old_price->currency);
+    /* The set keeps the reference returned by the lookup. */
+    if (g_hash_table_contains (batch->drop, old_price))
+        gnc_price_unref (old_price);
+    else
+        g_hash_table_add (batch->drop, old_price);
+    return TRUE;
+}
+
+static void
+price_batch_remove_dropped (GNCPrice *p)
+{
+    gnc_price_begin_edit (p);
+    qof_instance_set_destroying (p, TRUE);
+    gnc_price_commit_edit (p);
+    p->db = NULL;
+    gnc_price_unref (p);
+}
+
+guint
+gnc_pricedb_add_prices (GNCPriceDB *db, PriceList *prices)
+{
+    GHashTable *batches, *winners = NULL;
+    GHashTableIter iter, currency_iter;
+    gpointer key, value;
+    GList *dropped = NULL, *added = NULL, *node;
+    gboolean changed;
+    guint num_added = 0;
+
+    if (!db || !db->commodity_hash) return 0;
+    ENTER ("db=%p, %d prices", db, g_list_length (prices));
+
+    batches = g_hash_table_new_full (NULL, NULL, NULL,
+                                     (GDestroyNotify) g_hash_table_destroy);
+    if (!db->bulk_update)
+        winners = g_hash_table_new_full (price_day_key_hash,
+                                         price_day_key_equal, g_free, NULL);
+
+    for (node = prices; node; node = g_list_next (node))
+    {
+        GNCPrice *p = node->data, *winner;
+        PriceDayKey *day_key;
+
+        if (!p) continue;
+        if (!qof_instance_books_equal (db, p))
+        {
+            PERR ("attempted to mix up prices across different books");
+            continue;
+        }
+        if (!p->commodity || !p->currency)
+        {
+            PWARN ("no commodity or currency");
+            continue;
+        }
+        if (db->bulk_update)
+        {
+            gnc_price_ref (p);
+            g_ptr_array_add (price_batch_lookup (batches, p->commodity,
+                                                 p->currency)->add, p);
+            continue;
+        }
+
+        /* Like adding the prices in turn: a later price on the same day
+         * replaces an earlier one unless it has a worse source. */
+        day_key = price_day_key_new (p);
+        winner = g_hash_table_lookup (winners, day_key);
+        if (winner && p->source > winner->source)
+            g_free (day_key);
+        else
+            g_hash_table_insert (winners, day_key, p);
+    }
+
+    if (winners)
+    {
+        g_hash_table_iter_init (&iter, winners);
+        while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+            GNCPrice *p = value;
+            if (!price_batch_check_db (db, batches, p))
+                continue;
+            gnc_price_ref (p);
+            g_ptr_array_add (price_batch_lookup (batches, p->commodity,
+                                                 p->currency)->add, p);
+        }
+        g_hash_table_destroy (winners);
+    }
+
+    g_hash_table_iter_init (&iter, batches);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        g_hash_table_iter_init (&currency_iter, value);
+        while (g_hash_table_iter_next (&currency_iter, NULL, &value))
+        {
+            PriceBatch *batch = value;
+            GHashTableIter drop_iter;
+            gpointer dropped_price;
+
+            g_hash_table_iter_init (&drop_iter, batch->drop);
+            while (g_hash_table_iter_next (&drop_iter, &dropped_price, NULL))
+            {
+                qof_event_gen (&((GNCPrice *) dropped_price)->inst,
+                               QOF_EVENT_REMOVE, NULL);
+                dropped = g_list_prepend (dropped, dropped_price);
+            }
+            g_ptr_array_sort (batch->add, compare_price_ptrs_by_date);
+        }
+    }
+
+    g_hash_table_iter_init (&iter, batches);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        gnc_commodity *commodity = key;
+        GPtrArray *view_add = g_ptr_array_new ();
+        GHashTable *view_drop = g_hash_table_new (NULL, NULL);
+
+        g_hash_table_iter_init (&currency_iter, value);
+        while (g_hash_table_iter_next (&currency_iter, &key, &value))
+        {
+            PriceBatch *batch = value;
+            GHashTableIter drop_iter;
+            gpointer dropped_price;
+            guint i;
+
+            pricedb_merge_series (db, commodity, key, batch, !db->bulk_update);
+            for (i = 0; i < batch->add->len; i++)
+            {
+                GNCPrice *p = g_ptr_array_index (batch->add, i);
+                gnc_price_ref (p);
+                added = g_list_prepend (added, p);
+                g_ptr_array_add (view_add, p);
+            }
+            g_hash_table_iter_init (&drop_iter, batch->drop);
+            while (g_hash_table_iter_next (&drop_iter, &dropped_price, NULL))
+                g_hash_table_add (view_drop, dropped_price);
+        }
+
+        g_ptr_array_sort (view_add, compare_price_ptrs_by_date);
+        pricedb_view_merge (db, commodity, view_add, view_drop);
+        g_ptr_array_free (view_add, TRUE);
+        g_hash_table_destroy (view_drop);
+    }
+    g_hash_table_destroy (batches);
+
+    changed = dropped || added;
+    if (changed)
+        conversion_cache_invalidate (db);
+
+    /* Finish off the replaced prices the way gnc_pricedb_remove_price()
+     * does, then announce the new ones. */
+    g_list_foreach (dropped, (GFunc) price_batch_remove_dropped, NULL);
+    g_list_free (dropped);
+
+    for (node = added; node; node = g_list_next (node))
+    {
+        GNCPrice *p = node->data;
+        p->db = db;
+        qof_event_gen (&p->inst, QOF_EVENT_ADD, NULL);
+        gnc_price_unref (p);
+        num_added++;
+    }
+    g_list_free (added);
+
+    if (changed)
+    {
+        gnc_pricedb_begin_edit (db);
+        qof_instance_set_dirty (&db->inst);
+        gnc_pricedb_commit_edit (db);
+    }
+
+    LEAVE ("db=%p, added %u prices", db, num_added);
+    return num_added;
+}
+
+/* remove_price() is a utility; its only function is to remove the price
+ * from the double-hash tables.
+ */
+
+static gboolean
+remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)
+{
+    GPtrArray *series;
+    gnc_commodity *commodity;
+    gnc_commodity *currency;
+    GHashTable *currency_hash;
+
+    if (!db || !p) return FALSE;
+    ENTER ("db=%p, pr=%p dirty=%d destroying=%d",
+           db, p, qof_instance_get_dirty_flag(p),
+           qof_instance_get_destroying(p));
+
+    commodity = gnc_price_get_commodity(p);
+    if (!commodity)
+    {
+        LEAVE (" no commodity");
+        return FALSE;
+    }
+    currency = gnc_price_get_currency(p);
+    if (!currency)
+    {
+        LEAVE (" no currency");
+        return FALSE;
+    }
+    if (!db->commodity_hash)
+    {
+        LEAVE (" no commodity hash");
+        return FALSE;
+    }
+
+    currency_hash = g_hash_table_lookup(db->commodity_hash, commodity);
+    if (!currency_hash)
+    {
+        LEAVE (" no currency hash");
+        return FALSE;
+    }
+
+    qof_event_gen (&p->inst, QOF_EVENT_REMOVE, NULL);
+    conversion_cache_invalidate(db);
+    series = g_hash_table_lookup(currency_hash, currency);
+    gnc_price_ref(p);
+    if (series && price_series_remove(series, p))
+        pricedb_view_remove(db, p);
+
+    /* if the price series is empty, then remove this currency from the
+       commodity hash */
+    if (!series || series->len == 0)
+    {
+        g_hash_table_remove(currency_hash, currency);
+        if (series)
+            g_ptr_array_free(series, TRUE);
+
+        if (cleanup)
+        {
+            /* chances are good that this commodity had only one currency.
+             * If there are no currencies, we may as well destroy the
+             * commodity too. */
+            guint num_currencies = g_hash_table_size (currency_hash);
+            if (0 == num_currencies)
+            {
+                g_hash_table_remove (db->commodity_hash, commodity);
+                g_hash_table_destroy (currency_hash);
+            }
+        }
+    }
+
+    gnc_price_unref(p);
+    LEAVE ("db=%p, pr=%p", db, p);
+    return TRUE;
+}
+
+gboolean
+gnc_pricedb_remove_price(GNCPriceDB *db, GNCPrice *p)
+{
+    gboolean rc;
+    char datebuff[MAX_DATE_LENGTH + 1];
+    memset(datebuff, 0, sizeof(datebuff));
+    if (!db || !p) return FALSE;
+    ENTER ("db=%p, pr=%p dirty=%d destroying=%d",
+           db, p, qof_instance_get_dirty_flag(p),
+           qof_instance_get_destroying(p));
+
+    gnc_price_ref(p);
+    qof_print_date_buff(datebuff, sizeof(datebuff), gnc_price_get_time64 (p));
     DEBUG("Remove Date is %s, Commodity is %s, Source is %s", datebuff,
           gnc_commodity_get_fullname (gnc_price_get_commodity (p)),
           gnc_price_get_source_string (p));
@@ -1303,24 +2017,28 @@ gnc_pricedb_remove_price(GNCPriceDB *db, GNCPrice *p)
 
 typedef struct
 {
-    GNCPriceDB *db;
     time64 cutoff;
     gboolean delete_fq;
     gboolean delete_user;
     gboolean delete_app;
-    GSList *list;
+    PriceRemoveKeepOptions keep;
+    GDate fiscal_end_date;
+    GDateMonth fiscal_month_start;
+    gint saved_test_value;
+    gint next_test_value;
 } remove_info;
 
+/* Returns TRUE if the price is a candidate for removal, i.e. it has one of
+ * the sources to remove and is older than the cutoff. */
 static gboolean
-check_one_price_date (GNCPrice *price, gpointer user_data)
+check_one_price_date (GNCPrice *price, remove_info *data)
 {
-    remove_info *data = user_data;
     PriceSource source;
     time64 time;
 
     ENTER("price %p (%s), data %p", price,
           gnc_commodity_get_mnemonic(gnc_price_get_commodity(price)),
-          user_data);
+          data);
 
     source = gnc_price_get_source (price);
 
@@ -1333,7 +2051,7 @@ check_one_price_date (GNCPrice *price, gpointer user_data)
     else
     {
         LEAVE("Not a matching source");
-        return TRUE;
+        return FALSE;
     }
 
     time = gnc_price_get_time64 (price);
@@ -1344,82 +2062,12 @@ check_one_price_date (GNCPrice *price, gpointer user_data)
     }
     if (time < data->cutoff)
     {
-        data->list = g_slist_prepend(data->list, price);
         DEBUG("will delete");
+        LEAVE(" ");
+        return TRUE;
     }
     LEAVE(" ");
-    return TRUE;
-}
-
-static void
-pricedb_remove_foreach_pricelist (gpointer key,
-                                  gpointer val,
-                                  gpointer user_data)
-{
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
-    remove_info *data = (remove_info *) user_data;
-
-    ENTER("key %p, value %p, data %p", key, val, user_data);
-
-    /* now check each item in the list */
-    g_list_foreach(node, (GFunc)check_one_price_date, data);
-
-    LEAVE(" ");
-}
-
-static gint
-compare_prices_by_commodity_date (gconstpointer a, gconstpointer b)
-{
-    time64 time_a, time_b;
-    gnc_commodity *comma;
-    gnc_commodity *commb;
-    gnc_commodity *curra;
-    gnc_commodity *currb;
-    gint result;
-
-    if (!a && !b) return 0;
-    /* nothing is always less than something */
-    if (!a) return -1;
-    if (!b) return 1;
-
-    comma = gnc_price_get_commodity ((GNCPrice *) a);
-    commb = gnc_price_get_commodity ((GNCPrice *) b);
-
-    if (!gnc_commodity_equal(comma, commb))
-        return gnc_commodity_compare(comma, commb);
-
-    curra = gnc_price_get_currency ((GNCPrice *) a);
-    currb = gnc_price_get_currency ((GNCPrice *) b);
-
-    if (!gnc_commodity_equal(curra, currb))
-        return gnc_commodity_compare(curra, currb);
-
-    time_a = gnc_price_get_time64((GNCPrice *) a);
-    time_b = gnc_price_get_time64((GNCPrice *) b);
-
-    /* Note we return -1 if time_b is before time_a. */
-    result = time64_cmp(time_b, time_a);
-    if (result) return result;
-
-    /* For a stable sort */
-    return guid_compare (gnc_price_get_guid((GNCPrice *) a),
-                         gnc_price_get_guid((GNCPrice *) b));
-}
-
-static gboolean
-price_commodity_and_currency_equal (GNCPrice *a, GNCPrice *b)
-{
-    gboolean ret_comm = FALSE;
-    gboolean ret_curr = FALSE;
-
-    if (gnc_commodity_equal (gnc_price_get_commodity(a), gnc_price_get_commodity (b)))
-        ret_comm = TRUE;
-
-    if (gnc_commodity_equal (gnc_price_get_currency(a), gnc_price_get_currency (b)))
-        ret_curr = TRUE;
-
-    return (ret_comm && ret_curr);
+    return FALSE;
 }
 
 static void
@@ -1445,24 +2093,6 @@ gnc_pricedb_remove_old_prices_pinfo (GNCPrice *price, gboolean keep_message)
         PINFO("Keep price date is invalid");
 }
 
-static void
-clone_price (GNCPrice **price, GNCPrice *source_price)
-{
-    QofBook *book;
-
-    if (!source_price) return;
-    if (price == NULL) return;
-
-    book = qof_instance_get_book (QOF_INSTANCE(source_price));
-
-    if (*price)
-        gnc_price_unref (*price);
-
-    *price = gnc_price_clone (source_price, book);
-
-    gnc_pricedb_remove_old_prices_pinfo (source_price, TRUE);
-}
-
 static gint
 roundUp (gint numToRound, gint multiple)
 {
@@ -1489,113 +2119,158 @@ get_fiscal_quarter (GDate *date, GDateMonth fiscal_start)
     return q;
 }
 
-static void
-gnc_pricedb_process_removal_list (GNCPriceDB *db, GDate *fiscal_end_date,
-                                  remove_info data, PriceRemoveKeepOptions keep)
+/* Returns TRUE if next, an older candidate than the last kept one, falls
+ * in the same period as saved and can go. */
+static gboolean
+price_in_saved_period (remove_info *data, GNCPrice *saved, GNCPrice *next)
 {
-    GSList *item;
-    gboolean save_first_price = FALSE;
-    gint saved_test_value = 0, next_test_value = 0;
-    GNCPrice *cloned_price = NULL;
-    GDateMonth fiscal_month_start;
-    GDate *tmp_date = g_date_new_dmy (g_date_get_day (fiscal_end_date),
-                                      g_date_get_month (fiscal_end_date),
-                                      g_date_get_year (fiscal_end_date));
-
-    // get the fiscal start month
-    g_date_subtract_months (tmp_date, 12);
-    fiscal_month_start = g_date_get_month (tmp_date) + 1;
-    g_date_free (tmp_date);
+    GDate saved_price_date = time64_to_gdate (gnc_price_get_time64 (saved));
+    GDate next_price_date = time64_to_gdate (gnc_price_get_time64 (next));
 
-    // sort the list by commodity / currency / date
-    data.list = g_slist_sort (data.list, compare_prices_by_commodity_date);
-
-    /* Now run this external list deleting prices */
-    for (item = data.list; item; item = g_slist_next(item))
+    // Keep last price in fiscal year
+    if (data->keep == PRICE_REMOVE_KEEP_LAST_PERIOD)
     {
-        GDate saved_price_date;
-        GDate next_price_date;
+        GDate saved_fiscal_end = saved_price_date;
+        GDate next_fiscal_end = next_price_date;
 
-        // Keep None
-        if (keep == PRICE_REMOVE_KEEP_NONE)
-        {
-            gnc_pricedb_remove_old_prices_pinfo (item->data, FALSE);
-            gnc_pricedb_remove_price (db, item->data);
-            continue;
-        }
+        gnc_gdate_set_fiscal_year_end (&saved_fiscal_end, &data->fiscal_end_date);
+        gnc_gdate_set_fiscal_year_end (&next_fiscal_end, &data->fiscal_end_date);
 
-        save_first_price = !price_commodity_and_currency_equal (item->data, cloned_price); // Not Equal
-        if (save_first_price == TRUE)
-        {
-            clone_price (&cloned_price, item->data);
-            continue;
-        }
+        data->saved_test_value = g_date_get_year (&saved_fiscal_end);
+        data->next_test_value = g_date_get_year (&next_fiscal_end);
 
-        // get the price dates
-        saved_price_date = time64_to_gdate (gnc_price_get_time64 (cloned_price));
-        next_price_date = time64_to_gdate (gnc_price_get_time64 (item->data));
+        PINFO("Keep last price in fiscal year");
+    }
 
-        // Keep last price in fiscal year
-        if (keep == PRICE_REMOVE_KEEP_LAST_PERIOD && save_first_price == FALSE)
-        {
-            GDate *saved_fiscal_end = g_date_new_dmy (g_date_get_day (&saved_price_date),
-                                                      g_date_get_month (&saved_price_date),
-                                                      g_date_get_year (&saved_price_date));
+    // Keep last price in fiscal quarter
+    if (data->keep == PRICE_REMOVE_KEEP_LAST_QUARTERLY)
+    {
+        data->saved_test_value = get_fiscal_quarter (&saved_price_date, data->fiscal_month_start);
+        data->next_test_value = get_fiscal_quarter (&next_price_date, data->fiscal_month_start);
 
-            GDate *next_fiscal_end = g_date_new_dmy (g_date_get_day (&next_price_date),
-                                                     g_date_get_month (&next_price_date),
-                                                     g_date_get_year (&next_price_date));
+        PINFO("Keep last price in fiscal quarter");
+    }
 
-            gnc_gdate_set_fiscal_year_end (saved_fiscal_end, fiscal_end_date);
-            gnc_gdate_set_fiscal_year_end (next_fiscal_end, fiscal_end_date);
+    // Keep last price of every month
+    if (data->keep == PRICE_REMOVE_KEEP_LAST_MONTHLY)
+    {
+        data->saved_test_value = g_date_get_month (&saved_price_date);
+        data->next_test_value = g_date_get_month (&next_price_date);
 
-            saved_test_value = g_date_get_year (saved_fiscal_end);
-            next_test_value = g_date_get_year (next_fiscal_end);
+        PINFO("Keep last price of every month");
+    }
 
-            PINFO("Keep last price in fiscal year");
+    // Keep last price of every week
+    if (data->keep == PRICE_REMOVE_KEEP_LAST_WEEKLY)
+    {
+        data->saved_test_value = g_date_get_iso8601_week_of_year (&saved_price_date);
+        data->next_test_value = g_date_get_iso8601_week_of_year (&next_price_date);
 
-            g_date_free (saved_fiscal_end);
-            g_date_free (next_fiscal_end);
-        }
+        PINFO("Keep last price of every week");
+    }
 
-        // Keep last price in fiscal quarter
-        if (keep == PRICE_REMOVE_KEEP_LAST_QUARTERLY && save_first_price == FALSE)
-        {
-            saved_test_value = get_fiscal_quarter (&saved_price_date, fiscal_month_start);
-            next_test_value = get_fiscal_quarter (&next_price_date, fiscal_month_start);
+    return data->saved_test_value == data->next_test_value;
+}
 
-            PINFO("Keep last price in fiscal quarter");
-        }
+/* Takes the prices to remove out of a series in one pass, newest first, and
+ * appends them to removed with the series' references.  Returns TRUE if
+ * the series had any candidates at all.
+ */
+static gboolean
+pricedb_prune_series (GPtrArray *series, remove_info *data,
+                      GPtrArray *removed)
+{
+    GNCPrice *saved = NULL;
+    gboolean found = FALSE;
+    guint i, kept;
 
-        // Keep last price of every month
-        if (keep == PRICE_REMOVE_KEEP_LAST_MONTHLY && save_first_price == FALSE)
-        {
-            saved_test_value = g_date_get_month (&saved_price_date);
-            next_test_value = g_date_get_month (&next_price_date);
+    for (i = 0, kept = 0; i < series->len; i++)
+    {
+        GNCPrice *p = g_ptr_array_index (series, i);
+        gboolean remove = FALSE;
 
-            PINFO("Keep last price of every month");
+        if (check_one_price_date (p, data))
+        {
+            found = TRUE;
+            if (data->keep == PRICE_REMOVE_KEEP_NONE ||
+                (saved && price_in_saved_period (data, saved, p)))
+                remove = TRUE;
+            else
+            {
+                /* The first candidate of the series is always kept. */
+                saved = p;
+                gnc_pricedb_remove_old_prices_pinfo (p, TRUE);
+            }
         }
 
-        // Keep last price of every week
-        if (keep == PRICE_REMOVE_KEEP_LAST_WEEKLY && save_first_price == FALSE)
+        if (remove)
         {
-            saved_test_value = g_date_get_iso8601_week_of_year (&saved_price_date);
-            next_test_value = g_date_get_iso8601_week_of_year (&next_price_date);
-
-            PINFO("Keep last price of every week");
+            gnc_pricedb_remove_old_prices_pinfo (p, FALSE);
+            g_ptr_array_add (removed, p);
         }
+        else
+            series->pdata[kept++] = p;
+    }
+    g_ptr_array_set_size (series, kept);
+    return found;
+}
 
-        // Now compare the values
-        if (saved_test_value == next_test_value)
+/* Prunes all the series of one commodity and its view.  Returns TRUE if
+ * there were any candidates.
+ */
+static gboolean
+pricedb_prune_commodity (GNCPriceDB *db, gnc_commodity *commodity,
+                         remove_info *data, GPtrArray *removed,
+                         GList **removals)
+{
+    GHashTable *currency_hash = g_hash_table_lookup (db->commodity_hash,
+                                                     commodity);
+    GHashTableIter iter;
+    gpointer value;
+    gboolean found = FALSE;
+    int num_before;
+    guint first = removed->len, i;
+
+    if (!currency_hash) return FALSE;
+    num_before = gnc_pricedb_num_prices (db, commodity);
+
+    g_hash_table_iter_init (&iter, currency_hash);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        GPtrArray *series = value;
+
+        if (pricedb_prune_series (series, data, removed))
+            found = TRUE;
+        if (series->len == 0)
         {
-            gnc_pricedb_remove_old_prices_pinfo (item->data, FALSE);
-            gnc_pricedb_remove_price (db, item->data);
+            g_hash_table_iter_remove (&iter);
+            g_ptr_array_free (series, TRUE);
         }
-        else
-            clone_price (&cloned_price, item->data);
     }
-    if (cloned_price)
-        gnc_price_unref (cloned_price);
+    if (g_hash_table_size (currency_hash) == 0)
+    {
+        g_hash_table_remove (db->commodity_hash, commodity);
+        g_hash_table_destroy (currency_hash);
+    }
+
+    if (removed->len > first)
+    {
+        GPtrArray *none = g_ptr_array_new ();
+        GHashTable *drop = g_hash_table_new (NULL, NULL);
+        GNCPriceDBRemoval *removal = g_new (GNCPriceDBRemoval, 1);
+
+        for (i = first; i < removed->len; i++)
+            g_hash_table_add (drop, g_ptr_array_index (removed, i));
+        pricedb_view_merge (db, commodity, none, drop);
+        g_hash_table_destroy (drop);
+        g_ptr_array_free (none, TRUE);
+
+        removal->commodity = commodity;
+        removal->num_before = num_before;
+        removal->num_after = gnc_pricedb_num_prices (db, commodity);
+        *removals = g_list_prepend (*removals, removal);
+    }
+    return found;
 }
 
 gboolean
@@ -1605,16 +2280,20 @@ gnc_pricedb_remove_old_prices (GNCPriceDB *db, GList *comm_list,
                               PriceRemoveKeepOptions keep)
 {
     remove_info data;
-    GList *node;
+    GList *node, *removals = NULL;
+    GPtrArray *removed;
+    gboolean found = FALSE;
+    guint i;
     char datebuff[MAX_DATE_LENGTH + 1];
     memset (datebuff, 0, sizeof(datebuff));
 
-    data.db = db;
     data.cutoff = cutoff;
-    data.list = NULL;
     data.delete_fq = FALSE;
     data.delete_user = FALSE;
     data.delete_app = FALSE;
+    data.keep = keep;
+    data.saved_test_value = 0;
+    data.next_test_value = 0;
 
     ENTER("Remove Prices for Source %d, keeping %d", source, keep);
 
@@ -1628,38 +2307,70 @@ gnc_pricedb_remove_old_prices (GNCPriceDB *db, GList *comm_list,
     if (source & PRICE_REMOVE_SOURCE_USER)
         data.delete_user = TRUE;
 
-    // Walk the list of commodities
-    for (node = g_list_first (comm_list); node; node = g_list_next (node))
+    // Check for a valid fiscal end of year date
+    g_date_clear (&data.fiscal_end_date, 1);
+    if (fiscal_end_date && g_date_valid (fiscal_end_date))
+        data.fiscal_end_date = *fiscal_end_date;
+    else
     {
-        GHashTable *currencies_hash = g_hash_table_lookup (db->commodity_hash, node->data);
-        g_hash_table_foreach (currencies_hash, pricedb_remove_foreach_pricelist, &data);
+        GDate *today = gnc_g_date_new_today ();
+        g_date_set_dmy (&data.fiscal_end_date, 31, 12, g_date_get_year (today));
+        g_date_free (today);
     }
 
-    if (data.list == NULL)
+    // get the fiscal start month
     {
-        LEAVE("Empty price list");
-        return FALSE;
+        GDate tmp_date = data.fiscal_end_date;
+        g_date_subtract_months (&tmp_date, 12);
+        data.fiscal_month_start = g_date_get_month (&tmp_date) + 1;
     }
+
     qof_print_date_buff (datebuff, sizeof(datebuff), cutoff);
-    DEBUG("Number of Prices in list is %d, Cutoff date is %s",
-          g_slist_length (data.list), datebuff);
+    DEBUG("Cutoff date is %s", datebuff);
 
-    // Check for a valid fiscal end of year date
-    if (fiscal_end_date == NULL)
+    // Walk the list of commodities, pruning each series in one pass
+    removed = g_ptr_array_new ();
+    for (node = g_list_first (comm_list); node; node = g_list_next (node))
+        if (pricedb_prune_commodity (db, node->data, &data, removed, &removals))
+            found = TRUE;
+
+    if (!found)
     {
-        GDateYear year_now = g_date_get_year (gnc_g_date_new_today ());
-        fiscal_end_date = g_date_new ();
-        g_date_set_dmy (fiscal_end_date, 31, 12, year_now);
+        g_ptr_array_free (removed, TRUE);
+        LEAVE("Empty price list");
+        return FALSE;
     }
-    else if (g_date_valid (fiscal_end_date) == FALSE)
+    DEBUG("Number of Prices removed is %u", removed->len);
+
+    if (removed->len > 0)
     {
-        GDateYear year_now = g_date_get_year (gnc_g_date_new_today ());
-        g_date_clear (fiscal_end_date, 1);
-        g_date_set_dmy (fiscal_end_date, 31, 12, year_now);
+        conversion_cache_invalidate (db);
+
+        /* Destroy the prices inside one edit of the db so that the backend
+         * can delete them in one go, and replace the events of each of
+         * them by a single summary event. */
+        qof_event_suspend ();
+        gnc_pricedb_begin_edit (db);
+        for (i = 0; i < removed->len; i++)
+        {
+            GNCPrice *p = g_ptr_array_index (removed, i);
+
+            gnc_price_begin_edit (p);
+            qof_instance_set_destroying (p, TRUE);
+            gnc_price_commit_edit (p);
+            p->db = NULL;
+        }
+        qof_instance_set_dirty (&db->inst);
+        gnc_pricedb_commit_edit (db);
+        for (i = 0; i < removed->len; i++)
+            gnc_price_unref (g_ptr_array_index (removed, i));
+        qof_event_resume ();
+
+        qof_event_gen (&db->inst, GNC_EVENT_ITEM_REMOVED, removals);
     }
-    gnc_pricedb_process_removal_list (db, fiscal_end_date, data, keep);
 
-    g_slist_free (data.list);
+    g_list_free_full (removals, g_free);
+    g_ptr_array_free (removed, TRUE);
     LEAVE(" ");
     return TRUE;
 }
@@ -1673,30 +2384,33 @@ static void
 hash_values_helper(gpointer key, gpointer value, gpointer data)
 {
     GList ** l = data;
+    GList *series_list = price_series_to_list (value);
     if (*l)
     {
         GList *new_l;
-        new_l = pricedb_price_list_merge(*l, value);
+        new_l = pricedb_price_list_merge(*l, series_list);
         g_list_free (*l);
+        g_list_free (series_list);
         *l = new_l;
     }
     else
-        *l = g_list_copy (value);
+        *l = series_list;
 }
 
 static PriceList *
 price_list_from_hashtable (GHashTable *hash, const gnc_commodity *currency)
 {
-    GList *price_list = NULL, *result = NULL ;
+    GPtrArray *series = NULL;
+    GList *result = NULL;
     if (currency)
     {
-        price_list = g_hash_table_lookup(hash, currency);
-        if (!price_list)
+        series = g_hash_table_lookup(hash, currency);
+        if (!series)
         {
             LEAVE (" no price list");
             return NULL;
         }
-        result = g_list_copy (price_list);
+        result = price_series_to_list (series);
     }
     else
     {
@@ -1785,24 +2499,70 @@ pricedb_get_prices_internal(GNCPriceDB *db, const gnc_commodity *commodity,
     return forward_list;
 }
 
+static GPtrArray *
+pricedb_get_series (GNCPriceDB *db, const gnc_commodity *commodity,
+                    const gnc_commodity *currency)
+{
+    GHashTable *currency_hash;
+
+    if (!db->commodity_hash) return NULL;
+    currency_hash = g_hash_table_lookup (db->commodity_hash, commodity);
+    if (!currency_hash) return NULL;
+    return g_hash_table_lookup (currency_hash, currency);
+}
+
+/* Finds the prices on either side of t among the prices of commodity in
+ * currency and of currency in commodity: before is set to the newest price
+ * at or before t and after to the oldest price later than t, or NULL if
+ * there isn't one.  The prices aren't reffed.  Ties are broken the same way
+ * as in the merged list returned by pricedb_get_prices_internal(), so this
+ * gives the same answers as walking that list without having to build it.
+ */
+static void
+pricedb_bracket_time (GNCPriceDB *db, const gnc_commodity *commodity,
+                      const gnc_commodity *currency, time64 t,
+                      GNCPrice **before, GNCPrice **after)
+{
+    GPtrArray *series[2];
+    int n;
+
+    *before = *after = NULL;
+    series[0] = pricedb_get_series (db, commodity, currency);
+    series[1] = pricedb_get_series (db, currency, commodity);
+    for (n = 0; n < 2; n++)
+    {
+        guint i;
+
+        if (!series[n]) continue;
+        i = price_series_index_before (series[n], t, FALSE);
+        if (i < series[n]->len)
+        {
+            GNCPrice *p = g_ptr_array_index (series[n], i);
+            if (!*before || compare_prices_by_date (p, *before) < 0)
+                *before = p;
+        }
+        if (i > 0)
+        {
+            GNCPrice *p = g_ptr_array_index (series[n], i - 1);
+            if (!*after || compare_prices_by_date (p, *after) > 0)
+                *after = p;
+        }
+    }
+}
+
 GNCPrice *gnc_pricedb_lookup_latest(GNCPriceDB *db,
                           const gnc_commodity *commodity,
                           const gnc_commodity *currency)
 {
-    GList *price_list;
-    GNCPrice *result;
+    GNCPrice *result, *after;
 
     if (!db || !commodity || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, commodity, currency);
 
-    price_list = pricedb_get_prices_internal(db, commodity, currency, TRUE);
-    if (!price_list) return NULL;
-    /* This works magically because prices are inserted in date-sorted
-     * order, and the latest date always comes first. So return the
-     * first in the list.  */
-    result = price_list->data;
+    /* Nothing is later than INT64_MAX, so the latest price is the one
+     * before it. */
+    pricedb_bracket_time (db, commodity, currency, INT64_MAX, &result, &after);
     gnc_price_ref(result);
-    g_list_free (price_list);
     LEAVE("price is %p", result);
     return result;
 }
@@ -1825,54 +2585,49 @@ typedef struct
 */
 
 static gboolean
-price_list_scan_any_currency(GList *price_list, gpointer data)
+price_list_scan_any_currency(GPtrArray *series, gpointer data)
 {
     UsesCommodity *helper = (UsesCommodity*)data;
-    GList *node = price_list;
+    GNCPrice *price;
     gnc_commodity *com;
     gnc_commodity *cur;
+    guint index;
 
-    if (!price_list)
+    if (!series || series->len == 0)
         return TRUE;
 
-    com = gnc_price_get_commodity(node->data);
-    cur = gnc_price_get_currency(node->data);
+    price = g_ptr_array_index(series, 0);
+    com = gnc_price_get_commodity(price);
+    cur = gnc_price_get_currency(price);
 
-    /* if this price list isn't for the commodity we are interested in,
+    /* if this price series isn't for the commodity we are interested in,
        ignore it. */
     if (com != helper->com && cur != helper->com)
         return TRUE;
 
-    /* The price list is sorted in decreasing order of time.  Find the first
-       price on it that is older than the requested time and add it and the
-       previous price to the result list. */
-    while (node != NULL)
+    /* The price series is sorted in decreasing order of time.  Find the
+       first price on it that is older than the requested time and add it
+       and the previous price to the result list. */
+    index = price_series_index_before(series, helper->t, TRUE);
+    if (index < series->len)
     {
-        GNCPrice *price = node->data;
-        time64 price_t = gnc_price_get_time64(price);
-        if (price_t < helper->t)
-        {
-            /* If there is a previous price add it to the results. */
-            if (node->prev)
-            {
-                GNCPrice *prev_price = node->prev->data;
-                gnc_price_ref(prev_price);
-                *helper->list = g_list_prepend(*helper->list, prev_price);
-            }
-            /* Add the first price before the desired time */
-            gnc_price_ref(price);
-            *helper->list = g_list_prepend(*helper->list, price);
-            /* No point in looking further, they will all be older */
-            break;
-        }
-        else if (node->next == NULL)
+        /* If there is a previous price add it to the results. */
+        if (index > 0)
         {
-            /* The last price is later than given time, add it */
-            gnc_price_ref(price);
-            *helper->list = g_list_prepend(*helper->list, price);
+            GNCPrice *prev_price = g_ptr_array_index(series, index - 1);
+            gnc_price_ref(prev_price);
+            *helper->list = g_list_prepend(*helper->list, prev_price);
         }
-        node = node->next;
+        /* Add the first price before the desired time */
+        price = g_ptr_array_index(series, index);
     }
+    else
+    {
+        /* The last price is later than given time, add it */
+        price = g_ptr_array_index(series, series->len - 1);
+    }
+    gnc_price_ref(price);
+    *helper->list = g_list_prepend(*helper->list, price);
 
     return TRUE;
 }
@@ -2077,7 +2832,7 @@ gnc_pricedb_has_prices(GNCPriceDB *db,
                        const gnc_commodity *commodity,
                        const gnc_commodity *currency)
 {
-    GList *price_list;
+    GPtrArray *series;
     GHashTable *currency_hash;
     gint size;
 
@@ -2092,8 +2847,8 @@ gnc_pricedb_has_prices(GNCPriceDB *db,
 
     if (currency)
     {
-        price_list = g_hash_table_lookup(currency_hash, currency);
-        if (price_list)
+        series = g_hash_table_lookup(currency_hash, currency);
+        if (series)
         {
             LEAVE("yes");
             return TRUE;
@@ -2133,59 +2888,29 @@ gnc_pricedb_get_prices(GNCPriceDB *db,
 
 /* Return the number of prices in the data base for the given commodity
  */
-static void
-price_count_helper(gpointer key, gpointer value, gpointer data)
-{
-    int *result = data;
-    GList *price_list = value;
-
-    *result += g_list_length(price_list);
-}
-
 int
 gnc_pricedb_num_prices(GNCPriceDB *db,
                        const gnc_commodity *c)
 {
     int result = 0;
-    GHashTable *currency_hash;
+    GPtrArray *view;
 
     if (!db || !c) return 0;
     ENTER ("db=%p commodity=%p", db, c);
 
-    currency_hash = g_hash_table_lookup(db->commodity_hash, c);
-    if (currency_hash)
-    {
-        g_hash_table_foreach(currency_hash, price_count_helper,  (gpointer)&result);
-    }
+    view = g_hash_table_lookup(db->commodity_views, c);
+    if (view)
+        result = view->len;
 
     LEAVE ("count=%d", result);
     return result;
 }
 
-/* Helper function for combining the price lists in gnc_pricedb_nth_price. */
-static void
-list_combine (gpointer element, gpointer data)
-{
-    GList *list = *(GList**)data;
-    if (list == NULL)
-        *(GList**)data = g_list_copy (element);
-    else
-    {
-        GList *new_list = g_list_concat ((GList *)list, g_list_copy (element));
-        *(GList**)data = new_list;
-    }
-}
-
-/* This function is used by gnc-tree-model-price.c for iterating through the
- * prices when building or filtering the pricedb dialog's
- * GtkTreeView. gtk-tree-view-price.c sorts the results after it has obtained
- * the values so there's nothing gained by sorting. However, for very large
- * collections of prices in multiple currencies (here commodity is the one being
- * priced and currency the one in which the price is denominated; note that they
- * may both be currencies or not) just concatenating the price lists together
- * can be expensive because the recieving list must be traversed to obtain its
- * end. To avoid that cost n times we cache the commodity and merged price list.
- * Since this is a GUI-driven function there is no concern about concurrency.
+/* gnc_pricedb_nth_price() and gnc_pricedb_price_index() are used by
+ * gnc-tree-model-price.c for iterating through the prices when building or
+ * filtering the pricedb dialog's GtkTreeView.  Both work on the commodity
+ * views, so they agree with each other and with the order of
+ * gnc_pricedb_get_prices() without a currency.
  */
 
 GNCPrice *
@@ -2193,51 +2918,35 @@ gnc_pricedb_nth_price (GNCPriceDB *db,
                        const gnc_commodity *c,
                        const int n)
 {
-    static const gnc_commodity *last_c = NULL;
-    static GList *prices = NULL;
-
     GNCPrice *result = NULL;
-    GHashTable *currency_hash;
+    GPtrArray *view;
     g_return_val_if_fail (GNC_IS_COMMODITY (c), NULL);
 
     if (!db || !c || n < 0) return NULL;
     ENTER ("db=%p commodity=%s index=%d", db, gnc_commodity_get_mnemonic(c), n);
 
-    if (last_c && prices && last_c == c && db->reset_nth_price_cache == FALSE)
-    {
-        result = g_list_nth_data (prices, n);
-        LEAVE ("price=%p", result);
-        return result;
-    }
-
-    last_c = c;
-
-    if (prices)
-    {
-        g_list_free (prices);
-        prices = NULL;
-    }
-
-    db->reset_nth_price_cache = FALSE;
-
-    currency_hash = g_hash_table_lookup (db->commodity_hash, c);
-    if (currency_hash)
-    {
-        GList *currencies = g_hash_table_get_values (currency_hash);
-        g_list_foreach (currencies, list_combine, &prices);
-        result = g_list_nth_data (prices, n);
-        g_list_free (currencies);
-    }
+    view = g_hash_table_lookup (db->commodity_views, c);
+    if (view && (guint) n < view->len)
+        result = g_ptr_array_index (view, n);
 
     LEAVE ("price=%p", result);
     return result;
 }
 
-void
-gnc_pricedb_nth_price_reset_cache (GNCPriceDB *db)
+int
+gnc_pricedb_price_index (GNCPriceDB *db, const GNCPrice *p)
 {
-    if (db)
-        db->reset_nth_price_cache = TRUE;
+    GPtrArray *view;
+    guint i;
+
+    if (!db || !p || !p->commodity) return -1;
+
+    view = g_hash_table_lookup (db->commodity_views, p->commodity);
+    if (!view) return -1;
+    i = price_view_position (view, p);
+    if (i < view->len && g_ptr_array_index (view, i) == p)
+        return i;
+    return -1;
 }
 
 GNCPrice *
@@ -2255,27 +2964,17 @@ gnc_pricedb_lookup_at_time64(GNCPriceDB *db,
                              const gnc_commodity *currency,
                              time64 t)
 {
-    GList *price_list;
-    GList *item = NULL;
+    GNCPrice *before, *after;
 
     if (!db || !c || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    item = price_list;
-    while (item)
-    {
-        GNCPrice *p = item->data;
-        time64 price_time = gnc_price_get_time64(p);
-        if (price_time == t)
-        {
-            gnc_price_ref(p);
-            g_list_free (price_list);
-            LEAVE("price is %p", p);
-            return p;
-        }
-        item = item->next;
+    pricedb_bracket_time (db, c, currency, t, &before, &after);
+    if (before && gnc_price_get_time64(before) == t)
+    {
+        gnc_price_ref(before);
+        LEAVE("price is %p", before);
+        return before;
     }
-    g_list_free (price_list);
     LEAVE (" ");
     return NULL;
 }
@@ -2287,37 +2986,28 @@ lookup_nearest_in_time(GNCPriceDB *db,
                        time64 t,
                        gboolean sameday)
 {
-    GList *price_list;
     GNCPrice *current_price = NULL;
     GNCPrice *next_price = NULL;
     GNCPrice *result = NULL;
-    GList *item = NULL;
 
     if (!db || !c || !currency) return NULL;
     if (t == INT64_MAX) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    if (!price_list) return NULL;
-    item = price_list;
-
-    /* default answer */
-    current_price = item->data;
 
-    /* find the first candidate past the one we want.  Remember that
-       prices are in most-recent-first order. */
-    while (!next_price && item)
+    /* Remember that prices are in most-recent-first order: next_price is
+       the first candidate past the one we want and current_price the one
+       just before it. */
+    pricedb_bracket_time (db, c, currency, t, &next_price, &current_price);
+    if (!next_price && !current_price)
     {
-        GNCPrice *p = item->data;
-        time64 price_time = gnc_price_get_time64(p);
-        if (price_time <= t)
-        {
-            next_price = item->data;
-            break;
-        }
-        current_price = item->data;
-        item = item->next;
+        LEAVE ("no prices");
+        return NULL;
     }
 
+    /* default answer */
+    if (!current_price)
+        current_price = next_price;
+
     if (current_price)      /* How can this be null??? */
     {
         if (!next_price)
@@ -2388,7 +3078,6 @@ lookup_nearest_in_time(GNCPriceDB *db,
     }
 
     gnc_price_ref(result);
-    g_list_free (price_list);
     LEAVE (" ");
     return result;
 }
@@ -2409,32 +3098,359 @@ gnc_pricedb_lookup_latest_before_t64 (GNCPriceDB *db,
                                       gnc_commodity *currency,
                                       time64 t)
 {
-    GList *price_list;
     GNCPrice *current_price = NULL;
-    /*  GNCPrice *next_price = NULL;
-        GNCPrice *result = NULL;*/
-    GList *item = NULL;
-    time64 price_time;
+    GNCPrice *later_price = NULL;
 
     if (!db || !c || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    if (!price_list) return NULL;
-    item = price_list;
-    do
-    {
-        price_time = gnc_price_get_time64 (item->data);
-        if (price_time <= t)
-            current_price = item->data;
-        item = item->next;
-    }
-    while (price_time > t && item);
+    pricedb_bracket_time (db, c, currency, t, &current_price, &later_price);
     gnc_price_ref(current_price);
-    g_list_free (price_list);
     LEAVE (" ");
     return current_price;
 }
 
+/* Sorts the indices of a date array so that the latest date comes first. */
+static gint
+compare_date_index_latest_first (gconstpointer a, gconstpointer b,
+                                 gpointer user_data)
+{
+    const time64 *dates = user_data;
+    time64 ta = dates[*(const guint *) a];
+    time64 tb = dates[*(const guint *) b];
+
+    return ta < tb ? 1 : (ta > tb ? -1 : 0);
+}
+
+/* For each date, in the latest first order given by order, sets best[date] to
+ * the newest price of series at or before it if that is newer than the one
+ * already there.  Because the dates are visited latest first the index of
+ * that price never goes backwards, so each binary search only has to look at
+ * the part of the series the previous one didn't skip.
+ */
+static void
+price_series_sweep_before (const GPtrArray *series, const time64 *dates,
+                           const guint *order, guint n_dates, GNCPrice **best)
+{
+    guint start = 0, n;
+
+    if (!series) return;
+    for (n = 0; n < n_dates && start < series->len; n++)
+    {
+        guint date = order[n], lo = start, hi = series->len;
+        GNCPrice *p;
+
+        while (lo < hi)
+        {
+            guint mid = lo + (hi - lo) / 2;
+            if (gnc_price_get_time64 (g_ptr_array_index (series, mid)) <= dates[date])
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        start = lo;
+        if (start == series->len)
+            break;
+        p = g_ptr_array_index (series, start);
+        if (!best[date] || compare_prices_by_date (p, best[date]) < 0)
+            best[date] = p;
+    }
+}
+
+GNCPriceMatrix *
+gnc_pricedb_lookup_latest_before_matrix (GNCPriceDB *db,
+                                         CommodityList *commodities,
+                                         const gnc_commodity *currency,
+                                         const time64 *dates, guint n_dates)
+{
+    GNCPriceMatrix *matrix;
+    GNCPrice **best;
+    guint *order, row = 0, n;
+    GList *node;
+
+    g_return_val_if_fail (n_dates == 0 || dates, NULL);
+
+    matrix = g_new0 (GNCPriceMatrix, 1);
+    matrix->n_commodities = g_list_length (commodities);
+    matrix->n_dates = n_dates;
+    matrix->values = g_new (gnc_numeric, matrix->n_commodities * n_dates);
+    for (n = 0; n < matrix->n_commodities * n_dates; n++)
+        matrix->values[n] = gnc_numeric_zero ();
+    if (!db || !currency || !n_dates || !matrix->n_commodities)
+        return matrix;
+
+    ENTER ("db=%p commodities=%u currency=%p dates=%u", db,
+           matrix->n_commodities, currency, n_dates);
+    order = g_new (guint, n_dates);
+    for (n = 0; n < n_dates; n++)
+        order[n] = n;
+    g_qsort_with_data (order, n_dates, sizeof (guint),
+                       compare_date_index_latest_first, (gpointer) dates);
+
+    best = g_new (GNCPrice*, n_dates);
+    for (node = commodities; node; node = node->next, row++)
+    {
+        gnc_commodity *commodity = node->data;
+        gnc_numeric *values = matrix->values + row * n_dates;
+
+        if (!commodity) continue;
+        if (gnc_commodity_equiv (commodity, currency))
+        {
+            for (n = 0; n < n_dates; n++)
+                values[n] = gnc_numeric_create (1, 1);
+            continue;
+        }
+
+        memset (best, 0, n_dates * sizeof (GNCPrice*));
+        price_series_sweep_before (pricedb_get_series (db, commodity, currency),
+                                   dates, order, n_dates, best);
+        price_series_sweep_before (pricedb_get_series (db, currency, commodity),
+                                   dates, order, n_dates, best);
+        for (n = 0; n < n_dates; n++)
+        {
+            if (!best[n]) continue;
+            values[n] = gnc_price_get_value (best[n]);
+            if (gnc_price_get_commodity (best[n]) != commodity &&
+                !gnc_numeric_zero_p (values[n]))
+                values[n] = gnc_numeric_invert (values[n]);
+        }
+    }
+    g_free (best);
+    g_free (order);
+    LEAVE (" ");
+    return matrix;
+}
+
+gnc_numeric
+gnc_price_matrix_get_value (const GNCPriceMatrix *matrix, guint row, guint col)
+{
+    if (!matrix || row >= matrix->n_commodities || col >= matrix->n_dates)
+        return gnc_numeric_zero ();
+    return matrix->values[row * matrix->n_dates + col];
+}
+
+void
+gnc_price_matrix_free (GNCPriceMatrix *matrix)
+{
+    if (!matrix) return;
+    g_free (matrix->values);
+    g_free (matrix);
+}
+
+/* Walks the prices of commodity in currency and of currency in commodity
+ * between two times, oldest first, merging the two series as it goes.  The
+ * series are newest first, so each one is walked down from pos to stop.
+ */
+typedef struct
+{
+    const GPtrArray *series[2];
+    guint pos[2];
+    guint stop[2];
+    const gnc_commodity *commodity;
+} PriceRangeScan;
+
+static void
+price_range_scan_init (PriceRangeScan *scan, GNCPriceDB *db,
+                       const gnc_commodity *commodity,
+                       const gnc_commodity *currency, time64 start, time64 end)
+{
+    int n;
+
+    scan->commodity = commodity;
+    scan->series[0] = pricedb_get_series (db, commodity, currency);
+    scan->series[1] = pricedb_get_series (db, currency, commodity);
+    for (n = 0; n < 2; n++)
+    {
+        scan->pos[n] = scan->stop[n] = 0;
+        if (!scan->series[n] || start > end) continue;
+        scan->stop[n] = price_series_index_before (scan->series[n], end, FALSE);
+        scan->pos[n] = price_series_index_before (scan->series[n], start, TRUE);
+    }
+}
+
+static gboolean
+price_range_scan_next (PriceRangeScan *scan, time64 *t, double *value)
+{
+    GNCPrice *p = NULL;
+    int n, from = -1;
+
+    for (n = 0; n < 2; n++)
+    {
+        GNCPrice *candidate;
+
+        if (scan->pos[n] <= scan->stop[n]) continue;
+        candidate = g_ptr_array_index (scan->series[n], scan->pos[n] - 1);
+        if (!p || compare_prices_by_date (candidate, p) > 0)
+        {
+            p = candidate;
+            from = n;
+        }
+    }
+    if (!p)
+        return FALSE;
+
+    scan->pos[from]--;
+    *t = gnc_price_get_time64 (p);
+    *value = gnc_numeric_to_double (gnc_price_get_value (p));
+    if (gnc_price_get_commodity (p) != scan->commodity && *value != 0.0)
+        *value = 1.0 / *value;
+    return TRUE;
+}
+
+GNCPriceSamples *
+gnc_pricedb_get_price_samples (GNCPriceDB *db, const gnc_commodity *commodity,
+                               const gnc_commodity *currency,
+                               time64 start, time64 end)
+{
+    GNCPriceSamples *samples = g_new0 (GNCPriceSamples, 1);
+    GArray *times, *values;
+    PriceRangeScan scan;
+    time64 t;
+    double value;
+
+    if (!db || !commodity || !currency)
+        return samples;
+    ENTER ("db=%p commodity=%p currency=%p", db, commodity, currency);
+    price_range_scan_init (&scan, db, commodity, currency, start, end);
+    times = g_array_new (FALSE, FALSE, sizeof (time64));
+    values = g_array_new (FALSE, FALSE, sizeof (double));
+    while (price_range_scan_next (&scan, &t, &value))
+    {
+        g_array_append_val (times, t);
+        g_array_append_val (values, value);
+    }
+    samples->len = times->len;
+    samples->times = (time64*) g_array_free (times, FALSE);
+    samples->values = (double*) g_array_free (values, FALSE);
+    LEAVE ("%u prices", samples->len);
+    return samples;
+}
+
+/* Returns the start of bucket number n.  Each bucket is computed from the
+ * first one so that adding months doesn't drift when a day gets clamped to
+ * the end of a short month. */
+static time64
+price_bucket_start (const GDate *first, PriceBucketInterval interval,
+                    guint mult, guint n)
+{
+    GDate date = *first;
+
+    switch (interval)
+    {
+    case PRICE_BUCKET_DAY:
+        g_date_add_days (&date, n * mult);
+        break;
+    case PRICE_BUCKET_WEEK:
+        g_date_add_days (&date, 7 * n * mult);
+        break;
+    case PRICE_BUCKET_MONTH:
+        g_date_add_months (&date, n * mult);
+        break;
+    case PRICE_BUCKET_QUARTER:
+        g_date_add_months (&date, 3 * n * mult);
+        break;
+    case PRICE_BUCKET_YEAR:
+    default:
+        g_date_add_years (&date, n * mult);
+        break;
+    }
+    return gnc_time64_get_day_start_gdate (&date);
+}
+
+GNCPriceSamples *
+gnc_pricedb_get_price_buckets (GNCPriceDB *db, const gnc_commodity *commodity,
+                               const gnc_commodity *currency,
+                               time64 start, time64 end,
+                               PriceBucketInterval interval, guint mult)
+{
+    GNCPriceSamples *samples = g_new0 (GNCPriceSamples, 1);
+    GArray *times, *values, *mins, *maxs, *avgs, *counts;
+    GNCPrice *before, *after;
+    PriceRangeScan scan;
+    GDate first;
+    time64 bucket, next, t = 0;
+    double value = 0.0, last = 0.0;
+    gboolean have_price, have_last = FALSE;
+    guint n = 0;
+
+    if (!db || !commodity || !currency || start > end)
+        return samples;
+    ENTER ("db=%p commodity=%p currency=%p interval=%d mult=%u", db,
+           commodity, currency, interval, mult);
+    if (mult == 0)
+        mult = 1;
+    first = time64_to_gdate (start);
+    bucket = gnc_time64_get_day_start_gdate (&first);
+
+    /* The value carried into the first bucket if it has no prices. */
+    pricedb_bracket_time (db, commodity, currency, bucket - 1, &before, &after);
+    if (before)
+    {
+        last = gnc_numeric_to_double (gnc_price_get_value (before));
+        if (gnc_price_get_commodity (before) != commodity && last != 0.0)
+            last = 1.0 / last;
+        have_last = TRUE;
+    }
+
+    times = g_array_new (FALSE, FALSE, sizeof (time64));
+    values = g_array_new (FALSE, FALSE, sizeof (double));
+    mins = g_array_new (FALSE, FALSE, sizeof (double));
+    maxs = g_array_new (FALSE, FALSE, sizeof (double));
+    avgs = g_array_new (FALSE, FALSE, sizeof (double));
+    counts = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    price_range_scan_init (&scan, db, commodity, currency, bucket, end);
+    have_price = price_range_scan_next (&scan, &t, &value);
+    for (; bucket <= end; bucket = next)
+    {
+        double min = last, max = last, sum = 0.0, avg;
+        guint count = 0;
+
+        next = price_bucket_start (&first, interval, mult, ++n);
+        for (; have_price && t < next;
+             have_price = price_range_scan_next (&scan, &t, &value))
+        {
+            if (count == 0 || value < min) min = value;
+            if (count == 0 || value > max) max = value;
+            sum += value;
+            last = value;
+            have_last = TRUE;
+            count++;
+        }
+        if (!have_last)
+            continue;
+        avg = count ? sum / count : last;
+        g_array_append_val (times, bucket);
+        g_array_append_val (values, last);
+        g_array_append_val (mins, min);
+        g_array_append_val (maxs, max);
+        g_array_append_val (avgs, avg);
+        g_array_append_val (counts, count);
+    }
+
+    samples->len = times->len;
+    samples->times = (time64*) g_array_free (times, FALSE);
+    samples->values = (double*) g_array_free (values, FALSE);
+    samples->min = (double*) g_array_free (mins, FALSE);
+    samples->max = (double*) g_array_free (maxs, FALSE);
+    samples->avg = (double*) g_array_free (avgs, FALSE);
+    samples->counts = (guint*) g_array_free (counts, FALSE);
+    LEAVE ("%u buckets", samples->len);
+    return samples;
+}
+
+void
+gnc_price_samples_free (GNCPriceSamples *samples)
+{
+    if (!samples) return;
+    g_free (samples->times);
+    g_free (samples->values);
+    g_free (samples->min);
+    g_free (samples->max);
+    g_free (samples->avg);
+    g_free (samples->counts);
+    g_free (samples);
+}
+
 static gnc_numeric
 direct_balance_conversion (GNCPriceDB *db, gnc_numeric bal,
                            const gnc_commodity *from, const gnc_commodity *to,
@@ -2543,25 +3559,70 @@ convert_balance(gnc_numeric bal, const gnc_commodity *from,
                            fraction, GNC_HOW_RND_ROUND);
 
 }
-static gnc_numeric
-indirect_balance_conversion (GNCPriceDB *db, gnc_numeric bal,
-                             const gnc_commodity *from, const gnc_commodity *to,
-                             time64 t )
+typedef struct
+{
+    const gnc_commodity *from;
+    const gnc_commodity *to;
+    time64 t;
+    time64 next;
+} NextPriceHelper;
+
+/* Helper for pricedb_pricelist_traversal() that finds the time of the
+ * first price of either commodity later than t. */
+static gboolean
+price_series_scan_next(GPtrArray *series, gpointer data)
+{
+    NextPriceHelper *helper = data;
+    GNCPrice *price;
+    gnc_commodity *com, *cur;
+    guint index;
+
+    if (series->len == 0)
+        return TRUE;
+    price = g_ptr_array_index(series, 0);
+    com = gnc_price_get_commodity(price);
+    cur = gnc_price_get_currency(price);
+    if (com != helper->from && cur != helper->from &&
+        com != helper->to && cur != helper->to)
+        return TRUE;
+
+    index = price_series_index_before(series, helper->t, FALSE);
+    if (index > 0)
+    {
+        time64 next_t = gnc_price_get_time64(g_ptr_array_index(series,
+                                                                 index - 1));
+        if (next_t < helper->next)
+            helper->next = next_t;
+    }
+    return TRUE;
+}
+
+/* Find the prices indirect_balance_conversion() needs, without the cache.
+ * The latest prices are those of gnc_pricedb_lookup_latest_any_currency(),
+ * which leaves out prices dated after now; *expires is set to the time a
+ * later price of either commodity takes over, so that the cache agrees with
+ * that lookup. */
+static PriceTuple
+find_indirect_prices (GNCPriceDB *db, const gnc_commodity *from,
+                      const gnc_commodity *to, time64 t, time64 *expires)
 {
     GList *from_prices = NULL, *to_prices = NULL;
-    PriceTuple tuple;
-    gnc_numeric zero = gnc_numeric_zero();
-    if (from == NULL || to == NULL)
-        return zero;
-    if (gnc_numeric_zero_p(bal))
-        return zero;
+    PriceTuple tuple = {NULL, NULL};
+
+    *expires = INT64_MAX;
     if (t == INT64_MAX)
     {
+        /* Taken before the lookups, so a price becoming the latest while
+           they run can only make the entry expire early. */
+        NextPriceHelper helper = {from, to, gnc_time(NULL), INT64_MAX};
+
         from_prices = gnc_pricedb_lookup_latest_any_currency(db, from);
         /* "to" is often the book currency which may have lots of prices,
             so avoid getting them if they aren't needed. */
         if (from_prices)
             to_prices = gnc_pricedb_lookup_latest_any_currency(db, to);
+        pricedb_pricelist_traversal(db, price_series_scan_next, &helper);
+        *expires = helper.next;
     }
     else
     {
@@ -2571,16 +3632,329 @@ indirect_balance_conversion (GNCPriceDB *db, gnc_numeric bal,
             to_prices = gnc_pricedb_lookup_nearest_in_time_any_currency_t64(db,
                                                                     to, t);
     }
-    if (from_prices == NULL || to_prices == NULL)
-        return zero;
-    tuple = extract_common_prices(from_prices, to_prices, from, to);
+    if (from_prices && to_prices)
+        tuple = extract_common_prices(from_prices, to_prices, from, to);
     gnc_price_list_destroy(from_prices);
     gnc_price_list_destroy(to_prices);
-    if (tuple.from)
+    return tuple;
+}
+
+static gnc_numeric
+indirect_balance_conversion (GNCPriceDB *db, gnc_numeric bal,
+                             const gnc_commodity *from, const gnc_commodity *to,
+                             time64 t )
+{
+    ConversionKey key = {from, to, t};
+    ConversionEntry *entry;
+    PriceTuple tuple;
+    gnc_numeric zero = gnc_numeric_zero();
+    if (from == NULL || to == NULL)
+        return zero;
+    if (gnc_numeric_zero_p(bal))
+        return zero;
+
+    /* Reports convert the same pairs over and over, so remember the prices
+       found for each (from, to, time) until the prices change. */
+    entry = g_hash_table_lookup(db->conversion_cache, &key);
+    if (entry && entry->expires <= gnc_time(NULL))
+        entry = NULL;
+    if (entry)
+    {
+        db->conversion_cache_hits++;
+    }
+    else
+    {
+        ConversionKey *new_key = g_new(ConversionKey, 1);
+
+        db->conversion_cache_misses++;
+        if (g_hash_table_size(db->conversion_cache) >=
+            CONVERSION_CACHE_MAX_ENTRIES)
+            conversion_cache_invalidate(db);
+
+        entry = g_new(ConversionEntry, 1);
+        tuple = find_indirect_prices(db, from, to, t, &entry->expires);
+        entry->from = tuple.from;
+        entry->to = tuple.to;
+        *new_key = key;
+        g_hash_table_replace(db->conversion_cache, new_key, entry);
+    }
+
+    if (entry->from)
+    {
+        tuple.from = entry->from;
+        tuple.to = entry->to;
         return convert_balance(bal, from, to, tuple);
+    }
     return zero;
 }
 
+/* ==================================================================== */
+/* Price graph
+
+   For conversions needing more than one intermediate commodity the
+   price DB is treated as a graph: the commodities are the nodes and, for
+   a given time, the price of each series nearest to it is an edge that
+   can be followed in either direction.  A rate table holds the rates from
+   one commodity to every commodity reachable from it.  It's found with a
+   breadth first search, so the path with the fewest prices wins; among
+   those, the one whose stalest price is nearest to the time wins.
+ */
+
+/* Significant figures kept when multiplying rates along a path. */
+#define PRICE_GRAPH_SIGFIGS 12
+
+typedef struct
+{
+    gnc_commodity *other;
+    gnc_numeric rate;           /* Units of other per unit of this one */
+    time64 distance;            /* From the price's time to the table's */
+} PriceEdge;
+
+typedef struct
+{
+    PriceGraph *graph;
+    time64 t;
+    gboolean latest;
+} PriceGraphHelper;
+
+/* The price of a series nearest to t, preferring the older one on a tie
+ * like lookup_nearest_in_time() does. */
+static GNCPrice *
+price_series_nearest (const GPtrArray *series, time64 t)
+{
+    guint index = price_series_index_before (series, t, FALSE);
+    GNCPrice *before = index < series->len ?
+        g_ptr_array_index (series, index) : NULL;
+    GNCPrice *after = index > 0 ? g_ptr_array_index (series, index - 1) : NULL;
+
+    if (!before || !after)
+        return before ? before : after;
+    if (gnc_price_get_time64 (after) - t < t - gnc_price_get_time64 (before))
+        return after;
+    return before;
+}
+
+static void
+price_graph_add_edge (GHashTable *edges, gnc_commodity *from,
+                      gnc_commodity *to, gnc_numeric rate, time64 distance)
+{
+    GArray *array = g_hash_table_lookup (edges, from);
+    PriceEdge edge = {to, rate, distance};
+
+    if (!array)
+    {
+        array = g_array_new (FALSE, FALSE, sizeof (PriceEdge));
+        g_hash_table_insert (edges, from, array);
+    }
+    g_array_append_val (array, edge);
+}
+
+/* Helper for pricedb_pricelist_traversal() adding the edges of a series. */
+static gboolean
+price_graph_add_series (GPtrArray *series, gpointer data)
+{
+    PriceGraphHelper *helper = data;
+    GNCPrice *price;
+    gnc_numeric value;
+    time64 distance;
+
+    if (series->len == 0)
+        return TRUE;
+
+    if (helper->latest)
+    {
+        guint index = price_series_index_before (series, helper->t, FALSE);
+        if (index > 0)
+        {
+            time64 next_t = gnc_price_get_time64 (g_ptr_array_index (series,
+                                                                     index - 1));
+            if (next_t < helper->graph->expires)
+                helper->graph->expires = next_t;
+        }
+        if (index == series->len)
+            return TRUE;
+        price = g_ptr_array_index (series, index);
+    }
+    else
+        price = price_series_nearest (series, helper->t);
+
+    value = gnc_price_get_value (price);
+    if (gnc_numeric_check (value) || gnc_numeric_zero_p (value))
+        return TRUE;
+
+    distance = llabs (gnc_price_get_time64 (price) - helper->t);
+    price_graph_add_edge (helper->graph->edges, gnc_price_get_commodity (price),
+                          gnc_price_get_currency (price), value, distance);
+    price_graph_add_edge (helper->graph->edges, gnc_price_get_currency (price),
+                          gnc_price_get_commodity (price),
+                          gnc_numeric_invert (value), distance);
+    return TRUE;
+}
+
+static void
+price_graph_free_edges (gpointer data)
+{
+    g_array_free ((GArray *) data, TRUE);
+}
+
+/* The edges of the price graph at time t, or of the latest prices if t is
+ * INT64_MAX, built from all price series on first use. */
+static PriceGraph *
+price_graph_get (GNCPriceDB *db, time64 t)
+{
+    PriceGraph *graph = g_hash_table_lookup (db->price_graphs, &t);
+    PriceGraphHelper helper;
+
+    if (graph && graph->expires > gnc_time (NULL))
+        return graph;
+
+    if (!graph &&
+        g_hash_table_size (db->price_graphs) >= PRICE_GRAPH_CACHE_MAX_ENTRIES)
+        g_hash_table_remove_all (db->price_graphs);
+
+    graph = g_new (PriceGraph, 1);
+    graph->edges = g_hash_table_new_full (NULL, NULL, NULL,
+                                          price_graph_free_edges);
+    graph->expires = INT64_MAX;
+    helper.graph = graph;
+    helper.latest = (t == INT64_MAX);
+    helper.t = helper.latest ? gnc_time (NULL) : t;
+    pricedb_pricelist_traversal (db, price_graph_add_series, &helper);
+    g_hash_table_replace (db->price_graphs, g_memdup (&t, sizeof (t)), graph);
+    return graph;
+}
+
+/* Build the rate table from the commodity from at time t, or from the
+ * latest prices if t is INT64_MAX. */
+static RateTable *
+price_graph_rate_table (GNCPriceDB *db, const gnc_commodity *from, time64 t)
+{
+    PriceGraph *graph = price_graph_get (db, t);
+    RateTable *table = g_new (RateTable, 1);
+    RateEntry *entry = g_new (RateEntry, 1);
+    GPtrArray *frontier = g_ptr_array_new ();
+
+    table->rates = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+    table->expires = graph->expires;
+    entry->rate = gnc_numeric_create (1, 1);
+    entry->hops = 0;
+    entry->staleness = 0;
+    g_hash_table_insert (table->rates, (gpointer) from, entry);
+    g_ptr_array_add (frontier, (gpointer) from);
+
+    /* Each pass finds the commodities one more price away. */
+    while (frontier->len > 0)
+    {
+        GPtrArray *next = g_ptr_array_new ();
+        guint i, j;
+
+        for (i = 0; i < frontier->len; i++)
+        {
+            gpointer node = g_ptr_array_index (frontier, i);
+            RateEntry *node_entry = g_hash_table_lookup (table->rates, node);
+            GArray *edges = g_hash_table_lookup (graph->edges, node);
+
+            if (!edges) continue;
+            for (j = 0; j < edges->len; j++)
+            {
+                PriceEdge *edge = &g_array_index (edges, PriceEdge, j);
+                RateEntry *other = g_hash_table_lookup (table->rates,
+                                                        edge->other);
+                time64 staleness = MAX (node_entry->staleness, edge->distance);
+
+                if (other && (other->hops <= node_entry->hops ||
+                              other->staleness <= staleness))
+                    continue;
+                if (!other)
+                {
+                    other = g_new (RateEntry, 1);
+                    other->hops = node_entry->hops + 1;
+                    g_hash_table_insert (table->rates, edge->other, other);
+                    g_ptr_array_add (next, edge->other);
+                }
+                other->staleness = staleness;
+                other->rate = gnc_numeric_mul (node_entry->rate, edge->rate,
+                                               GNC_DENOM_AUTO,
+                                               GNC_HOW_DENOM_SIGFIGS (PRICE_GRAPH_SIGFIGS) |
+                                               GNC_HOW_RND_ROUND_HALF_UP);
+            }
+        }
+        g_ptr_array_free (frontier, TRUE);
+        frontier = next;
+    }
+    g_ptr_array_free (frontier, TRUE);
+    return table;
+}
+
+static gnc_numeric
+price_graph_rate (GNCPriceDB *db, const gnc_commodity *from,
+                  const gnc_commodity *to, time64 t)
+{
+    ConversionKey key = {from, NULL, t};
+    RateTable *table;
+    RateEntry *entry;
+
+    if (!db || !from || !to)
+        return gnc_numeric_zero ();
+    if (from == to)
+        return gnc_numeric_create (1, 1);
+
+    table = g_hash_table_lookup (db->rate_tables, &key);
+    if (table && table->expires <= gnc_time (NULL))
+        table = NULL;
+    if (!table)
+    {
+        ConversionKey *new_key = g_new (ConversionKey, 1);
+
+        if (g_hash_table_size (db->rate_tables) >= RATE_TABLE_CACHE_MAX_ENTRIES)
+            g_hash_table_remove_all (db->rate_tables);
+        table = price_graph_rate_table (db, from, t);
+        *new_key = key;
+        g_hash_table_replace (db->rate_tables, new_key, table);
+    }
+
+    entry = g_hash_table_lookup (table->rates, to);
+    if (!entry || gnc_numeric_check (entry->rate))
+        return gnc_numeric_zero ();
+    return entry->rate;
+}
+
+static gnc_numeric
+path_balance_conversion (GNCPriceDB *db, gnc_numeric bal,
+                         const gnc_commodity *from, const gnc_commodity *to,
+                         time64 t)
+{
+    gnc_numeric rate;
+
+    if (from == NULL || to == NULL)
+        return gnc_numeric_zero ();
+    if (gnc_numeric_zero_p (bal))
+        return gnc_numeric_zero ();
+    rate = price_graph_rate (db, from, to, t);
+    if (gnc_numeric_zero_p (rate))
+        return gnc_numeric_zero ();
+    return gnc_numeric_mul (bal, rate, gnc_commodity_get_fraction (to),
+                            GNC_HOW_RND_ROUND);
+}
+
+gnc_numeric
+gnc_pricedb_exchange_rate_latest (GNCPriceDB *db,
+                                  const gnc_commodity *from,
+                                  const gnc_commodity *to)
+{
+    return price_graph_rate (db, from, to, INT64_MAX);
+}
+
+gnc_numeric
+gnc_pricedb_exchange_rate_nearest_t64 (GNCPriceDB *db,
+                                       const gnc_commodity *from,
+                                       const gnc_commodity *to,
+                                       time64 t)
+{
+    if (t == INT64_MAX)
+        return gnc_numeric_zero ();
+    return price_graph_rate (db, from, to, t);
+}
 
 /*
  * Convert a balance from one currency to another.
@@ -2607,8 +3981,35 @@ gnc_pricedb_convert_balance_latest_price(GNCPriceDB *pdb,
      * no direct price found, try if we find a price in another currency
      * and convert in two stages
      */
-    return indirect_balance_conversion(pdb, balance, balance_currency,
-                                       new_currency, INT64_MAX);
+    new_value = indirect_balance_conversion(pdb, balance, balance_currency,
+                                            new_currency, INT64_MAX);
+    if (!gnc_numeric_zero_p(new_value))
+        return new_value;
+
+    /* Last resort, follow a chain of prices through several commodities. */
+    return path_balance_conversion(pdb, balance, balance_currency,
+                                   new_currency, INT64_MAX);
+}
+
+void
+gnc_pricedb_get_conversion_cache_stats(GNCPriceDB *db, guint *hits,
+                                       guint *misses, guint *entries)
+{
+    if (hits)
+        *hits = db ? db->conversion_cache_hits : 0;
+    if (misses)
+        *misses = db ? db->conversion_cache_misses : 0;
+    if (entries)
+        *entries = db && db->conversion_cache ?
+            g_hash_table_size(db->conversion_cache) : 0;
+}
+
+void
+gnc_pricedb_reset_conversion_cache_stats(GNCPriceDB *db)
+{
+    if (!db) return;
+    db->conversion_cache_hits = 0;
+    db->conversion_cache_misses = 0;
 }
 
 gnc_numeric
@@ -2634,8 +4035,14 @@ gnc_pricedb_convert_balance_nearest_price_t64(GNCPriceDB *pdb,
      * no direct price found, try if we find a price in another currency
      * and convert in two stages
      */
-    return indirect_balance_conversion(pdb, balance, balance_currency,
-                                       new_currency, t);
+    new_value = indirect_balance_conversion(pdb, balance, balance_currency,
+                                            new_currency, t);
+    if (!gnc_numeric_zero_p(new_value))
+        return new_value;
+
+    /* Last resort, follow a chain of prices through several commodities. */
+    return path_balance_conversion(pdb, balance, balance_currency,
+                                   new_currency, t);
 }
 
 
@@ -2653,16 +4060,15 @@ typedef struct
 static void
 pricedb_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
+    GPtrArray *series = (GPtrArray *) val;
     GNCPriceDBForeachData *foreach_data = (GNCPriceDBForeachData *) user_data;
+    guint i;
 
     /* stop traversal when func returns FALSE */
-    while (foreach_data->ok && node)
+    for (i = 0; foreach_data->ok && i < series->len; i++)
     {
-        GNCPrice *p = (GNCPrice *) node->data;
+        GNCPrice *p = (GNCPrice *) g_ptr_array_index (series, i);
         foreach_data->ok = foreach_data->func(p, foreach_data->user_data);
-        node = node->next;
     }
 }
 
@@ -2699,18 +4105,18 @@ unstable_price_traversal(GNCPriceDB *db,
 typedef struct
 {
     gboolean ok;
-    gboolean (*func)(GList *p, gpointer user_data);
+    gboolean (*func)(GPtrArray *p, gpointer user_data);
     gpointer user_data;
 } GNCPriceListForeachData;
 
 static void
 pricedb_pricelist_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
-    GList *price_list = (GList *) val;
+    GPtrArray *series = (GPtrArray *) val;
     GNCPriceListForeachData *foreach_data = (GNCPriceListForeachData *) user_data;
     if (foreach_data->ok)
     {
-        foreach_data->ok = foreach_data->func(price_list, foreach_data->user_data);
+        foreach_data->ok = foreach_data->func(series, foreach_data->user_data);
     }
 }
 
@@ -2723,7 +4129,7 @@ pricedb_pricelist_foreach_currencies_hash(gpointer key, gpointer val, gpointer u
 
 static gboolean
 pricedb_pricelist_traversal(GNCPriceDB *db,
-                         gboolean (*f)(GList *p, gpointer user_data),
+                         gboolean (*f)(GPtrArray *p, gpointer user_data),
                          gpointer user_data)
 {
     GNCPriceListForeachData foreach_data;
@@ -2795,12 +4201,12 @@ stable_price_traversal(GNCPriceDB *db,
         for (j = price_lists; j; j = j->next)
         {
             HashEntry *pricelist_entry = (HashEntry *) j->data;
-            GList *price_list = (GList *) pricelist_entry->value;
-            GList *node;
+            GPtrArray *series = (GPtrArray *) pricelist_entry->value;
+            guint k;
 
-            for (node = (GList *) price_list; node; node = node->next)
+            for (k = 0; k < series->len; k++)
             {
-                GNCPrice *price = (GNCPrice *) node->data;
+                GNCPrice *price = (GNCPrice *) g_ptr_array_index (series, k);
 
                 /* stop traversal when f returns FALSE */
                 if (FALSE == ok) break;
@@ -3020,15 +4426,14 @@ VoidGNCPriceDBForeachData;
 static void
 void_pricedb_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
+    GPtrArray *series = (GPtrArray *) val;
     VoidGNCPriceDBForeachData *foreach_data = (VoidGNCPriceDBForeachData *) user_data;
+    guint i;
 
-    while (node)
+    for (i = 0; i < series->len; i++)
     {
-        GNCPrice *p = (GNCPrice *) node->data;
+        GNCPrice *p = (GNCPrice *) g_ptr_array_index (series, i);
         foreach_data->func(p, foreach_data->user_data);
-        node = node->next;
     }
 }
 
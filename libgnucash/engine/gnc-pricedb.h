@@ -370,6 +370,18 @@ void gnc_pricedb_set_bulk_update(GNCPriceDB *db, gboolean bulk_update);
  */
 gboolean     gnc_pricedb_add_price(GNCPriceDB *db, GNCPrice *p);
 
+/** @brief Add a batch of prices to the pricedb.
+ *
+ * The result is the same as calling gnc_pricedb_add_price() on each price
+ * in turn, including the replacement of prices on the same day unless bulk
+ * updates are on, but each price series is only walked once.  The pricedb
+ * takes its own references, so the caller still has to unref the prices.
+ * @param db The pricedb
+ * @param prices The GNCPrices to add.
+ * @return The number of prices that were added.
+ */
+guint        gnc_pricedb_add_prices(GNCPriceDB *db, PriceList *prices);
+
 /** @brief Remove a price from the pricedb and unref the price.
  * @param db The Pricedb
  * @param p The price to remove.
@@ -394,7 +406,24 @@ typedef enum
     PRICE_REMOVE_KEEP_SCALED,         // leave one every week then one a month
 } PriceRemoveKeepOptions;
 
+/** @brief What gnc_pricedb_remove_old_prices() removed from a commodity.
+ *
+ * Rather than a QOF_EVENT_REMOVE for each price, that function generates a
+ * single GNC_EVENT_ITEM_REMOVED event on the pricedb.  Its event data is a
+ * GList of these, one for each commodity that lost prices.
+ */
+typedef struct
+{
+    gnc_commodity *commodity;
+    int num_before;     /**< gnc_pricedb_num_prices() before the removal */
+    int num_after;      /**< gnc_pricedb_num_prices() after the removal */
+} GNCPriceDBRemoval;
+
 /** @brief Remove and unref prices older than a certain time.
+ *
+ * Each price series is pruned in a single pass.  The removed prices are
+ * destroyed within one edit of the pricedb, so that the backend can delete
+ * them together.
  * @param db The pricedb
  * @param comm_list A list of commodities
  * @param fiscal_end_date the end date of the current accounting period
@@ -558,6 +587,121 @@ PriceList * gnc_pricedb_lookup_latest_before_any_currency_t64(GNCPriceDB *db,
                                                          const gnc_commodity *c,
                                                               time64 t);
 
+/** @brief A dense table of price values, one row per commodity and one
+ * column per date, as returned by gnc_pricedb_lookup_latest_before_matrix().
+ */
+typedef struct
+{
+    guint n_commodities;
+    guint n_dates;
+    /** Row-major: the value of commodity row at date col is
+     * values[row * n_dates + col]. */
+    gnc_numeric *values;
+} GNCPriceMatrix;
+
+/** @brief Look up the value of many commodities in one currency at one or
+ * more dates.
+ *
+ * Each value comes from the same price gnc_pricedb_lookup_latest_before_t64()
+ * would return, but it is always expressed as the amount of currency per unit
+ * of the commodity: prices quoted the other way round are inverted.  Each
+ * price series involved is walked once for all of the dates, so this is much
+ * cheaper than calling the single lookup for every cell.
+ * @param db The pricedb
+ * @param commodities The commodities, one per row of the result
+ * @param currency The currency the values are expressed in
+ * @param dates The dates, one per column of the result, in any order
+ * @param n_dates The number of dates
+ * @return A newly allocated matrix to be freed with gnc_price_matrix_free().
+ * Cells for which there is no price are zero and a commodity equal to the
+ * currency has a value of one.
+ */
+GNCPriceMatrix *gnc_pricedb_lookup_latest_before_matrix(GNCPriceDB *db,
+                                                        CommodityList *commodities,
+                                                        const gnc_commodity *currency,
+                                                        const time64 *dates,
+                                                        guint n_dates);
+
+/** @return The value at row and col of the matrix, or zero if either is out
+ * of range. */
+gnc_numeric gnc_price_matrix_get_value (const GNCPriceMatrix *matrix,
+                                        guint row, guint col);
+
+/** Free a matrix returned by gnc_pricedb_lookup_latest_before_matrix(). */
+void gnc_price_matrix_free (GNCPriceMatrix *matrix);
+
+typedef enum
+{
+    PRICE_BUCKET_DAY,
+    PRICE_BUCKET_WEEK,
+    PRICE_BUCKET_MONTH,
+    PRICE_BUCKET_QUARTER,
+    PRICE_BUCKET_YEAR,
+} PriceBucketInterval;
+
+/** @brief Packed price values of one commodity in one currency, oldest first.
+ *
+ * For a range scan each entry is one price: times holds its time and values
+ * its value, and min, max, avg and counts are NULL.  For buckets times holds
+ * the start of each bucket, values the last price in it, min, max and avg
+ * summarize its prices and counts says how many there were.  A bucket
+ * without prices has a count of zero and repeats the last known value.
+ */
+typedef struct
+{
+    guint len;
+    time64 *times;
+    double *values;
+    double *min;
+    double *max;
+    double *avg;
+    guint *counts;
+} GNCPriceSamples;
+
+/** @brief Return the prices of a commodity in a currency between two times.
+ *
+ * Prices quoted the other way round are inverted, so all of the values are
+ * amounts of currency per unit of commodity.
+ * @param db The pricedb
+ * @param commodity The commodity
+ * @param currency The currency
+ * @param start The earliest time to include
+ * @param end The latest time to include
+ * @return A newly allocated GNCPriceSamples, free it with
+ * gnc_price_samples_free().
+ */
+GNCPriceSamples *gnc_pricedb_get_price_samples (GNCPriceDB *db,
+                                                const gnc_commodity *commodity,
+                                                const gnc_commodity *currency,
+                                                time64 start, time64 end);
+
+/** @brief Resample the prices of a commodity in a currency to a calendar
+ * interval.
+ *
+ * The buckets are mult intervals long, the first one starts on the day of
+ * start and the last one is the one containing end.  Leading buckets are
+ * left out until there is a price, at or before them, to give them a value.
+ * @param db The pricedb
+ * @param commodity The commodity
+ * @param currency The currency
+ * @param start The time in the first bucket
+ * @param end The time in the last bucket
+ * @param interval The calendar unit of a bucket
+ * @param mult The number of units in a bucket
+ * @return A newly allocated GNCPriceSamples, free it with
+ * gnc_price_samples_free().
+ */
+GNCPriceSamples *gnc_pricedb_get_price_buckets (GNCPriceDB *db,
+                                                const gnc_commodity *commodity,
+                                                const gnc_commodity *currency,
+                                                time64 start, time64 end,
+                                                PriceBucketInterval interval,
+                                                guint mult);
+
+/** Free the samples returned by gnc_pricedb_get_price_samples() or
+ * gnc_pricedb_get_price_buckets(). */
+void gnc_price_samples_free (GNCPriceSamples *samples);
+
 
 /** @brief Convert a balance from one currency to another using the most recent
  * price between the two.
@@ -591,6 +735,60 @@ gnc_pricedb_convert_balance_nearest_price_t64(GNCPriceDB *pdb,
                                               const gnc_commodity *new_currency,
                                               time64 t);
 
+/** @brief Find the exchange rate between two commodities using the latest
+ * prices, through as many intermediate commodities as needed.
+ *
+ * The path using the fewest prices is used.  The rates from a commodity
+ * to all others are computed together and cached until the prices change,
+ * so asking for many rates from the same commodity is cheap.  The two
+ * convert_balance functions above fall back to this when there is neither
+ * a direct price nor a single intermediate commodity.
+ * @param db The pricedb
+ * @param from The commodity to convert from
+ * @param to The commodity to convert to
+ * @return The number of units of to per unit of from, or gnc_numeric_zero
+ * if no chain of prices connects them.
+ */
+gnc_numeric gnc_pricedb_exchange_rate_latest(GNCPriceDB *db,
+                                             const gnc_commodity *from,
+                                             const gnc_commodity *to);
+
+/** @brief Find the exchange rate between two commodities using the prices
+ * nearest to a time, through as many intermediate commodities as needed.
+ *
+ * Like gnc_pricedb_exchange_rate_latest(), but each price used is the one
+ * nearest to t of its commodity and currency.  Among the paths with the
+ * fewest prices, the one whose prices are all closest to t is used.
+ * @param db The pricedb
+ * @param from The commodity to convert from
+ * @param to The commodity to convert to
+ * @param t The time nearest to which prices should be used.
+ * @return The number of units of to per unit of from, or gnc_numeric_zero
+ * if no chain of prices connects them.
+ */
+gnc_numeric gnc_pricedb_exchange_rate_nearest_t64(GNCPriceDB *db,
+                                                  const gnc_commodity *from,
+                                                  const gnc_commodity *to,
+                                                  time64 t);
+
+/** @brief Report how well the cache of indirect conversions is working.
+ *
+ * The two functions above remember the prices they used to convert between
+ * commodities without a direct price, until a price is added, removed or
+ * changed.  Any of the out parameters may be NULL.
+ * @param db The pricedb
+ * @param hits Set to the number of conversions answered from the cache
+ * @param misses Set to the number of conversions that had to search prices
+ * @param entries Set to the number of conversions currently cached
+ */
+void gnc_pricedb_get_conversion_cache_stats(GNCPriceDB *db, guint *hits,
+                                            guint *misses, guint *entries);
+
+/** @brief Set the hit and miss counts of the conversion cache back to zero.
+ * @param db The pricedb
+ */
+void gnc_pricedb_reset_conversion_cache_stats(GNCPriceDB *db);
+
 typedef gboolean (*GncPriceForeachFunc)(GNCPrice *p, gpointer user_data);
 
 /** @brief Call a GncPriceForeachFunction once for each price in db, until the
@@ -633,7 +831,13 @@ gnc_pricedb_nth_price (GNCPriceDB *db,
                        const gnc_commodity *c,
                        const int n);
 
-void gnc_pricedb_nth_price_reset_cache (GNCPriceDB *db);
+/** @brief Get the position of a price among the prices of its commodity.
+ * @param db The pricedb
+ * @param p The price to look for
+ * @return The index for which gnc_pricedb_nth_price() returns p, or -1 if
+ * p isn't in the pricedb
+ */
+int gnc_pricedb_price_index (GNCPriceDB *db, const GNCPrice *p);
 
 /* The following two convenience functions are used to test the xml backend */
 /** @brief Return the number of prices in the database.
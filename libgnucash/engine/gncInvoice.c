@@ -609,6 +609,18 @@ void gncInvoiceSetPostedTxn (GncInvoice *invoice, Transaction *txn)
     gncInvoiceCommitEdit (invoice);
 }
 
+/* The backends replace a posted transaction they reload, which
+ * gncInvoiceSetPostedTxn won't do. */
+void gncInvoiceReplacePostedTxn (GncInvoice *invoice, Transaction *txn)
+{
+    if (!invoice) return;
+
+    gncInvoiceBeginEdit (invoice);
+    invoice->posted_txn = txn;
+    mark_invoice (invoice);
+    gncInvoiceCommitEdit (invoice);
+}
+
 void gncInvoiceSetPostedLot (GncInvoice *invoice, GNCLot *lot)
 {
     if (!invoice) return;
@@ -38,6 +38,7 @@ gboolean gncInvoiceRegister (void);
 gchar *gncInvoiceNextID (QofBook *book, const GncOwner *owner);
 void gncInvoiceSetPostedAcc (GncInvoice *invoice, Account *acc);
 void gncInvoiceSetPostedTxn (GncInvoice *invoice, Transaction *txn);
+void gncInvoiceReplacePostedTxn (GncInvoice *invoice, Transaction *txn);
 void gncInvoiceSetPostedLot (GncInvoice *invoice, GNCLot *lot);
 //void gncInvoiceSetPaidTxn (GncInvoice *invoice, Transaction *txn);
 
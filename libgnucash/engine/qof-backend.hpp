@@ -55,31 +55,14 @@ extern "C"
 #include <algorithm>
 #include <vector>
 /* NOTE: The following comments were musings by the original developer about how
- * some additional API might work. The compile/free/run_query functions were
- * implemented for the DBI backend but never put into use; the rest were never
- * implemented. They're here as something to consider if we ever decide to
- * implement them.
+ * some additional API might work. The compile/free/run_query functions are
+ * the virtual functions of the same name in QofBackend below; the rest were
+ * never implemented. They're here as something to consider if we ever decide
+ * to implement them.
  *
- * The compile_query() method compiles a QOF query object into
- *    a backend-specific data structure and returns the compiled
- *    query. For an SQL backend, the contents of the query object
- *    need to be turned into a corresponding SQL query statement, and
- *    sent to the database for evaluation.
- *
- * The free_query() method frees the data structure returned from
- *    compile_query()
- *
- * The run_query() callback takes a compiled query (generated by
- *    compile_query) and runs the query in across the backend,
- *    inserting the responses into the engine. The database will
- *    return a set of splits and transactions and this callback needs
- *    to poke these into the account-group hierarchy held by the query
- *    object.
- *
- *    For a network-communications backend, essentially the same is
- *    done, except that this routine would convert the query to wire
- *    protocol, get an answer from the remote server, and push that
- *    into the account-group object.
+ * For a network-communications backend, run_query() would convert the
+ *    query to wire protocol, get an answer from the remote server, and
+ *    push that into the account-group object.
  *
  *    The returned list of entities can be used to build a local
  *    cache of the matching data.  This will allow the QOF client to
@@ -265,6 +248,25 @@ public:
  *   database with it. Implemented only in the XML backend at present.
  */
     virtual void export_coa(QofBook *) {}
+/**
+ *    Compile a QOF query into a backend-specific data structure, for
+ *    example an SQL statement selecting the rows that can match it.  Called
+ *    whenever the query's terms change.
+ *    @return The compiled query, or nullptr if the backend has nothing to
+ *    fetch for this kind of query.
+ */
+    virtual void* compile_query(QofQuery*) { return nullptr; }
+/**
+ *    Run a query compiled by compile_query() across the backend, loading
+ *    into the book any objects that might match it and aren't loaded yet.
+ *    The engine then runs the query over the objects in memory as usual, so
+ *    the backend may load more than the query matches but never less.
+ */
+    virtual void run_query(void*) {}
+/**
+ *    Free the data structure returned by compile_query().
+ */
+    virtual void free_query(void*) {}
 /** Set the error value only if there isn't already an error already.
  */
     void set_error(QofBackendError err);
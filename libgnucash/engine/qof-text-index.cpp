@@ -0,0 +1,519 @@
+/********************************************************************\
+ * qof-text-index.cpp -- trigram index over string parameters       *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+extern "C"
+{
+#include <config.h>
+
+#include <glib.h>
+#include <regex.h>
+#include <string.h>
+#include "qof.h"
+#include "qofquerycore-p.h"
+#include "qofevent-p.h"
+#include "qof-text-index.h"
+}
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static QofLogModule log_module = QOF_MOD_TEXT_INDEX;
+
+static const char* text_index_key = "qof-text-index";
+
+using Trigram = guint32;
+using TrigramList = std::vector<Trigram>;
+using ObjectList = std::vector<gpointer>;
+using ObjectLess = std::less<gconstpointer>;
+
+/* Append the byte trigrams of a string. */
+static void
+add_trigrams (const char* str, size_t len, TrigramList& trigrams)
+{
+    auto bytes = reinterpret_cast<const guchar*>(str);
+    for (size_t i = 0; i + 2 < len; ++i)
+        trigrams.push_back ((bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2]);
+}
+
+static void
+sort_trigrams (TrigramList& trigrams)
+{
+    std::sort (trigrams.begin (), trigrams.end ());
+    trigrams.erase (std::unique (trigrams.begin (), trigrams.end ()),
+                    trigrams.end ());
+}
+
+/* The indexed form of a string is the one qof_utf8_substr_nocase()
+ * searches in.  ASCII characters survive it unchanged apart from being
+ * lower-cased, which lets the other string matches use the index too. */
+static char*
+text_index_fold (const char* str)
+{
+    auto casefold = g_utf8_casefold (str, -1);
+    auto normalized = g_utf8_normalize (casefold, -1, G_NORMALIZE_ALL);
+    g_free (casefold);
+    /* Invalid UTF-8; qof_utf8_substr_nocase can't match it either. */
+    if (!normalized)
+        normalized = g_ascii_strdown (str, -1);
+    return normalized;
+}
+
+/* Append the runs of ASCII characters of str that are at least three
+ * bytes long, lower-cased. */
+static void
+add_ascii_runs (const char* str, std::vector<std::string>& runs)
+{
+    std::string run;
+    for (auto p = str; ; ++p)
+    {
+        if (*p && !(*p & 0x80))
+        {
+            run += g_ascii_tolower (*p);
+            continue;
+        }
+        if (run.size () >= 3)
+            runs.push_back (run);
+        run.clear ();
+        if (!*p)
+            break;
+    }
+}
+
+/* Find the literal strings that every match of a POSIX extended regular
+ * expression must contain.  This is deliberately simple: alternations
+ * give up, groups and bracket expressions are skipped, and a literal
+ * followed by a quantifier that allows zero repetitions is dropped. */
+static void
+add_regex_literals (const char* pattern, std::vector<std::string>& runs)
+{
+    std::string run;
+    int depth = 0;
+
+    auto end_run = [&runs, &run]()
+        {
+            if (run.size () >= 3)
+                runs.push_back (run);
+            run.clear ();
+        };
+
+    for (auto p = pattern; *p; ++p)
+    {
+        switch (*p)
+        {
+        case '|':
+            runs.clear ();
+            return;
+        case '\\':
+            if (p[1] && !(p[1] & 0x80) && g_ascii_ispunct (p[1]))
+            {
+                ++p;
+                if (!depth)
+                    run += *p;
+            }
+            else
+            {
+                end_run ();
+                if (p[1])
+                    ++p;
+            }
+            break;
+        case '(':
+            end_run ();
+            ++depth;
+            break;
+        case ')':
+            if (depth)
+                --depth;
+            break;
+        case '[':
+            end_run ();
+            ++p;
+            if (*p == '^')
+                ++p;
+            if (*p == ']')
+                ++p;
+            while (*p && *p != ']')
+                ++p;
+            if (!*p)
+                --p;
+            break;
+        case '*':
+        case '?':
+        case '{':
+            if (!run.empty ())
+                run.pop_back ();
+            end_run ();
+            if (*p == '{')
+            {
+                while (*p && *p != '}')
+                    ++p;
+                if (!*p)
+                    --p;
+            }
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            end_run ();
+            break;
+        default:
+            if (*p & 0x80)
+                end_run ();
+            else if (!depth)
+                run += g_ascii_tolower (*p);
+            break;
+        }
+    }
+    end_run ();
+}
+
+class TextIndex
+{
+public:
+    TextIndex (QofIdTypeConst obj_type, const QofParam* param) :
+        m_type{obj_type}, m_param{param} {}
+    bool matches (QofIdTypeConst obj_type, const char* param_name) const
+    {
+        return m_type == obj_type && m_param->param_name == std::string{param_name};
+    }
+    bool indexes (QofIdTypeConst obj_type) const { return m_type == obj_type; }
+    void build (QofBook* book);
+    void update (gpointer object);
+    void remove (gpointer object);
+    GPtrArray* lookup (const std::vector<std::string>& needles) const;
+private:
+    TrigramList object_trigrams (gpointer object) const;
+    std::string m_type;
+    const QofParam* m_param;
+    std::unordered_map<Trigram, ObjectList> m_postings;
+    std::unordered_map<gpointer, TrigramList> m_objects;
+};
+
+TrigramList
+TextIndex::object_trigrams (gpointer object) const
+{
+    TrigramList trigrams;
+    using string_getter = const char* (*)(gpointer, const QofParam*);
+    auto str = reinterpret_cast<string_getter>(m_param->param_getfcn)(object, m_param);
+    if (!str || strlen (str) < 3)
+        return trigrams;
+    auto folded = text_index_fold (str);
+    add_trigrams (folded, strlen (folded), trigrams);
+    g_free (folded);
+    sort_trigrams (trigrams);
+    return trigrams;
+}
+
+void
+TextIndex::build (QofBook* book)
+{
+    ENTER ("book=%p type=%s param=%s", book, m_type.c_str (), m_param->param_name);
+    m_postings.clear ();
+    m_objects.clear ();
+    qof_object_foreach (m_type.c_str (), book,
+                        [](QofInstance* inst, gpointer data)
+                        {
+                            auto self = static_cast<TextIndex*>(data);
+                            auto trigrams = self->object_trigrams (inst);
+                            for (auto trigram : trigrams)
+                                self->m_postings[trigram].push_back (inst);
+                            self->m_objects.emplace (inst, std::move (trigrams));
+                        }, this);
+
+    for (auto& posting : m_postings)
+        std::sort (posting.second.begin (), posting.second.end (), ObjectLess ());
+    LEAVE ("%zu objects, %zu trigrams", m_objects.size (), m_postings.size ());
+}
+
+void
+TextIndex::remove (gpointer object)
+{
+    auto iter = m_objects.find (object);
+    if (iter == m_objects.end ())
+        return;
+
+    for (auto trigram : iter->second)
+    {
+        auto& posting = m_postings[trigram];
+        auto pos = std::lower_bound (posting.begin (), posting.end (),
+                                     object, ObjectLess ());
+        if (pos != posting.end () && *pos == object)
+            posting.erase (pos);
+        if (posting.empty ())
+            m_postings.erase (trigram);
+    }
+    m_objects.erase (iter);
+}
+
+void
+TextIndex::update (gpointer object)
+{
+    remove (object);
+
+    auto trigrams = object_trigrams (object);
+    for (auto trigram : trigrams)
+    {
+        auto& posting = m_postings[trigram];
+        auto pos = std::lower_bound (posting.begin (), posting.end (),
+                                     object, ObjectLess ());
+        posting.insert (pos, object);
+    }
+    m_objects.emplace (object, std::move (trigrams));
+}
+
+GPtrArray*
+TextIndex::lookup (const std::vector<std::string>& needles) const
+{
+    TrigramList trigrams;
+    for (const auto& needle : needles)
+        add_trigrams (needle.c_str (), needle.size (), trigrams);
+    sort_trigrams (trigrams);
+
+    std::vector<const ObjectList*> postings;
+    for (auto trigram : trigrams)
+    {
+        auto iter = m_postings.find (trigram);
+        if (iter == m_postings.end ())
+            return g_ptr_array_new ();
+        postings.push_back (&iter->second);
+    }
+
+    /* Intersect starting with the rarest trigram. */
+    std::sort (postings.begin (), postings.end (),
+               [](const ObjectList* a, const ObjectList* b)
+               { return a->size () < b->size (); });
+
+    ObjectList candidates{*postings.front ()};
+    for (auto iter = postings.begin () + 1;
+         iter != postings.end () && !candidates.empty (); ++iter)
+    {
+        ObjectList both;
+        std::set_intersection (candidates.begin (), candidates.end (),
+                               (*iter)->begin (), (*iter)->end (),
+                               std::back_inserter (both), ObjectLess ());
+        candidates.swap (both);
+    }
+
+    auto result = g_ptr_array_sized_new (candidates.size ());
+    for (auto object : candidates)
+        g_ptr_array_add (result, object);
+    return result;
+}
+
+/* All indexes of one book, stored in the book's data table. */
+struct BookTextIndexes
+{
+    QofBook* book;
+    gint handler_id;
+    /* qof_event_get_dropped_count() when the indexes were last known to
+     * be up to date. */
+    guint dropped_events;
+    std::vector<std::unique_ptr<TextIndex>> indexes;
+};
+
+static void
+text_index_event_handler (QofInstance *ent, QofEventId event_type,
+                          gpointer handler_data, gpointer event_data)
+{
+    auto bti = static_cast<BookTextIndexes*>(handler_data);
+
+    if (!(event_type & (QOF_EVENT_CREATE | QOF_EVENT_MODIFY | QOF_EVENT_DESTROY)))
+        return;
+    if (!ent || qof_instance_get_book (ent) != bti->book ||
+        qof_book_shutting_down (bti->book))
+        return;
+
+    for (auto& index : bti->indexes)
+    {
+        if (!index->indexes (ent->e_type))
+            continue;
+        if ((event_type & QOF_EVENT_DESTROY) || qof_instance_get_destroying (ent))
+            index->remove (ent);
+        else
+            index->update (ent);
+    }
+}
+
+static void
+text_index_book_end (QofBook *book, gpointer key, gpointer user_data)
+{
+    auto bti = static_cast<BookTextIndexes*>(user_data);
+
+    qof_event_unregister_handler (bti->handler_id);
+    qof_book_set_data (book, text_index_key, NULL);
+    delete bti;
+}
+
+static BookTextIndexes*
+get_book_indexes (QofBook *book, bool create)
+{
+    auto bti = static_cast<BookTextIndexes*>(qof_book_get_data (book, text_index_key));
+    if (bti || !create)
+        return bti;
+
+    bti = new BookTextIndexes;
+    bti->book = book;
+    bti->handler_id = qof_event_register_handler (text_index_event_handler, bti);
+    bti->dropped_events = qof_event_get_dropped_count ();
+    qof_book_set_data_fin (book, text_index_key, bti, text_index_book_end);
+    return bti;
+}
+
+/* Changes made while events were suspended went unseen, and objects
+ * may have been freed and others allocated in their place, so all the
+ * indexes of the book are built again. */
+static void
+refresh_book_indexes (BookTextIndexes *bti)
+{
+    auto dropped = qof_event_get_dropped_count ();
+    if (bti->dropped_events == dropped)
+        return;
+
+    PINFO ("%u events dropped, rebuilding the text indexes of book %p",
+           dropped - bti->dropped_events, bti->book);
+    for (auto& index : bti->indexes)
+        index->build (bti->book);
+    bti->dropped_events = dropped;
+}
+
+static TextIndex*
+find_index (QofBook *book, QofIdTypeConst obj_type, const char *param_name)
+{
+    auto bti = get_book_indexes (book, false);
+    if (!bti)
+        return nullptr;
+
+    for (auto& index : bti->indexes)
+        if (index->matches (obj_type, param_name))
+            return index.get ();
+    return nullptr;
+}
+
+void
+qof_text_index_enable (QofBook *book, QofIdTypeConst obj_type,
+                       const char *param_name)
+{
+    g_return_if_fail (book && obj_type && param_name);
+
+    if (find_index (book, obj_type, param_name))
+        return;
+
+    auto param = qof_class_get_parameter (obj_type, param_name);
+    if (!param || g_strcmp0 (param->param_type, QOF_TYPE_STRING))
+    {
+        PWARN ("%s is not a string parameter of %s", param_name, obj_type);
+        return;
+    }
+
+    auto index = new TextIndex (obj_type, param);
+    index->build (book);
+    get_book_indexes (book, true)->indexes.emplace_back (index);
+}
+
+void
+qof_text_index_disable (QofBook *book, QofIdTypeConst obj_type,
+                        const char *param_name)
+{
+    g_return_if_fail (book && obj_type && param_name);
+
+    auto bti = get_book_indexes (book, false);
+    if (!bti)
+        return;
+
+    auto& indexes = bti->indexes;
+    indexes.erase (std::remove_if (indexes.begin (), indexes.end (),
+                                   [obj_type, param_name](const std::unique_ptr<TextIndex>& index)
+                                   { return index->matches (obj_type, param_name); }),
+                   indexes.end ());
+}
+
+gboolean
+qof_text_index_is_enabled (QofBook *book, QofIdTypeConst obj_type,
+                           const char *param_name)
+{
+    if (!book || !obj_type || !param_name)
+        return FALSE;
+    return find_index (book, obj_type, param_name) != nullptr;
+}
+
+GPtrArray*
+qof_text_index_lookup (QofBook *book, QofIdTypeConst obj_type,
+                       const char *param_name, const QofQueryPredData *pdata)
+{
+    std::vector<std::string> needles;
+
+    if (!book || !obj_type || !param_name || !pdata)
+        return NULL;
+    if (g_strcmp0 (pdata->type_name, QOF_TYPE_STRING))
+        return NULL;
+    if (pdata->how != QOF_COMPARE_CONTAINS && pdata->how != QOF_COMPARE_EQUAL)
+        return NULL;
+
+    auto index = find_index (book, obj_type, param_name);
+    if (!index)
+        return NULL;
+
+    auto spdata = reinterpret_cast<const query_string_def*>(pdata);
+    if (spdata->is_regex)
+        add_regex_literals (spdata->matchstring, needles);
+    else if (spdata->options == QOF_STRING_MATCH_CASEINSENSITIVE)
+    {
+        /* Equality is decided by collation, which the index can't see. */
+        if (pdata->how != QOF_COMPARE_CONTAINS)
+            return NULL;
+        auto folded = text_index_fold (spdata->matchstring);
+        if (strlen (folded) >= 3)
+            needles.emplace_back (folded);
+        g_free (folded);
+    }
+    else
+        add_ascii_runs (spdata->matchstring, needles);
+
+    if (needles.empty ())
+        return NULL;
+
+    refresh_book_indexes (get_book_indexes (book, false));
+    return index->lookup (needles);
+}
+
+gint
+qof_text_index_compare (gconstpointer a, gconstpointer b)
+{
+    auto obj_a = *static_cast<const gconstpointer*>(a);
+    auto obj_b = *static_cast<const gconstpointer*>(b);
+    if (ObjectLess ()(obj_a, obj_b))
+        return -1;
+    return ObjectLess ()(obj_b, obj_a) ? 1 : 0;
+}
+
+gboolean
+qof_text_index_contains (const GPtrArray *candidates, gconstpointer object)
+{
+    g_return_val_if_fail (candidates, FALSE);
+    auto begin = const_cast<const gpointer*>(candidates->pdata);
+    return std::binary_search (begin, begin + candidates->len,
+                               object, ObjectLess ());
+}
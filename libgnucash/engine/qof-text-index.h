@@ -0,0 +1,96 @@
+/********************************************************************\
+ * qof-text-index.h -- trigram index over string parameters         *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+/** @addtogroup Query
+    @{ */
+/** @file qof-text-index.h
+    @brief Optional trigram index used to pre-filter string queries.
+
+    A text index remembers, for every object of one type in a book, the
+    set of byte trigrams of one of its string parameters.  The string is
+    case-folded and normalized first, exactly like
+    qof_utf8_substr_nocase() does.  The query engine uses the index to
+    find the few objects that can possibly satisfy a "contains" or
+    regular expression string predicate, and only runs the real
+    predicate on those.
+
+    The index is kept up to date from the QOF_EVENT_CREATE, MODIFY and
+    DESTROY events of the indexed objects.  Events dropped while they
+    were suspended make the next lookup build the book's indexes again.
+    Indexes are dropped with their book.
+*/
+
+#ifndef QOF_TEXT_INDEX_H
+#define QOF_TEXT_INDEX_H
+
+#include "qofbook.h"
+#include "qofquerycore.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define QOF_MOD_TEXT_INDEX "qof.text-index"
+
+/** Build an index over the string parameter param_name of all objects
+ *  of type obj_type in book and keep it up to date from then on.  Does
+ *  nothing if the index already exists or the parameter isn't a string.
+ */
+void qof_text_index_enable (QofBook *book, QofIdTypeConst obj_type,
+                            const char *param_name);
+
+/** Drop the index built by qof_text_index_enable(). */
+void qof_text_index_disable (QofBook *book, QofIdTypeConst obj_type,
+                             const char *param_name);
+
+/** @return TRUE if an index exists for that parameter. */
+gboolean qof_text_index_is_enabled (QofBook *book, QofIdTypeConst obj_type,
+                                    const char *param_name);
+
+/** Find the candidates for a string predicate on an indexed parameter.
+ *
+ *  @return NULL if there is no index or the predicate can't be narrowed
+ *  down by it (negated matches, patterns without a literal of at least
+ *  three bytes, ...).  Otherwise a newly allocated array of the objects
+ *  that may match, sorted by address for qof_text_index_contains().
+ *  Objects not in the array are guaranteed not to match.  Free it with
+ *  g_ptr_array_free().
+ */
+GPtrArray *qof_text_index_lookup (QofBook *book, QofIdTypeConst obj_type,
+                                  const char *param_name,
+                                  const QofQueryPredData *pdata);
+
+/** A GCompareFunc for g_ptr_array_sort() that restores the order of a
+ *  candidate array after appending the candidates of another book. */
+gint qof_text_index_compare (gconstpointer a, gconstpointer b);
+
+/** @return TRUE if object is in a candidate array returned by
+ *  qof_text_index_lookup(). */
+gboolean qof_text_index_contains (const GPtrArray *candidates,
+                                  gconstpointer object);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QOF_TEXT_INDEX_H */
+/** @} */
@@ -86,5 +86,6 @@
 #include "qofsession.h"
 #include "qofchoice.h"
 #include "qof-string-cache.h"
+#include "qof-text-index.h"
 
 #endif /* QOF_H_ */
@@ -104,6 +104,8 @@ typedef enum
                                     for internal use by GnuCash */
     ERR_FILEIO_FILE_UPGRADE,   /**< file will be upgraded and not be able to be
                                     read by prior versions - warn users*/
+    ERR_FILEIO_RELOAD,         /**< the load was abandoned part way through and
+                                    has to be done again into an empty book */
 
     /* network errors */
     ERR_NETIO_SHORT_READ = 2000,  /**< not enough bytes received */
@@ -39,4 +39,9 @@ typedef struct
 /* generates an event even when events are suspended! */
 void qof_event_force (QofInstance *entity, QofEventId event_id, gpointer event_data);
 
+/* The number of events not generated because events were suspended.
+ * State kept up to date by an event handler may have missed changes if
+ * this has grown since it was last brought up to date. */
+guint qof_event_get_dropped_count (void);
+
 #endif
@@ -33,6 +33,7 @@ extern "C"
 
 /* Static Variables ************************************************/
 static guint   suspend_counter   = 0;
+static guint   dropped_events    = 0;
 static gint    next_handler_id   = 1;
 static guint   handler_run_level = 0;
 static guint   pending_deletes   = 0;
@@ -237,9 +238,18 @@ qof_event_gen (QofInstance *entity, QofEventId event_id, gpointer event_data)
         return;
 
     if (suspend_counter)
+    {
+        dropped_events++;
         return;
+    }
 
     qof_event_generate_internal (entity, event_id, event_data);
 }
 
+guint
+qof_event_get_dropped_count (void)
+{
+    return dropped_events;
+}
+
 /* =========================== END OF FILE ======================= */
@@ -36,8 +36,10 @@ extern "C"
 #include "qof-backend.hpp"
 #include "qofbook-p.h"
 #include "qofclass-p.h"
+#include "qofevent-p.h"
 #include "qofquery-p.h"
 #include "qofquerycore-p.h"
+#include "qof-text-index.h"
 
 static QofLogModule log_module = QOF_MOD_QUERY;
 
@@ -54,6 +56,10 @@ struct _QofQueryTerm
      */
     GSList *                param_fcns;
     QofQueryPredicateFunc   pred_fcn;
+
+    /* Objects that may satisfy pred_fcn according to a text index, or
+     * NULL to check every object.  Only set while the query runs. */
+    GPtrArray *             candidates;
 };
 
 struct _QofQuerySort
@@ -93,6 +99,13 @@ struct _QofQuery
     /* The maximum number of results to return */
     gint              max_results;
 
+    /* Number of worker threads used to evaluate the terms; 0 or 1 runs
+     * serially, a negative value picks one per processor. */
+    gint              n_workers;
+
+    /* Whether the matches may be served from the shared result cache */
+    gboolean          cached;
+
     /* list of books that will be participating in the query */
     GList *           books;
 
@@ -113,6 +126,20 @@ typedef struct _QofQueryCB
     gint              count;
 } QofQueryCB;
 
+/* One partition of a collection being checked by a worker thread. */
+typedef struct _QofQueryPartition
+{
+    const QofQuery *  query;
+    gpointer *        objects;
+    guint             n_objects;
+    GList *           list;
+    gint              count;
+} QofQueryPartition;
+
+/* Don't bother spawning threads for fewer objects than this per worker
+ * when the number of workers was chosen automatically. */
+#define QOF_QUERY_MIN_OBJECTS_PER_WORKER 2048
+
 /* initial_term will be owned by the new Query */
 static void query_init (QofQuery *q, QofQueryTerm *initial_term)
 {
@@ -195,6 +222,7 @@ static QofQueryTerm * copy_query_term (const QofQueryTerm *qt)
     new_qt->param_list = g_slist_copy (qt->param_list);
     new_qt->param_fcns = g_slist_copy (qt->param_fcns);
     new_qt->pdata = qof_query_core_predicate_copy (qt->pdata);
+    new_qt->candidates = NULL;
     return new_qt;
 }
 
@@ -394,7 +422,16 @@ check_object (const QofQuery *q, gpointer object)
                     conv_obj = param->param_getfcn (conv_obj, param);
                 }
 
-                if (((qt->pred_fcn)(conv_obj, param, qt->pdata)) == qt->invert)
+                if (qt->candidates &&
+                        !qof_text_index_contains (qt->candidates, conv_obj))
+                {
+                    if (!qt->invert)
+                    {
+                        and_terms_ok = 0;
+                        break;
+                    }
+                }
+                else if (((qt->pred_fcn)(conv_obj, param, qt->pdata)) == qt->invert)
                 {
                     and_terms_ok = 0;
                     break;
@@ -548,25 +585,96 @@ static void compile_terms (QofQuery *q)
     compile_sort (&(q->tertiary_sort), q->search_for);
 
     q->defaultSort = qof_class_get_default_sort (q->search_for);
-#ifdef QOF_BACKEND_QUERY
+
     /* Now compile the backend instances */
     for (node = q->books; node; node = node->next)
     {
         QofBook* book = static_cast<QofBook*>(node->data);
-        QofBackend* be = book->backend;
+        QofBackend* be = qof_book_get_backend (book);
 
-        if (be && be->compile_query)
+        if (be)
         {
-            gpointer result = (be->compile_query)(be, q);
+            gpointer result = be->compile_query (q);
             if (result)
                 g_hash_table_insert (q->be_compiled, book, result);
         }
-
     }
-#endif
     LEAVE (" query=%p", q);
 }
 
+/* Look for string terms that a text index can narrow down and attach
+ * the index candidates to them.  A term is only narrowed if every book
+ * searched has an index on its parameter.
+ */
+static void plan_text_index (QofQuery *q)
+{
+    for (GList *or_ptr = q->terms; or_ptr; or_ptr = or_ptr->next)
+    {
+        for (GList *and_ptr = static_cast<GList*>(or_ptr->data); and_ptr;
+             and_ptr = and_ptr->next)
+        {
+            QofQueryTerm *qt = static_cast<QofQueryTerm*>(and_ptr->data);
+            QofIdTypeConst obj_type = q->search_for;
+            const QofParam *param = NULL;
+            GPtrArray *candidates = NULL;
+
+            if (qt->invert || !qt->param_fcns || !qt->pred_fcn)
+                continue;
+
+            /* The index is on the object handed to the last getter */
+            for (GSList *node = qt->param_fcns; node; node = node->next)
+            {
+                param = static_cast<QofParam*>(node->data);
+                if (!node->next) break;
+                obj_type = param->param_type;
+            }
+
+            for (GList *node = q->books; node; node = node->next)
+            {
+                QofBook *book = static_cast<QofBook*>(node->data);
+                GPtrArray *found = qof_text_index_lookup (book, obj_type,
+                                                          param->param_name,
+                                                          qt->pdata);
+                if (!found)
+                {
+                    if (candidates)
+                        g_ptr_array_free (candidates, TRUE);
+                    candidates = NULL;
+                    break;
+                }
+                if (!candidates)
+                {
+                    candidates = found;
+                    continue;
+                }
+                for (guint i = 0; i < found->len; i++)
+                    g_ptr_array_add (candidates, found->pdata[i]);
+                g_ptr_array_free (found, TRUE);
+            }
+
+            if (!candidates)
+                continue;
+            if (q->books && q->books->next)
+                g_ptr_array_sort (candidates, qof_text_index_compare);
+            PINFO ("term %p narrowed to %u candidates", qt, candidates->len);
+            qt->candidates = candidates;
+        }
+    }
+}
+
+static void clear_text_index_plan (QofQuery *q)
+{
+    for (GList *or_ptr = q->terms; or_ptr; or_ptr = or_ptr->next)
+        for (GList *and_ptr = static_cast<GList*>(or_ptr->data); and_ptr;
+             and_ptr = and_ptr->next)
+        {
+            QofQueryTerm *qt = static_cast<QofQueryTerm*>(and_ptr->data);
+            if (qt->candidates)
+                g_ptr_array_free (qt->candidates, TRUE);
+            qt->candidates = NULL;
+        }
+}
+
 static void check_item_cb (gpointer object, gpointer user_data)
 {
     QofQueryCB* ql = static_cast<QofQueryCB*>(user_data);
@@ -581,6 +689,137 @@ static void check_item_cb (gpointer object, gpointer user_data)
     return;
 }
 
+/* Parallel evaluation.
+ *
+ * check_object() only reads the query and calls the registered
+ * parameter getters and predicates, so disjoint slices of a collection
+ * can be checked concurrently as long as nothing edits the book while
+ * the query runs (the query is run from the GUI thread, which is also
+ * the only thread that edits).  The getters registered for splits and
+ * transactions were audited for this:
+ *
+ *  - Plain field readers (xaccSplitGetMemo, xaccSplitGetAmount,
+ *    xaccTransGetDescription, xaccTransRetDatePosted, ...) and the
+ *    computed ones (xaccSplitGetSharePrice, xaccTransGetImbalanceValue,
+ *    trans_is_balanced_p) only read engine state and allocate through
+ *    GLib, which is thread safe.
+ *  - KVP readers (xaccTransGetNotes, xaccTransGetVoidStatus,
+ *    xaccSplitGetType, xaccSplitVoidFormerAmount, ...) go through
+ *    qof_instance_get_kvp, which only walks the frame and copies the
+ *    value out.
+ *  - xaccTransGetIsClosingTxn fills isClosingTxn_cached on first use.
+ *    The flag is read and stored with g_atomic_int_get/set, so workers
+ *    filling it at the same time don't race.
+ *  - xaccTransGetVoidTime parses with GncDateTime, whose time zone
+ *    provider is only read after its (thread safe) static construction.
+ *  - xaccSplitGetBalance and friends return the cached running balance
+ *    without recomputing it.
+ *
+ * The core predicates are pure; regexec() is thread safe on a shared,
+ * compiled regex_t.  Getters registered from Scheme or by other objects
+ * have not been audited and should not be searched in parallel.
+ */
+static void gather_item_cb (gpointer object, gpointer user_data)
+{
+    GPtrArray* objects = static_cast<GPtrArray*>(user_data);
+
+    if (object)
+        g_ptr_array_add (objects, object);
+}
+
+static gpointer check_partition_thread (gpointer data)
+{
+    QofQueryPartition* part = static_cast<QofQueryPartition*>(data);
+
+    for (guint i = 0; i < part->n_objects; i++)
+    {
+        gpointer object = part->objects[i];
+        if (check_object (part->query, object))
+        {
+            part->list = g_list_prepend (part->list, object);
+            part->count++;
+        }
+    }
+    return part;
+}
+
+static guint query_worker_count (const QofQuery *q, guint n_objects)
+{
+    guint n_workers;
+
+    if (q->n_workers < 0)
+    {
+        n_workers = g_get_num_processors ();
+        n_workers = MIN (n_workers, n_objects / QOF_QUERY_MIN_OBJECTS_PER_WORKER);
+    }
+    else
+        n_workers = q->n_workers;
+
+    n_workers = MIN (n_workers, n_objects);
+    return MAX (n_workers, 1);
+}
+
+static void check_items_parallel (QofQueryCB *qcb, QofBook *book)
+{
+    GPtrArray *objects = g_ptr_array_new ();
+    QofQueryPartition *parts;
+    GThread **threads;
+    guint n_workers, chunk, rest, start = 0;
+
+    qof_object_foreach (qcb->query->search_for, book,
+                        (QofInstanceForeachCB) gather_item_cb, objects);
+
+    n_workers = query_worker_count (qcb->query, objects->len);
+    if (n_workers < 2)
+    {
+        g_ptr_array_foreach (objects, check_item_cb, qcb);
+        g_ptr_array_free (objects, TRUE);
+        return;
+    }
+
+    PINFO ("checking %u objects on %u workers", objects->len, n_workers);
+    parts = g_new0 (QofQueryPartition, n_workers);
+    threads = g_new0 (GThread*, n_workers);
+    chunk = objects->len / n_workers;
+    rest = objects->len % n_workers;
+
+    for (guint i = 0; i < n_workers; i++)
+    {
+        parts[i].query = qcb->query;
+        parts[i].objects = objects->pdata + start;
+        parts[i].n_objects = chunk + (i < rest ? 1 : 0);
+        start += parts[i].n_objects;
+    }
+
+    /* The calling thread takes the first partition itself. If a thread
+     * can't be created its partition is checked here as well. */
+    for (guint i = 1; i < n_workers; i++)
+    {
+        threads[i] = g_thread_try_new ("qof-query", check_partition_thread,
+                                       &parts[i], NULL);
+        if (!threads[i])
+            check_partition_thread (&parts[i]);
+    }
+    check_partition_thread (&parts[0]);
+
+    for (guint i = 1; i < n_workers; i++)
+        if (threads[i])
+            g_thread_join (threads[i]);
+
+    /* Each partition list is reversed, just as check_item_cb would have
+     * left it, so stacking them in partition order yields exactly the
+     * list a serial run produces. */
+    for (guint i = 0; i < n_workers; i++)
+    {
+        qcb->list = g_list_concat (parts[i].list, qcb->list);
+        qcb->count += parts[i].count;
+    }
+
+    g_free (threads);
+    g_free (parts);
+    g_ptr_array_free (objects, TRUE);
+}
+
 static int param_list_cmp (const QofQueryParamList *l1, const QofQueryParamList *l2)
 {
     int ret;
@@ -623,22 +862,418 @@ static GList * merge_books (GList *l1, GList *l2)
 static gboolean
 query_free_compiled (gpointer key, gpointer value, gpointer not_used)
 {
-#ifdef QOF_BACKEND_QUERY
     QofBook* book = static_cast<QofBook*>(key);
-    QofBackend* be = book->backend;
+    QofBackend* be = qof_book_get_backend (book);
 
-    if (be && be->free_query)
-        (be->free_query)(be, value);
-#endif
+    if (be)
+        be->free_query (value);
     return TRUE;
 }
 
+/* Give the backend of each book a chance to load the objects that might
+ * match the query before the query runs over the objects in memory.
+ */
+static void query_run_backends (QofQuery *q)
+{
+    for (GList *node = q->books; node; node = node->next)
+    {
+        QofBook* book = static_cast<QofBook*>(node->data);
+        QofBackend* be = qof_book_get_backend (book);
+        gpointer compiled_query = g_hash_table_lookup (q->be_compiled, book);
+
+        if (be && compiled_query)
+            be->run_query (compiled_query);
+    }
+}
+
 /* clear out any cached query_compilations */
 static void query_clear_compiles (QofQuery *q)
 {
     g_hash_table_foreach_remove (q->be_compiled, query_free_compiled, NULL);
 }
 
+/* Result cache.
+ *
+ * Queries that opt in with qof_query_set_cached() share a small cache
+ * of unsorted match sets, keyed by the type searched for, the books
+ * searched and the terms.  An event handler records which objects of
+ * the searched type were created, changed or destroyed since a set was
+ * computed, and the next run only re-checks those.  The objects of
+ * other types that the terms walk through (the account of a split, say)
+ * remember which searched objects reached them, and a change to one of
+ * them only re-checks those.  Too many changes, or any event dropped
+ * while events were suspended, make the next run a full one.
+ */
+typedef struct _QofQueryCacheEntry
+{
+    guint             hash;
+    QofQuery *        key;          /* private copy of the cached query */
+    GSList *          path_types;   /* other types the terms walk through */
+    GHashTable *      matches;      /* object -> copy of its GncGUID */
+    GHashTable *      changed;      /* object -> copy of its GncGUID */
+    GHashTable *      dependents;   /* path object -> objects reaching it */
+    guint             dropped_events; /* when the entry was last filled */
+    gboolean          stale;
+} QofQueryCacheEntry;
+
+#define QOF_QUERY_CACHE_SIZE 16
+#define QOF_QUERY_CACHE_MIN_CHANGES 256
+
+static GList *query_cache = NULL;   /* most recently used first */
+static gint query_cache_handler_id = 0;
+
+static gboolean query_terms_equal (const GList *terms1, const GList *terms2);
+
+static guint query_cache_hash (const QofQuery *q)
+{
+    guint hash = g_str_hash (q->search_for);
+
+    /* The order of the books doesn't matter */
+    for (GList *node = q->books; node; node = node->next)
+        hash ^= g_direct_hash (node->data);
+
+    for (GList *or_ptr = q->terms; or_ptr; or_ptr = or_ptr->next)
+    {
+        hash = hash * 31 + 1;
+        for (GList *and_ptr = static_cast<GList*>(or_ptr->data); and_ptr;
+             and_ptr = and_ptr->next)
+        {
+            QofQueryTerm *qt = static_cast<QofQueryTerm*>(and_ptr->data);
+
+            hash = hash * 31 + qt->invert;
+            hash = hash * 31 + qt->pdata->how;
+            hash = hash * 31 + g_str_hash (qt->pdata->type_name);
+            for (GSList *node = qt->param_list; node; node = node->next)
+                hash = hash * 31 + g_str_hash (node->data);
+        }
+    }
+    return hash;
+}
+
+static gboolean query_cache_key_equal (const QofQuery *q1, const QofQuery *q2)
+{
+    if (g_strcmp0 (q1->search_for, q2->search_for)) return FALSE;
+    if (g_list_length (q1->books) != g_list_length (q2->books)) return FALSE;
+
+    for (GList *node = q1->books; node; node = node->next)
+        if (!g_list_find (q2->books, node->data))
+            return FALSE;
+
+    return query_terms_equal (q1->terms, q2->terms);
+}
+
+static void query_cache_entry_reset (QofQueryCacheEntry *entry)
+{
+    g_hash_table_remove_all (entry->matches);
+    g_hash_table_remove_all (entry->changed);
+    g_hash_table_remove_all (entry->dependents);
+    entry->stale = TRUE;
+}
+
+static QofQueryCacheEntry * query_cache_entry_new (QofQuery *q, guint hash)
+{
+    QofQueryCacheEntry *entry = g_new0 (QofQueryCacheEntry, 1);
+
+    entry->hash = hash;
+    entry->key = qof_query_copy (q);
+    entry->key->cached = FALSE;
+    g_list_free (entry->key->results);
+    entry->key->results = NULL;
+    entry->matches = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL, (GDestroyNotify) guid_free);
+    entry->changed = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL, (GDestroyNotify) guid_free);
+    entry->dependents = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                               NULL, (GDestroyNotify) g_hash_table_destroy);
+    entry->stale = TRUE;
+
+    /* The terms are compiled by now; collect the types of the objects
+     * that their getters are applied to, besides the searched one. */
+    for (GList *or_ptr = q->terms; or_ptr; or_ptr = or_ptr->next)
+        for (GList *and_ptr = static_cast<GList*>(or_ptr->data); and_ptr;
+             and_ptr = and_ptr->next)
+        {
+            QofQueryTerm *qt = static_cast<QofQueryTerm*>(and_ptr->data);
+
+            for (GSList *node = qt->param_fcns; node && node->next;
+                 node = node->next)
+            {
+                QofParam *param = static_cast<QofParam*>(node->data);
+                if (!g_slist_find_custom (entry->path_types, param->param_type,
+                                          (GCompareFunc) g_strcmp0))
+                    entry->path_types = g_slist_prepend (entry->path_types,
+                                                         (gpointer) param->param_type);
+            }
+        }
+
+    return entry;
+}
+
+static void query_cache_entry_free (QofQueryCacheEntry *entry)
+{
+    qof_query_destroy (entry->key);
+    g_slist_free (entry->path_types);
+    g_hash_table_destroy (entry->matches);
+    g_hash_table_destroy (entry->changed);
+    g_hash_table_destroy (entry->dependents);
+    g_free (entry);
+}
+
+/* Record the objects that the terms walk through from object. */
+static void query_cache_add_dependent (QofQueryCacheEntry *entry,
+                                       gpointer object)
+{
+    const GncGUID *guid = qof_instance_get_guid (object);
+
+    for (GList *or_ptr = entry->key->terms; or_ptr; or_ptr = or_ptr->next)
+        for (GList *and_ptr = static_cast<GList*>(or_ptr->data); and_ptr;
+             and_ptr = and_ptr->next)
+        {
+            QofQueryTerm *qt = static_cast<QofQueryTerm*>(and_ptr->data);
+            gpointer conv_obj = object;
+
+            for (GSList *node = qt->param_fcns; node && node->next && conv_obj;
+                 node = node->next)
+            {
+                QofParam *param = static_cast<QofParam*>(node->data);
+                GHashTable *objects;
+                gpointer known;
+
+                conv_obj = param->param_getfcn (conv_obj, param);
+                if (!conv_obj)
+                    break;
+
+                objects = static_cast<GHashTable*>(g_hash_table_lookup (entry->dependents, conv_obj));
+                if (!objects)
+                {
+                    objects = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                     NULL, (GDestroyNotify) guid_free);
+                    g_hash_table_insert (entry->dependents, conv_obj, objects);
+                }
+                /* Refresh the GncGUID in case another object took the
+                 * place of a freed one. */
+                known = g_hash_table_lookup (objects, object);
+                if (!known || !guid_equal (static_cast<GncGUID*>(known), guid))
+                    g_hash_table_insert (objects, object, guid_copy (guid));
+            }
+        }
+}
+
+static void query_cache_add_dependent_cb (QofInstance *inst, gpointer user_data)
+{
+    query_cache_add_dependent (static_cast<QofQueryCacheEntry*>(user_data), inst);
+}
+
+/* The GncGUID of an object's own event is always current, the one kept
+ * for a dependent may belong to a freed object at the same address. */
+static void query_cache_mark_changed (QofQueryCacheEntry *entry,
+                                      gpointer object, const GncGUID *guid,
+                                      gboolean own_event)
+{
+    guint max_changes;
+
+    if (!own_event && g_hash_table_contains (entry->changed, object))
+        return;
+    g_hash_table_insert (entry->changed, object, guid_copy (guid));
+    max_changes = MAX (QOF_QUERY_CACHE_MIN_CHANGES,
+                       g_hash_table_size (entry->matches) / 4);
+    if (g_hash_table_size (entry->changed) > max_changes)
+        query_cache_entry_reset (entry);
+}
+
+static void
+query_cache_event_handler (QofInstance *ent, QofEventId event_type,
+                           gpointer handler_data, gpointer event_data)
+{
+    QofBook *book;
+    GList *node, *next;
+
+    if (!ent || !(event_type & (QOF_EVENT_CREATE | QOF_EVENT_MODIFY |
+                                QOF_EVENT_DESTROY | QOF_EVENT_ADD |
+                                QOF_EVENT_REMOVE)))
+        return;
+
+    if (QOF_IS_BOOK (ent))
+    {
+        if (!(event_type & QOF_EVENT_DESTROY))
+            return;
+        for (node = query_cache; node; node = next)
+        {
+            QofQueryCacheEntry *entry = static_cast<QofQueryCacheEntry*>(node->data);
+            next = node->next;
+            if (g_list_find (entry->key->books, ent))
+            {
+                query_cache = g_list_delete_link (query_cache, node);
+                query_cache_entry_free (entry);
+            }
+        }
+        return;
+    }
+
+    book = qof_instance_get_book (ent);
+    for (node = query_cache; node; node = node->next)
+    {
+        QofQueryCacheEntry *entry = static_cast<QofQueryCacheEntry*>(node->data);
+        GHashTable *objects;
+
+        if (entry->stale || !g_list_find (entry->key->books, book))
+            continue;
+
+        /* Re-check the objects that reach ent through the terms.  They
+         * are only known by GncGUID, some may be gone already. */
+        objects = static_cast<GHashTable*>(g_hash_table_lookup (entry->dependents, ent));
+        if (objects)
+        {
+            GHashTableIter iter;
+            gpointer object, guid;
+
+            g_hash_table_iter_init (&iter, objects);
+            while (!entry->stale && g_hash_table_iter_next (&iter, &object, &guid))
+                query_cache_mark_changed (entry, object,
+                                          static_cast<GncGUID*>(guid), FALSE);
+            if (entry->stale)
+                continue;
+            if (event_type & QOF_EVENT_DESTROY)
+                g_hash_table_remove (entry->dependents, ent);
+        }
+
+        if (g_strcmp0 (ent->e_type, entry->key->search_for))
+            continue;
+
+        if (event_type & QOF_EVENT_DESTROY)
+        {
+            g_hash_table_remove (entry->matches, ent);
+            g_hash_table_remove (entry->changed, ent);
+            continue;
+        }
+
+        query_cache_mark_changed (entry, ent, qof_instance_get_guid (ent),
+                                  TRUE);
+    }
+}
+
+/* Objects can in principle be freed without a destroy event, so make
+ * sure every object handed out is still the one registered under its
+ * GncGUID. */
+static gboolean query_cache_object_gone (gpointer object, gpointer guid,
+                                         gpointer user_data)
+{
+    QofQuery *q = static_cast<QofQuery*>(user_data);
+
+    for (GList *node = q->books; node; node = node->next)
+    {
+        QofBook *book = static_cast<QofBook*>(node->data);
+        QofCollection *col = qof_book_get_collection (book, q->search_for);
+
+        if (qof_collection_lookup_entity (col, static_cast<GncGUID*>(guid)) == object)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static QofQueryCacheEntry * query_cache_lookup (QofQuery *q)
+{
+    guint hash = query_cache_hash (q);
+    QofQueryCacheEntry *entry;
+    GList *node;
+
+    for (node = query_cache; node; node = node->next)
+    {
+        entry = static_cast<QofQueryCacheEntry*>(node->data);
+        if (entry->hash == hash && query_cache_key_equal (entry->key, q))
+        {
+            /* Keep the most recently used entries at the front */
+            query_cache = g_list_remove_link (query_cache, node);
+            query_cache = g_list_concat (node, query_cache);
+            return entry;
+        }
+    }
+
+    if (!query_cache_handler_id)
+        query_cache_handler_id =
+            qof_event_register_handler (query_cache_event_handler, NULL);
+
+    entry = query_cache_entry_new (q, hash);
+    query_cache = g_list_prepend (query_cache, entry);
+    if (g_list_length (query_cache) > QOF_QUERY_CACHE_SIZE)
+    {
+        node = g_list_last (query_cache);
+        query_cache_entry_free (static_cast<QofQueryCacheEntry*>(node->data));
+        query_cache = g_list_delete_link (query_cache, node);
+    }
+    return entry;
+}
+
+static void query_cache_shutdown (void)
+{
+    if (query_cache_handler_id)
+        qof_event_unregister_handler (query_cache_handler_id);
+    query_cache_handler_id = 0;
+
+    g_list_free_full (query_cache, (GDestroyNotify) query_cache_entry_free);
+    query_cache = NULL;
+}
+
+static void qof_query_run_cb(QofQueryCB* qcb, gpointer cb_arg);
+
+static void qof_query_run_cached_cb(QofQueryCB* qcb, gpointer cb_arg)
+{
+    QofQuery *q = qcb->query;
+    QofQueryCacheEntry *entry = query_cache_lookup (q);
+    GHashTableIter iter;
+    gpointer object, guid;
+
+    /* Changes made while events were suspended went unseen. */
+    if (entry->dropped_events != qof_event_get_dropped_count ())
+        query_cache_entry_reset (entry);
+
+    if (entry->stale)
+    {
+        qof_query_run_cb (qcb, cb_arg);
+        for (GList *node = qcb->list; node; node = node->next)
+            g_hash_table_insert (entry->matches, node->data,
+                                 guid_copy (qof_instance_get_guid (node->data)));
+        if (entry->path_types)
+            for (GList *node = q->books; node; node = node->next)
+                qof_collection_foreach (qof_book_get_collection (static_cast<QofBook*>(node->data),
+                                                                 q->search_for),
+                                        query_cache_add_dependent_cb, entry);
+        entry->dropped_events = qof_event_get_dropped_count ();
+        entry->stale = FALSE;
+        return;
+    }
+
+    /* Objects the backends load now arrive as change events. */
+    query_run_backends (q);
+
+    PINFO ("patching %u cached matches with %u changed objects",
+           g_hash_table_size (entry->matches),
+           g_hash_table_size (entry->changed));
+
+    g_hash_table_foreach_remove (entry->matches, query_cache_object_gone, q);
+
+    g_hash_table_iter_init (&iter, entry->changed);
+    while (g_hash_table_iter_next (&iter, &object, &guid))
+    {
+        if (query_cache_object_gone (object, guid, q))
+            continue;
+        query_cache_add_dependent (entry, object);
+        if (check_object (q, object))
+            g_hash_table_insert (entry->matches, object,
+                                 guid_copy (static_cast<GncGUID*>(guid)));
+        else
+            g_hash_table_remove (entry->matches, object);
+    }
+    g_hash_table_remove_all (entry->changed);
+
+    g_hash_table_iter_init (&iter, entry->matches);
+    while (g_hash_table_iter_next (&iter, &object, NULL))
+    {
+        qcb->list = g_list_prepend (qcb->list, object);
+        qcb->count++;
+    }
+}
+
 /********************************************************************/
 /* PUBLISHED API FUNCTIONS */
 
@@ -749,6 +1384,8 @@ static GList * qof_query_run_internal (QofQuery *q,
     if (qof_log_check (log_module, QOF_LOG_DEBUG))
         qof_query_print (q);
 
+    plan_text_index (q);
+
     /* Now run the query over all the objects and save the results */
     {
         QofQueryCB qcb;
@@ -762,6 +1399,7 @@ static GList * qof_query_run_internal (QofQuery *q,
         matching_objects = qcb.list;
         object_count = qcb.count;
     }
+    clear_text_index_plan (q);
     PINFO ("matching objects=%p count=%d", matching_objects, object_count);
 
     /* There is no absolute need to reverse this list, since it's being
@@ -821,33 +1459,26 @@ static void qof_query_run_cb(QofQueryCB* qcb, gpointer cb_arg)
     (void)cb_arg; /* unused */
     g_return_if_fail(qcb);
 
+    query_run_backends (qcb->query);
+
     for (node = qcb->query->books; node; node = node->next)
     {
         QofBook* book = static_cast<QofBook*>(node->data);
-#ifdef QOF_BACKEND_QUERY
-        QofBackend* be = book->backend;
 
-
-        if (be)
-        {
-            gpointer compiled_query = g_hash_table_lookup (qcb->query->be_compiled,
-                                      book);
-
-            if (compiled_query && be->run_query)
-            {
-                (be->run_query) (be, compiled_query);
-            }
-        }
-#endif
         /* And then iterate over all the objects */
-        qof_object_foreach (qcb->query->search_for, book,
-                            (QofInstanceForeachCB) check_item_cb, qcb);
+        if (qcb->query->n_workers > 1 || qcb->query->n_workers < 0)
+            check_items_parallel (qcb, book);
+        else
+            qof_object_foreach (qcb->query->search_for, book,
+                                (QofInstanceForeachCB) check_item_cb, qcb);
     }
 }
 
 GList * qof_query_run (QofQuery *q)
 {
     /* Just a wrapper */
+    if (q && q->cached)
+        return qof_query_run_internal(q, qof_query_run_cached_cb, NULL);
     return qof_query_run_internal(q, qof_query_run_cb, NULL);
 }
 
@@ -1050,6 +1681,8 @@ QofQuery * qof_query_invert (QofQuery *q)
     case 0:
         retval = qof_query_create();
         retval->max_results = q->max_results;
+        retval->n_workers = q->n_workers;
+        retval->cached = q->cached;
         break;
 
         /* This is the DeMorgan expansion for a single AND expression. */
@@ -1057,6 +1690,8 @@ QofQuery * qof_query_invert (QofQuery *q)
     case 1:
         retval = qof_query_create();
         retval->max_results = q->max_results;
+        retval->n_workers = q->n_workers;
+        retval->cached = q->cached;
         retval->books = g_list_copy (q->books);
         retval->search_for = q->search_for;
         retval->changed = 1;
@@ -1090,6 +1725,8 @@ QofQuery * qof_query_invert (QofQuery *q)
         retval = qof_query_merge(iright, ileft, QOF_QUERY_AND);
         retval->books          = g_list_copy (q->books);
         retval->max_results    = q->max_results;
+        retval->n_workers      = q->n_workers;
+        retval->cached         = q->cached;
         retval->search_for     = q->search_for;
         retval->changed        = 1;
 
@@ -1150,6 +1787,8 @@ qof_query_merge(QofQuery *q1, QofQuery *q2, QofQueryOp op)
             g_list_concat(copy_or_terms(q1->terms), copy_or_terms(q2->terms));
         retval->books           = merge_books (q1->books, q2->books);
         retval->max_results    = q1->max_results;
+        retval->n_workers      = q1->n_workers;
+        retval->cached         = q1->cached;
         retval->changed        = 1;
         break;
 
@@ -1157,6 +1796,8 @@ qof_query_merge(QofQuery *q1, QofQuery *q2, QofQueryOp op)
         retval = qof_query_create();
         retval->books          = merge_books (q1->books, q2->books);
         retval->max_results    = q1->max_results;
+        retval->n_workers      = q1->n_workers;
+        retval->cached         = q1->cached;
         retval->changed        = 1;
 
         /* g_list_append() can take forever, so let's build the list in
@@ -1274,6 +1915,18 @@ void qof_query_set_max_results (QofQuery *q, int n)
     q->max_results = n;
 }
 
+void qof_query_set_parallel (QofQuery *q, gint n_workers)
+{
+    if (!q) return;
+    q->n_workers = n_workers;
+}
+
+void qof_query_set_cached (QofQuery *q, gboolean cached)
+{
+    if (!q) return;
+    q->cached = cached;
+}
+
 void qof_query_add_guid_list_match (QofQuery *q, QofQueryParamList *param_list,
                                     GList *guid_list, QofGuidMatch options,
                                     QofQueryOp op)
@@ -1349,6 +2002,7 @@ void qof_query_init (void)
 
 void qof_query_shutdown (void)
 {
+    query_cache_shutdown ();
     qof_class_shutdown ();
     qof_query_core_shutdown ();
 }
@@ -1451,17 +2105,15 @@ qof_query_sort_equal (const QofQuerySort* qs1, const QofQuerySort* qs2)
     return (param_list_cmp (qs1->param_list, qs2->param_list) == 0);
 }
 
-gboolean qof_query_equal (const QofQuery *q1, const QofQuery *q2)
+static gboolean
+query_terms_equal (const GList *terms1, const GList *terms2)
 {
-    GList *or1, *or2;
-
-    if (q1 == q2) return TRUE;
-    if (!q1 || !q2) return FALSE;
+    const GList *or1, *or2;
 
-    if (g_list_length (q1->terms) != g_list_length (q2->terms)) return FALSE;
-    if (q1->max_results != q2->max_results) return FALSE;
+    if (g_list_length ((GList*)terms1) != g_list_length ((GList*)terms2))
+        return FALSE;
 
-    for (or1 = q1->terms, or2 = q2->terms; or1;
+    for (or1 = terms1, or2 = terms2; or1;
             or1 = or1->next, or2 = or2->next)
     {
         GList *and1, *and2;
@@ -1476,6 +2128,16 @@ gboolean qof_query_equal (const QofQuery *q1, const QofQuery *q2)
 				       static_cast<QofQueryTerm*>(and2->data)))
                 return FALSE;
     }
+    return TRUE;
+}
+
+gboolean qof_query_equal (const QofQuery *q1, const QofQuery *q2)
+{
+    if (q1 == q2) return TRUE;
+    if (!q1 || !q2) return FALSE;
+
+    if (q1->max_results != q2->max_results) return FALSE;
+    if (!query_terms_equal (q1->terms, q2->terms)) return FALSE;
 
     if (!qof_query_sort_equal (&(q1->primary_sort), &(q2->primary_sort)))
         return FALSE;
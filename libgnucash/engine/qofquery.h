@@ -360,6 +360,34 @@ void qof_query_set_sort_increasing (QofQuery *q, gboolean prim_inc,
  */
 void qof_query_set_max_results (QofQuery *q, int n);
 
+/**
+ * Evaluate the query terms on several threads.  The objects of each
+ * searched book are split into n_workers slices that are checked
+ * concurrently; the matches are merged back in collection order before
+ * sorting, so the results are the same as for a serial run.  A value
+ * of 0 or 1 (the default) runs serially, a negative value uses one
+ * worker per processor for large collections.
+ *
+ * The book must not be edited while the query runs, and every
+ * parameter getter used by the terms must be safe to call from
+ * another thread.  The split and transaction getters are.
+ */
+void qof_query_set_parallel (QofQuery *q, gint n_workers);
+
+/**
+ * Let the query share its matches with equal queries through the
+ * engine's result cache.  Two queries are equal for the cache if they
+ * search the same type in the same books with the same terms; the
+ * sort order and 'max-results' are applied on every run.  The cache
+ * listens to the engine events of the searched objects and only
+ * re-checks the objects that changed since the last run.
+ *
+ * Only use this if the parameter getters of the terms depend on
+ * nothing but the objects along their parameter path; the order of
+ * the results of an unsorted cached query is unspecified.
+ */
+void qof_query_set_cached (QofQuery *q, gboolean cached);
+
 /** Compare two queries for equality.
  * Query terms are compared each to each.
  * This is a simplistic
@@ -214,7 +214,21 @@ QofSessionImpl::load (QofPercentageFunc percentage_func) noexcept
     {
         be->set_percentage(percentage_func);
         be->load (m_book, LOAD_TYPE_INITIAL_LOAD);
-        push_error (be->get_error(), {});
+        auto be_err = be->get_error ();
+        /* What the backend loaded before giving up is thrown away with the
+         * book and the load done again into a new one, until the backend
+         * has nothing left to fall back on. */
+        while (be_err == ERR_FILEIO_RELOAD)
+        {
+            auto old_book = m_book;
+            m_book = qof_book_new ();
+            qof_book_set_backend (m_book, be);
+            qof_book_set_backend (old_book, nullptr);
+            qof_book_destroy (old_book);
+            be->load (m_book, LOAD_TYPE_INITIAL_LOAD);
+            be_err = be->get_error ();
+        }
+        push_error (be_err, {});
     }
 
     auto err = get_error ();
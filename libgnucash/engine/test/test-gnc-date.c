@@ -1467,6 +1467,105 @@ test_gnc_time64_to_iso8601_buff (FixtureA *f, gconstpointer pData)
     g_free (time_str);
 }
 
+/* The fixed-format paths of gnc_time64_to_iso8601_buff and
+ * gnc_iso8601_to_time64_gmt, checked at a different time of day on every day
+ * of the supported range and second by second at its ends. Every 31st day is
+ * also checked against GDateTime and against GncDateTime's parser, which the
+ * fractional seconds force.
+ */
+#define LAST_ISO_TIME (MAXTIME + 86399)
+typedef struct
+{
+    const char *zone;
+    time64 offset;
+} IsoZone;
+
+static const IsoZone iso_zones[] =
+{
+    {" +0000", 0}, {" -05", -5 * 3600}, {"+01:00", 3600},
+    {" +08:40", 8 * 3600 + 40 * 60}, {"  -1200", -12 * 3600},
+    {" +14:00", 14 * 3600}, {" -03:30", -(3 * 3600 + 30 * 60)},
+};
+
+static gboolean
+check_iso_round_trip (time64 t, gboolean check_general)
+{
+    gchar buff[ISO8601_SIZE], other[ISO8601_SIZE + 16];
+    gchar *end = gnc_time64_to_iso8601_buff (t, buff);
+    const IsoZone *zone;
+    time64 zoned;
+
+    if (end - buff != 19 || strlen (buff) != 19 ||
+        gnc_iso8601_to_time64_gmt (buff) != t)
+        return FALSE;
+
+    /* YYYYMMDDHHMMSS */
+    g_snprintf (other, sizeof (other), "%.4s%.2s%.2s%.2s%.2s%.2s", buff,
+                buff + 5, buff + 8, buff + 11, buff + 14, buff + 17);
+    if (gnc_iso8601_to_time64_gmt (other) != t)
+        return FALSE;
+
+    zone = &iso_zones[(guint64)(t - MINTIME) / 86400 % G_N_ELEMENTS (iso_zones)];
+    zoned = t - zone->offset;
+    g_snprintf (other, sizeof (other), "%s%s", buff, zone->zone);
+    if (zoned >= MINTIME && zoned <= LAST_ISO_TIME &&
+        gnc_iso8601_to_time64_gmt (other) != zoned)
+        return FALSE;
+
+    if (check_general)
+    {
+        GDateTime *gdt = g_date_time_new_from_unix_utc (t);
+        gchar *expected = g_date_time_format (gdt, "%Y-%m-%d %H:%M:%S");
+        gboolean same = g_strcmp0 (buff, expected) == 0;
+        g_free (expected);
+        g_date_time_unref (gdt);
+        if (!same)
+            return FALSE;
+
+        g_snprintf (other, sizeof (other), "%s.0%s", buff, zone->zone);
+        if (zoned >= MINTIME && zoned <= LAST_ISO_TIME &&
+            gnc_iso8601_to_time64_gmt (other) != zoned)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+test_gnc_iso8601_round_trip (void)
+{
+    time64 day, t;
+    time64 n_days = (LAST_ISO_TIME - MINTIME) / 86400 + 1;
+
+    for (day = 0; day < n_days; ++day)
+    {
+        t = MINTIME + day * 86400 + day * 7919 % 86400;
+        if (!check_iso_round_trip (t, day % 31 == 0))
+        {
+            g_test_message ("Round trip failed for %" G_GINT64_FORMAT, t);
+            g_assert_not_reached ();
+        }
+    }
+    for (t = MINTIME; t < MINTIME + 86400; ++t)
+        g_assert (check_iso_round_trip (t, t % 97 == 0));
+    for (t = LAST_ISO_TIME - 86399; t <= LAST_ISO_TIME; ++t)
+        g_assert (check_iso_round_trip (t, t % 97 == 0));
+}
+
+static void
+test_gnc_iso8601_fallback (void)
+{
+    /* Not the fixed layout, so parsed by GncDateTime. */
+    g_assert_cmpint (gnc_iso8601_to_time64_gmt ("1989-03-27 13:43:27.5"), ==,
+                     INT64_C(607009407));
+    g_assert_cmpint (gnc_iso8601_to_time64_gmt ("19890327134327.0"), ==,
+                     INT64_C(607009407));
+    g_assert_cmpint (gnc_iso8601_to_time64_gmt ("19890327134327 -05"), ==,
+                     INT64_C(607027407));
+    /* And the fixed layout itself. */
+    g_assert_cmpint (gnc_iso8601_to_time64_gmt ("2000-02-29 00:00:00"),
+                     ==, INT64_C(951782400));
+}
+
 /* gnc_dmy2time64_internal
 static time64
 gnc_dmy2time64_internal (int day, int month, int year, gboolean start_of_day)// Local: 2:0:0
@@ -1910,6 +2009,8 @@ test_suite_gnc_date (void)
     GNC_TEST_ADD_FUNC (suitename, "gnc_date_timestamp", test_gnc_date_timestamp);
     GNC_TEST_ADD (suitename, "gnc iso8601 to time64 gmt", FixtureA, NULL, setup, test_gnc_iso8601_to_time64_gmt, NULL);
     GNC_TEST_ADD (suitename, "gnc time64 to iso8601 buff", FixtureA, NULL, setup, test_gnc_time64_to_iso8601_buff, NULL);
+    GNC_TEST_ADD_FUNC (suitename, "gnc iso8601 round trip", test_gnc_iso8601_round_trip);
+    GNC_TEST_ADD_FUNC (suitename, "gnc iso8601 fallback", test_gnc_iso8601_fallback);
 // GNC_TEST_ADD_FUNC (suitename, "gnc dmy2time64 internal", test_gnc_dmy2time64_internal);
 
     GNC_TEST_ADD (suitename, "gnc dmy2time64", FixtureB, NULL, setup_begin, test_gnc_dmy2time64, NULL);
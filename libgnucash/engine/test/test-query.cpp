@@ -24,8 +24,10 @@ extern "C"
 {
 #include <config.h>
 #include <glib.h>
+#include <string.h>
 #include "qof.h"
 #include "cashobjects.h"
+#include "Account.h"
 #include "Transaction.h"
 #include "TransLog.h"
 #include "gnc-engine.h"
@@ -67,6 +69,334 @@ test_trans_query (Transaction *trans, gpointer data)
     return 0;
 }
 
+static gboolean
+same_results (GList *l1, GList *l2)
+{
+    for (; l1 && l2; l1 = l1->next, l2 = l2->next)
+        if (l1->data != l2->data)
+            return FALSE;
+    return !l1 && !l2;
+}
+
+static void
+test_parallel_query (QofBook *book)
+{
+    QofQuery *q;
+    GList *serial, *parallel;
+
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+
+    serial = g_list_copy (qof_query_run (q));
+    qof_query_set_parallel (q, 4);
+    parallel = qof_query_run (q);
+
+    if (!same_results (serial, parallel))
+        failure ("parallel query results differ from serial ones");
+    else
+        success ("parallel query matches serial query");
+
+    g_list_free (serial);
+    qof_query_destroy (q);
+}
+
+/* Enough splits for the automatic worker count to pick several workers */
+#define N_PARALLEL_TRANSACTIONS 4200
+
+static void
+test_parallel_sorted_query (void)
+{
+    QofBook *book = qof_book_new ();
+    Account *root = gnc_account_create_root (book);
+    Account *acc1 = xaccMallocAccount (book);
+    Account *acc2 = xaccMallocAccount (book);
+    gnc_commodity *usd = gnc_commodity_new (book, "US Dollar", "CURRENCY",
+                                            "USD", "840", 100);
+    QofQuery *q;
+    GList *serial;
+    GSList *primary, *secondary;
+    int i;
+
+    xaccAccountBeginEdit (acc1);
+    xaccAccountSetCommodity (acc1, usd);
+    gnc_account_append_child (root, acc1);
+    xaccAccountCommitEdit (acc1);
+    xaccAccountBeginEdit (acc2);
+    xaccAccountSetCommodity (acc2, usd);
+    gnc_account_append_child (root, acc2);
+    xaccAccountCommitEdit (acc2);
+
+    for (i = 0; i < N_PARALLEL_TRANSACTIONS; i++)
+    {
+        Transaction *trans = xaccMallocTransaction (book);
+        Split *split1 = xaccMallocSplit (book);
+        Split *split2 = xaccMallocSplit (book);
+        gnc_numeric value = gnc_numeric_create ((i % 97) * 100, 100);
+        gchar *desc = g_strdup_printf ("txn %d", i);
+
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, usd);
+        xaccTransSetDatePostedSecsNormalized (trans, 1500000000 +
+                                              (i % 365) * 86400);
+        xaccTransSetDescription (trans, desc);
+        xaccSplitSetParent (split1, trans);
+        xaccSplitSetAccount (split1, acc1);
+        xaccSplitSetValue (split1, value);
+        xaccSplitSetAmount (split1, value);
+        xaccSplitSetParent (split2, trans);
+        xaccSplitSetAccount (split2, acc2);
+        xaccSplitSetValue (split2, gnc_numeric_neg (value));
+        xaccSplitSetAmount (split2, gnc_numeric_neg (value));
+        if (i % 50 == 0)
+            xaccTransSetIsClosingTxn (trans, TRUE);
+        xaccTransCommitEdit (trans);
+        g_free (desc);
+    }
+
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddValueMatch (q, gnc_numeric_create (2000, 100),
+                            QOF_NUMERIC_MATCH_ANY, QOF_COMPARE_GT,
+                            QOF_QUERY_AND);
+    xaccQueryAddDescriptionMatch (q, "[0-9]*[37]$", TRUE, TRUE,
+                                  QOF_COMPARE_CONTAINS, QOF_QUERY_AND);
+    xaccQueryAddClosingTransMatch (q, FALSE, QOF_QUERY_AND);
+    primary = g_slist_prepend (g_slist_prepend (NULL,
+                                                (gpointer)TRANS_DATE_POSTED),
+                               (gpointer)SPLIT_TRANS);
+    secondary = g_slist_prepend (NULL, (gpointer)SPLIT_VALUE);
+    qof_query_set_sort_order (q, primary, secondary, NULL);
+    qof_query_set_max_results (q, 500);
+
+    serial = g_list_copy (qof_query_run (q));
+    if (g_list_length (serial) != 500)
+        failure ("sorted query found too few splits");
+
+    qof_query_set_parallel (q, 4);
+    if (!same_results (serial, qof_query_run (q)))
+        failure ("parallel sorted query results differ from serial ones");
+    else
+        success ("parallel sorted query matches serial query");
+
+    qof_query_set_parallel (q, -1);
+    if (!same_results (serial, qof_query_run (q)))
+        failure ("automatic parallel query results differ from serial ones");
+    else
+        success ("automatic parallel query matches serial query");
+
+    g_list_free (serial);
+    qof_query_destroy (q);
+    qof_book_destroy (book);
+}
+
+static void
+test_text_index_query (QofBook *book)
+{
+    QofQuery *all, *q;
+    GList *node, *plain, *indexed;
+    const char *desc = NULL;
+    gchar *needle;
+
+    all = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (all, book);
+    for (node = qof_query_run (all); node; node = node->next)
+    {
+        desc = xaccTransGetDescription (xaccSplitGetParent (static_cast<Split*>(node->data)));
+        if (desc && strlen (desc) >= 6)
+            break;
+        desc = NULL;
+    }
+    if (!desc)
+    {
+        qof_query_destroy (all);
+        return;
+    }
+
+    needle = g_strndup (desc + 1, 4);
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddDescriptionMatch (q, needle, TRUE, FALSE,
+                                  QOF_COMPARE_CONTAINS, QOF_QUERY_AND);
+
+    plain = g_list_copy (qof_query_run (q));
+    xaccQueryEnableTextIndex (book);
+    indexed = qof_query_run (q);
+
+    if (!same_results (plain, indexed))
+        failure ("indexed query results differ from plain ones");
+    else if (!g_list_find (indexed, node->data))
+        failure ("indexed query missed the split it was built from");
+    else
+        success ("indexed query matches plain query");
+
+    g_list_free (plain);
+    g_free (needle);
+    qof_query_destroy (q);
+    qof_query_destroy (all);
+}
+
+static void
+test_cached_query (QofBook *book)
+{
+    QofQuery *cached, *plain, *any;
+    Split *split;
+    const char *needle = "cached-query-needle";
+
+    cached = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (cached, book);
+    xaccQueryAddMemoMatch (cached, needle, TRUE, FALSE,
+                           QOF_COMPARE_CONTAINS, QOF_QUERY_AND);
+    plain = qof_query_copy (cached);
+    qof_query_set_cached (cached, TRUE);
+
+    /* Fill the cache, then change a split behind its back */
+    qof_query_run (cached);
+
+    any = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (any, book);
+    split = static_cast<Split*>(g_list_nth_data (qof_query_run (any), 0));
+    qof_query_destroy (any);
+    if (!split)
+    {
+        qof_query_destroy (cached);
+        qof_query_destroy (plain);
+        return;
+    }
+
+    xaccTransBeginEdit (xaccSplitGetParent (split));
+    xaccSplitSetMemo (split, needle);
+    xaccTransCommitEdit (xaccSplitGetParent (split));
+
+    if (!same_results (qof_query_run (cached), qof_query_run (plain)))
+        failure ("cached query results differ from plain ones");
+    else if (!g_list_find (qof_query_last_run (cached), split))
+        failure ("cached query missed a changed split");
+    else
+        success ("cached query follows changes");
+
+    qof_query_destroy (cached);
+    qof_query_destroy (plain);
+}
+
+static Split *
+first_split (QofBook *book)
+{
+    QofQuery *any = qof_query_create_for (GNC_ID_SPLIT);
+    Split *split;
+
+    qof_query_set_book (any, book);
+    split = static_cast<Split*>(g_list_nth_data (qof_query_run (any), 0));
+    qof_query_destroy (any);
+    return split;
+}
+
+static void
+test_cached_query_suspended (QofBook *book)
+{
+    QofQuery *cached, *plain;
+    Split *split = first_split (book);
+    const char *needle = "suspended-query-needle";
+
+    if (!split)
+        return;
+
+    cached = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (cached, book);
+    xaccQueryAddMemoMatch (cached, needle, TRUE, FALSE,
+                           QOF_COMPARE_CONTAINS, QOF_QUERY_AND);
+    plain = qof_query_copy (cached);
+    qof_query_set_cached (cached, TRUE);
+    qof_query_run (cached);
+
+    /* No events tell the cache about this change */
+    qof_event_suspend ();
+    xaccTransBeginEdit (xaccSplitGetParent (split));
+    xaccSplitSetMemo (split, needle);
+    xaccTransCommitEdit (xaccSplitGetParent (split));
+    qof_event_resume ();
+
+    if (!same_results (qof_query_run (cached), qof_query_run (plain)))
+        failure ("cached query results differ from plain ones");
+    else if (!g_list_find (qof_query_last_run (cached), split))
+        failure ("cached query missed a change made with events suspended");
+    else
+        success ("cached query follows changes made with events suspended");
+
+    qof_query_destroy (cached);
+    qof_query_destroy (plain);
+}
+
+static void
+test_text_index_suspended (QofBook *book)
+{
+    QofQuery *q;
+    Split *split = first_split (book);
+    const char *needle = "suspended-index-needle";
+
+    if (!split)
+        return;
+
+    xaccQueryEnableTextIndex (book);
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddMemoMatch (q, needle, TRUE, FALSE,
+                           QOF_COMPARE_CONTAINS, QOF_QUERY_AND);
+
+    /* No events tell the index about this change */
+    qof_event_suspend ();
+    xaccTransBeginEdit (xaccSplitGetParent (split));
+    xaccSplitSetMemo (split, needle);
+    xaccTransCommitEdit (xaccSplitGetParent (split));
+    qof_event_resume ();
+
+    if (!g_list_find (qof_query_run (q), split))
+        failure ("indexed query missed a change made with events suspended");
+    else
+        success ("indexed query follows changes made with events suspended");
+
+    qof_query_destroy (q);
+}
+
+static void
+test_cached_account_query (QofBook *book)
+{
+    QofQuery *cached, *plain;
+    Split *split = first_split (book);
+    Account *account = split ? xaccSplitGetAccount (split) : NULL;
+    const char *needle = "cached-account-needle";
+
+    if (!account)
+        return;
+
+    cached = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (cached, book);
+    qof_query_add_term (cached,
+                        qof_query_build_param_list (SPLIT_ACCOUNT,
+                                                    ACCOUNT_NAME_, NULL),
+                        qof_query_string_predicate (QOF_COMPARE_EQUAL, needle,
+                                                    QOF_STRING_MATCH_NORMAL,
+                                                    FALSE),
+                        QOF_QUERY_AND);
+    plain = qof_query_copy (cached);
+    qof_query_set_cached (cached, TRUE);
+    qof_query_run (cached);
+
+    /* Renaming the account changes the matches of its splits only */
+    xaccAccountBeginEdit (account);
+    xaccAccountSetName (account, needle);
+    xaccAccountCommitEdit (account);
+
+    if (!same_results (qof_query_run (cached), qof_query_run (plain)))
+        failure ("cached account query results differ from plain ones");
+    else if (!g_list_find (qof_query_last_run (cached), split))
+        failure ("cached account query missed a renamed account");
+    else
+        success ("cached account query follows account changes");
+
+    qof_query_destroy (cached);
+    qof_query_destroy (plain);
+}
+
 static void
 run_test (void)
 {
@@ -81,6 +411,12 @@ run_test (void)
     add_random_transactions_to_book (book, 20);
 
     xaccAccountTreeForEachTransaction (root, test_trans_query, book);
+    test_parallel_query (book);
+    test_text_index_query (book);
+    test_cached_query (book);
+    test_cached_query_suspended (book);
+    test_text_index_suspended (book);
+    test_cached_account_query (book);
 
     qof_session_end (session);
 }
@@ -108,6 +444,7 @@ main (int argc, char **argv)
     {
         run_test ();
     }
+    test_parallel_sorted_query ();
     success("queries seem to work");
 
 cleanup:
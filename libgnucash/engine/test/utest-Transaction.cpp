@@ -34,6 +34,7 @@ extern "C"
 #include "../Account.h"
 #include "../gnc-lot.h"
 #include "../gnc-event.h"
+#include "../Scrub.h"
 #include <qof.h>
 
 #if defined(__clang__) && (__clang_major__ == 5 || (__clang_major__ == 3 && __clang_minor__ < 5))
@@ -1980,6 +1981,142 @@ test_xaccTransScrubGainsDate_gains_dirty (GainsFixture *fixture,
                      ==, 0);
 }
 
+/* xaccBookScrubImbalance
+ * The parallel check pass must pick exactly the transactions that the
+ * serial scrubbers would change.
+ */
+#define SCRUB_TEST_TRANSACTIONS 3000
+
+static gchar *
+scrub_test_describe (Transaction *trans)
+{
+    GString *desc = g_string_new (NULL);
+
+    g_string_append_printf (desc, "%p:", xaccTransGetCurrency (trans));
+    for (auto node = xaccTransGetSplitList (trans); node; node = node->next)
+    {
+        auto split = static_cast<Split*>(node->data);
+        auto value = gnc_numeric_to_string (xaccSplitGetValue (split));
+        auto amount = gnc_numeric_to_string (xaccSplitGetAmount (split));
+        g_string_append_printf (desc, " %p %s %s;", xaccSplitGetAccount (split),
+                                value, amount);
+        g_free (value);
+        g_free (amount);
+    }
+    return g_string_free (desc, FALSE);
+}
+
+static Account *
+scrub_test_account (Account *root, gnc_commodity *comm, const char *name)
+{
+    auto acc = xaccMallocAccount (gnc_account_get_book (root));
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetName (acc, name);
+    xaccAccountSetCommodity (acc, comm);
+    gnc_account_append_child (root, acc);
+    xaccAccountCommitEdit (acc);
+    return acc;
+}
+
+static void
+scrub_test_add_split (Transaction *trans, Account *acc, gint64 value,
+                      gint64 amount)
+{
+    auto split = xaccMallocSplit (xaccTransGetBook (trans));
+    xaccSplitSetParent (split, trans);
+    if (acc)
+        xaccSplitSetAccount (split, acc);
+    xaccSplitSetValue (split, gnc_numeric_create (value, 100));
+    xaccSplitSetAmount (split, gnc_numeric_create (amount, 100));
+}
+
+static void
+test_xaccBookScrubImbalance (void)
+{
+    auto book = qof_book_new ();
+    auto curr = gnc_commodity_new (book, "Gnu Rand", "CURRENCY", "GNR", "", 100);
+    auto comm = gnc_commodity_new (book, "Wildebeest Fund", "FUND", "WBFXX", "", 100);
+    auto root = gnc_account_create_root (book);
+    auto cash = scrub_test_account (root, curr, "Cash");
+    auto expense = scrub_test_account (root, curr, "Expense");
+    auto fund = scrub_test_account (root, comm, "Fund");
+    Transaction *trans[SCRUB_TEST_TRANSACTIONS];
+    gchar *before[SCRUB_TEST_TRANSACTIONS];
+    gboolean dirty[SCRUB_TEST_TRANSACTIONS];
+
+    /* Keep the commits from repairing the broken transactions. */
+    xaccDisableDataScrubbing ();
+    for (int i = 0; i < SCRUB_TEST_TRANSACTIONS; i++)
+    {
+        gint64 value = 100 + i;
+
+        trans[i] = xaccMallocTransaction (book);
+        xaccTransBeginEdit (trans[i]);
+        xaccTransSetCurrency (trans[i], curr);
+        xaccTransSetDatePostedSecsNormalized (trans[i], 1500000000 + i * 3600);
+        switch (i % 10)
+        {
+        case 1:     /* Imbalanced */
+            scrub_test_add_split (trans[i], cash, value, value);
+            scrub_test_add_split (trans[i], expense, 1 - value, 1 - value);
+            break;
+        case 3:     /* Amount differs from value in the currency */
+            scrub_test_add_split (trans[i], cash, value, value + 1);
+            scrub_test_add_split (trans[i], expense, -value, -value);
+            break;
+        case 5:     /* Split without an account */
+            scrub_test_add_split (trans[i], cash, value, value);
+            scrub_test_add_split (trans[i], nullptr, -value, -value);
+            break;
+        case 7:     /* Balanced purchase of another commodity */
+            scrub_test_add_split (trans[i], fund, value, 7);
+            scrub_test_add_split (trans[i], cash, -value, -value);
+            break;
+        default:
+            scrub_test_add_split (trans[i], cash, value, value);
+            scrub_test_add_split (trans[i], expense, -value, -value);
+            break;
+        }
+        xaccTransCommitEdit (trans[i]);
+        dirty[i] = i % 10 == 1 || i % 10 == 3 || i % 10 == 5;
+    }
+    xaccEnableDataScrubbing ();
+
+    for (int i = 0; i < SCRUB_TEST_TRANSACTIONS; i++)
+        before[i] = scrub_test_describe (trans[i]);
+
+    xaccBookScrubImbalance (book, NULL);
+
+    for (int i = 0; i < SCRUB_TEST_TRANSACTIONS; i++)
+    {
+        auto after = scrub_test_describe (trans[i]);
+        if (dirty[i])
+        {
+            g_assert_cmpstr (after, !=, before[i]);
+            g_assert (xaccTransIsBalanced (trans[i]));
+        }
+        else
+            g_assert_cmpstr (after, ==, before[i]);
+        g_free (before[i]);
+        before[i] = after;
+    }
+
+    /* Scrubbing each transaction again must not find anything the check
+     * pass missed. */
+    for (int i = 0; i < SCRUB_TEST_TRANSACTIONS; i++)
+    {
+        xaccTransScrubOrphans (trans[i]);
+        xaccTransScrubCurrency (trans[i]);
+        xaccTransScrubImbalance (trans[i], root, NULL);
+        auto after = scrub_test_describe (trans[i]);
+        g_assert_cmpstr (after, ==, before[i]);
+        g_free (after);
+        g_free (before[i]);
+    }
+
+    qof_book_destroy (book);
+}
+
 /* xaccTransScrubGains Local: 1:0:0
  * Non-trivial, but it passes through selected splits to functions in
  * cap-gains.c and Scrub3.c that are beyond the scope of this test
@@ -2043,5 +2180,6 @@ test_suite_transaction (void)
     GNC_TEST_ADD (suitename, "xaccTransScrubGainsDate_no_dirty", GainsFixture, NULL, setup_with_gains, test_xaccTransScrubGainsDate_no_dirty, teardown_with_gains);
     GNC_TEST_ADD (suitename, "xaccTransScrubGainsDate_base_dirty", GainsFixture, NULL, setup_with_gains, test_xaccTransScrubGainsDate_base_dirty, teardown_with_gains);
     GNC_TEST_ADD (suitename, "xaccTransScrubGainsDate_gains_dirty", GainsFixture, NULL, setup_with_gains, test_xaccTransScrubGainsDate_gains_dirty, teardown_with_gains);
+    GNC_TEST_ADD_FUNC (suitename, "xaccBookScrubImbalance", test_xaccBookScrubImbalance);
 
 }
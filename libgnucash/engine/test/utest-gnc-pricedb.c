@@ -23,11 +23,13 @@
  ********************************************************************/
 #include <config.h>
 #include <string.h>
+#include <math.h>
 #include <glib.h>
 #include <unittest-support.h>
 /* Add specific headers for this class */
 #include <gnc-pricedb.h>
 #include <gnc-pricedb-p.h>
+#include <gnc-event.h>
 
 static const gchar *suitename = "/engine/gnc-pricedb";
 void test_suite_gnc_pricedb ( void );
@@ -737,6 +739,58 @@ gnc_pricedb_add_price(GNCPriceDB *db, GNCPrice *p)// C: 7 in 7 SCM: 1  Local: 0:
 test_gnc_pricedb_add_price (Fixture *fixture, gconstpointer pData)
 {
 }*/
+/* gnc_pricedb_add_prices
+guint
+gnc_pricedb_add_prices(GNCPriceDB *db, PriceList *prices)// C: 3 in 3 SCM: 1  Local: 0:0:0
+*/
+static void
+test_gnc_pricedb_add_prices (PriceDBFixture *fixture, gconstpointer pData)
+{
+    GNCPriceDB *db = fixture->pricedb;
+    QofBook *book = qof_instance_get_book(QOF_INSTANCE(db));
+    Commodities *c = fixture->com;
+    time64 t_old = gnc_dmy2time64(2, 1, 2001);
+    time64 t_new = gnc_dmy2time64(17, 11, 2012);
+    GNCPrice *worse, *best, *replaced, *replacement, *price;
+    PriceList *prices = NULL;
+
+    /* A better source on the same day keeps an earlier one of the batch;
+     * otherwise the later price wins, also over the one in the db. */
+    best = construct_price(book, c->gbp, c->usd, t_old, PRICE_SOURCE_EDIT_DLG,
+                           gnc_numeric_create(16, 10));
+    worse = construct_price(book, c->gbp, c->usd, t_old + 3600,
+                            PRICE_SOURCE_FQ, gnc_numeric_create(161, 100));
+    replaced = construct_price(book, c->usd, c->gbp, t_new,
+                               PRICE_SOURCE_USER_PRICE,
+                               gnc_numeric_create(63, 100));
+    replacement = construct_price(book, c->gbp, c->usd, t_new + 20247,
+                                  PRICE_SOURCE_EDIT_DLG,
+                                  gnc_numeric_create(159, 100));
+    prices = g_list_append(prices, best);
+    prices = g_list_append(prices, worse);
+    prices = g_list_append(prices, replaced);
+    prices = g_list_append(prices, replacement);
+
+    g_assert_cmpint(gnc_pricedb_add_prices(db, prices), ==, 2);
+    g_assert_cmpint(gnc_pricedb_get_num_prices(db), ==, 43);
+    price = gnc_pricedb_lookup_day_t64(db, c->usd, c->gbp, t_old);
+    g_assert(price == best);
+    gnc_price_unref(price);
+    price = gnc_pricedb_lookup_day_t64(db, c->usd, c->gbp, t_new);
+    g_assert(price == replacement);
+    gnc_price_unref(price);
+    gnc_price_list_destroy(prices);
+
+    /* Bulk updates don't replace anything. */
+    prices = g_list_append(NULL, construct_price(book, c->gbp, c->usd, t_new,
+                                                 PRICE_SOURCE_FQ,
+                                                 gnc_numeric_create(158, 100)));
+    gnc_pricedb_set_bulk_update(db, TRUE);
+    g_assert_cmpint(gnc_pricedb_add_prices(db, prices), ==, 1);
+    gnc_pricedb_set_bulk_update(db, FALSE);
+    g_assert_cmpint(gnc_pricedb_get_num_prices(db), ==, 44);
+    gnc_price_list_destroy(prices);
+}
 /* remove_price
 static gboolean
 remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)// Local: 4:0:0
@@ -785,6 +839,7 @@ static void test_gnc_pricedb_remove_old_prices (PriceDBFixture *fixture, gconstp
 {
     GList *comm_list = NULL;
     Commodities *c = fixture->com;
+    TestSignal sig;
     PriceRemoveSourceFlags source_all = PRICE_REMOVE_SOURCE_FQ |
                                         PRICE_REMOVE_SOURCE_USER |
                                         PRICE_REMOVE_SOURCE_APP;
@@ -804,12 +859,16 @@ static void test_gnc_pricedb_remove_old_prices (PriceDBFixture *fixture, gconstp
 
     g_assert_cmpint (gnc_pricedb_get_num_prices(fixture->pricedb), ==, 42);
 
+    sig = test_signal_new (&fixture->pricedb->inst, GNC_EVENT_ITEM_REMOVED, NULL);
     g_assert (gnc_pricedb_remove_old_prices(fixture->pricedb, comm_list,
                                            fiscal_end_date, t_cut1,
                                            PRICE_REMOVE_SOURCE_USER, // source is USER
                                            PRICE_REMOVE_KEEP_NONE)); // keep none
 
     g_assert_cmpint (gnc_pricedb_get_num_prices(fixture->pricedb), ==, 39);
+    // one summary event for the whole pruning pass
+    test_signal_assert_hits (sig, 1);
+    test_signal_free (sig);
 
     // there should be no prices before cutoff, returns false
     g_assert (!gnc_pricedb_remove_old_prices(fixture->pricedb, comm_list,
@@ -1064,6 +1123,39 @@ test_gnc_pricedb_get_prices (PriceDBFixture *fixture, gconstpointer pData)
     g_assert_cmpint(g_list_length(prices), ==, 5);
     gnc_price_list_destroy(prices);
 }
+/* gnc_pricedb_nth_price
+GNCPrice *
+gnc_pricedb_nth_price (GNCPriceDB *db,// C: 5 in 1  Local: 0:0:0
+*/
+static void
+test_gnc_pricedb_nth_price (PriceDBFixture *fixture, gconstpointer pData)
+{
+    GNCPriceDB *db = fixture->pricedb;
+    gnc_commodity *gbp = fixture->com->gbp;
+    PriceList *prices = gnc_pricedb_get_prices(db, gbp, NULL), *node;
+    GNCPrice *removed, *next;
+    int n = 0;
+
+    g_assert_cmpint(gnc_pricedb_num_prices(db, gbp), ==, 23);
+    for (node = prices; node; node = g_list_next(node), n++)
+    {
+        g_assert(gnc_pricedb_nth_price(db, gbp, n) == node->data);
+        g_assert_cmpint(gnc_pricedb_price_index(db, node->data), ==, n);
+    }
+    g_assert_cmpint(n, ==, 23);
+    g_assert(gnc_pricedb_nth_price(db, gbp, n) == NULL);
+    gnc_price_list_destroy(prices);
+
+    removed = gnc_pricedb_nth_price(db, gbp, 5);
+    next = gnc_pricedb_nth_price(db, gbp, 6);
+    gnc_price_ref(removed);
+    gnc_pricedb_remove_price(db, removed);
+    g_assert_cmpint(gnc_pricedb_price_index(db, removed), ==, -1);
+    g_assert(gnc_pricedb_nth_price(db, gbp, 5) == next);
+    g_assert_cmpint(gnc_pricedb_price_index(db, next), ==, 5);
+    g_assert_cmpint(gnc_pricedb_num_prices(db, gbp), ==, 22);
+    gnc_price_unref(removed);
+}
 /* gnc_pricedb_lookup_day_t64
 GNCPrice *
 gnc_pricedb_lookup_day_t64(GNCPriceDB *db,// C: 4 in 2 SCM: 2 in 1 Local: 1:0:0
@@ -1129,11 +1221,177 @@ test_gnc_pricedb_lookup_nearest_in_time64 (PriceDBFixture *fixture, gconstpointe
     g_assert_cmpstr(GET_CUR_NAME(price), ==, "AUD");
     g_assert_cmpstr(GET_COM_NAME(price), ==, "USD");
 }
-// Not Used
 /* gnc_pricedb_lookup_latest_before_t64
 GNCPrice *
 gnc_pricedb_lookup_latest_before_t64 (GNCPriceDB *db,// Local: 0:0:0
 */
+static void
+test_gnc_pricedb_lookup_latest_before_t64 (PriceDBFixture *fixture, gconstpointer pData)
+{
+    time64 t1 = gnc_dmy2time64(1, 1, 2012);
+    time64 t2 = gnc_dmy2time64(1, 8, 2013);
+    time64 t3 = gnc_dmy2time64(1, 1, 2009);
+    GNCPrice *price =
+        gnc_pricedb_lookup_latest_before_t64(fixture->pricedb,
+                                             fixture->com->usd,
+                                             fixture->com->aud, t1);
+    g_assert_cmpstr(GET_COM_NAME(price), ==, "AUD");
+    g_assert_cmpint(gnc_price_get_time64(price), ==,
+                    gnc_dmy2time64(20, 7, 2011));
+    gnc_price_unref(price);
+    price = gnc_pricedb_lookup_latest_before_t64(fixture->pricedb,
+                                                 fixture->com->usd,
+                                                 fixture->com->aud, t2);
+    g_assert_cmpstr(GET_COM_NAME(price), ==, "USD");
+    g_assert_cmpint(gnc_price_get_time64(price), ==, t2);
+    gnc_price_unref(price);
+    price = gnc_pricedb_lookup_latest_before_t64(fixture->pricedb,
+                                                 fixture->com->usd,
+                                                 fixture->com->aud, t3);
+    g_assert(price == NULL);
+}
+/* gnc_pricedb_lookup_latest_before_matrix
+GNCPriceMatrix *
+gnc_pricedb_lookup_latest_before_matrix (GNCPriceDB *db,// Local: 0:0:0
+*/
+static void
+test_gnc_pricedb_lookup_latest_before_matrix (PriceDBFixture *fixture, gconstpointer pData)
+{
+    Commodities *c = fixture->com;
+    time64 dates[] = {gnc_dmy2time64(1, 1, 2012), gnc_dmy2time64(1, 1, 2009),
+                      gnc_dmy2time64(1, 8, 2013), gnc_dmy2time64(1, 1, 2012),
+                      gnc_dmy2time64(15, 6, 2010)};
+    guint n_dates = G_N_ELEMENTS (dates), row, col;
+    GList *comms = NULL, *node;
+    GNCPriceMatrix *matrix;
+
+    comms = g_list_append (comms, c->usd);
+    comms = g_list_append (comms, c->gbp);
+    comms = g_list_append (comms, c->aud);
+    comms = g_list_append (comms, c->amzn);
+    comms = g_list_append (comms, c->bgn);
+    matrix = gnc_pricedb_lookup_latest_before_matrix (fixture->pricedb, comms,
+                                                      c->aud, dates, n_dates);
+    g_assert_cmpuint (matrix->n_commodities, ==, 5);
+    g_assert_cmpuint (matrix->n_dates, ==, n_dates);
+
+    for (node = comms, row = 0; node; node = node->next, row++)
+        for (col = 0; col < n_dates; col++)
+        {
+            gnc_numeric value = gnc_price_matrix_get_value (matrix, row, col);
+            GNCPrice *price =
+                gnc_pricedb_lookup_latest_before_t64 (fixture->pricedb,
+                                                      node->data, c->aud,
+                                                      dates[col]);
+            gnc_numeric expected = gnc_numeric_zero ();
+
+            if (node->data == c->aud)
+                expected = gnc_numeric_create (1, 1);
+            else if (price)
+                expected = gnc_price_get_commodity (price) == node->data ?
+                    gnc_price_get_value (price) :
+                    gnc_numeric_invert (gnc_price_get_value (price));
+            g_assert (gnc_numeric_equal (value, expected));
+            gnc_price_unref (price);
+        }
+
+    /* The 2011 AUD price of USD is quoted the other way round. */
+    g_assert (!gnc_numeric_zero_p (gnc_price_matrix_get_value (matrix, 0, 0)));
+    g_assert (gnc_numeric_zero_p (gnc_price_matrix_get_value (matrix, 0, 1)));
+    g_assert (gnc_numeric_zero_p (gnc_price_matrix_get_value (matrix, 5, 0)));
+    gnc_price_matrix_free (matrix);
+    g_list_free (comms);
+}
+/* gnc_pricedb_get_price_samples
+GNCPriceSamples *
+gnc_pricedb_get_price_samples (GNCPriceDB *db,// Local: 0:0:0
+*/
+static void
+test_gnc_pricedb_get_price_samples (PriceDBFixture *fixture, gconstpointer pData)
+{
+    Commodities *c = fixture->com;
+    GNCPriceSamples *samples;
+    guint n;
+
+    samples = gnc_pricedb_get_price_samples (fixture->pricedb, c->usd, c->aud,
+                                             gnc_dmy2time64 (1, 1, 2009),
+                                             gnc_dmy2time64 (31, 12, 2014));
+    g_assert_cmpuint (samples->len, ==, 7);
+    g_assert (samples->min == NULL && samples->counts == NULL);
+    for (n = 1; n < samples->len; n++)
+        g_assert_cmpint (samples->times[n - 1], <=, samples->times[n]);
+    g_assert_cmpint (samples->times[0], ==, gnc_dmy2time64 (11, 4, 2009));
+    g_assert_cmpfloat (samples->values[0], ==, 13.119);
+    /* The 2011 price is AUD in USD and comes back inverted. */
+    g_assert_cmpint (samples->times[3], ==, gnc_dmy2time64 (20, 7, 2011));
+    g_assert_cmpfloat (fabs (samples->values[3] - 1 / 1.0648), <, 1e-9);
+    gnc_price_samples_free (samples);
+
+    samples = gnc_pricedb_get_price_samples (fixture->pricedb, c->usd, c->aud,
+                                             gnc_dmy2time64 (1, 1, 2010),
+                                             gnc_dmy2time64 (31, 12, 2012));
+    g_assert_cmpuint (samples->len, ==, 3);
+    gnc_price_samples_free (samples);
+
+    samples = gnc_pricedb_get_price_samples (fixture->pricedb, c->usd, c->aud,
+                                             gnc_dmy2time64 (1, 1, 2016),
+                                             gnc_dmy2time64 (31, 12, 2017));
+    g_assert_cmpuint (samples->len, ==, 0);
+    gnc_price_samples_free (samples);
+}
+/* gnc_pricedb_get_price_buckets
+GNCPriceSamples *
+gnc_pricedb_get_price_buckets (GNCPriceDB *db,// Local: 0:0:0
+*/
+static void
+test_gnc_pricedb_get_price_buckets (PriceDBFixture *fixture, gconstpointer pData)
+{
+    Commodities *c = fixture->com;
+    GNCPriceSamples *samples;
+    guint counts[] = {2, 1, 1, 1, 1, 1};
+    guint n;
+
+    samples = gnc_pricedb_get_price_buckets (fixture->pricedb, c->usd, c->aud,
+                                             gnc_dmy2time64 (1, 1, 2009),
+                                             gnc_dmy2time64 (31, 12, 2014),
+                                             PRICE_BUCKET_YEAR, 1);
+    g_assert_cmpuint (samples->len, ==, G_N_ELEMENTS (counts));
+    for (n = 0; n < samples->len; n++)
+    {
+        g_assert_cmpint (samples->times[n], ==, gnc_dmy2time64 (1, 1, 2009 + n));
+        g_assert_cmpuint (samples->counts[n], ==, counts[n]);
+        g_assert_cmpfloat (samples->min[n], <=, samples->avg[n]);
+        g_assert_cmpfloat (samples->avg[n], <=, samples->max[n]);
+    }
+    g_assert_cmpfloat (samples->min[0], ==, 13.119);
+    g_assert_cmpfloat (samples->max[0], ==, 13.119);
+    g_assert_cmpfloat (samples->values[1], ==, 11.1794);
+    gnc_price_samples_free (samples);
+
+    /* Buckets before the first price are left out. */
+    samples = gnc_pricedb_get_price_buckets (fixture->pricedb, c->usd, c->aud,
+                                             gnc_dmy2time64 (1, 1, 2008),
+                                             gnc_dmy2time64 (31, 12, 2009),
+                                             PRICE_BUCKET_YEAR, 1);
+    g_assert_cmpuint (samples->len, ==, 1);
+    g_assert_cmpint (samples->times[0], ==, gnc_dmy2time64 (1, 1, 2009));
+    gnc_price_samples_free (samples);
+
+    /* Empty buckets carry the last price forward. */
+    samples = gnc_pricedb_get_price_buckets (fixture->pricedb, c->usd, c->aud,
+                                             gnc_dmy2time64 (1, 6, 2009),
+                                             gnc_dmy2time64 (31, 12, 2009),
+                                             PRICE_BUCKET_MONTH, 1);
+    g_assert_cmpuint (samples->len, ==, 7);
+    for (n = 0; n < samples->len; n++)
+    {
+        g_assert_cmpint (samples->times[n], ==, gnc_dmy2time64 (1, 6 + n, 2009));
+        g_assert_cmpuint (samples->counts[n], ==, 0);
+        g_assert_cmpfloat (samples->values[n], ==, 13.119);
+        g_assert_cmpfloat (samples->avg[n], ==, 13.119);
+    }
+    gnc_price_samples_free (samples);
+}
 /* direct_balance_conversion
 static gnc_numeric
 direct_balance_conversion (GNCPriceDB *db, gnc_numeric bal,// Local: 2:0:0
@@ -1248,6 +1506,118 @@ test_gnc_pricedb_convert_balance_nearest_price_t64 (PriceDBFixture *fixture, gco
     g_assert_cmpint(result.denom, ==, 100);
 
 }
+
+/* EUR to AUD needs three prices: GBP/EUR, GBP/USD and AUD/USD. */
+static void
+test_gnc_pricedb_exchange_rate_nearest_t64 (PriceDBFixture *fixture, gconstpointer pData)
+{
+    time64 t = gnc_dmy2time64(15, 8, 2011);
+    gnc_numeric from = gnc_numeric_create(10000, 100);
+    gnc_numeric rate =
+        gnc_pricedb_exchange_rate_nearest_t64(fixture->pricedb,
+                                              fixture->com->eur,
+                                              fixture->com->aud, t);
+    gnc_numeric result;
+
+    g_assert_cmpfloat(fabs(gnc_numeric_to_double(rate) -
+                           1.61643 / 1.13289 / 1.06480), <, 1e-9);
+    result = gnc_pricedb_convert_balance_nearest_price_t64(fixture->pricedb,
+                                                           from,
+                                                           fixture->com->eur,
+                                                           fixture->com->aud,
+                                                           t);
+    g_assert_cmpint(result.num, ==, 13400);
+    g_assert_cmpint(result.denom, ==, 100);
+    rate = gnc_pricedb_exchange_rate_nearest_t64(fixture->pricedb,
+                                                 fixture->com->eur,
+                                                 fixture->com->bgn, t);
+    g_assert(gnc_numeric_zero_p(rate));
+
+    /* A search from another commodity reuses the graph's edges... */
+    rate = gnc_pricedb_exchange_rate_nearest_t64(fixture->pricedb,
+                                                 fixture->com->aud,
+                                                 fixture->com->eur, t);
+    g_assert_cmpfloat(fabs(gnc_numeric_to_double(rate) -
+                           1.13289 * 1.06480 / 1.61643), <, 1e-9);
+    /* ...until a new price joins BGN to it. */
+    gnc_pricedb_add_price(fixture->pricedb,
+                          construct_price(qof_instance_get_book(fixture->pricedb),
+                                          fixture->com->eur, fixture->com->bgn,
+                                          t, PRICE_SOURCE_USER_PRICE,
+                                          gnc_numeric_create(2, 1)));
+    rate = gnc_pricedb_exchange_rate_nearest_t64(fixture->pricedb,
+                                                 fixture->com->aud,
+                                                 fixture->com->bgn, t);
+    g_assert_cmpfloat(fabs(gnc_numeric_to_double(rate) -
+                           2 * 1.13289 * 1.06480 / 1.61643), <, 1e-9);
+}
+
+static void
+test_gnc_pricedb_conversion_cache (PriceDBFixture *fixture, gconstpointer pData)
+{
+    time64 t = gnc_dmy2time64(15, 8, 2011);
+    gnc_numeric from = gnc_numeric_create(10000, 100);
+    QofBook *book = qof_instance_get_book(fixture->pricedb);
+    guint hits, misses, entries;
+    gnc_numeric result;
+
+    gnc_pricedb_reset_conversion_cache_stats(fixture->pricedb);
+    result = gnc_pricedb_convert_balance_nearest_price_t64(fixture->pricedb,
+                                                           from,
+                                                           fixture->com->gbp,
+                                                           fixture->com->dkk,
+                                                           t);
+    g_assert_cmpint(result.num, ==, 84450);
+    result = gnc_pricedb_convert_balance_nearest_price_t64(fixture->pricedb,
+                                                           from,
+                                                           fixture->com->gbp,
+                                                           fixture->com->dkk,
+                                                           t);
+    g_assert_cmpint(result.num, ==, 84450);
+    gnc_pricedb_get_conversion_cache_stats(fixture->pricedb, &hits, &misses,
+                                           &entries);
+    g_assert_cmpuint(hits, ==, 1);
+    g_assert_cmpuint(misses, ==, 1);
+    g_assert_cmpuint(entries, ==, 1);
+
+    /* A new price nearer to t has to be used. */
+    gnc_pricedb_add_price(fixture->pricedb,
+                          construct_price(book, fixture->com->gbp,
+                                          fixture->com->usd, t,
+                                          PRICE_SOURCE_USER_PRICE,
+                                          gnc_numeric_create(2, 1)));
+    gnc_pricedb_get_conversion_cache_stats(fixture->pricedb, NULL, NULL,
+                                           &entries);
+    g_assert_cmpuint(entries, ==, 0);
+    result = gnc_pricedb_convert_balance_nearest_price_t64(fixture->pricedb,
+                                                           from,
+                                                           fixture->com->gbp,
+                                                           fixture->com->dkk,
+                                                           t);
+    g_assert_cmpint(result.num, !=, 84450);
+    gnc_pricedb_get_conversion_cache_stats(fixture->pricedb, &hits, &misses,
+                                           NULL);
+    g_assert_cmpuint(hits, ==, 1);
+    g_assert_cmpuint(misses, ==, 2);
+
+    /* The latest prices are those of
+     * gnc_pricedb_lookup_latest_any_currency(), which doesn't return a
+     * price dated in the future yet. */
+    result = gnc_pricedb_convert_balance_latest_price(fixture->pricedb, from,
+                                                      fixture->com->gbp,
+                                                      fixture->com->dkk);
+    g_assert_cmpint(result.num, ==, 94389);
+    gnc_pricedb_add_price(fixture->pricedb,
+                          construct_price(book, fixture->com->gbp,
+                                          fixture->com->usd,
+                                          gnc_time(NULL) + 365 * 86400,
+                                          PRICE_SOURCE_USER_PRICE,
+                                          gnc_numeric_create(3, 1)));
+    result = gnc_pricedb_convert_balance_latest_price(fixture->pricedb, from,
+                                                      fixture->com->gbp,
+                                                      fixture->com->dkk);
+    g_assert_cmpint(result.num, ==, 94389);
+}
 /* pricedb_foreach_pricelist
 static void
 pricedb_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)// Local: 0:1:0
@@ -1474,6 +1844,7 @@ test_suite_gnc_pricedb (void)
 // GNC_TEST_ADD (suitename, "insert or replace price", Fixture, NULL, setup, test_insert_or_replace_price, teardown);
 // GNC_TEST_ADD (suitename, "add price", Fixture, NULL, setup, test_add_price, teardown);
 // GNC_TEST_ADD (suitename, "gnc pricedb add price", Fixture, NULL, setup, test_gnc_pricedb_add_price, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb add prices", PriceDBFixture, NULL, setup, test_gnc_pricedb_add_prices, teardown);
 // GNC_TEST_ADD (suitename, "remove price", Fixture, NULL, setup, test_remove_price, teardown);
 // GNC_TEST_ADD (suitename, "gnc pricedb remove price", Fixture, NULL, setup, test_gnc_pricedb_remove_price, teardown);
 // GNC_TEST_ADD (suitename, "check one price date", Fixture, NULL, setup, test_check_one_price_date, teardown);
@@ -1495,15 +1866,22 @@ test_suite_gnc_pricedb (void)
 // GNC_TEST_ADD (suitename, "hash values helper", PriceDBFixture, NULL, setup, test_hash_values_helper, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb has prices", PriceDBFixture, NULL, setup, test_gnc_pricedb_has_prices, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb get prices", PriceDBFixture, NULL, setup, test_gnc_pricedb_get_prices, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb nth price", PriceDBFixture, NULL, setup, test_gnc_pricedb_nth_price, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb lookup day", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_day_t64, teardown);
 // GNC_TEST_ADD (suitename, "lookup nearest in time", Fixture, NULL, setup, test_lookup_nearest_in_time, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb lookup nearest in time", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_nearest_in_time64, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb lookup latest before", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_latest_before_t64, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb lookup latest before matrix", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_latest_before_matrix, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb get price samples", PriceDBFixture, NULL, setup, test_gnc_pricedb_get_price_samples, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb get price buckets", PriceDBFixture, NULL, setup, test_gnc_pricedb_get_price_buckets, teardown);
 // GNC_TEST_ADD (suitename, "direct balance conversion", Fixture, NULL, setup, test_direct_balance_conversion, teardown);
 // GNC_TEST_ADD (suitename, "extract common prices", Fixture, NULL, setup, test_extract_common_prices, teardown);
 // GNC_TEST_ADD (suitename, "convert balance", Fixture, NULL, setup, test_convert_balance, teardown);
 // GNC_TEST_ADD (suitename, "indirect balance conversion", Fixture, NULL, setup, test_indirect_balance_conversion, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb convert balance latest price", PriceDBFixture, NULL, setup, test_gnc_pricedb_convert_balance_latest_price, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb convert balance nearest price", PriceDBFixture, NULL, setup, test_gnc_pricedb_convert_balance_nearest_price_t64, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb exchange rate nearest", PriceDBFixture, NULL, setup, test_gnc_pricedb_exchange_rate_nearest_t64, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb conversion cache", PriceDBFixture, NULL, setup, test_gnc_pricedb_conversion_cache, teardown);
 // GNC_TEST_ADD (suitename, "pricedb foreach pricelist", Fixture, NULL, setup, test_pricedb_foreach_pricelist, teardown);
 // GNC_TEST_ADD (suitename, "pricedb foreach currencies hash", Fixture, NULL, setup, test_pricedb_foreach_currencies_hash, teardown);
 // GNC_TEST_ADD (suitename, "unstable price traversal", Fixture, NULL, setup, test_unstable_price_traversal, teardown);
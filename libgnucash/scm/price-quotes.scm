@@ -393,13 +393,10 @@
       ))
 
   (define (book-add-prices! book prices)
-    (let ((pricedb (gnc-pricedb-get-db book)))
-      (for-each
-       (lambda (price)
-         (when price
-           (gnc-pricedb-add-price pricedb price)
-           (gnc-price-unref price)))
-       prices)))
+    (let ((pricedb (gnc-pricedb-get-db book))
+          (prices (filter identity prices)))
+      (gnc-pricedb-add-prices pricedb prices)
+      (for-each gnc-price-unref prices)))
 
   (define (show-error msg)
     (gnc:gui-error msg (_ msg)))